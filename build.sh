@@ -1 +1,2 @@
-clang++ -g -Wall `sdl2-config --cflags` `sdl2-config --libs` -lSDL2_image -framework OpenGL src/main.cpp -o voxel
+clang++ -g -Wall -pthread `sdl2-config --cflags` `sdl2-config --libs` -lSDL2_image -framework OpenGL src/main.cpp -o voxel
+clang++ -g -O2 -Wall -pthread src/bench.cpp -o voxel_bench
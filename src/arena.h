@@ -0,0 +1,196 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "common.h"
+
+// Sub-allocator for ranges of one big GPU buffer, in elements rather than bytes. Free ranges are
+// kept sorted by offset and merged with their neighbours when freed, allocation takes the first
+// free range that fits. When nothing fits the owner either grows the arena or compacts it, which
+// packs the live ranges to the front in their current order and leaves one free range at the end.
+// Only offsets move here, the owner re-uploads whatever it was storing in a moved range.
+
+typedef struct ArenaRange {
+	u32 offset;
+	u32 count;
+} ArenaRange;
+
+typedef struct ArenaStats {
+	u64 allocs;
+	u64 frees;
+	u64 grows;
+	u64 compactions;
+	// elements the owner has to re-upload after compactions
+	u64 elements_moved;
+} ArenaStats;
+
+typedef struct Arena {
+	u32 capacity;
+	u32 used;
+	ArenaRange *free_ranges;
+	u32 num_free;
+	u32 free_capacity;
+	ArenaStats stats;
+} Arena;
+
+void arena_insert_free(Arena *arena, u32 index, ArenaRange range) {
+	if (arena->num_free == arena->free_capacity) {
+		arena->free_capacity = arena->free_capacity ? arena->free_capacity * 2 : 64;
+		arena->free_ranges = (ArenaRange *)realloc(arena->free_ranges, sizeof(ArenaRange) * arena->free_capacity);
+	}
+	memmove(&arena->free_ranges[index + 1], &arena->free_ranges[index], sizeof(ArenaRange) * (arena->num_free - index));
+	arena->free_ranges[index] = range;
+	arena->num_free++;
+}
+
+void arena_remove_free(Arena *arena, u32 index) {
+	memmove(&arena->free_ranges[index], &arena->free_ranges[index + 1], sizeof(ArenaRange) * (arena->num_free - index - 1));
+	arena->num_free--;
+}
+
+// Returns a range to the free list, merging it with the free ranges on either side
+void arena_free(Arena *arena, ArenaRange range) {
+	if (range.count == 0) {
+		return;
+	}
+
+	u32 i = 0;
+	while (i < arena->num_free && arena->free_ranges[i].offset < range.offset) {
+		i++;
+	}
+
+	ArenaRange *ranges = arena->free_ranges;
+	bool joins_prev = i > 0 && ranges[i - 1].offset + ranges[i - 1].count == range.offset;
+	bool joins_next = i < arena->num_free && range.offset + range.count == ranges[i].offset;
+	if (joins_prev && joins_next) {
+		ranges[i - 1].count += range.count + ranges[i].count;
+		arena_remove_free(arena, i);
+	} else if (joins_prev) {
+		ranges[i - 1].count += range.count;
+	} else if (joins_next) {
+		ranges[i].offset = range.offset;
+		ranges[i].count += range.count;
+	} else {
+		arena_insert_free(arena, i, range);
+	}
+
+	arena->used -= range.count;
+	arena->stats.frees++;
+}
+
+void arena_init(Arena *arena, u32 capacity) {
+	memset(arena, 0, sizeof(Arena));
+	arena->capacity = capacity;
+	ArenaRange all = {0, capacity};
+	arena_insert_free(arena, 0, all);
+}
+
+void arena_destroy(Arena *arena) {
+	free(arena->free_ranges);
+	memset(arena, 0, sizeof(Arena));
+}
+
+// First fit, false when no free range is big enough
+bool arena_alloc(Arena *arena, u32 count, ArenaRange *out) {
+	for (u32 i = 0; i < arena->num_free; i++) {
+		ArenaRange *range = &arena->free_ranges[i];
+		if (range->count < count) {
+			continue;
+		}
+
+		out->offset = range->offset;
+		out->count = count;
+		range->offset += count;
+		range->count -= count;
+		if (range->count == 0) {
+			arena_remove_free(arena, i);
+		}
+
+		arena->used += count;
+		arena->stats.allocs++;
+		return true;
+	}
+	return false;
+}
+
+// Adds [capacity, new_capacity) to the free list
+void arena_grow(Arena *arena, u32 new_capacity) {
+	ArenaRange *last = arena->num_free ? &arena->free_ranges[arena->num_free - 1] : NULL;
+	if (last && last->offset + last->count == arena->capacity) {
+		last->count += new_capacity - arena->capacity;
+	} else {
+		ArenaRange added = {arena->capacity, new_capacity - arena->capacity};
+		arena_insert_free(arena, arena->num_free, added);
+	}
+	arena->capacity = new_capacity;
+	arena->stats.grows++;
+}
+
+u32 arena_largest_free(Arena *arena) {
+	u32 largest = 0;
+	for (u32 i = 0; i < arena->num_free; i++) {
+		largest = arena->free_ranges[i].count > largest ? arena->free_ranges[i].count : largest;
+	}
+	return largest;
+}
+
+// Ranges are reserved a quarter larger than asked so small edits re-upload in place
+u32 arena_padded(u32 count) {
+	return count + count / 4;
+}
+
+// When an allocation of count fails: compacting is worth it once the free space adds up to twice
+// the request, below that the arena is close to full and grows instead
+bool arena_should_compact(Arena *arena, u32 count) {
+	return arena->capacity - arena->used >= count * 2;
+}
+
+u32 arena_grown_capacity(Arena *arena, u32 count) {
+	u32 doubled = arena->capacity * 2;
+	return doubled >= arena->capacity + count ? doubled : arena->capacity + count;
+}
+
+int compare_range_offset(const void *a, const void *b) {
+	u32 x = ((const ArenaRange *)a)->offset;
+	u32 y = ((const ArenaRange *)b)->offset;
+	return (x > y) - (x < y);
+}
+
+// Packs the given live ranges (every range allocated from the arena) to the front, keeping their
+// order. moved[i] is set when live[i] changed offset. Returns how many moved.
+u32 arena_compact(Arena *arena, ArenaRange **live, u32 count, u8 *moved) {
+	// offset and index into live, sorted by offset
+	ArenaRange *order = (ArenaRange *)malloc(sizeof(ArenaRange) * count);
+	for (u32 i = 0; i < count; i++) {
+		order[i].offset = live[i]->offset;
+		order[i].count = i;
+	}
+	qsort(order, count, sizeof(ArenaRange), compare_range_offset);
+
+	u32 offset = 0;
+	u32 num_moved = 0;
+	for (u32 i = 0; i < count; i++) {
+		ArenaRange *range = live[order[i].count];
+		moved[order[i].count] = range->offset != offset;
+		if (range->offset != offset) {
+			range->offset = offset;
+			arena->stats.elements_moved += range->count;
+			num_moved++;
+		}
+		offset += range->count;
+	}
+	free(order);
+
+	arena->num_free = 0;
+	ArenaRange rest = {offset, arena->capacity - offset};
+	if (rest.count) {
+		arena_insert_free(arena, 0, rest);
+	}
+	arena->used = offset;
+	arena->stats.compactions++;
+	return num_moved;
+}
+
+#endif
@@ -0,0 +1,3079 @@
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#define STB_PERLIN_IMPLEMENTATION
+#include "stb_perlin.h"
+
+#include "common.h"
+#include "point.h"
+#include "perlin_simd.h"
+#include "chunk.h"
+#include "jobs.h"
+#include "world.h"
+#include "greedy.h"
+#include "edit.h"
+#include "lighting.h"
+#include "region.h"
+#include "stream.h"
+#include "cache.h"
+#include "frustum.h"
+#include "occlusion.h"
+#include "lod.h"
+#include "arena.h"
+#include "raycast.h"
+#include "snapshot.h"
+#include "svo.h"
+#include "trace.h"
+#include "bench.h"
+
+// Headless driver for the world pipeline, every bench prints a single json object to stdout
+
+void bench_world(int argc, char **argv) {
+	set_world_size(arg_u32(argc, argv, "-x", num_x_chunks), arg_u32(argc, argv, "-y", num_y_chunks));
+	world_seed = arg_u32(argc, argv, "-s", world_seed);
+	u32 iterations = arg_u32(argc, argv, "-n", 5);
+	u32 num_threads = arg_u32(argc, argv, "-t", 1);
+
+	JobSystem *sys = NULL;
+	if (num_threads != 1) {
+		sys = job_system_create(num_threads, num_chunks * 3);
+		num_threads = sys->num_threads;
+	}
+
+	Samples gen_samples = {};
+	Samples hull_samples = {};
+	Samples update_samples = {};
+
+	Chunk **chunks = (Chunk **)malloc(sizeof(Chunk *) * num_chunks);
+	WorldBuildTimes *times = alloc_world_build_times();
+
+	u64 block_load = 0;
+	u64 total_ns = 0;
+	bool matches_serial = true;
+	for (u32 iter = 0; iter < iterations; iter++) {
+		u64 start = get_time_ns();
+		if (sys) {
+			build_world_parallel(sys, chunks, times);
+		} else {
+			build_world(chunks, times);
+		}
+		total_ns += get_time_ns() - start;
+
+		block_load = 0;
+		for (u32 i = 0; i < num_chunks; i++) {
+			samples_push(&gen_samples, (f64)times->generate_ns[i]);
+			samples_push(&hull_samples, (f64)times->hull_ns[i]);
+			samples_push(&update_samples, (f64)times->update_ns[i]);
+			block_load += chunks[i]->num_blocks;
+		}
+
+		if (sys && iter == 0) {
+			Chunk **serial_chunks = (Chunk **)malloc(sizeof(Chunk *) * num_chunks);
+			build_world(serial_chunks, NULL);
+			matches_serial = worlds_match(chunks, serial_chunks);
+			for (u32 i = 0; i < num_chunks; i++) {
+				free_chunk(serial_chunks[i]);
+			}
+			free(serial_chunks);
+		}
+
+		for (u32 i = 0; i < num_chunks; i++) {
+			free_chunk(chunks[i]);
+		}
+	}
+
+	f64 total_s = (f64)total_ns / 1e9;
+	printf("{\"bench\": \"world\", \"num_x_chunks\": %u, \"num_y_chunks\": %u, \"seed\": %u, \"iterations\": %u, \"threads\": %u, ",
+		num_x_chunks, num_y_chunks, world_seed, iterations, num_threads);
+	printf("\"stages\": {");
+	print_samples_json("generate_chunk", &gen_samples);
+	printf(", ");
+	print_samples_json("hull_chunk", &hull_samples);
+	printf(", ");
+	print_samples_json("update_chunk", &update_samples);
+	printf("}, ");
+	printf("\"blocks\": %lu, \"total_ms\": %.3f, \"blocks_per_sec\": %.1f, \"matches_serial\": %s, \"peak_rss_bytes\": %lu}\n",
+		block_load, total_s * 1e3, (f64)(block_load * iterations) / total_s, matches_serial ? "true" : "false", get_peak_rss());
+
+	if (sys) {
+		job_system_destroy(sys);
+	}
+	free_world_build_times(times);
+	free(chunks);
+	samples_free(&gen_samples);
+	samples_free(&hull_samples);
+	samples_free(&update_samples);
+}
+
+// Fills xs/ys/zs with the sample positions generate_chunk uses for octave o over a width x depth region
+void fill_noise_region(f32 *xs, f32 *ys, f32 *zs, u32 width, u32 depth, u8 o) {
+	f32 scale = (f32)(2 << o) * 1.01f;
+	for (u32 z = 0; z < depth; z++) {
+		for (u32 x = 0; x < width; x++) {
+			u32 i = twod_to_oned(x, z, width);
+			xs[i] = (f32)x / scale;
+			ys[i] = (f32)z / scale;
+			zs[i] = o * 2.0f;
+		}
+	}
+}
+
+void bench_noise_region(const char *name, u32 width, u32 depth, u32 iterations) {
+	u32 count = width * depth;
+	f32 *xs = (f32 *)malloc(sizeof(f32) * count);
+	f32 *ys = (f32 *)malloc(sizeof(f32) * count);
+	f32 *zs = (f32 *)malloc(sizeof(f32) * count);
+	f32 *reference = (f32 *)malloc(sizeof(f32) * count);
+	f32 *out = (f32 *)malloc(sizeof(f32) * count);
+
+	f64 scalar_ns = 0.0;
+	PerlinSimdLevel detected = perlin_simd_level;
+
+	printf("\"%s\": {\"samples\": %u", name, count * 3);
+	for (i32 level = PERLIN_SCALAR; level <= (i32)detected; level++) {
+		perlin_simd_level = (PerlinSimdLevel)level;
+
+		u64 ns = 0;
+		f32 max_error = 0.0f;
+		for (u8 o = 5; o < 8; o++) {
+			fill_noise_region(xs, ys, zs, width, depth, o);
+			for (u32 i = 0; i < count; i++) {
+				reference[i] = stb_perlin_noise3(xs[i], ys[i], zs[i], 256, 256, 256);
+			}
+
+			for (u32 iter = 0; iter < iterations; iter++) {
+				u64 start = get_time_ns();
+				if (level == PERLIN_SCALAR) {
+					for (u32 i = 0; i < count; i++) {
+						out[i] = stb_perlin_noise3(xs[i], ys[i], zs[i], 256, 256, 256);
+					}
+				} else {
+					perlin_noise3_batch(xs, ys, zs, out, count, 256, 256, 256);
+				}
+				ns += get_time_ns() - start;
+			}
+
+			for (u32 i = 0; i < count; i++) {
+				f32 error = fabsf(out[i] - reference[i]);
+				if (error > max_error) {
+					max_error = error;
+				}
+			}
+		}
+
+		f64 ns_per_sample = (f64)ns / ((f64)count * 3.0 * iterations);
+		if (level == PERLIN_SCALAR) {
+			scalar_ns = ns_per_sample;
+		}
+
+		printf(", \"%s\": {\"ns_per_sample\": %.3f, \"speedup\": %.2f, \"max_abs_error\": %g, \"within_tolerance\": %s}",
+			perlin_simd_level_names[level], ns_per_sample, scalar_ns / ns_per_sample, max_error,
+			max_error <= PERLIN_SIMD_TOLERANCE ? "true" : "false");
+	}
+	printf("}");
+
+	perlin_simd_level = detected;
+	free(xs);
+	free(ys);
+	free(zs);
+	free(reference);
+	free(out);
+}
+
+void bench_noise(int argc, char **argv) {
+	u32 iterations = arg_u32(argc, argv, "-n", 20);
+
+	printf("{\"bench\": \"noise\", \"detected\": \"%s\", \"tolerance\": %g, ", perlin_simd_level_names[perlin_simd_level], PERLIN_SIMD_TOLERANCE);
+	bench_noise_region("chunk_16x16", chunk_width, chunk_depth, iterations * 100);
+	printf(", ");
+	bench_noise_region("region_1024x1024", 1024, 1024, iterations / 10 + 1);
+	printf("}\n");
+}
+
+void bench_storage(int argc, char **argv) {
+	set_world_size(arg_u32(argc, argv, "-x", num_x_chunks), arg_u32(argc, argv, "-y", num_y_chunks));
+	world_seed = arg_u32(argc, argv, "-s", world_seed);
+	u32 num_ops = arg_u32(argc, argv, "-n", 1000000);
+
+	Chunk **chunks = (Chunk **)malloc(sizeof(Chunk *) * num_chunks);
+	build_world(chunks, NULL);
+
+	// what a chunk held when every buffer was allocated at chunk_size up front
+	u64 eager_bytes = sizeof(Chunk) + (u64)chunk_size * (sizeof(glm::vec3) * 2 + sizeof(u32) + sizeof(u8)) + chunk_width * chunk_depth;
+
+	u64 total_bytes = 0;
+	u64 min_bytes = ~(u64)0;
+	u64 max_bytes = 0;
+	u64 storage_total = 0;
+	u32 bits_histogram[9] = {};
+	for (u32 i = 0; i < num_chunks; i++) {
+		u64 bytes = chunk_bytes(chunks[i]);
+		total_bytes += bytes;
+		storage_total += storage_bytes(chunks[i]->pre_render_list);
+		min_bytes = bytes < min_bytes ? bytes : min_bytes;
+		max_bytes = bytes > max_bytes ? bytes : max_bytes;
+
+		ChunkStorage *storage = chunks[i]->pre_render_list;
+		for (u32 j = 0; j < storage->num_sections; j++) {
+			bits_histogram[storage->sections[j].bits]++;
+		}
+	}
+
+	// random sets and gets against a dense mirror of one chunk
+	ChunkStorage *storage = storage_create(chunk_height, 0);
+	u8 *dense = (u8 *)calloc(chunk_size, 1);
+	srand(world_seed);
+
+	u64 start = get_time_ns();
+	for (u32 i = 0; i < num_ops; i++) {
+		u32 x = rand() % chunk_width;
+		u32 y = rand() % chunk_height;
+		u32 z = rand() % chunk_depth;
+		u8 value = rand() % 12;
+		storage_set(storage, x, y, z, value);
+		dense[threed_to_oned(x, y, z, chunk_width, chunk_height)] = value;
+	}
+	u64 set_ns = get_time_ns() - start;
+
+	bool matches_dense = true;
+	u64 checksum = 0;
+	start = get_time_ns();
+	for (u32 z = 0; z < chunk_depth; z++) {
+		for (u32 y = 0; y < chunk_height; y++) {
+			for (u32 x = 0; x < chunk_width; x++) {
+				u8 value = storage_get(storage, x, y, z);
+				checksum += value;
+				if (value != dense[threed_to_oned(x, y, z, chunk_width, chunk_height)]) {
+					matches_dense = false;
+				}
+			}
+		}
+	}
+	u64 get_ns = get_time_ns() - start;
+
+	storage_compact(storage);
+	for (u32 i = 0; i < chunk_size; i++) {
+		Point p = oned_to_threed(i, chunk_width, chunk_height);
+		if (storage_get(storage, p.x, p.y, p.z) != dense[i]) {
+			matches_dense = false;
+		}
+	}
+
+	printf("{\"bench\": \"storage\", \"num_x_chunks\": %u, \"num_y_chunks\": %u, \"seed\": %u, ", num_x_chunks, num_y_chunks, world_seed);
+	printf("\"bytes_per_chunk_before\": %lu, \"bytes_per_chunk_after\": {\"avg\": %lu, \"min\": %lu, \"max\": %lu}, \"storage_bytes_per_chunk\": %lu, \"reduction\": %.1f, ",
+		eager_bytes, total_bytes / num_chunks, min_bytes, max_bytes, storage_total / num_chunks, (f64)eager_bytes / (f64)(total_bytes / num_chunks));
+	printf("\"sections_by_bits\": {\"uniform\": %u, \"1\": %u, \"2\": %u, \"4\": %u, \"8\": %u}, ",
+		bits_histogram[0], bits_histogram[1], bits_histogram[2], bits_histogram[4], bits_histogram[8]);
+	printf("\"sets_per_sec\": %.1f, \"gets_per_sec\": %.1f, \"checksum\": %lu, \"matches_dense\": %s}\n",
+		(f64)num_ops / ((f64)set_ns / 1e9), (f64)chunk_size / ((f64)get_ns / 1e9), checksum, matches_dense ? "true" : "false");
+
+	storage_free(storage);
+	free(dense);
+	for (u32 i = 0; i < num_chunks; i++) {
+		free_chunk(chunks[i]);
+	}
+	free(chunks);
+}
+
+// Decodes every packed instance the way obj_vert.vsh does and checks it against update_chunk's vec3 output
+void bench_instances(int argc, char **argv) {
+	set_world_size(arg_u32(argc, argv, "-x", num_x_chunks), arg_u32(argc, argv, "-y", num_y_chunks));
+	world_seed = arg_u32(argc, argv, "-s", world_seed);
+
+	Chunk **chunks = (Chunk **)malloc(sizeof(Chunk *) * num_chunks);
+	build_world(chunks, NULL);
+
+	u64 num_instances = 0;
+	u64 mismatches = 0;
+	for (u32 i = 0; i < num_chunks; i++) {
+		Chunk *chunk = chunks[i];
+		for (u64 j = 0; j < chunk->num_blocks; j++) {
+			glm::vec3 position;
+			glm::vec3 color;
+			unpack_instance(chunk, chunk->instances[j], &position, &color);
+			if (position != chunk->positions[j] || color != chunk->colors[j]) {
+				mismatches++;
+			}
+		}
+		num_instances += chunk->num_blocks;
+	}
+
+	u64 vec3_bytes = num_instances * sizeof(glm::vec3) * 2;
+	u64 packed_bytes = num_instances * sizeof(u32);
+	printf("{\"bench\": \"instances\", \"num_x_chunks\": %u, \"num_y_chunks\": %u, \"seed\": %u, \"instances\": %lu, ",
+		num_x_chunks, num_y_chunks, world_seed, num_instances);
+	printf("\"vec3_bytes_per_frame\": %lu, \"packed_bytes_per_frame\": %lu, \"reduction\": %.1f, \"mismatches\": %lu}\n",
+		vec3_bytes, packed_bytes, (f64)vec3_bytes / (f64)packed_bytes, mismatches);
+
+	for (u32 i = 0; i < num_chunks; i++) {
+		free_chunk(chunks[i]);
+	}
+	free(chunks);
+}
+
+// Exposed unit faces of an instanced cube, worked out from world coordinates rather than the apron.
+// Nothing shows past the edge of the world or under its floor.
+u32 count_exposed_faces(Chunk **chunks, glm::vec3 position) {
+	u32 wx = (u32)position.x;
+	u32 y = (u32)position.y;
+	u32 wz = (u32)position.z;
+	u32 world_width = num_x_chunks * chunk_width;
+	u32 world_depth = num_y_chunks * chunk_depth;
+
+	u32 faces = 0;
+	Chunk *chunk = chunks[twod_to_oned(wx / chunk_width, wz / chunk_depth, num_x_chunks)];
+	if (y + 1 == chunk_height || !voxel_solid(chunk, wx % chunk_width, y + 1, wz % chunk_depth)) {
+		faces++;
+	}
+	if (y > 0 && !voxel_solid(chunk, wx % chunk_width, y - 1, wz % chunk_depth)) {
+		faces++;
+	}
+
+	i32 offsets[4][2] = {{1, 0}, {-1, 0}, {0, 1}, {0, -1}};
+	for (u32 i = 0; i < 4; i++) {
+		i32 nx = (i32)wx + offsets[i][0];
+		i32 nz = (i32)wz + offsets[i][1];
+		if (nx < 0 || nz < 0 || nx >= (i32)world_width || nz >= (i32)world_depth) {
+			continue;
+		}
+
+		Chunk *other_chunk = chunks[twod_to_oned(nx / chunk_width, nz / chunk_depth, num_x_chunks)];
+		if (!voxel_solid(other_chunk, nx % chunk_width, y, nz % chunk_depth)) {
+			faces++;
+		}
+	}
+	return faces;
+}
+
+// Compares the greedy meshes against the instanced cubes: triangles drawn and surface covered
+void bench_mesh(int argc, char **argv) {
+	set_world_size(arg_u32(argc, argv, "-x", num_x_chunks), arg_u32(argc, argv, "-y", num_y_chunks));
+	world_seed = arg_u32(argc, argv, "-s", world_seed);
+
+	Chunk **chunks = (Chunk **)malloc(sizeof(Chunk *) * num_chunks);
+	build_world(chunks, NULL);
+
+	Samples mesh_samples = {};
+	u64 greedy_tris = 0;
+	u64 greedy_area = 0;
+	u64 greedy_bytes = 0;
+	for (u32 i = 0; i < num_chunks; i++) {
+		u64 start = get_time_ns();
+		build_chunk_mesh(chunks[i]);
+		samples_push(&mesh_samples, (f64)(get_time_ns() - start));
+
+		ChunkMesh *mesh = chunks[i]->mesh;
+		greedy_tris += mesh->num_indices / 3;
+		greedy_area += mesh->area;
+		greedy_bytes += sizeof(MeshVertex) * mesh->num_vertices + sizeof(u32) * mesh->num_indices;
+	}
+
+	u64 instances = 0;
+	u64 exposed_faces = 0;
+	for (u32 i = 0; i < num_chunks; i++) {
+		for (u64 j = 0; j < chunks[i]->num_blocks; j++) {
+			exposed_faces += count_exposed_faces(chunks, chunks[i]->positions[j]);
+		}
+		instances += chunks[i]->num_blocks;
+	}
+
+	printf("{\"bench\": \"mesh\", \"num_x_chunks\": %u, \"num_y_chunks\": %u, \"seed\": %u, ", num_x_chunks, num_y_chunks, world_seed);
+	printf("\"instanced\": {\"triangles\": %lu, \"faces\": %lu, \"exposed_faces\": %lu, \"bytes\": %lu}, ",
+		instances * 12, instances * 6, exposed_faces, instances * sizeof(u32));
+	printf("\"greedy\": {\"triangles\": %lu, \"area\": %lu, \"bytes\": %lu, ", greedy_tris, greedy_area, greedy_bytes);
+	print_samples_json("build_chunk_mesh", &mesh_samples);
+	printf("}, \"triangle_reduction\": %.2f, \"area_matches\": %s}\n",
+		(f64)(instances * 12) / (f64)greedy_tris, greedy_area == exposed_faces ? "true" : "false");
+
+	for (u32 i = 0; i < num_chunks; i++) {
+		free_chunk(chunks[i]);
+	}
+	free(chunks);
+	samples_free(&mesh_samples);
+}
+
+int compare_u32(const void *a, const void *b) {
+	u32 x = *(const u32 *)a;
+	u32 y = *(const u32 *)b;
+	return (x > y) - (x < y);
+}
+
+typedef struct InstanceAo {
+	u32 instance;
+	u8 ao[AO_FACES];
+} InstanceAo;
+
+int compare_instance_ao(const void *a, const void *b) {
+	return compare_u32(&((const InstanceAo *)a)->instance, &((const InstanceAo *)b)->instance);
+}
+
+// The chunk's instances with their ambient occlusion, sorted by instance
+InstanceAo *sorted_instance_ao(Chunk *chunk) {
+	InstanceAo *sorted = (InstanceAo *)malloc(sizeof(InstanceAo) * (chunk->num_blocks + 1));
+	for (u64 j = 0; j < chunk->num_blocks; j++) {
+		sorted[j].instance = chunk->instances[j];
+		memcpy(sorted[j].ao, &chunk->ao_bits[AO_FACES * j], AO_FACES);
+	}
+	qsort(sorted, chunk->num_blocks, sizeof(InstanceAo), compare_instance_ao);
+	return sorted;
+}
+
+// Random single block edits through set_block / remove_block, checked against rebuilding the whole world
+void bench_edit(int argc, char **argv) {
+	set_world_size(arg_u32(argc, argv, "-x", num_x_chunks), arg_u32(argc, argv, "-y", num_y_chunks));
+	world_seed = arg_u32(argc, argv, "-s", world_seed);
+	u32 num_edits = arg_u32(argc, argv, "-n", 100000);
+
+	Chunk **chunks = (Chunk **)malloc(sizeof(Chunk *) * num_chunks);
+	build_world(chunks, NULL);
+
+	// what the same edit costs when the chunk is rehulled and re-instanced whole
+	Samples full_samples = {};
+	u64 full_bytes = 0;
+	for (u32 i = 0; i < num_chunks; i++) {
+		u64 start = get_time_ns();
+		hull_chunk(chunks[i]);
+		update_chunk(chunks[i]);
+		samples_push(&full_samples, (f64)(get_time_ns() - start));
+		full_bytes += chunks[i]->num_blocks * (sizeof(u32) + AO_FACES * 2);
+	}
+
+	u32 world_width = num_x_chunks * chunk_width;
+	u32 world_depth = num_y_chunks * chunk_depth;
+	srand(world_seed);
+
+	EditStats stats = {};
+	Samples edit_samples = {};
+	u32 rejected = 0;
+	u64 start = get_time_ns();
+	for (u32 i = 0; i < num_edits; i++) {
+		u32 wx = rand() % world_width;
+		u32 wz = rand() % world_depth;
+		u32 height = *column_height(chunks, wx, wz);
+		bool place = (rand() & 1) && height < chunk_height - 2;
+
+		u64 edit_start = get_time_ns();
+		bool applied = place ? set_block(chunks, wx, height + 1, wz, &stats) : remove_block(chunks, wx, height, wz, &stats);
+		samples_push(&edit_samples, (f64)(get_time_ns() - edit_start));
+		if (!applied) {
+			rejected++;
+		}
+	}
+	u64 edit_ns = get_time_ns() - start;
+
+	// rebuild the edited columns from scratch, instance order differs so they are compared sorted
+	Chunk **reference = (Chunk **)malloc(sizeof(Chunk *) * num_chunks);
+	for (u32 i = 0; i < num_chunks; i++) {
+		Point cp = oned_to_twod(i, num_x_chunks);
+		reference[i] = generate_chunk(cp.x, cp.y);
+		memcpy(reference[i]->real_blocks, chunks[i]->real_blocks, chunk_width * chunk_depth);
+		memcpy(reference[i]->occupancy, chunks[i]->occupancy, sizeof(OccupancyColumn) * chunk_width * chunk_depth);
+	}
+	// every link first, ambient occlusion reads the diagonal chunks through the neighbours' links
+	for (u32 i = 0; i < num_chunks; i++) {
+		link_chunk(reference, i);
+	}
+	for (u32 i = 0; i < num_chunks; i++) {
+		hull_chunk(reference[i]);
+		update_chunk(reference[i]);
+	}
+
+	bool matches_rebuild = true;
+	for (u32 i = 0; i < num_chunks && matches_rebuild; i++) {
+		Chunk *a = chunks[i];
+		Chunk *b = reference[i];
+		if (a->num_blocks != b->num_blocks || !storage_equal(a->pre_render_list, b->pre_render_list)) {
+			matches_rebuild = false;
+			break;
+		}
+
+		// ambient occlusion included, so the diagonal columns must have been re-instanced too
+		InstanceAo *sorted_a = sorted_instance_ao(a);
+		InstanceAo *sorted_b = sorted_instance_ao(b);
+		for (u64 j = 0; j < a->num_blocks && matches_rebuild; j++) {
+			matches_rebuild = sorted_a[j].instance == sorted_b[j].instance && !memcmp(sorted_a[j].ao, sorted_b[j].ao, AO_FACES);
+		}
+		free(sorted_a);
+		free(sorted_b);
+	}
+
+	printf("{\"bench\": \"edit\", \"num_x_chunks\": %u, \"num_y_chunks\": %u, \"seed\": %u, \"edits\": %u, \"rejected\": %u, ",
+		num_x_chunks, num_y_chunks, world_seed, num_edits, rejected);
+	printf("\"edits_per_sec\": %.1f, ", (f64)num_edits / ((f64)edit_ns / 1e9));
+	print_samples_json("edit", &edit_samples);
+	printf(", \"columns_rehulled_per_edit\": %.2f, \"columns_reshaded_per_edit\": %.2f, \"chunks_touched_per_edit\": %.3f, \"remeshed_bytes\": %lu, \"remeshed_bytes_per_edit\": %.1f, ",
+		(f64)stats.columns_rehulled / (f64)stats.edits, (f64)stats.columns_reshaded / (f64)stats.edits, (f64)stats.chunks_touched / (f64)stats.edits,
+		stats.bytes_remeshed, (f64)stats.bytes_remeshed / (f64)stats.edits);
+	print_samples_json("full_chunk_rebuild", &full_samples);
+	printf(", \"full_chunk_bytes\": %lu, \"matches_rebuild\": %s}\n", full_bytes / num_chunks, matches_rebuild ? "true" : "false");
+
+	for (u32 i = 0; i < num_chunks; i++) {
+		free_chunk(chunks[i]);
+		free_chunk(reference[i]);
+	}
+	free(chunks);
+	free(reference);
+	samples_free(&edit_samples);
+	samples_free(&full_samples);
+}
+
+// Flies laps of a circle through a streamed world. Every lap covers the same terrain, so after the
+// first lap the loaded chunk bytes and peak RSS should not grow any further.
+void bench_stream(int argc, char **argv) {
+	world_seed = arg_u32(argc, argv, "-s", world_seed);
+	u32 radius = arg_u32(argc, argv, "-r", 4);
+	u32 keep_radius = arg_u32(argc, argv, "-k", radius + 2);
+	u32 num_frames = arg_u32(argc, argv, "-n", 4000);
+	u32 speed = arg_u32(argc, argv, "-v", 2);
+	u32 path_radius = arg_u32(argc, argv, "-p", 20) * chunk_width;
+	u32 hulls_per_update = arg_u32(argc, argv, "-b", 4);
+	u32 num_threads = arg_u32(argc, argv, "-t", 0);
+	const char *dir = arg_str(argc, argv, "-d", NULL);
+
+	JobSystem *sys = job_system_create(num_threads, 64);
+	ChunkStream *stream = stream_create(sys, radius, keep_radius, 16, hulls_per_update);
+	if (dir) {
+		stream->store = region_store_open(dir);
+	}
+
+	glm::vec3 camera_pos = glm::vec3(path_radius, chunk_height + 3.0, 0.0);
+	u64 start = get_time_ns();
+	stream_fill(stream, camera_pos);
+	u64 fill_ns = get_time_ns() - start;
+	u64 pool_bytes_first = 0;
+
+	u32 lap_frames = (u32)(2.0 * M_PI * path_radius / speed);
+	Samples update_samples = {};
+	u64 peak_bytes_first = 0;
+	u64 peak_bytes_later = 0;
+	u32 peak_loaded = 0;
+	u64 rss_first = 0;
+	u32 incomplete_frames = 0;
+	for (u32 frame = 0; frame < num_frames; frame++) {
+		f32 angle = (f32)frame * speed / path_radius;
+		camera_pos.x = cosf(angle) * path_radius;
+		camera_pos.z = sinf(angle) * path_radius;
+
+		u64 update_start = get_time_ns();
+		stream_update(stream, camera_pos);
+		samples_push(&update_samples, (f64)(get_time_ns() - update_start));
+
+		if (!stream_complete(stream)) {
+			incomplete_frames++;
+		}
+
+		u64 bytes = stream_bytes(stream);
+		u32 loaded = stream_loaded_chunks(stream);
+		peak_loaded = loaded > peak_loaded ? loaded : peak_loaded;
+		if (frame < lap_frames) {
+			peak_bytes_first = bytes > peak_bytes_first ? bytes : peak_bytes_first;
+		} else {
+			peak_bytes_later = bytes > peak_bytes_later ? bytes : peak_bytes_later;
+		}
+		if (frame == lap_frames) {
+			rss_first = get_peak_rss();
+			pool_bytes_first = chunk_pool_stats().bytes_reserved;
+		}
+	}
+	u64 rss_end = get_peak_rss();
+	// region files are read through mmap, so once chunks come back from disk their pages count too
+	u64 mapped_bytes = 0;
+	for (u32 i = 0; stream->store && i < stream->store->num_regions; i++) {
+		mapped_bytes += stream->store->regions[i].map_size;
+	}
+
+	// once the camera stops everything within radius has to finish loading
+	for (u32 i = 0; i < 10000 && !stream_complete(stream); i++) {
+		stream_update(stream, camera_pos);
+	}
+	bool complete = stream_complete(stream);
+
+	u32 window = stream->keep_radius * 2 + 1;
+	bool memory_flat = num_frames > lap_frames * 2 && peak_loaded <= window * window &&
+		peak_bytes_later <= peak_bytes_first + peak_bytes_first / 20 && rss_end <= rss_first + rss_first / 20 + mapped_bytes &&
+		chunk_pool_stats().bytes_reserved == pool_bytes_first;
+
+	printf("{\"bench\": \"stream\", \"seed\": %u, \"radius\": %u, \"keep_radius\": %u, \"frames\": %u, \"lap_frames\": %u, \"blocks_per_frame\": %u, \"threads\": %u, ",
+		world_seed, radius, stream->keep_radius, num_frames, lap_frames, speed, sys->num_threads);
+	printf("\"initial_fill_ms\": %.3f, ", (f64)fill_ns / 1e6);
+	print_samples_json("stream_update", &update_samples);
+	printf(", \"generated\": %lu, \"hulled\": %lu, \"evicted\": %lu, \"incomplete_frames\": %u, \"peak_loaded_chunks\": %u, ",
+		stream->stats.generated, stream->stats.hulled, stream->stats.evicted, incomplete_frames, peak_loaded);
+	printf("\"peak_chunk_bytes\": {\"first_lap\": %lu, \"later_laps\": %lu}, \"peak_rss\": {\"first_lap\": %lu, \"end\": %lu}, ",
+		peak_bytes_first, peak_bytes_later, rss_first, rss_end);
+	if (stream->store) {
+		printf("\"region\": {\"chunks_loaded\": %lu, \"chunks_saved\": %lu, \"mapped_bytes\": %lu}, ",
+			stream->store->stats.chunks_loaded, stream->store->stats.chunks_saved, mapped_bytes);
+	}
+	PoolStats pool = chunk_pool_stats();
+	printf("\"chunk_pool\": {\"live\": %u, \"high_water\": %u, \"capacity\": %u, \"blocks\": %u, \"bytes_reserved\": {\"first_lap\": %lu, \"end\": %lu}, \"takes\": %lu}, ",
+		pool.live, pool.high_water, pool.capacity, pool.blocks, pool_bytes_first, pool.bytes_reserved, pool.takes);
+	printf("\"memory_flat\": %s, \"complete\": %s}\n", memory_flat ? "true" : "false", complete ? "true" : "false");
+
+	RegionStore *store = stream->store;
+	stream_destroy(stream);
+	if (store) {
+		region_store_close(store);
+	}
+	job_system_destroy(sys);
+	samples_free(&update_samples);
+}
+
+// A chunk edited by bench_cache and its encoding right after the last edit
+typedef struct EditedChunk {
+	i32 cx;
+	i32 cz;
+	u8 *encoded;
+	u32 size;
+	bool loaded;
+} EditedChunk;
+
+// Flies laps of a circle through a streamed world with a chunk cache under a byte budget, placing
+// lamps on raised blocks during the first lap. Reports hit rate, rebuilds caused by eviction and
+// bytes per tier, checks that the loaded and warm chunks fit the budget after every update, and
+// that every edited chunk comes back from the warm tier or the region store exactly as it was left.
+void bench_cache(int argc, char **argv) {
+	world_seed = arg_u32(argc, argv, "-s", world_seed);
+	u32 radius = arg_u32(argc, argv, "-r", 4);
+	u32 keep_radius = arg_u32(argc, argv, "-k", radius + 2);
+	u32 num_frames = arg_u32(argc, argv, "-n", 4000);
+	u32 speed = arg_u32(argc, argv, "-v", 2);
+	u32 path_chunks = arg_u32(argc, argv, "-p", 20);
+	u32 path_radius = path_chunks * chunk_width;
+	u32 num_threads = arg_u32(argc, argv, "-t", 0);
+	// by default room for the ring within radius + 1 and about half a lap of warm chunks, density chunks are larger
+	u64 budget = (u64)arg_u32(argc, argv, "-m", world_terrain == TERRAIN_DENSITY ? 7800 : 6000) * 1024;
+	u32 num_edits = arg_u32(argc, argv, "-e", 64);
+	const char *dir = arg_str(argc, argv, "-d", "bench_cache_regions");
+
+	// start from empty region files, whatever the cache drops cold is read back from them
+	i32 reach = (i32)(path_chunks + keep_radius + 1);
+	for (i32 rz = region_coord(-reach); rz <= region_coord(reach); rz++) {
+		for (i32 rx = region_coord(-reach); rx <= region_coord(reach); rx++) {
+			char path[512];
+			snprintf(path, sizeof(path), "%s/r.%d.%d.vxr", dir, rx, rz);
+			unlink(path);
+		}
+	}
+
+	JobSystem *sys = job_system_create(num_threads, 64);
+	ChunkStream *stream = stream_create(sys, radius, keep_radius, 16, 4);
+	stream->store = region_store_open(dir);
+	stream->cache = cache_create(budget);
+	ChunkCache *cache = stream->cache;
+
+	glm::vec3 camera_pos = glm::vec3(path_radius, chunk_height + 3.0, 0.0);
+	stream_fill(stream, camera_pos);
+
+	u32 lap_frames = (u32)(2.0 * M_PI * path_radius / speed);
+	u32 edit_every = num_edits ? (lap_frames / num_edits > 0 ? lap_frames / num_edits : 1) : 0;
+	EditedChunk *edited = (EditedChunk *)calloc(num_edits ? num_edits : 1, sizeof(EditedChunk));
+	u32 num_edited = 0;
+	u32 edits_made = 0;
+	u32 edit_checks = 0;
+	u32 edit_mismatches = 0;
+
+	Samples update_samples = {};
+	u64 peak_hot = 0;
+	u64 peak_warm = 0;
+	u64 peak_total = 0;
+	u32 budget_violations = 0;
+	u32 over_budget_updates = 0;
+	srand(world_seed);
+	for (u32 frame = 0; frame < num_frames; frame++) {
+		f32 angle = (f32)frame * speed / path_radius;
+		camera_pos.x = cosf(angle) * path_radius;
+		camera_pos.z = sinf(angle) * path_radius;
+
+		u64 update_start = get_time_ns();
+		stream_update(stream, camera_pos);
+		samples_push(&update_samples, (f64)(get_time_ns() - update_start));
+
+		// everything over the budget is counted, the cache's table and cold records included. It is a
+		// violation by the cache unless the chunks within the generated ring need more on their own.
+		u64 hot = stream_bytes(stream);
+		u64 warm = cache->stats.warm_bytes;
+		u64 total = hot + cache_bytes(cache);
+		bool beyond_ring = false;
+		for (u32 i = 0; i < stream->window * stream->window; i++) {
+			StreamSlot *slot = &stream->slots[i];
+			beyond_ring |= (slot->state == SLOT_GENERATED || slot->state == SLOT_READY) &&
+				chunk_ring(slot->cx, slot->cz, stream->centre_x, stream->centre_z) > radius + 1;
+		}
+		if (total > budget && (warm || beyond_ring)) {
+			budget_violations++;
+		}
+		over_budget_updates += total > budget;
+		peak_hot = hot > peak_hot ? hot : peak_hot;
+		peak_warm = warm > peak_warm ? warm : peak_warm;
+		peak_total = total > peak_total ? total : peak_total;
+
+		// every time an edited chunk is loaded again it must encode to what it was left as
+		for (u32 e = 0; e < num_edited; e++) {
+			StreamSlot *slot = stream_find(stream, edited[e].cx, edited[e].cz);
+			bool loaded = slot && slot->state != SLOT_GENERATING;
+			if (loaded && !edited[e].loaded) {
+				u8 *encoded = (u8 *)malloc(chunk_encoding_bound(slot->chunk));
+				u32 encoding;
+				u32 size = encode_chunk(slot->chunk, encoded, &encoding);
+				edit_checks++;
+				edit_mismatches += size != edited[e].size || memcmp(encoded, edited[e].encoded, size) != 0;
+				free(encoded);
+			}
+			edited[e].loaded = loaded;
+		}
+
+		// a lamp on a block raised on a random column of the camera's chunk
+		StreamSlot *camera_slot = stream_find(stream, stream->centre_x, stream->centre_z);
+		if (edit_every && frame < lap_frames && frame % edit_every == 0 && edits_made < num_edits &&
+			camera_slot && camera_slot->state == SLOT_READY) {
+			Chunk *chunk = camera_slot->chunk;
+			u32 x = rand() % chunk_width;
+			u32 z = rand() % chunk_depth;
+			u32 y = chunk->real_blocks[twod_to_oned(x, z, chunk_width)] + 1;
+			if (y < chunk_height && chunk_set_block(chunk, x, y, z, NULL)) {
+				light_set_emitter(&world_light, chunk, x, y, z, 14);
+				light_flush(&world_light);
+				edits_made++;
+
+				u32 e = 0;
+				while (e < num_edited && (edited[e].cx != camera_slot->cx || edited[e].cz != camera_slot->cz)) {
+					e++;
+				}
+				if (e == num_edited) {
+					num_edited++;
+					edited[e].cx = camera_slot->cx;
+					edited[e].cz = camera_slot->cz;
+					edited[e].loaded = true;
+				}
+				free(edited[e].encoded);
+				edited[e].encoded = (u8 *)malloc(chunk_encoding_bound(chunk));
+				u32 encoding;
+				edited[e].size = encode_chunk(chunk, edited[e].encoded, &encoding);
+			}
+		}
+	}
+
+	CacheStats stats = cache->stats;
+	u64 hot_end = stream_bytes(stream);
+	u32 hot_chunks = stream_loaded_chunks(stream);
+	// a budget smaller than the chunks within the generated ring need cannot be kept, that fails too
+	bool within_budget = peak_total <= budget;
+	bool correct = within_budget && budget_violations == 0 && edit_mismatches == 0 && stats.unencodable == 0;
+
+	printf("{\"bench\": \"cache\", \"seed\": %u, \"radius\": %u, \"keep_radius\": %u, \"frames\": %u, \"lap_frames\": %u, \"threads\": %u, \"budget\": %lu, ",
+		world_seed, radius, stream->keep_radius, num_frames, lap_frames, sys->num_threads, budget);
+	print_samples_json("stream_update", &update_samples);
+	printf(", \"hits\": %lu, \"misses\": %lu, \"hit_rate\": %.4f, \"loaded\": %lu, \"region_loads\": %lu, ",
+		stats.hits, stats.misses, cache_hit_rate(cache), stream->stats.generated, stream->store->stats.chunks_loaded);
+	printf("\"rebuilds\": {\"from_warm\": %lu, \"from_cold\": %lu}, \"demoted\": %lu, \"budget_demoted\": %lu, \"dropped\": %lu, ",
+		stats.hits, stats.cold_rebuilds, stats.demoted, stats.budget_demoted, stats.dropped);
+	printf("\"tiers\": {\"hot\": {\"chunks\": %u, \"bytes\": %lu, \"peak_bytes\": %lu, \"bytes_per_chunk\": %.0f}, ",
+		hot_chunks, hot_end, peak_hot, hot_chunks ? (f64)hot_end / hot_chunks : 0.0);
+	printf("\"warm\": {\"chunks\": %u, \"bytes\": %lu, \"peak_bytes\": %lu, \"bytes_per_chunk\": %.0f}, ",
+		stats.warm_chunks, stats.warm_bytes, peak_warm, stats.warm_chunks ? (f64)stats.warm_bytes / stats.warm_chunks : 0.0);
+	printf("\"cold\": {\"chunks\": %u, \"bytes\": %lu}, \"table_bytes\": %lu}, \"peak_total_bytes\": %lu, \"within_budget\": %s, \"over_budget_updates\": %u, ",
+		stats.cold_chunks, stats.cold_bytes, stats.table_bytes, peak_total, within_budget ? "true" : "false", over_budget_updates);
+	printf("\"budget_violations\": %u, \"unsaved_kept\": %lu, ", budget_violations, stats.unsaved_kept);
+	printf("\"edits\": %u, \"edited_chunks\": %u, \"edit_checks\": %u, \"edit_mismatches\": %u, \"correct\": %s}\n",
+		edits_made, num_edited, edit_checks, edit_mismatches, correct ? "true" : "false");
+
+	RegionStore *store = stream->store;
+	stream_destroy(stream);
+	cache_destroy(cache);
+	region_store_close(store);
+	job_system_destroy(sys);
+	for (u32 e = 0; e < num_edited; e++) {
+		free(edited[e].encoded);
+	}
+	free(edited);
+	samples_free(&update_samples);
+}
+
+typedef struct FramesRun {
+	FrameHistogram render_times;
+	FrameHistogram tick_times;
+	u64 ticks;
+	SnapshotStats snapshots;
+	RenderWorldStats proxies;
+	u64 commands_sent;
+	u32 incomplete_frames;
+	u32 proxy_mismatches;
+	u32 proxies_checked;
+	bool complete;
+} FramesRun;
+
+// Whether a proxy holds what its world chunk would draw with
+bool proxy_matches(Chunk *proxy, Chunk *chunk, bool greedy) {
+	u64 count = chunk->num_blocks;
+	if (proxy->num_blocks != count || proxy->y_min != chunk->y_min || proxy->y_max != chunk->y_max || proxy->lod != chunk->lod ||
+		memcmp(proxy->occupancy, chunk->occupancy, sizeof(OccupancyColumn) * chunk_width * chunk_depth) ||
+		memcmp(proxy->instances, chunk->instances, sizeof(u32) * count) ||
+		memcmp(proxy->ao_bits, chunk->ao_bits, AO_FACES * count) || memcmp(proxy->light_bits, chunk->light_bits, AO_FACES * count)) {
+		return false;
+	}
+
+	ChunkMesh *mesh = chunk->lod ? chunk->lod_meshes[chunk->lod] : (greedy ? chunk->mesh : NULL);
+	ChunkMesh *drawn = chunk->lod ? proxy->lod_meshes[chunk->lod] : (greedy ? proxy->mesh : NULL);
+	if (mesh == NULL) {
+		return drawn == NULL || !greedy;
+	}
+	return drawn && drawn->num_vertices == mesh->num_vertices && drawn->num_indices == mesh->num_indices &&
+		!memcmp(drawn->vertices, mesh->vertices, sizeof(MeshVertex) * mesh->num_vertices) &&
+		!memcmp(drawn->indices, mesh->indices, sizeof(u32) * mesh->num_indices);
+}
+
+// Flies a circle with the world ticked either inline before each render frame or on the world
+// thread, while each render frame applies the newest snapshot and frustum and occlusion culls its
+// chunks, then waits out a 60Hz frame. edits_per_frame blocks are placed on top of random columns
+// of the drawn chunks every frame.
+void frames_run(bool threaded, u32 radius, u32 num_frames, u32 speed, u32 edits_per_frame, bool greedy, u32 num_threads, FramesRun *run) {
+	memset(run, 0, sizeof(FramesRun));
+	JobSystem *sys = job_system_create(num_threads, 64);
+	ChunkStream *stream = stream_create(sys, radius, radius + 2, 16, 4);
+	u32 path_radius = 20 * chunk_width;
+	glm::vec3 camera_pos = glm::vec3(path_radius, chunk_height + 3.0, 0.0);
+	glm::vec3 camera_front = glm::vec3(0.0, -0.3, 1.0);
+	stream_fill(stream, camera_pos);
+
+	WorldThread *world = world_thread_create(stream);
+	RenderWorld *rw = render_world_create(stream->window);
+	world_send_camera(world, camera_pos, camera_front, greedy);
+	if (threaded) {
+		world_thread_start(world);
+	}
+
+	u8 *visible = (u8 *)malloc(stream->window * stream->window);
+	AabbList bounds = {};
+	OcclusionBuffer *occlusion_buffer = occlusion_create(24);
+	glm::mat4 perspective = glm::perspective(glm::radians(45.0f), 640.0f / 480.0f, 0.1f, 5000.0f);
+	u64 frame_ns = 16666667;
+
+	srand(world_seed);
+	for (u32 frame = 0; frame < num_frames; frame++) {
+		u64 frame_start = get_time_ns();
+		f32 angle = (f32)frame * speed / path_radius;
+		camera_pos.x = cosf(angle) * path_radius;
+		camera_pos.z = sinf(angle) * path_radius;
+		camera_front = glm::vec3(-sinf(angle), -0.3f, cosf(angle));
+		world_send_camera(world, camera_pos, camera_front, greedy);
+
+		for (u32 e = 0; e < edits_per_frame && rw->num_ready; e++) {
+			Chunk *proxy = rw->ready[rand() % rw->num_ready];
+			u32 x = rand() % chunk_width;
+			u32 z = rand() % chunk_depth;
+			WorldCommand command = {};
+			command.kind = COMMAND_PLACE;
+			command.x = proxy->x_off + (i32)x;
+			command.y = (i32)column_highest(proxy->occupancy[twod_to_oned(x, z, chunk_width)]);
+			command.z = proxy->z_off + (i32)z;
+			command.normal[1] = 1;
+			run->commands_sent += world_send_command(world, command);
+		}
+
+		if (!threaded) {
+			world_tick(world);
+		}
+		WorldSnapshot *snapshot = snapshot_take(&world->exchange);
+		if (snapshot) {
+			render_world_apply(rw, snapshot);
+		}
+
+		glm::mat4 pv = perspective * glm::lookAt(camera_pos, camera_pos + camera_front, glm::vec3(0.0, 1.0, 0.0));
+		aabb_list_clear(&bounds);
+		for (u32 i = 0; i < rw->num_ready; i++) {
+			glm::vec3 min, max;
+			chunk_aabb(rw->ready[i], &min, &max);
+			aabb_list_push(&bounds, min, max);
+		}
+		Frustum frustum = frustum_from_pv(pv);
+		cull_aabbs(&frustum, &bounds, visible);
+		occlusion_cull_chunks(occlusion_buffer, pv, camera_pos, rw->ready, rw->num_ready, visible);
+
+		u64 render_ns = get_time_ns() - frame_start;
+		histogram_push(&run->render_times, render_ns);
+		if (!threaded && !stream_complete(stream)) {
+			run->incomplete_frames++;
+		}
+
+		// what is left of the frame is the swap's wait for vsync
+		if (render_ns < frame_ns) {
+			struct timespec wait = {0, (long)(frame_ns - render_ns)};
+			nanosleep(&wait, NULL);
+		}
+	}
+
+	// the stream is this thread's again, tick until everything within radius is in and check that
+	// the proxies came out of the snapshots exactly as the world chunks are
+	world_thread_stop(world);
+	for (u32 i = 0; i < 10000 && !stream_complete(stream); i++) {
+		world_tick(world);
+	}
+	world_tick(world);
+	run->complete = stream_complete(stream);
+	WorldSnapshot *snapshot = snapshot_take(&world->exchange);
+	if (snapshot) {
+		render_world_apply(rw, snapshot);
+	}
+
+	for (u32 i = 0; i < stream->window * stream->window; i++) {
+		StreamSlot *slot = &stream->slots[i];
+		if (slot->state != SLOT_READY) {
+			continue;
+		}
+		Chunk *proxy = render_world_find(rw, slot->cx, slot->cz);
+		run->proxies_checked++;
+		run->proxy_mismatches += proxy == NULL || !proxy_matches(proxy, slot->chunk, greedy);
+	}
+	run->proxy_mismatches += rw->num_ready != run->proxies_checked;
+
+	run->tick_times = world->tick_times;
+	run->ticks = world->ticks;
+	run->snapshots = world->exchange.stats;
+	run->proxies = rw->stats;
+
+	aabb_list_free(&bounds);
+	occlusion_destroy(occlusion_buffer);
+	free(visible);
+	render_world_destroy(rw);
+	world_thread_destroy(world);
+	stream_destroy(stream);
+	job_system_destroy(sys);
+}
+
+void print_frames_run_json(const char *name, FramesRun *run) {
+	printf("\"%s\": {", name);
+	histogram_print_json("render_frames", &run->render_times);
+	printf(", ");
+	histogram_print_json("world_ticks", &run->tick_times);
+	printf(", \"ticks\": %lu, \"snapshots\": {\"published\": %lu, \"taken\": %lu, \"skipped\": %lu, \"bytes_copied\": %lu}, ",
+		run->ticks, run->snapshots.published, run->snapshots.taken, run->snapshots.skipped, run->snapshots.bytes_copied);
+	printf("\"proxies\": {\"created\": %lu, \"dropped\": %lu, \"updates_applied\": %lu, \"checked\": %u, \"mismatches\": %u}, ",
+		run->proxies.proxies_created, run->proxies.proxies_dropped, run->proxies.updates_applied, run->proxies_checked, run->proxy_mismatches);
+	printf("\"edits_sent\": %lu, \"complete\": %s}", run->commands_sent, run->complete ? "true" : "false");
+}
+
+// Render frame times with the world ticked on the render thread against on the world thread
+// (snapshot.h), under a fast camera and a stream of edits. Checks that after the world settles
+// the render world's proxies match the world chunks in both modes.
+void bench_frames(int argc, char **argv) {
+	world_seed = arg_u32(argc, argv, "-s", world_seed);
+	u32 radius = arg_u32(argc, argv, "-r", 6);
+	u32 num_frames = arg_u32(argc, argv, "-n", 600);
+	u32 speed = arg_u32(argc, argv, "-v", 4);
+	u32 edits_per_frame = arg_u32(argc, argv, "-e", 4);
+	bool greedy = arg_u32(argc, argv, "-g", 1) != 0;
+	u32 num_threads = arg_u32(argc, argv, "-t", 0);
+
+	FramesRun serial;
+	FramesRun threaded;
+	frames_run(false, radius, num_frames, speed, edits_per_frame, greedy, num_threads, &serial);
+	frames_run(true, radius, num_frames, speed, edits_per_frame, greedy, num_threads, &threaded);
+
+	bool correct = serial.proxy_mismatches == 0 && threaded.proxy_mismatches == 0 && serial.complete && threaded.complete;
+	printf("{\"bench\": \"frames\", \"seed\": %u, \"radius\": %u, \"frames\": %u, \"blocks_per_frame\": %u, \"edits_per_frame\": %u, \"greedy\": %s, ",
+		world_seed, radius, num_frames, speed, edits_per_frame, greedy ? "true" : "false");
+	print_frames_run_json("serial", &serial);
+	printf(", ");
+	print_frames_run_json("threaded", &threaded);
+	printf(", \"render_p99_ms\": {\"serial\": %.1f, \"threaded\": %.1f}, \"proxies_match\": %s}\n",
+		histogram_percentile(&serial.render_times, 99.0), histogram_percentile(&threaded.render_times, 99.0), correct ? "true" : "false");
+}
+
+// Saves an x by y chunk world to region files, reopens them and times loading against generate_chunk
+void bench_region(int argc, char **argv) {
+	set_world_size(arg_u32(argc, argv, "-x", REGION_SIZE), arg_u32(argc, argv, "-y", REGION_SIZE));
+	world_seed = arg_u32(argc, argv, "-s", world_seed);
+	const char *dir = arg_str(argc, argv, "-d", "bench_regions");
+
+	// start from empty region files so every chunk is appended once
+	u32 num_rx = region_coord(num_x_chunks - 1) + 1;
+	u32 num_rz = region_coord(num_y_chunks - 1) + 1;
+	for (u32 rz = 0; rz < num_rz; rz++) {
+		for (u32 rx = 0; rx < num_rx; rx++) {
+			char path[512];
+			snprintf(path, sizeof(path), "%s/r.%d.%d.vxr", dir, rx, rz);
+			unlink(path);
+		}
+	}
+
+	Chunk **chunks = (Chunk **)malloc(sizeof(Chunk *) * num_chunks);
+	Samples gen_samples = {};
+	for (u32 i = 0; i < num_chunks; i++) {
+		Point cp = oned_to_twod(i, num_x_chunks);
+		u64 start = get_time_ns();
+		chunks[i] = generate_chunk(cp.x, cp.y);
+		samples_push(&gen_samples, (f64)(get_time_ns() - start));
+	}
+
+	RegionStore *store = region_store_open(dir);
+	Samples save_samples = {};
+	u32 save_failures = 0;
+	for (u32 i = 0; i < num_chunks; i++) {
+		u64 start = get_time_ns();
+		if (!region_save_chunk(store, chunks[i])) {
+			save_failures++;
+		}
+		samples_push(&save_samples, (f64)(get_time_ns() - start));
+	}
+	u64 bytes_saved = store->stats.bytes_saved;
+	region_store_close(store);
+
+	u64 file_bytes = 0;
+	for (u32 rz = 0; rz < num_rz; rz++) {
+		for (u32 rx = 0; rx < num_rx; rx++) {
+			char path[512];
+			snprintf(path, sizeof(path), "%s/r.%d.%d.vxr", dir, rx, rz);
+			struct stat st;
+			if (stat(path, &st) == 0) {
+				file_bytes += st.st_size;
+			}
+		}
+	}
+
+	store = region_store_open(dir);
+	Samples load_samples = {};
+	bool matches_generated = true;
+	for (u32 i = 0; i < num_chunks; i++) {
+		Point cp = oned_to_twod(i, num_x_chunks);
+		u64 start = get_time_ns();
+		Chunk *chunk = load_or_generate_chunk(store, cp.x, cp.y);
+		samples_push(&load_samples, (f64)(get_time_ns() - start));
+
+		if (chunk->unsaved || memcmp(chunk->real_blocks, chunks[i]->real_blocks, chunk_width * chunk_depth) ||
+			memcmp(chunk->occupancy, chunks[i]->occupancy, sizeof(OccupancyColumn) * chunk_width * chunk_depth)) {
+			matches_generated = false;
+		}
+		free_chunk(chunk);
+	}
+	u64 chunks_loaded = store->stats.chunks_loaded;
+	region_store_close(store);
+
+	f64 gen_ms = samples_total(&gen_samples) / 1e6;
+	f64 load_ms = samples_total(&load_samples) / 1e6;
+	printf("{\"bench\": \"region\", \"num_x_chunks\": %u, \"num_y_chunks\": %u, \"seed\": %u, ", num_x_chunks, num_y_chunks, world_seed);
+	print_samples_json("generate_chunk", &gen_samples);
+	printf(", ");
+	print_samples_json("region_save_chunk", &save_samples);
+	printf(", ");
+	print_samples_json("region_load_chunk", &load_samples);
+	printf(", \"load_speedup\": %.2f, \"encoded_bytes_per_chunk\": %.1f, \"raw_bytes_per_chunk\": %u, \"file_bytes\": %lu, ",
+		gen_ms / load_ms, (f64)bytes_saved / (f64)num_chunks, chunk_width * chunk_depth, file_bytes);
+	printf("\"chunks_loaded\": %lu, \"save_failures\": %u, \"matches_generated\": %s}\n",
+		chunks_loaded, save_failures, matches_generated && chunks_loaded == num_chunks ? "true" : "false");
+
+	for (u32 i = 0; i < num_chunks; i++) {
+		free_chunk(chunks[i]);
+	}
+	free(chunks);
+	samples_free(&gen_samples);
+	samples_free(&save_samples);
+	samples_free(&load_samples);
+}
+
+f32 random_f32(f32 min, f32 max) {
+	return min + (max - min) * ((f32)rand() / (f32)RAND_MAX);
+}
+
+glm::mat4 camera_pv(glm::vec3 eye, glm::vec3 front, f32 far) {
+	glm::mat4 perspective = glm::perspective(glm::radians(45.0f), 640.0f / 480.0f, 0.1f, far);
+	return perspective * glm::lookAt(eye, eye + front, glm::vec3(0.0, 1.0, 0.0));
+}
+
+typedef struct CullPose {
+	const char *name;
+	glm::vec3 min;
+	glm::vec3 max;
+	bool visible;
+} CullPose;
+
+// Checks known boxes against a fixed camera, SIMD kernels against the scalar test on random
+// boxes, and how many chunks of a built world the main loop would draw
+void bench_frustum(int argc, char **argv) {
+	set_world_size(arg_u32(argc, argv, "-x", num_x_chunks), arg_u32(argc, argv, "-y", num_y_chunks));
+	world_seed = arg_u32(argc, argv, "-s", world_seed);
+	u32 num_boxes = arg_u32(argc, argv, "-n", 100000);
+	u32 iterations = arg_u32(argc, argv, "-i", 100);
+	srand(world_seed);
+
+	// camera at (0, 50, 0) looking down +z with a far plane at 200
+	Frustum frustum = frustum_from_pv(camera_pv(glm::vec3(0.0, 50.0, 0.0), glm::vec3(0.0, 0.0, 1.0), 200.0f));
+	CullPose poses[] = {
+		{"ahead", glm::vec3(-2, 48, 20), glm::vec3(2, 52, 24), true},
+		{"around_camera", glm::vec3(-1, 49, -1), glm::vec3(1, 51, 1), true},
+		{"crossing_left_plane", glm::vec3(-30, 48, 20), glm::vec3(-8, 52, 24), true},
+		{"behind", glm::vec3(-2, 48, -24), glm::vec3(2, 52, -20), false},
+		{"beyond_far", glm::vec3(-2, 48, 300), glm::vec3(2, 52, 304), false},
+		{"off_right", glm::vec3(100, 48, 20), glm::vec3(104, 52, 24), false},
+		{"above", glm::vec3(-2, 100, 20), glm::vec3(2, 104, 24), false},
+		{"below", glm::vec3(-2, -4, 20), glm::vec3(2, 0, 24), false},
+	};
+	u32 num_poses = ARRAY_SIZE(poses);
+
+	// repeated so the wide kernels and the scalar tail both see every pose
+	AabbList pose_list = {};
+	for (u32 r = 0; r < 3; r++) {
+		for (u32 i = 0; i < num_poses; i++) {
+			aabb_list_push(&pose_list, poses[i].min, poses[i].max);
+		}
+	}
+
+	AabbList boxes = {};
+	for (u32 i = 0; i < num_boxes; i++) {
+		glm::vec3 min = glm::vec3(random_f32(-300, 300), random_f32(-50, 150), random_f32(-300, 300));
+		glm::vec3 size = glm::vec3(random_f32(0, 32), random_f32(0, 64), random_f32(0, 32));
+		aabb_list_push(&boxes, min, min + size);
+	}
+
+	u8 *reference = (u8 *)malloc(num_boxes);
+	u8 *visible = (u8 *)malloc(num_boxes);
+	glm::vec3 front = glm::normalize(glm::vec3(0.6, -0.3, 0.8));
+	Frustum random_frustum = frustum_from_pv(camera_pv(glm::vec3(10.0, 60.0, -20.0), front, 250.0f));
+	for (u32 i = 0; i < num_boxes; i++) {
+		reference[i] = aabb_in_frustum(&random_frustum, boxes.cx[i], boxes.cy[i], boxes.cz[i], boxes.ex[i], boxes.ey[i], boxes.ez[i]);
+	}
+
+	CullSimdLevel detected = cull_simd_level;
+	f64 scalar_ns = 0.0;
+	bool all_match = true;
+
+	printf("{\"bench\": \"frustum\", \"detected\": \"%s\", \"boxes\": %u, ", cull_simd_level_names[detected], num_boxes);
+	printf("\"poses\": {");
+	u8 *pose_visible = (u8 *)malloc(pose_list.count);
+	for (u32 i = 0; i < num_poses; i++) {
+		bool correct = true;
+		for (i32 level = CULL_SCALAR; level <= (i32)detected; level++) {
+			cull_simd_level = (CullSimdLevel)level;
+			cull_aabbs(&frustum, &pose_list, pose_visible);
+			for (u32 r = 0; r < 3; r++) {
+				correct &= pose_visible[r * num_poses + i] == poses[i].visible;
+			}
+		}
+		all_match &= correct;
+		printf("%s\"%s\": {\"expected\": \"%s\", \"correct\": %s}", i ? ", " : "", poses[i].name,
+			poses[i].visible ? "visible" : "culled", correct ? "true" : "false");
+	}
+	printf("}");
+
+	for (i32 level = CULL_SCALAR; level <= (i32)detected; level++) {
+		cull_simd_level = (CullSimdLevel)level;
+
+		u32 num_visible = 0;
+		u64 start = get_time_ns();
+		for (u32 iter = 0; iter < iterations; iter++) {
+			num_visible = cull_aabbs(&random_frustum, &boxes, visible);
+		}
+		f64 ns_per_box = (f64)(get_time_ns() - start) / ((f64)num_boxes * iterations);
+		if (level == CULL_SCALAR) {
+			scalar_ns = ns_per_box;
+		}
+
+		bool matches_scalar = !memcmp(visible, reference, num_boxes);
+		all_match &= matches_scalar;
+		printf(", \"%s\": {\"ns_per_box\": %.3f, \"boxes_per_sec\": %.0f, \"speedup\": %.2f, \"visible\": %u, \"matches_scalar\": %s}",
+			cull_simd_level_names[level], ns_per_box, 1e9 / ns_per_box, scalar_ns / ns_per_box, num_visible,
+			matches_scalar ? "true" : "false");
+	}
+	cull_simd_level = detected;
+
+	// a camera just above the ground in the middle of the world looking along +x, as the main loop would cull it
+	Chunk **chunks = (Chunk **)malloc(sizeof(Chunk *) * num_chunks);
+	build_world(chunks, NULL);
+
+	AabbList chunk_bounds = {};
+	for (u32 i = 0; i < num_chunks; i++) {
+		glm::vec3 min, max;
+		chunk_aabb(chunks[i], &min, &max);
+		aabb_list_push(&chunk_bounds, min, max);
+	}
+
+	u32 eye_x = num_x_chunks * chunk_width / 2;
+	u32 eye_z = num_y_chunks * chunk_depth / 2;
+	glm::vec3 eye = glm::vec3(eye_x, *column_height(chunks, eye_x, eye_z) + 8.0, eye_z);
+	Frustum world_frustum = frustum_from_pv(camera_pv(eye, glm::normalize(glm::vec3(1.0, -0.2, 0.3)), 5000.0f));
+	u8 *chunk_visible = (u8 *)malloc(num_chunks);
+	u32 chunks_drawn = cull_aabbs(&world_frustum, &chunk_bounds, chunk_visible);
+
+	// a culled chunk must not have a single block the frustum could see
+	bool bounds_conservative = true;
+	for (u32 i = 0; i < num_chunks; i++) {
+		if (chunk_visible[i]) {
+			continue;
+		}
+		for (u64 j = 0; j < chunks[i]->num_blocks; j++) {
+			glm::vec3 p = chunks[i]->positions[j];
+			if (aabb_in_frustum(&world_frustum, p.x + 0.5f, p.y + 0.5f, p.z + 0.5f, 0.5f, 0.5f, 0.5f)) {
+				bounds_conservative = false;
+			}
+		}
+	}
+	all_match &= bounds_conservative;
+
+	printf(", \"world\": {\"num_x_chunks\": %u, \"num_y_chunks\": %u, \"seed\": %u, \"chunks_drawn\": %u, \"chunks_culled\": %u, \"bounds_conservative\": %s}",
+		num_x_chunks, num_y_chunks, world_seed, chunks_drawn, num_chunks - chunks_drawn, bounds_conservative ? "true" : "false");
+	printf(", \"correct\": %s}\n", all_match ? "true" : "false");
+
+	for (u32 i = 0; i < num_chunks; i++) {
+		free_chunk(chunks[i]);
+	}
+	free(chunks);
+	free(chunk_visible);
+	free(pose_visible);
+	free(reference);
+	free(visible);
+	aabb_list_free(&chunk_bounds);
+	aabb_list_free(&pose_list);
+	aabb_list_free(&boxes);
+}
+
+// Exact test of whether the segment from eye to target passes below the terrain surface, walking
+// the columns it crosses. Columns outside the world are empty.
+bool heightfield_segment_blocked(Chunk **chunks, glm::vec3 eye, glm::vec3 target) {
+	glm::vec3 d = target - eye;
+	i32 cx = (i32)floorf(eye.x);
+	i32 cz = (i32)floorf(eye.z);
+	i32 end_x = (i32)floorf(target.x);
+	i32 end_z = (i32)floorf(target.z);
+	i32 step_x = d.x > 0.0f ? 1 : -1;
+	i32 step_z = d.z > 0.0f ? 1 : -1;
+
+	// t where the segment crosses the next column boundary on each axis
+	f32 t_max_x = d.x != 0.0f ? ((f32)(cx + (step_x > 0)) - eye.x) / d.x : FLT_MAX;
+	f32 t_max_z = d.z != 0.0f ? ((f32)(cz + (step_z > 0)) - eye.z) / d.z : FLT_MAX;
+	f32 t_delta_x = d.x != 0.0f ? fabsf(1.0f / d.x) : FLT_MAX;
+	f32 t_delta_z = d.z != 0.0f ? fabsf(1.0f / d.z) : FLT_MAX;
+
+	f32 t_enter = 0.0f;
+	for (;;) {
+		f32 t_exit = fminf(fminf(t_max_x, t_max_z), 1.0f);
+		u8 *height = cx >= 0 && cz >= 0 ? column_height(chunks, cx, cz) : NULL;
+		if (height) {
+			f32 lowest = fminf(eye.y + d.y * t_enter, eye.y + d.y * t_exit);
+			if (lowest < *height + 1.0f) {
+				return true;
+			}
+		}
+
+		if ((cx == end_x && cz == end_z) || t_exit >= 1.0f) {
+			return false;
+		}
+
+		t_enter = t_exit;
+		if (t_max_x < t_max_z) {
+			cx += step_x;
+			t_max_x += t_delta_x;
+		} else {
+			cz += step_z;
+			t_max_z += t_delta_z;
+		}
+	}
+}
+
+// A wall in front of a fixed camera, then random low camera poses over a built world where every
+// occluded chunk is checked for a column top inside the frustum that the eye can actually see
+void bench_occlusion(int argc, char **argv) {
+	set_world_size(arg_u32(argc, argv, "-x", 24), arg_u32(argc, argv, "-y", 24));
+	world_seed = arg_u32(argc, argv, "-s", world_seed);
+	u32 num_poses = arg_u32(argc, argv, "-n", 64);
+	u32 max_occluders = arg_u32(argc, argv, "-o", 24);
+	srand(world_seed);
+
+	OcclusionBuffer *buf = occlusion_create(max_occluders);
+
+	// camera at (0, 50, 0) looking down +z at a wall 10 blocks ahead
+	occlusion_begin(buf, camera_pv(glm::vec3(0.0, 50.0, 0.0), glm::vec3(0.0, 0.0, 1.0), 200.0f));
+	occlusion_draw_box(buf, glm::vec3(-3, 0, 10), glm::vec3(3, 52, 12));
+	occlusion_finish(buf);
+
+	CullPose poses[] = {
+		{"behind_wall", glm::vec3(-2, 40, 30), glm::vec3(2, 45, 34), false},
+		{"wall_itself", glm::vec3(-3, 0, 10), glm::vec3(3, 52, 12), true},
+		{"in_front_of_wall", glm::vec3(-1, 49, 5), glm::vec3(1, 51, 7), true},
+		{"peeking_over_wall", glm::vec3(-2, 55, 40), glm::vec3(2, 60, 44), true},
+		{"beside_wall", glm::vec3(12, 45, 30), glm::vec3(14, 48, 34), true},
+		{"around_camera", glm::vec3(-1, 49, -1), glm::vec3(1, 51, 1), true},
+	};
+	u32 num_cull_poses = ARRAY_SIZE(poses);
+
+	bool all_correct = true;
+	printf("{\"bench\": \"occlusion\", \"buffer\": \"%ux%u\", \"poses\": {", OCCLUSION_WIDTH, OCCLUSION_HEIGHT);
+	for (u32 i = 0; i < num_cull_poses; i++) {
+		bool correct = occlusion_test_box(buf, poses[i].min, poses[i].max) == poses[i].visible;
+		all_correct &= correct;
+		printf("%s\"%s\": {\"expected\": \"%s\", \"correct\": %s}", i ? ", " : "", poses[i].name,
+			poses[i].visible ? "visible" : "occluded", correct ? "true" : "false");
+	}
+	printf("}");
+
+	Chunk **chunks = (Chunk **)malloc(sizeof(Chunk *) * num_chunks);
+	build_world(chunks, NULL);
+
+	AabbList chunk_bounds = {};
+	for (u32 i = 0; i < num_chunks; i++) {
+		glm::vec3 min, max;
+		chunk_aabb(chunks[i], &min, &max);
+		aabb_list_push(&chunk_bounds, min, max);
+	}
+
+	u8 *in_frustum = (u8 *)malloc(num_chunks);
+	u8 *visible = (u8 *)malloc(num_chunks);
+	u8 *first_visible = (u8 *)malloc(num_chunks);
+	glm::mat4 first_pv;
+	glm::vec3 first_eye;
+
+	Samples cull_samples = {};
+	u64 frustum_visible = 0;
+	u64 occluded = 0;
+	u64 occluders_drawn = 0;
+	u32 false_occlusions = 0;
+	u32 world_width = num_x_chunks * chunk_width;
+	u32 world_depth = num_y_chunks * chunk_depth;
+	for (u32 p = 0; p < num_poses; p++) {
+		// a couple of chunks in from the edge so the camera looks over terrain
+		u32 wx = 2 * chunk_width + rand() % (world_width - 4 * chunk_width);
+		u32 wz = 2 * chunk_depth + rand() % (world_depth - 4 * chunk_depth);
+		glm::vec3 eye = glm::vec3(wx + 0.5f, *column_height(chunks, wx, wz) + random_f32(2.0f, 6.0f), wz + 0.5f);
+		f32 yaw = random_f32(0.0f, 360.0f);
+		f32 pitch = random_f32(-15.0f, 5.0f);
+		glm::vec3 front = glm::vec3(cos(glm::radians(yaw)) * cos(glm::radians(pitch)), sin(glm::radians(pitch)), sin(glm::radians(yaw)) * cos(glm::radians(pitch)));
+		glm::mat4 pv = camera_pv(eye, front, 5000.0f);
+
+		Frustum frustum = frustum_from_pv(pv);
+		frustum_visible += cull_aabbs(&frustum, &chunk_bounds, in_frustum);
+		memcpy(visible, in_frustum, num_chunks);
+
+		occluded += occlusion_cull_chunks(buf, pv, eye, chunks, num_chunks, visible);
+		occluders_drawn += buf->stats.occluders_drawn;
+		samples_push(&cull_samples, (f64)buf->stats.cull_ns);
+
+		if (p == 0) {
+			memcpy(first_visible, visible, num_chunks);
+			first_pv = pv;
+			first_eye = eye;
+		}
+
+		for (u32 i = 0; i < num_chunks; i++) {
+			if (!in_frustum[i] || visible[i]) {
+				continue;
+			}
+
+			Chunk *chunk = chunks[i];
+			for (u32 c = 0; c < chunk_width * chunk_depth; c++) {
+				Point cp = oned_to_twod(c, chunk_width);
+				glm::vec3 top = glm::vec3(chunk->x_off + cp.x + 0.5f, chunk->real_blocks[c] + 1.0f, chunk->z_off + cp.y + 0.5f);
+				if (aabb_in_frustum(&frustum, top.x, top.y, top.z, 0.0f, 0.0f, 0.0f) && !heightfield_segment_blocked(chunks, eye, top)) {
+					false_occlusions++;
+					break;
+				}
+			}
+		}
+	}
+
+	// the same pose again has to give the same answer
+	Frustum frustum = frustum_from_pv(first_pv);
+	cull_aabbs(&frustum, &chunk_bounds, visible);
+	occlusion_cull_chunks(buf, first_pv, first_eye, chunks, num_chunks, visible);
+	bool deterministic = !memcmp(visible, first_visible, num_chunks);
+
+	printf(", \"world\": {\"num_x_chunks\": %u, \"num_y_chunks\": %u, \"seed\": %u, \"camera_poses\": %u, \"max_occluder_chunks\": %u, ",
+		num_x_chunks, num_y_chunks, world_seed, num_poses, max_occluders);
+	printf("\"chunks_in_frustum\": %.1f, \"chunks_occluded\": %.1f, \"occlusion_rate\": %.3f, \"occluders_drawn\": %.1f, ",
+		(f64)frustum_visible / num_poses, (f64)occluded / num_poses, (f64)occluded / (f64)frustum_visible, (f64)occluders_drawn / num_poses);
+	print_samples_json("occlusion_cull", &cull_samples);
+	printf(", \"false_occlusions\": %u, \"deterministic\": %s}", false_occlusions, deterministic ? "true" : "false");
+	printf(", \"correct\": %s}\n", all_correct && false_occlusions == 0 && deterministic ? "true" : "false");
+
+	for (u32 i = 0; i < num_chunks; i++) {
+		free_chunk(chunks[i]);
+	}
+	free(chunks);
+	free(in_frustum);
+	free(visible);
+	free(first_visible);
+	aabb_list_free(&chunk_bounds);
+	samples_free(&cull_samples);
+	occlusion_destroy(buf);
+}
+
+ChunkMesh *mesh_at_level(Chunk *chunk, u32 level) {
+	return level == 0 ? chunk->mesh : chunk->lod_meshes[level];
+}
+
+// Height of the top a chunk drawn at level shows over column (x, z)
+u32 level_top(Chunk *chunk, u32 level, u32 x, u32 z) {
+	u32 size = lod_cell_size(level);
+	return lod_cell_height(chunk, x / size * size, z / size * size, size);
+}
+
+// Whether voxel y of column (x, z) is solid as a chunk drawn at level shows it, coarse levels fill
+// everything under their top
+bool level_solid(Chunk *chunk, u32 level, u32 x, u32 z, u32 y) {
+	return level ? y <= level_top(chunk, level, x, z) : voxel_solid(chunk, x, y, z);
+}
+
+// Marks the unit y steps covered by the mesh's walls in the plane where coordinate axis equals
+// plane, over the unit segment starting at segment along the other horizontal axis
+void mark_walls(ChunkMesh *mesh, u32 axis, u32 plane, u32 segment, u8 *covered) {
+	u32 other = axis == 0 ? 2 : 0;
+	for (u32 q = 0; q < mesh->num_vertices; q += 4) {
+		MeshVertex *v = &mesh->vertices[q];
+		u16 coords[4][3];
+		bool in_plane = true;
+		for (u32 c = 0; c < 4; c++) {
+			coords[c][0] = v[c].x;
+			coords[c][1] = v[c].y;
+			coords[c][2] = v[c].z;
+			in_plane &= coords[c][axis] == plane;
+		}
+		if (!in_plane) {
+			continue;
+		}
+
+		u32 lo = coords[0][other], hi = coords[0][other], y_lo = coords[0][1], y_hi = coords[0][1];
+		for (u32 c = 1; c < 4; c++) {
+			lo = coords[c][other] < lo ? coords[c][other] : lo;
+			hi = coords[c][other] > hi ? coords[c][other] : hi;
+			y_lo = coords[c][1] < y_lo ? coords[c][1] : y_lo;
+			y_hi = coords[c][1] > y_hi ? coords[c][1] : y_hi;
+		}
+		if (lo <= segment && segment + 1 <= hi) {
+			for (u32 y = y_lo; y < y_hi; y++) {
+				covered[y] = 1;
+			}
+		}
+	}
+}
+
+// Builds every level for a world and reports triangles and build time per level, checks that no
+// pair of neighbouring chunks leaves a gap along their border whatever levels they are drawn at,
+// and that lod_select does not flicker while the camera hovers around a switch distance
+void bench_lod(int argc, char **argv) {
+	set_world_size(arg_u32(argc, argv, "-x", num_x_chunks), arg_u32(argc, argv, "-y", num_y_chunks));
+	world_seed = arg_u32(argc, argv, "-s", world_seed);
+
+	Chunk **chunks = (Chunk **)malloc(sizeof(Chunk *) * num_chunks);
+	build_world(chunks, NULL);
+
+	u64 instanced_tris = 0;
+	for (u32 i = 0; i < num_chunks; i++) {
+		instanced_tris += chunks[i]->num_blocks * 12;
+	}
+
+	printf("{\"bench\": \"lod\", \"num_x_chunks\": %u, \"num_y_chunks\": %u, \"seed\": %u, \"instanced_triangles\": %lu, \"levels\": {",
+		num_x_chunks, num_y_chunks, world_seed, instanced_tris);
+	for (u32 level = 0; level < LOD_LEVELS; level++) {
+		Samples build_samples = {};
+		u64 tris = 0;
+		u64 bytes = 0;
+		u64 height_error = 0;
+		for (u32 i = 0; i < num_chunks; i++) {
+			u64 start = get_time_ns();
+			if (level == 0) {
+				build_chunk_mesh(chunks[i]);
+			} else {
+				build_lod_mesh(chunks[i], level);
+			}
+			samples_push(&build_samples, (f64)(get_time_ns() - start));
+
+			ChunkMesh *mesh = mesh_at_level(chunks[i], level);
+			tris += mesh->num_indices / 3;
+			bytes += sizeof(MeshVertex) * mesh->num_vertices + sizeof(u32) * mesh->num_indices;
+			for (u32 c = 0; c < chunk_width * chunk_depth; c++) {
+				Point cp = oned_to_twod(c, chunk_width);
+				height_error += level_top(chunks[i], level, cp.x, cp.y) - chunks[i]->real_blocks[c];
+			}
+		}
+
+		printf("%s\"%u\": {\"block_size\": %u, \"triangles\": %lu, \"bytes\": %lu, \"mean_height_error\": %.2f, ", level ? ", " : "",
+			level, lod_cell_size(level), tris, bytes, (f64)height_error / (f64)(num_chunks * chunk_width * chunk_depth));
+		print_samples_json(level ? "build_lod_mesh" : "build_chunk_mesh", &build_samples);
+		printf("}");
+		samples_free(&build_samples);
+	}
+	printf("}");
+
+	// every border segment between two chunks at any pair of levels: the walls on either side have
+	// to close the step between the two tops, wherever the taller side is solid
+	u8 *covered = (u8 *)malloc(chunk_height + 2);
+	u64 segments_checked = 0;
+	u64 gaps = 0;
+	for (u32 i = 0; i < num_chunks; i++) {
+		ChunkSide sides[2] = {SIDE_POS_X, SIDE_POS_Z};
+		for (u32 s = 0; s < 2; s++) {
+			ChunkSide side = sides[s];
+			Chunk *a = chunks[i];
+			Chunk *b = a->neighbours[side];
+			if (b == NULL) {
+				continue;
+			}
+
+			u32 axis = side == SIDE_POS_X ? 0 : 2;
+			u32 a_plane = axis == 0 ? chunk_width : chunk_depth;
+			u32 length = axis == 0 ? chunk_depth : chunk_width;
+			for (u32 la = 0; la < LOD_LEVELS; la++) {
+				for (u32 lb = 0; lb < LOD_LEVELS; lb++) {
+					for (u32 segment = 0; segment < length; segment++) {
+						u32 a_top = axis == 0 ? level_top(a, la, chunk_width - 1, segment) : level_top(a, la, segment, chunk_depth - 1);
+						u32 b_top = axis == 0 ? level_top(b, lb, 0, segment) : level_top(b, lb, segment, 0);
+
+						memset(covered, 0, chunk_height + 2);
+						mark_walls(mesh_at_level(a, la), axis, a_plane, segment, covered);
+						mark_walls(mesh_at_level(b, lb), axis, 0, segment, covered);
+
+						u32 low = a_top < b_top ? a_top : b_top;
+						u32 high = a_top > b_top ? a_top : b_top;
+						bool a_taller = a_top > b_top;
+						u32 tx = axis == 0 ? (a_taller ? chunk_width - 1 : 0) : segment;
+						u32 tz = axis == 0 ? segment : (a_taller ? chunk_depth - 1 : 0);
+						for (u32 y = low + 1; y < high + 1; y++) {
+							if (!covered[y] && level_solid(a_taller ? a : b, a_taller ? la : lb, tx, tz, y)) {
+								gaps++;
+								break;
+							}
+						}
+						segments_checked++;
+					}
+				}
+			}
+		}
+	}
+
+	// out past the last level and back, then hovering 4 blocks either side of every switch distance
+	u32 sweep_switches = 0;
+	u8 level = 0;
+	for (f32 d = 0.0f; d < lod_distances[LOD_LEVELS - 1] * 1.5f; d += 0.5f) {
+		u8 next = lod_select(level, d);
+		sweep_switches += next != level;
+		level = next;
+	}
+	for (f32 d = lod_distances[LOD_LEVELS - 1] * 1.5f; d >= 0.0f; d -= 0.5f) {
+		u8 next = lod_select(level, d);
+		sweep_switches += next != level;
+		level = next;
+	}
+
+	u32 hover_switches = 0;
+	for (u32 l = 1; l < LOD_LEVELS; l++) {
+		level = lod_select(0, lod_distances[l] + 4.0f);
+		for (u32 step = 0; step < 100; step++) {
+			u8 next = lod_select(level, lod_distances[l] + ((step & 1) ? 4.0f : -4.0f));
+			hover_switches += next != level;
+			level = next;
+		}
+	}
+
+	printf(", \"border_segments_checked\": %lu, \"gaps\": %lu, \"sweep_switches\": %u, \"hover_switches\": %u, \"correct\": %s}\n",
+		segments_checked, gaps, sweep_switches, hover_switches,
+		gaps == 0 && sweep_switches == 2 * (LOD_LEVELS - 1) && hover_switches == 0 ? "true" : "false");
+
+	for (u32 i = 0; i < num_chunks; i++) {
+		free_chunk(chunks[i]);
+	}
+	free(chunks);
+	free(covered);
+}
+
+// Same policy as renderer_reserve in render.h, minus the GL. buffer stands in for the gpu copy.
+bool bench_reserve(Arena *arena, u32 count, ArenaRange *range, ArenaRange **live, u32 *stamps, u32 num_live, u32 **buffer) {
+	if (count <= range->count) {
+		return false;
+	}
+
+	arena_free(arena, *range);
+	range->count = 0;
+
+	u32 padded = arena_padded(count);
+	if (arena_alloc(arena, padded, range)) {
+		return true;
+	}
+
+	if (arena_should_compact(arena, padded)) {
+		u8 *moved = (u8 *)malloc(num_live);
+		arena_compact(arena, live, num_live, moved);
+		// moved ranges re-upload from the CPU copy
+		for (u32 i = 0; i < num_live; i++) {
+			for (u32 e = 0; moved[i] && e < live[i]->count; e++) {
+				(*buffer)[live[i]->offset + e] = stamps[i];
+			}
+		}
+		free(moved);
+		if (arena_alloc(arena, padded, range)) {
+			return true;
+		}
+	}
+
+	arena_grow(arena, arena_grown_capacity(arena, padded));
+	*buffer = (u32 *)realloc(*buffer, sizeof(u32) * arena->capacity);
+	arena_alloc(arena, padded, range);
+	return true;
+}
+
+// Live ranges in bounds and disjoint, the free list sorted, merged and disjoint from them, and
+// every range still holding what its owner last wrote
+bool arena_consistent(Arena *arena, ArenaRange **live, u32 *stamps, u32 num_live, u32 *buffer) {
+	ArenaRange *ranges = (ArenaRange *)malloc(sizeof(ArenaRange) * (num_live + arena->num_free));
+	u32 count = 0;
+	u64 used = 0;
+	bool ok = true;
+	for (u32 i = 0; i < num_live; i++) {
+		if (live[i]->count == 0) {
+			continue;
+		}
+		ranges[count++] = *live[i];
+		used += live[i]->count;
+		for (u32 e = 0; e < live[i]->count; e++) {
+			ok &= buffer[live[i]->offset + e] == stamps[i];
+		}
+	}
+
+	u64 free_total = 0;
+	for (u32 i = 0; i < arena->num_free; i++) {
+		ArenaRange *range = &arena->free_ranges[i];
+		ok &= range->count > 0;
+		if (i > 0) {
+			ArenaRange *prev = &arena->free_ranges[i - 1];
+			ok &= prev->offset + prev->count < range->offset;
+		}
+		ranges[count++] = *range;
+		free_total += range->count;
+	}
+
+	qsort(ranges, count, sizeof(ArenaRange), compare_range_offset);
+	u64 end = 0;
+	for (u32 i = 0; i < count; i++) {
+		ok &= ranges[i].offset >= end;
+		end = (u64)ranges[i].offset + ranges[i].count;
+	}
+	ok &= end <= arena->capacity;
+	ok &= used == arena->used && used + free_total == arena->capacity;
+
+	free(ranges);
+	return ok;
+}
+
+// Streams chunks with real instance counts through an instance arena the way the renderer does:
+// chunks leave and new ones arrive, resident chunks get edited and grow or shrink a little
+void bench_arena(int argc, char **argv) {
+	set_world_size(arg_u32(argc, argv, "-x", num_x_chunks), arg_u32(argc, argv, "-y", num_y_chunks));
+	world_seed = arg_u32(argc, argv, "-s", world_seed);
+	u32 num_ops = arg_u32(argc, argv, "-n", 200000);
+	u32 resident = arg_u32(argc, argv, "-r", 81);
+	srand(world_seed);
+
+	Chunk **chunks = (Chunk **)malloc(sizeof(Chunk *) * num_chunks);
+	build_world(chunks, NULL);
+	u32 *sizes = (u32 *)malloc(sizeof(u32) * num_chunks);
+	u64 total_size = 0;
+	for (u32 i = 0; i < num_chunks; i++) {
+		sizes[i] = (u32)chunks[i]->num_blocks;
+		total_size += sizes[i];
+		free_chunk(chunks[i]);
+	}
+	free(chunks);
+
+	// starts at half of what the resident set needs so the first loads have to grow it
+	Arena arena;
+	arena_init(&arena, (u32)(total_size / num_chunks * resident / 2));
+	u32 *buffer = (u32 *)malloc(sizeof(u32) * arena.capacity);
+
+	ArenaRange *ranges = (ArenaRange *)calloc(resident, sizeof(ArenaRange));
+	ArenaRange **live = (ArenaRange **)malloc(sizeof(ArenaRange *) * resident);
+	u32 *counts = (u32 *)malloc(sizeof(u32) * resident);
+	u32 *stamps = (u32 *)malloc(sizeof(u32) * resident);
+	for (u32 i = 0; i < resident; i++) {
+		live[i] = &ranges[i];
+	}
+
+	Samples reserve_samples = {};
+	u32 next_stamp = 1;
+	u32 uploads_in_place = 0;
+	u32 failed_checks = 0;
+	u32 checks = 0;
+	f64 worst_fragmentation = 0.0;
+	for (u32 op = 0; op < num_ops + resident; op++) {
+		// the first resident ops fill every slot, then slots are reloaded or edited at random
+		u32 slot = op < resident ? op : (u32)(rand() % resident);
+		bool load = op < resident || rand() % 4 == 0;
+		if (load) {
+			arena_free(&arena, ranges[slot]);
+			ranges[slot].count = 0;
+			counts[slot] = sizes[rand() % num_chunks];
+		} else {
+			i32 delta = (rand() % 65) - 32;
+			counts[slot] = (u32)((i32)counts[slot] + delta > 0 ? (i32)counts[slot] + delta : 0);
+		}
+
+		u64 compactions = arena.stats.compactions;
+		u64 start = get_time_ns();
+		bool moved = bench_reserve(&arena, counts[slot], &ranges[slot], live, stamps, resident, &buffer);
+		samples_push(&reserve_samples, (f64)(get_time_ns() - start));
+		uploads_in_place += !moved;
+
+		// the upload, the stamp changes so stale contents show up in the check
+		stamps[slot] = next_stamp++;
+		for (u32 e = 0; e < ranges[slot].count; e++) {
+			buffer[ranges[slot].offset + e] = stamps[slot];
+		}
+
+		u32 free_total = arena.capacity - arena.used;
+		if (op >= resident && free_total) {
+			f64 fragmentation = 1.0 - (f64)arena_largest_free(&arena) / (f64)free_total;
+			worst_fragmentation = fragmentation > worst_fragmentation ? fragmentation : worst_fragmentation;
+		}
+		// always right after a compaction, before later uploads hide a range left stale
+		if (arena.stats.compactions != compactions || op % 97 == 0 || op == num_ops + resident - 1) {
+			failed_checks += !arena_consistent(&arena, live, stamps, resident, buffer);
+			checks++;
+		}
+	}
+
+	ArenaStats churn_stats = arena.stats;
+	u32 churn_capacity = arena.capacity;
+
+	// compacting everything by hand leaves the live ranges back to back in their old order
+	u8 *moved = (u8 *)malloc(resident);
+	ArenaRange *before = (ArenaRange *)malloc(sizeof(ArenaRange) * resident);
+	memcpy(before, ranges, sizeof(ArenaRange) * resident);
+	arena_compact(&arena, live, resident, moved);
+	bool packed = arena.num_free <= 1 && arena_largest_free(&arena) == arena.capacity - arena.used;
+	for (u32 i = 0; i < resident; i++) {
+		packed &= (moved[i] != 0) == (before[i].offset != ranges[i].offset) || ranges[i].count == 0;
+		for (u32 j = 0; j < resident; j++) {
+			if (ranges[i].count && ranges[j].count && before[i].offset < before[j].offset) {
+				packed &= ranges[i].offset < ranges[j].offset;
+			}
+		}
+	}
+
+	printf("{\"bench\": \"arena\", \"num_x_chunks\": %u, \"num_y_chunks\": %u, \"seed\": %u, \"resident_chunks\": %u, \"ops\": %u, ",
+		num_x_chunks, num_y_chunks, world_seed, resident, num_ops);
+	print_samples_json("reserve", &reserve_samples);
+	printf(", \"uploads_in_place\": %u, \"allocs\": %lu, \"frees\": %lu, \"grows\": %lu, \"compactions\": %lu, \"elements_moved\": %lu, ",
+		uploads_in_place, churn_stats.allocs, churn_stats.frees, churn_stats.grows, churn_stats.compactions, churn_stats.elements_moved);
+	printf("\"final_capacity\": %u, \"live_elements\": %u, \"worst_fragmentation\": %.3f, ",
+		churn_capacity, arena.used, worst_fragmentation);
+	printf("\"checks\": %u, \"failed_checks\": %u, \"compaction_packed\": %s, \"correct\": %s}\n",
+		checks, failed_checks, packed ? "true" : "false", failed_checks == 0 && packed ? "true" : "false");
+
+	arena_destroy(&arena);
+	samples_free(&reserve_samples);
+	free(sizes);
+	free(buffer);
+	free(ranges);
+	free(live);
+	free(counts);
+	free(stamps);
+	free(moved);
+	free(before);
+}
+
+// hull_chunk as it was before the apron pass: interior columns write walls into their taller
+// neighbours, border columns only check the neighbour chunk. Kept as bench_hull's baseline.
+void legacy_hull_chunk(Chunk *chunk) {
+	storage_clear(chunk->pre_render_list, 0);
+
+	for (u64 i = 0; i < chunk_width * chunk_depth; i++) {
+		Point p = oned_to_twod(i, chunk_width);
+
+		if (p.x > 0 && p.x < (chunk_width - 1) && p.y > 0 && p.y < (chunk_depth - 1)) {
+			//B
+			if (chunk->real_blocks[i] + 1 < chunk->real_blocks[twod_to_oned(p.x - 1, p.y, chunk_width)]) {
+				for (u32 dy = chunk->real_blocks[i] + 1; dy < chunk->real_blocks[twod_to_oned(p.x - 1, p.y, chunk_width)]; dy++) {
+					storage_set(chunk->pre_render_list, p.x - 1, dy, p.y, 3);
+				}
+			}
+			//GB
+			if (chunk->real_blocks[i] + 1 < chunk->real_blocks[twod_to_oned(p.x + 1, p.y, chunk_width)]) {
+				for (u32 dy = chunk->real_blocks[i] + 1; dy < chunk->real_blocks[twod_to_oned(p.x + 1, p.y, chunk_width)]; dy++) {
+					storage_set(chunk->pre_render_list, p.x + 1, dy, p.y, 2);
+				}
+			}
+			//RB
+			if (chunk->real_blocks[i] + 1 < chunk->real_blocks[twod_to_oned(p.x, p.y + 1, chunk_width)]) {
+				for (u32 dy = chunk->real_blocks[i] + 1; dy < chunk->real_blocks[twod_to_oned(p.x, p.y + 1, chunk_width)]; dy++) {
+					storage_set(chunk->pre_render_list, p.x, dy, p.y + 1, 4);
+				}
+			}
+			//R
+			if (chunk->real_blocks[i] + 1 < chunk->real_blocks[twod_to_oned(p.x, p.y - 1, chunk_width)]) {
+				for (u32 dy = chunk->real_blocks[i] + 1; dy < chunk->real_blocks[twod_to_oned(p.x, p.y - 1, chunk_width)]; dy++) {
+					storage_set(chunk->pre_render_list, p.x, dy, p.y - 1, 5);
+				}
+			}
+		} else {
+			if (p.x == chunk_width - 1 && chunk->neighbours[SIDE_POS_X]) {
+				Chunk *other_chunk = chunk->neighbours[SIDE_POS_X];
+				if (chunk->real_blocks[i] > other_chunk->real_blocks[twod_to_oned(0, p.y, chunk_width)] + 1) {
+					for (u32 dy = chunk->real_blocks[i]; dy > other_chunk->real_blocks[twod_to_oned(0, p.y, chunk_width)]; dy--) {
+						storage_set(chunk->pre_render_list, p.x, dy, p.y, 6);
+					}
+				}
+			}
+			if (p.x == 0 && chunk->neighbours[SIDE_NEG_X]) {
+				Chunk *other_chunk = chunk->neighbours[SIDE_NEG_X];
+				if (chunk->real_blocks[i] > other_chunk->real_blocks[twod_to_oned(chunk_width - 1, p.y, chunk_width)] + 1) {
+					for (u32 dy = chunk->real_blocks[i]; dy > other_chunk->real_blocks[twod_to_oned(chunk_width - 1, p.y, chunk_width)]; dy--) {
+						storage_set(chunk->pre_render_list, p.x, dy, p.y, 7);
+					}
+				}
+			}
+			if (p.y == chunk_width - 1 && chunk->neighbours[SIDE_POS_Z]) {
+				Chunk *other_chunk = chunk->neighbours[SIDE_POS_Z];
+				if (chunk->real_blocks[i] > other_chunk->real_blocks[twod_to_oned(p.x, 0, chunk_width)] + 1) {
+					for (u32 dy = chunk->real_blocks[i]; dy > other_chunk->real_blocks[twod_to_oned(p.x, 0, chunk_width)]; dy--) {
+						storage_set(chunk->pre_render_list, p.x, dy, p.y, 8);
+					}
+				}
+			}
+			if (p.y == 0 && chunk->neighbours[SIDE_NEG_Z]) {
+				Chunk *other_chunk = chunk->neighbours[SIDE_NEG_Z];
+				if (chunk->real_blocks[i] > other_chunk->real_blocks[twod_to_oned(p.x, chunk_depth - 1, chunk_width)] + 1) {
+					for (u32 dy = chunk->real_blocks[i]; dy > other_chunk->real_blocks[twod_to_oned(p.x, chunk_depth - 1, chunk_width)]; dy--) {
+						storage_set(chunk->pre_render_list, p.x, dy, p.y, 9);
+					}
+				}
+			}
+
+		}
+
+		storage_set(chunk->pre_render_list, p.x, chunk->real_blocks[i], p.y, 1);
+	}
+
+	storage_compact(chunk->pre_render_list);
+}
+
+// The column beside (x, z) on side, found through the neighbour pointers rather than the apron.
+// Past the edge of the world the column counts as its own neighbour.
+Chunk *chunk_beside(Chunk *chunk, i32 x, i32 z, u32 side, u32 *bx, u32 *bz) {
+	i32 dx = side == SIDE_POS_X ? 1 : (side == SIDE_NEG_X ? -1 : 0);
+	i32 dz = side == SIDE_POS_Z ? 1 : (side == SIDE_NEG_Z ? -1 : 0);
+	i32 nx = x + dx;
+	i32 nz = z + dz;
+	Chunk *other = chunk;
+	if (nx < 0 || nx >= (i32)chunk_width || nz < 0 || nz >= (i32)chunk_depth) {
+		other = chunk->neighbours[side];
+		nx = positive_mod(nx, chunk_width);
+		nz = positive_mod(nz, chunk_depth);
+	}
+	if (other == NULL) {
+		*bx = x;
+		*bz = z;
+		return chunk;
+	}
+	*bx = nx;
+	*bz = nz;
+	return other;
+}
+
+u32 column_beside(Chunk *chunk, i32 x, i32 z, u32 side) {
+	u32 bx;
+	u32 bz;
+	Chunk *other = chunk_beside(chunk, x, z, side, &bx, &bz);
+	return other->real_blocks[twod_to_oned(bx, bz, chunk_width)];
+}
+
+// Times the apron hull against the old two path one, then checks every column of the world: a
+// block is in the hull exactly when the voxel above, below or beside it is empty, whichever chunk
+// that voxel is in. The old hull only knows heightmaps, legacy_missing and legacy_extra compare it
+// against the heights.
+void bench_hull(int argc, char **argv) {
+	set_world_size(arg_u32(argc, argv, "-x", num_x_chunks), arg_u32(argc, argv, "-y", num_y_chunks));
+	world_seed = arg_u32(argc, argv, "-s", world_seed);
+	u32 iterations = arg_u32(argc, argv, "-n", 20);
+
+	Chunk **chunks = (Chunk **)malloc(sizeof(Chunk *) * num_chunks);
+	build_world(chunks, NULL);
+
+	Samples legacy_samples = {};
+	Samples apron_samples = {};
+	u64 legacy_missing = 0;
+	u64 legacy_extra = 0;
+	u64 wrong = 0;
+	u64 hull_blocks = 0;
+	u64 border_walls = 0;
+	for (u32 iter = 0; iter < iterations; iter++) {
+		for (u32 i = 0; i < num_chunks; i++) {
+			u64 start = get_time_ns();
+			legacy_hull_chunk(chunks[i]);
+			samples_push(&legacy_samples, (f64)(get_time_ns() - start));
+
+			if (iter == 0) {
+				for (u32 c = 0; c < chunk_width * chunk_depth; c++) {
+					Point cp = oned_to_twod(c, chunk_width);
+					u32 height = chunks[i]->real_blocks[c];
+					u32 lowest = height;
+					for (u32 side = 0; side < 4; side++) {
+						u32 beside = column_beside(chunks[i], cp.x, cp.y, side);
+						lowest = beside < lowest ? beside : lowest;
+					}
+					for (u32 y = 0; y < chunk_height; y++) {
+						bool expected = y == height || (y < height && y > lowest);
+						bool present = storage_get(chunks[i]->pre_render_list, cp.x, y, cp.y) != 0;
+						legacy_missing += expected && !present;
+						legacy_extra += present && !expected;
+					}
+				}
+			}
+
+			start = get_time_ns();
+			hull_chunk(chunks[i]);
+			samples_push(&apron_samples, (f64)(get_time_ns() - start));
+		}
+	}
+
+	for (u32 i = 0; i < num_chunks; i++) {
+		for (u32 c = 0; c < chunk_width * chunk_depth; c++) {
+			Point cp = oned_to_twod(c, chunk_width);
+			for (u32 y = 0; y < chunk_height; y++) {
+				u8 tile = storage_get(chunks[i]->pre_render_list, cp.x, y, cp.y);
+				u8 expected = 0;
+				if (voxel_solid(chunks[i], cp.x, y, cp.y)) {
+					if (y + 1 == chunk_height || !voxel_solid(chunks[i], cp.x, y + 1, cp.y)) {
+						expected = 1;
+					}
+					// the first side in hull_wall_order with an empty voxel beside y
+					for (u32 w = 0; w < 4 && expected == 0; w++) {
+						ChunkSide side = hull_wall_order[w];
+						u32 bx;
+						u32 bz;
+						Chunk *other = chunk_beside(chunks[i], cp.x, cp.y, side, &bx, &bz);
+						if (!voxel_solid(other, bx, y, bz)) {
+							bool across = other != chunks[i];
+							expected = hull_wall_tiles[side][across];
+							border_walls += across;
+						}
+					}
+					if (expected == 0 && y > 0 && !voxel_solid(chunks[i], cp.x, y - 1, cp.y)) {
+						expected = HULL_BOTTOM_TILE;
+					}
+				}
+				wrong += tile != expected;
+				hull_blocks += tile != 0;
+			}
+		}
+	}
+
+	f64 legacy_p50 = samples_percentile(&legacy_samples, 50.0);
+	f64 apron_p50 = samples_percentile(&apron_samples, 50.0);
+	printf("{\"bench\": \"hull\", \"num_x_chunks\": %u, \"num_y_chunks\": %u, \"seed\": %u, \"iterations\": %u, ",
+		num_x_chunks, num_y_chunks, world_seed, iterations);
+	print_samples_json("legacy_hull_chunk", &legacy_samples);
+	printf(", ");
+	print_samples_json("hull_chunk", &apron_samples);
+	printf(", \"speedup_p50\": %.2f, \"hull_blocks\": %lu, \"border_wall_blocks\": %lu, \"legacy_missing\": %lu, \"legacy_extra\": %lu, \"wrong\": %lu, \"correct\": %s}\n",
+		legacy_p50 / apron_p50, hull_blocks, border_walls, legacy_missing, legacy_extra, wrong, wrong == 0 ? "true" : "false");
+
+	for (u32 i = 0; i < num_chunks; i++) {
+		free_chunk(chunks[i]);
+	}
+	free(chunks);
+	samples_free(&legacy_samples);
+	samples_free(&apron_samples);
+}
+
+// update_chunk as it was before the occupancy bits: every voxel of every non-empty section of
+// pre_render_list is read back to find the hull. Kept as bench_occupancy's baseline.
+void legacy_update_chunk(Chunk *chunk) {
+	ChunkStorage *storage = chunk->pre_render_list;
+
+	u32 tile_index = 0;
+	u32 y_min = chunk_height;
+	u32 y_max = 0;
+	for (u32 z = 0; z < chunk_depth; z++) {
+		for (u32 s = 0; s < storage->num_sections; s++) {
+			Section *section = &storage->sections[s];
+			if (section->bits == 0 && section->value == 0) {
+				continue;
+			}
+
+			for (u32 sy = 0; sy < SECTION_SIZE; sy++) {
+				for (u32 x = 0; x < chunk_width; x++) {
+					u8 tile_id = section_get(section, section_index(x, sy, z));
+					if (tile_id == 0) {
+						continue;
+					}
+
+					u32 y = s * SECTION_SIZE + sy;
+					y_min = y < y_min ? y : y_min;
+					y_max = y > y_max ? y : y_max;
+
+					reserve_instances(chunk, tile_index + 1);
+					chunk->colors[tile_index] = tile_colors[tile_id];
+					chunk->instances[tile_index] = pack_instance(x, y, z, tile_id);
+					chunk->positions[tile_index] = glm::vec3((i32)x + chunk->x_off, y, (i32)z + chunk->z_off);
+					tile_index++;
+				}
+			}
+		}
+	}
+
+	chunk->num_blocks = tile_index;
+	chunk->y_min = y_min;
+	chunk->y_max = y_max;
+	chunk->dirty = true;
+}
+
+// update_chunk without the ambient occlusion and light it bakes into the instances, so the occupancy
+// path is timed like for like against legacy_update_chunk, which only instances the hull
+void unshaded_update_chunk(Chunk *chunk) {
+	OccupancyColumn solid[(SECTION_SIZE + 2) * (SECTION_SIZE + 2)];
+	fill_occupancy_apron(chunk, solid);
+
+	u64 tile_index = 0;
+	u32 y_min = chunk_height;
+	u32 y_max = 0;
+	for (u32 z = 0; z < chunk_depth; z++) {
+		for (u32 x = 0; x < chunk_width; x++) {
+			OccupancyColumn faces[HULL_FACES];
+			u8 tiles[HULL_FACES];
+			OccupancyColumn hull = hull_column_faces(solid, x, z, faces, tiles);
+			u32 count = column_count(hull);
+			if (count == 0) {
+				continue;
+			}
+
+			u32 lowest = column_lowest(hull);
+			u32 highest = column_highest(hull);
+			y_min = lowest < y_min ? lowest : y_min;
+			y_max = highest > y_max ? highest : y_max;
+
+			reserve_instances(chunk, tile_index + count);
+			for (u32 k = 0; k < OCCUPANCY_WORDS; k++) {
+				if (hull.words[k] == 0) {
+					continue;
+				}
+
+				for (u32 f = 0; f < HULL_FACES; f++) {
+					u64 word = faces[f].words[k];
+					while (word) {
+						u32 y = k * 64 + __builtin_ctzll(word);
+						word &= word - 1;
+
+						chunk->colors[tile_index] = tile_colors[tiles[f]];
+						chunk->instances[tile_index] = pack_instance(x, y, z, tiles[f]);
+						chunk->positions[tile_index] = glm::vec3((i32)x + chunk->x_off, y, (i32)z + chunk->z_off);
+						tile_index++;
+					}
+				}
+			}
+		}
+	}
+
+	chunk->num_blocks = tile_index;
+	chunk->y_min = y_min;
+	chunk->y_max = y_max;
+	chunk->dirty = true;
+}
+
+// Times the occupancy path of update_chunk, without the shading it bakes in since, against the
+// old walk over pre_render_list and reports the whole update_chunk and what its shading adds on
+// its own. Checks that both give every chunk the same set of instances, positions and colours and
+// the same bounds.
+void bench_occupancy(int argc, char **argv) {
+	set_world_size(arg_u32(argc, argv, "-x", num_x_chunks), arg_u32(argc, argv, "-y", num_y_chunks));
+	world_seed = arg_u32(argc, argv, "-s", world_seed);
+	u32 iterations = arg_u32(argc, argv, "-n", 20);
+
+	Chunk **chunks = (Chunk **)malloc(sizeof(Chunk *) * num_chunks);
+	build_world(chunks, NULL);
+
+	Samples legacy_samples = {};
+	Samples bits_samples = {};
+	Samples shaded_samples = {};
+	u64 hull_blocks = 0;
+	u32 mismatched_chunks = 0;
+	u32 *expected = (u32 *)malloc(sizeof(u32) * chunk_size);
+	for (u32 iter = 0; iter < iterations; iter++) {
+		for (u32 i = 0; i < num_chunks; i++) {
+			Chunk *chunk = chunks[i];
+
+			u64 start = get_time_ns();
+			legacy_update_chunk(chunk);
+			samples_push(&legacy_samples, (f64)(get_time_ns() - start));
+
+			u64 legacy_blocks = chunk->num_blocks;
+			u32 legacy_y_min = chunk->y_min;
+			u32 legacy_y_max = chunk->y_max;
+			if (iter == 0) {
+				memcpy(expected, chunk->instances, sizeof(u32) * legacy_blocks);
+			}
+
+			start = get_time_ns();
+			unshaded_update_chunk(chunk);
+			samples_push(&bits_samples, (f64)(get_time_ns() - start));
+
+			start = get_time_ns();
+			update_chunk(chunk);
+			samples_push(&shaded_samples, (f64)(get_time_ns() - start));
+
+			if (iter != 0) {
+				continue;
+			}
+
+			bool same = chunk->num_blocks == legacy_blocks && chunk->y_min == legacy_y_min && chunk->y_max == legacy_y_max;
+			for (u64 j = 0; j < chunk->num_blocks && same; j++) {
+				glm::vec3 position;
+				glm::vec3 color;
+				unpack_instance(chunk, chunk->instances[j], &position, &color);
+				same = position == chunk->positions[j] && color == chunk->colors[j];
+			}
+			if (same) {
+				qsort(expected, legacy_blocks, sizeof(u32), compare_u32);
+				u32 *sorted = (u32 *)malloc(sizeof(u32) * chunk->num_blocks);
+				memcpy(sorted, chunk->instances, sizeof(u32) * chunk->num_blocks);
+				qsort(sorted, chunk->num_blocks, sizeof(u32), compare_u32);
+				same = memcmp(sorted, expected, sizeof(u32) * legacy_blocks) == 0;
+				free(sorted);
+			}
+			mismatched_chunks += !same;
+			hull_blocks += chunk->num_blocks;
+		}
+	}
+	free(expected);
+
+	f64 legacy_p50 = samples_percentile(&legacy_samples, 50.0);
+	f64 bits_p50 = samples_percentile(&bits_samples, 50.0);
+	f64 shaded_p50 = samples_percentile(&shaded_samples, 50.0);
+	printf("{\"bench\": \"occupancy\", \"num_x_chunks\": %u, \"num_y_chunks\": %u, \"seed\": %u, \"iterations\": %u, ",
+		num_x_chunks, num_y_chunks, world_seed, iterations);
+	print_samples_json("legacy_update_chunk", &legacy_samples);
+	printf(", ");
+	print_samples_json("unshaded_update_chunk", &bits_samples);
+	printf(", ");
+	print_samples_json("update_chunk", &shaded_samples);
+	printf(", \"speedup_p50\": %.2f, \"shading_ns_p50\": %.0f, \"hull_blocks\": %lu, \"ns_per_hull_block\": %.2f, \"mismatched_chunks\": %u, \"identical\": %s}\n",
+		legacy_p50 / bits_p50, shaded_p50 - bits_p50, hull_blocks, bits_p50 * num_chunks / (f64)hull_blocks, mismatched_chunks, mismatched_chunks == 0 ? "true" : "false");
+
+	for (u32 i = 0; i < num_chunks; i++) {
+		free_chunk(chunks[i]);
+	}
+	free(chunks);
+	samples_free(&legacy_samples);
+	samples_free(&bits_samples);
+	samples_free(&shaded_samples);
+}
+
+// generate_density_chunk without the lattice: the density is evaluated at every voxel. Kept as
+// bench_density's baseline.
+Chunk *naive_density_chunk(i32 x_off, i32 z_off) {
+	Chunk *chunk = alloc_chunk(x_off, z_off);
+	chunk->unsaved = true;
+
+	f32 surface[SECTION_SIZE];
+	f32 *density = (f32 *)malloc(sizeof(f32) * chunk_height);
+	for (u32 z = 0; z < chunk_depth; z++) {
+		surface_heights(chunk->x_off, (i32)z + chunk->z_off, 1, chunk_width, surface);
+		for (u32 x = 0; x < chunk_width; x++) {
+			column_density((i32)x + chunk->x_off, (i32)z + chunk->z_off, surface[x], 0, 1, chunk_height, density);
+
+			OccupancyColumn *solid = &chunk->occupancy[twod_to_oned(x, z, chunk_width)];
+			memset(solid, 0, sizeof(OccupancyColumn));
+			for (u32 y = 0; y < chunk_height; y++) {
+				solid->words[y / 64] |= (u64)(density[y] > 0) << (y % 64);
+			}
+			solid->words[0] |= 1;
+			chunk->real_blocks[twod_to_oned(x, z, chunk_width)] = column_highest(*solid);
+		}
+	}
+
+	free(density);
+	return chunk;
+}
+
+// Times density terrain generation on the lattice against evaluating every voxel, compares the
+// two voxel for voxel (they have to agree exactly on lattice points, in between the lattice is an
+// approximation), then builds a density world and counts the overhangs and caves the hull shows
+void bench_density(int argc, char **argv) {
+	set_world_size(arg_u32(argc, argv, "-x", num_x_chunks), arg_u32(argc, argv, "-y", num_y_chunks));
+	world_seed = arg_u32(argc, argv, "-s", world_seed);
+	world_terrain = TERRAIN_DENSITY;
+
+	Samples lattice_samples = {};
+	Samples naive_samples = {};
+	u64 differing_voxels = 0;
+	u64 lattice_point_mismatches = 0;
+	for (u32 i = 0; i < num_chunks; i++) {
+		Point cp = oned_to_twod(i, num_x_chunks);
+		u64 start = get_time_ns();
+		Chunk *lattice = generate_density_chunk(cp.x, cp.y);
+		samples_push(&lattice_samples, (f64)(get_time_ns() - start));
+
+		start = get_time_ns();
+		Chunk *naive = naive_density_chunk(cp.x, cp.y);
+		samples_push(&naive_samples, (f64)(get_time_ns() - start));
+
+		for (u32 c = 0; c < chunk_width * chunk_depth; c++) {
+			Point col = oned_to_twod(c, chunk_width);
+			bool on_lattice = col.x % DENSITY_LATTICE == 0 && col.y % DENSITY_LATTICE == 0;
+			for (u32 y = 0; y < chunk_height; y++) {
+				bool differs = voxel_solid(lattice, col.x, y, col.y) != voxel_solid(naive, col.x, y, col.y);
+				differing_voxels += differs;
+				lattice_point_mismatches += differs && on_lattice && y % DENSITY_LATTICE == 0;
+			}
+		}
+		free_chunk(lattice);
+		free_chunk(naive);
+	}
+
+	Chunk **chunks = (Chunk **)malloc(sizeof(Chunk *) * num_chunks);
+	build_world(chunks, NULL);
+	u64 hull_blocks = 0;
+	u64 underside_blocks = 0;
+	u64 hollow_columns = 0;
+	for (u32 i = 0; i < num_chunks; i++) {
+		for (u32 c = 0; c < chunk_width * chunk_depth; c++) {
+			Point cp = oned_to_twod(c, chunk_width);
+			// empty voxels under the top of the column
+			hollow_columns += column_floor_run(chunks[i]->occupancy[c]) != (u32)chunks[i]->real_blocks[c] + 1;
+			for (u32 y = 0; y < chunk_height; y++) {
+				u8 tile = storage_get(chunks[i]->pre_render_list, cp.x, y, cp.y);
+				hull_blocks += tile != 0;
+				underside_blocks += tile == HULL_BOTTOM_TILE;
+			}
+		}
+	}
+
+	u64 voxels = (u64)num_chunks * chunk_size;
+	f64 lattice_s = samples_total(&lattice_samples) / 1e9;
+	f64 naive_s = samples_total(&naive_samples) / 1e9;
+	u32 lattice_width = chunk_width / DENSITY_LATTICE + 1;
+	u32 lattice_samples_per_chunk = lattice_width * lattice_width * (chunk_height / DENSITY_LATTICE + 1);
+	printf("{\"bench\": \"density\", \"num_x_chunks\": %u, \"num_y_chunks\": %u, \"seed\": %u, \"lattice\": %u, ",
+		num_x_chunks, num_y_chunks, world_seed, DENSITY_LATTICE);
+	print_samples_json("generate_density_chunk", &lattice_samples);
+	printf(", ");
+	print_samples_json("naive_density_chunk", &naive_samples);
+	printf(", \"lattice_voxels_per_sec\": %.0f, \"naive_voxels_per_sec\": %.0f, \"speedup\": %.2f, ",
+		(f64)voxels / lattice_s, (f64)voxels / naive_s, naive_s / lattice_s);
+	printf("\"density_samples_per_chunk\": {\"lattice\": %u, \"naive\": %u}, \"differing_voxel_fraction\": %.5f, \"lattice_point_mismatches\": %lu, ",
+		lattice_samples_per_chunk, chunk_size, (f64)differing_voxels / (f64)voxels, lattice_point_mismatches);
+	printf("\"hull_blocks\": %lu, \"underside_blocks\": %lu, \"hollow_columns\": %lu, \"correct\": %s}\n",
+		hull_blocks, underside_blocks, hollow_columns, lattice_point_mismatches == 0 ? "true" : "false");
+
+	for (u32 i = 0; i < num_chunks; i++) {
+		free_chunk(chunks[i]);
+	}
+	free(chunks);
+	samples_free(&lattice_samples);
+	samples_free(&naive_samples);
+}
+
+// Per-voxel Amanatides-Woo walk in world coordinates, what raycast has to agree with.
+// Misses past the edge of the world.
+bool reference_raycast(Chunk **chunks, Ray ray, f32 max_distance, RayHit *hit) {
+	memset(hit, 0, sizeof(RayHit));
+	glm::vec3 o = ray.origin;
+	glm::vec3 d = ray.dir / glm::length(ray.dir);
+
+	i32 cell[3] = {(i32)floorf(o.x), (i32)floorf(o.y), (i32)floorf(o.z)};
+	i32 step[3];
+	f32 next[3];
+	f32 delta[3];
+	for (u32 a = 0; a < 3; a++) {
+		step[a] = d[a] > 0 ? 1 : -1;
+		next[a] = ray_boundary(o[a], d[a], cell[a]);
+		delta[a] = d[a] != 0 ? 1.0f / fabsf(d[a]) : INFINITY;
+	}
+
+	i32 entered = -1;
+	f32 t = 0;
+	while (t <= max_distance) {
+		if (cell[0] < 0 || cell[2] < 0 || cell[0] >= (i32)(num_x_chunks * chunk_width) || cell[2] >= (i32)(num_y_chunks * chunk_depth) || cell[1] < 0) {
+			return false;
+		}
+
+		Chunk *chunk = chunks[twod_to_oned(cell[0] / chunk_width, cell[2] / chunk_depth, num_x_chunks)];
+		u32 x = cell[0] % chunk_width;
+		u32 z = cell[2] % chunk_depth;
+		if (cell[1] < (i32)chunk_height && voxel_solid(chunk, x, cell[1], z)) {
+			hit->hit = true;
+			hit->chunk = chunk;
+			hit->x = x;
+			hit->y = cell[1];
+			hit->z = z;
+			hit->distance = t;
+			if (entered >= 0) {
+				hit->normal[entered] = -step[entered];
+			}
+			return true;
+		}
+
+		u32 a = next[0] <= next[1] && next[0] <= next[2] ? 0 : next[2] <= next[1] ? 2 : 1;
+		t = next[a];
+		cell[a] += step[a];
+		next[a] += delta[a];
+		entered = a;
+	}
+	return false;
+}
+
+// Steps a fixed distance along the ray and stops in the first solid voxel, the obvious approach
+// raycast replaces. The normal comes from the cell the last step left.
+bool march_raycast(Chunk **chunks, Ray ray, f32 max_distance, f32 step, RayHit *hit) {
+	memset(hit, 0, sizeof(RayHit));
+	glm::vec3 d = ray.dir / glm::length(ray.dir);
+	i32 last[3] = {(i32)floorf(ray.origin.x), (i32)floorf(ray.origin.y), (i32)floorf(ray.origin.z)};
+	for (f32 t = 0; t <= max_distance; t += step) {
+		glm::vec3 p = ray.origin + d * t;
+		i32 cell[3] = {(i32)floorf(p.x), (i32)floorf(p.y), (i32)floorf(p.z)};
+		if (cell[0] < 0 || cell[2] < 0 || cell[0] >= (i32)(num_x_chunks * chunk_width) || cell[2] >= (i32)(num_y_chunks * chunk_depth) || cell[1] < 0) {
+			return false;
+		}
+
+		Chunk *chunk = chunks[twod_to_oned(cell[0] / chunk_width, cell[2] / chunk_depth, num_x_chunks)];
+		u32 x = cell[0] % chunk_width;
+		u32 z = cell[2] % chunk_depth;
+		if (cell[1] < (i32)chunk_height && voxel_solid(chunk, x, cell[1], z)) {
+			hit->hit = true;
+			hit->chunk = chunk;
+			hit->x = x;
+			hit->y = cell[1];
+			hit->z = z;
+			hit->distance = t;
+			for (u32 a = 0; a < 3; a++) {
+				hit->normal[a] = last[a] - cell[a];
+			}
+			return true;
+		}
+		memcpy(last, cell, sizeof(last));
+	}
+	return false;
+}
+
+bool same_hit(RayHit *a, RayHit *b) {
+	if (a->hit != b->hit) {
+		return false;
+	}
+	if (!a->hit) {
+		return true;
+	}
+	return a->chunk == b->chunk && a->x == b->x && a->y == b->y && a->z == b->z && !memcmp(a->normal, b->normal, sizeof(a->normal)) &&
+		fabsf(a->distance - b->distance) <= 1e-3f * (1.0f + a->distance);
+}
+
+// A ray that passes within float error of a voxel edge can fairly go either way round it. Such a
+// hit still matches the per-voxel walk with the origin nudged a little along some axis.
+bool grazing_hit(Chunk **chunks, Ray ray, f32 max_distance, RayHit *hit) {
+	for (u32 n = 0; n < 6; n++) {
+		Ray nudged = ray;
+		nudged.origin[n / 2] += n % 2 ? -1e-3f : 1e-3f;
+		RayHit other;
+		reference_raycast(chunks, nudged, max_distance, &other);
+		if (other.hit == hit->hit && (!hit->hit || (other.chunk == hit->chunk && other.x == hit->x && other.y == hit->y && other.z == hit->z))) {
+			return true;
+		}
+	}
+	return false;
+}
+
+// Counts hits that differ from the per-voxel walk's, and of those the grazing ones
+u32 count_ray_mismatches(Chunk **chunks, Ray *rays, u32 count, f32 max_distance, RayHit *hits, RayHit *expected, u32 *grazing) {
+	u32 mismatches = 0;
+	for (u32 i = 0; i < count; i++) {
+		if (same_hit(&hits[i], &expected[i])) {
+			continue;
+		}
+		if (grazing_hit(chunks, rays[i], max_distance, &hits[i])) {
+			(*grazing)++;
+		} else {
+			mismatches++;
+		}
+	}
+	return mismatches;
+}
+
+// Picking rays over a built world: half from camera heights up to where main starts the camera,
+// looking down at the terrain, half from just above random columns in every direction. raycast,
+// raycast_batch and raycast_batch_parallel are checked hit for hit against the per-voxel walk, and
+// a fixed step march is timed for comparison.
+void bench_raycast(int argc, char **argv) {
+	set_world_size(arg_u32(argc, argv, "-x", num_x_chunks), arg_u32(argc, argv, "-y", num_y_chunks));
+	world_seed = arg_u32(argc, argv, "-s", world_seed);
+	u32 num_rays = arg_u32(argc, argv, "-n", 200000);
+	f32 max_distance = (f32)arg_u32(argc, argv, "-m", 64);
+	u32 num_threads = arg_u32(argc, argv, "-t", 0);
+	srand(world_seed);
+
+	Chunk **chunks = (Chunk **)malloc(sizeof(Chunk *) * num_chunks);
+	build_world(chunks, NULL);
+
+	Ray *rays = (Ray *)malloc(sizeof(Ray) * num_rays);
+	f32 world_width = (f32)(num_x_chunks * chunk_width);
+	f32 world_depth = (f32)(num_y_chunks * chunk_depth);
+	for (u32 i = 0; i < num_rays; i++) {
+		Ray *ray = &rays[i];
+		ray->origin = glm::vec3(random_f32(0, world_width - 0.01f), 0, random_f32(0, world_depth - 0.01f));
+		u32 height = *column_height(chunks, (u32)ray->origin.x, (u32)ray->origin.z);
+		if (i % 2 == 0) {
+			ray->origin.y = random_f32(height + 2.0f, chunk_height + 3.0f);
+			f32 yaw = random_f32(0, 2.0f * (f32)M_PI);
+			f32 pitch = random_f32(-1.4f, 0.2f);
+			ray->dir = glm::vec3(cosf(yaw) * cosf(pitch), sinf(pitch), sinf(yaw) * cosf(pitch));
+		} else {
+			ray->origin.y = random_f32(height + 1.0f, height + 4.0f);
+			ray->dir = glm::vec3(random_f32(-1, 1), random_f32(-1, 1), random_f32(-1, 1));
+		}
+	}
+
+	RayHit *expected = (RayHit *)malloc(sizeof(RayHit) * num_rays);
+	RayHit *hits = (RayHit *)malloc(sizeof(RayHit) * num_rays);
+
+	u64 start = get_time_ns();
+	u32 expected_hits = 0;
+	for (u32 i = 0; i < num_rays; i++) {
+		expected_hits += reference_raycast(chunks, rays[i], max_distance, &expected[i]);
+	}
+	u64 walk_ns = get_time_ns() - start;
+
+	start = get_time_ns();
+	for (u32 i = 0; i < num_rays; i++) {
+		march_raycast(chunks, rays[i], max_distance, 0.1f, &hits[i]);
+	}
+	u64 march_ns = get_time_ns() - start;
+	u32 march_mismatches = 0;
+	for (u32 i = 0; i < num_rays; i++) {
+		march_mismatches += !same_hit(&hits[i], &expected[i]);
+	}
+
+	start = get_time_ns();
+	for (u32 i = 0; i < num_rays; i++) {
+		Chunk *origin = chunks[twod_to_oned((u32)rays[i].origin.x / chunk_width, (u32)rays[i].origin.z / chunk_depth, num_x_chunks)];
+		raycast(origin, rays[i], max_distance, &hits[i]);
+	}
+	u64 raycast_ns = get_time_ns() - start;
+	u32 grazing = 0;
+	u32 mismatches = count_ray_mismatches(chunks, rays, num_rays, max_distance, hits, expected, &grazing);
+
+	start = get_time_ns();
+	u32 batch_hits = raycast_batch(chunks[0], rays, num_rays, max_distance, hits);
+	u64 batch_ns = get_time_ns() - start;
+	u32 batch_grazing = 0;
+	u32 batch_mismatches = count_ray_mismatches(chunks, rays, num_rays, max_distance, hits, expected, &batch_grazing);
+
+	JobSystem *sys = job_system_create(num_threads, 256);
+	start = get_time_ns();
+	u32 parallel_hits = raycast_batch_parallel(sys, chunks[0], rays, num_rays, max_distance, hits);
+	u64 parallel_ns = get_time_ns() - start;
+	u32 parallel_grazing = 0;
+	u32 parallel_mismatches = count_ray_mismatches(chunks, rays, num_rays, max_distance, hits, expected, &parallel_grazing);
+
+	printf("{\"bench\": \"raycast\", \"num_x_chunks\": %u, \"num_y_chunks\": %u, \"seed\": %u, \"rays\": %u, \"max_distance\": %.0f, \"hit_rate\": %.3f, ",
+		num_x_chunks, num_y_chunks, world_seed, num_rays, max_distance, (f64)expected_hits / num_rays);
+	printf("\"rays_per_sec\": {\"march\": %.0f, \"voxel_walk\": %.0f, \"raycast\": %.0f, \"batch\": %.0f, \"parallel\": %.0f}, \"threads\": %u, ",
+		num_rays / (march_ns / 1e9), num_rays / (walk_ns / 1e9), num_rays / (raycast_ns / 1e9), num_rays / (batch_ns / 1e9),
+		num_rays / (parallel_ns / 1e9), sys->num_threads);
+	printf("\"speedup_over_voxel_walk\": %.2f, \"march_mismatches\": %u, \"grazing\": %u, \"mismatches\": %u, ",
+		(f64)walk_ns / raycast_ns, march_mismatches, grazing, mismatches);
+	bool correct = mismatches == 0 && batch_mismatches == 0 && parallel_mismatches == 0 &&
+		batch_grazing == grazing && parallel_grazing == grazing && batch_hits == parallel_hits;
+	printf("\"batch_mismatches\": %u, \"parallel_mismatches\": %u, \"correct\": %s}\n", batch_mismatches, parallel_mismatches, correct ? "true" : "false");
+
+	job_system_destroy(sys);
+	for (u32 i = 0; i < num_chunks; i++) {
+		free_chunk(chunks[i]);
+	}
+	free(chunks);
+	free(rays);
+	free(expected);
+	free(hits);
+}
+
+glm::vec3 arg_vec3(int argc, char **argv, const char *flag, glm::vec3 default_value) {
+	const char *value = arg_str(argc, argv, flag, NULL);
+	glm::vec3 v = default_value;
+	if (value && sscanf(value, "%f,%f,%f", &v.x, &v.y, &v.z) != 3) {
+		v = default_value;
+	}
+	return v;
+}
+
+// The octree hit as a raycast hit on the chunk grid, so the two can be compared
+RayHit svo_hit_on_grid(Chunk **chunks, SvoHit *svo_hit) {
+	RayHit hit = {};
+	if (svo_hit->hit) {
+		hit.hit = true;
+		hit.chunk = chunks[twod_to_oned(svo_hit->x / chunk_width, svo_hit->z / chunk_depth, num_x_chunks)];
+		hit.x = svo_hit->x % chunk_width;
+		hit.y = svo_hit->y;
+		hit.z = svo_hit->z % chunk_depth;
+		memcpy(hit.normal, svo_hit->normal, sizeof(hit.normal));
+		hit.distance = svo_hit->distance;
+	}
+	return hit;
+}
+
+// Builds a sparse voxel octree of a world and renders it on the CPU at 1, 2, 4... threads up to
+// -t, reporting octree memory against the chunks it came from, build time and rays/s per thread
+// count. Every pixel's hit is checked against the per-voxel walk, and the image is written to -o.
+void bench_trace(int argc, char **argv) {
+	set_world_size(arg_u32(argc, argv, "-x", num_x_chunks), arg_u32(argc, argv, "-y", num_y_chunks));
+	world_seed = arg_u32(argc, argv, "-s", world_seed);
+	u32 width = arg_u32(argc, argv, "-w", 640);
+	u32 height = arg_u32(argc, argv, "-h", 480);
+	u32 max_threads = arg_u32(argc, argv, "-t", 0);
+	max_threads = max_threads ? max_threads : get_num_cores();
+	const char *path = arg_str(argc, argv, "-o", "trace.tga");
+
+	Chunk **chunks = (Chunk **)malloc(sizeof(Chunk *) * num_chunks);
+	build_world(chunks, NULL);
+
+	TraceCamera camera;
+	camera.eye = arg_vec3(argc, argv, "-e", glm::vec3(4.0, 200.0, 4.0));
+	camera.front = arg_vec3(argc, argv, "-f", glm::vec3(1.0, -0.45, 1.0));
+	camera.fov = 60.0f;
+	camera.max_distance = 512.0f;
+
+	Samples build_samples = {};
+	Svo *svo = NULL;
+	for (u32 i = 0; i < 5; i++) {
+		if (svo) {
+			svo_free(svo);
+		}
+		u64 start = get_time_ns();
+		svo = svo_build(chunks, num_chunks);
+		samples_push(&build_samples, (f64)(get_time_ns() - start));
+	}
+
+	u64 chunk_total = 0;
+	for (u32 i = 0; i < num_chunks; i++) {
+		chunk_total += storage_bytes(chunks[i]->pre_render_list) + sizeof(OccupancyColumn) * chunk_width * chunk_depth;
+	}
+	u64 dense_bytes = (u64)num_chunks * chunk_size;
+
+	TraceImage *image = trace_image_create(width, height);
+	printf("{\"bench\": \"trace\", \"num_x_chunks\": %u, \"num_y_chunks\": %u, \"seed\": %u, \"width\": %u, \"height\": %u, ",
+		num_x_chunks, num_y_chunks, world_seed, width, height);
+	printf("\"svo\": {\"size\": %u, \"nodes\": %u, \"bricks\": %u, \"tiled_bricks\": %u, \"full_cells\": %u, \"bytes\": %lu, \"bytes_per_chunk\": %lu}, ",
+		svo->size, svo->stats.nodes, svo->stats.bricks, svo->stats.tiled_bricks, svo->stats.full_cells, svo->stats.bytes, svo->stats.bytes / num_chunks);
+	printf("\"chunk_storage_and_occupancy_bytes\": %lu, \"dense_bytes\": %lu, ", chunk_total, dense_bytes);
+	print_samples_json("svo_build", &build_samples);
+	printf(", \"threads\": [");
+
+	f64 single_rays_per_sec = 0;
+	for (u32 threads = 1;; threads = threads * 2 < max_threads ? threads * 2 : max_threads) {
+		JobSystem *sys = job_system_create(threads, 64);
+		u64 start = get_time_ns();
+		trace_render(sys, svo, &camera, image);
+		u64 render_ns = get_time_ns() - start;
+		job_system_destroy(sys);
+
+		f64 rays_per_sec = (f64)(width * height) / (render_ns / 1e9);
+		single_rays_per_sec = threads == 1 ? rays_per_sec : single_rays_per_sec;
+		printf("%s{\"threads\": %u, \"render_ms\": %.3f, \"rays_per_sec\": %.0f, \"scaling\": %.2f}",
+			threads == 1 ? "" : ", ", threads, render_ns / 1e6, rays_per_sec, rays_per_sec / single_rays_per_sec);
+		if (threads == max_threads) {
+			break;
+		}
+	}
+
+	u32 hits = 0;
+	u32 grazing = 0;
+	u32 mismatches = 0;
+	TraceView view = trace_view(&camera, width, height);
+	for (u32 y = 0; y < height; y++) {
+		for (u32 x = 0; x < width; x++) {
+			u32 i = twod_to_oned(x, y, width);
+			Ray ray = trace_pixel_ray(&view, x, y);
+			RayHit got = svo_hit_on_grid(chunks, &image->hits[i]);
+			RayHit expected;
+			reference_raycast(chunks, ray, camera.max_distance, &expected);
+			hits += got.hit;
+			if (same_hit(&got, &expected)) {
+				continue;
+			}
+			if (grazing_hit(chunks, ray, camera.max_distance, &got)) {
+				grazing++;
+			} else {
+				mismatches++;
+			}
+		}
+	}
+
+	trace_write_tga(path, image);
+	printf("], \"hit_rate\": %.3f, \"grazing\": %u, \"mismatches\": %u, \"image\": \"%s\", \"correct\": %s}\n",
+		(f64)hits / (width * height), grazing, mismatches, path, mismatches == 0 ? "true" : "false");
+
+	trace_image_free(image);
+	svo_free(svo);
+	for (u32 i = 0; i < num_chunks; i++) {
+		free_chunk(chunks[i]);
+	}
+	free(chunks);
+	samples_free(&build_samples);
+}
+
+// Voxel at world (wx, y, wz) of the grid, the floor solid and above the chunks empty like the hull sees them
+bool world_voxel_solid(Chunk **chunks, i32 wx, i32 y, i32 wz) {
+	if (y < 0) {
+		return true;
+	}
+	if (y >= (i32)chunk_height) {
+		return false;
+	}
+	Chunk *chunk = chunks[twod_to_oned(wx / chunk_width, wz / chunk_depth, num_x_chunks)];
+	return voxel_solid(chunk, wx % chunk_width, y, wz % chunk_depth);
+}
+
+// A face's ao_bits byte worked out corner by corner from world coordinates, what ao_column has to agree with
+u8 reference_face_ao(Chunk **chunks, i32 wx, i32 y, i32 wz, u32 f) {
+	u32 d = ao_faces[f].axis;
+	u32 u = (d + 1) % 3;
+	u32 v = (d + 2) % 3;
+	i32 front[3] = {wx, y, wz};
+	front[d] += ao_faces[f].sign;
+	if (world_voxel_solid(chunks, front[0], front[1], front[2])) {
+		return 0;
+	}
+
+	u8 bits = 0;
+	for (u32 c = 0; c < 4; c++) {
+		i32 side_u[3] = {wx, y, wz};
+		side_u[d] += ao_faces[f].sign;
+		i32 side_v[3] = {side_u[0], side_u[1], side_u[2]};
+		side_u[u] += c & 1 ? 1 : -1;
+		side_v[v] += c & 2 ? 1 : -1;
+		i32 corner[3] = {side_u[0], side_u[1], side_u[2]};
+		corner[v] += c & 2 ? 1 : -1;
+
+		bool su = world_voxel_solid(chunks, side_u[0], side_u[1], side_u[2]);
+		bool sv = world_voxel_solid(chunks, side_v[0], side_v[1], side_v[2]);
+		bool sc = world_voxel_solid(chunks, corner[0], corner[1], corner[2]);
+		u32 ao = su && sv ? 3 : su + sv + sc;
+		bits |= ao << (c * 2);
+	}
+	return bits;
+}
+
+// What baking ambient occlusion adds to instancing a chunk: update_chunk timed whole against its
+// ambient occlusion part alone, the bytes it adds per instance, and every face of every instance
+// away from the world's edge checked against the per-corner reference
+void bench_ao(int argc, char **argv) {
+	set_world_size(arg_u32(argc, argv, "-x", num_x_chunks), arg_u32(argc, argv, "-y", num_y_chunks));
+	world_seed = arg_u32(argc, argv, "-s", world_seed);
+	u32 iterations = arg_u32(argc, argv, "-n", 20);
+
+	Chunk **chunks = (Chunk **)malloc(sizeof(Chunk *) * num_chunks);
+	build_world(chunks, NULL);
+
+	Samples update_samples = {};
+	Samples ao_samples = {};
+	u32 columns = chunk_width * chunk_depth;
+	OccupancyColumn solid[(SECTION_SIZE + 2) * (SECTION_SIZE + 2)];
+	OccupancyColumn *hulls = (OccupancyColumn *)malloc(sizeof(OccupancyColumn) * columns);
+	u8 face_ao[AO_FACES];
+	u64 sink = 0;
+	for (u32 iter = 0; iter < iterations; iter++) {
+		for (u32 i = 0; i < num_chunks; i++) {
+			Chunk *chunk = chunks[i];
+			u64 start = get_time_ns();
+			update_chunk(chunk);
+			samples_push(&update_samples, (f64)(get_time_ns() - start));
+
+			fill_occupancy_apron(chunk, solid);
+			for (u32 c = 0; c < columns; c++) {
+				OccupancyColumn faces[HULL_FACES];
+				u8 tiles[HULL_FACES];
+				hulls[c] = hull_column_faces(solid, c % chunk_width, c / chunk_width, faces, tiles);
+			}
+
+			start = get_time_ns();
+			for (u32 c = 0; c < columns; c++) {
+				ColumnAo ao;
+				ao_column(solid, c % chunk_width, c / chunk_width, &hulls[c], &ao);
+				for (u32 k = 0; k < OCCUPANCY_WORDS; k++) {
+					u64 bits = hulls[c].words[k];
+					while (bits) {
+						ao_voxel(&ao, k * 64 + __builtin_ctzll(bits), face_ao);
+						sink += face_ao[0];
+						bits &= bits - 1;
+					}
+				}
+			}
+			samples_push(&ao_samples, (f64)(get_time_ns() - start));
+		}
+	}
+	free(hulls);
+
+	u64 instances = 0;
+	u64 checked = 0;
+	u64 mismatches = 0;
+	u64 occluded_corners = 0;
+	u32 world_width = num_x_chunks * chunk_width;
+	u32 world_depth = num_y_chunks * chunk_depth;
+	for (u32 i = 0; i < num_chunks; i++) {
+		Chunk *chunk = chunks[i];
+		instances += chunk->num_blocks;
+		for (u64 j = 0; j < chunk->num_blocks; j++) {
+			u8 *bits = &chunk->ao_bits[AO_FACES * j];
+			for (u32 f = 0; f < AO_FACES; f++) {
+				for (u32 c = 0; c < 4; c++) {
+					occluded_corners += ((bits[f] >> (c * 2)) & 3) != 0;
+				}
+			}
+
+			// the apron repeats the edge column past the world's edge, the reference does not
+			i32 wx = (i32)chunk->positions[j].x;
+			i32 y = (i32)chunk->positions[j].y;
+			i32 wz = (i32)chunk->positions[j].z;
+			if (wx == 0 || wz == 0 || wx == (i32)world_width - 1 || wz == (i32)world_depth - 1) {
+				continue;
+			}
+			checked++;
+			for (u32 f = 0; f < AO_FACES; f++) {
+				if (bits[f] != reference_face_ao(chunks, wx, y, wz, f)) {
+					mismatches++;
+					break;
+				}
+			}
+		}
+	}
+
+	f64 update_p50 = samples_percentile(&update_samples, 50.0);
+	f64 ao_p50 = samples_percentile(&ao_samples, 50.0);
+	printf("{\"bench\": \"ao\", \"num_x_chunks\": %u, \"num_y_chunks\": %u, \"seed\": %u, \"iterations\": %u, ",
+		num_x_chunks, num_y_chunks, world_seed, iterations);
+	print_samples_json("update_chunk", &update_samples);
+	printf(", ");
+	print_samples_json("ao", &ao_samples);
+	printf(", \"ao_share_p50\": %.3f, \"ao_ns_per_instance\": %.2f, \"instances\": %lu, \"instance_bytes\": %lu, \"ao_bytes_per_instance\": %u, \"ao_bytes_per_chunk\": %lu, ",
+		ao_p50 / update_p50, ao_p50 * num_chunks / (f64)instances, instances, (u64)sizeof(u32), AO_FACES, instances * AO_FACES / num_chunks);
+	printf("\"occluded_corner_fraction\": %.3f, \"checked\": %lu, \"mismatches\": %lu, \"sink\": %lu, \"correct\": %s}\n",
+		(f64)occluded_corners / (f64)(instances * AO_FACES * 4), checked, mismatches, sink % 2, mismatches == 0 ? "true" : "false");
+
+	for (u32 i = 0; i < num_chunks; i++) {
+		free_chunk(chunks[i]);
+	}
+	free(chunks);
+	samples_free(&update_samples);
+	samples_free(&ao_samples);
+}
+
+// Every voxel's light, chunk by chunk, to compare two lightings of the same world
+u8 *snapshot_light(Chunk **chunks) {
+	u64 volume = chunk_width * chunk_height * chunk_depth;
+	u8 *light = (u8 *)malloc(volume * num_chunks);
+	for (u32 i = 0; i < num_chunks; i++) {
+		u8 *out = light + volume * i;
+		for (u32 y = 0; y < chunk_height; y++) {
+			for (u32 z = 0; z < chunk_depth; z++) {
+				for (u32 x = 0; x < chunk_width; x++) {
+					*out++ = light_get(&chunks[i]->light, x, y, z);
+				}
+			}
+		}
+	}
+	return light;
+}
+
+// Light propagation: the whole world relit from scratch against single block edits and lamp
+// switches relighting incrementally. Lamps go on random surface blocks. Afterwards the incremental
+// light has to equal a full relight of the edited world, in every voxel and every instance's light_bits.
+void bench_light(int argc, char **argv) {
+	set_world_size(arg_u32(argc, argv, "-x", num_x_chunks), arg_u32(argc, argv, "-y", num_y_chunks));
+	world_seed = arg_u32(argc, argv, "-s", world_seed);
+	u32 num_edits = arg_u32(argc, argv, "-n", 2000);
+	u32 num_lamps = arg_u32(argc, argv, "-l", 64);
+	u32 iterations = arg_u32(argc, argv, "-i", 5);
+
+	Chunk **chunks = (Chunk **)malloc(sizeof(Chunk *) * num_chunks);
+	build_world(chunks, NULL);
+
+	u32 world_width = num_x_chunks * chunk_width;
+	u32 world_depth = num_y_chunks * chunk_depth;
+	srand(world_seed);
+	for (u32 i = 0; i < num_lamps; i++) {
+		u32 wx = rand() % world_width;
+		u32 wz = rand() % world_depth;
+		Chunk *chunk = chunks[twod_to_oned(wx / chunk_width, wz / chunk_depth, num_x_chunks)];
+		u32 x = wx % chunk_width;
+		u32 z = wz % chunk_depth;
+		chunk_set_emitter(chunk, x, chunk->real_blocks[twod_to_oned(x, z, chunk_width)], z, 8 + rand() % 7);
+	}
+
+	Samples relight_samples = {};
+	LightStats before = world_light.stats;
+	for (u32 iter = 0; iter < iterations; iter++) {
+		u64 start = get_time_ns();
+		light_world(&world_light, chunks, num_chunks);
+		samples_push(&relight_samples, (f64)(get_time_ns() - start));
+	}
+	u64 relight_voxels = (world_light.stats.voxels_lit - before.voxels_lit) / iterations;
+
+	u64 light_bytes_total = 0;
+	for (u32 i = 0; i < num_chunks; i++) {
+		light_bytes_total += light_bytes(&chunks[i]->light);
+	}
+	u64 dense_bytes = (u64)chunk_width * chunk_height * chunk_depth * num_chunks;
+
+	// one edit in eight switches a lamp on a surface block, the rest place or dig like bench_edit
+	Samples edit_samples = {};
+	Samples lamp_samples = {};
+	before = world_light.stats;
+	u32 rejected = 0;
+	for (u32 i = 0; i < num_edits; i++) {
+		u32 wx = rand() % world_width;
+		u32 wz = rand() % world_depth;
+		Chunk *chunk = chunks[twod_to_oned(wx / chunk_width, wz / chunk_depth, num_x_chunks)];
+		u32 x = wx % chunk_width;
+		u32 z = wz % chunk_depth;
+		u32 height = chunk->real_blocks[twod_to_oned(x, z, chunk_width)];
+
+		if (rand() % 8 == 0) {
+			u8 level = light_block(light_get(&chunk->light, x, height, z)) ? 0 : 8 + rand() % 7;
+			u64 start = get_time_ns();
+			light_set_emitter(&world_light, chunk, x, height, z, level);
+			light_flush(&world_light);
+			samples_push(&lamp_samples, (f64)(get_time_ns() - start));
+			continue;
+		}
+
+		bool place = (rand() & 1) && height < chunk_height - 2;
+		u64 start = get_time_ns();
+		bool applied = place ? chunk_set_block(chunk, x, height + 1, z, NULL) : chunk_remove_block(chunk, x, height, z, NULL);
+		samples_push(&edit_samples, (f64)(get_time_ns() - start));
+		rejected += !applied;
+	}
+	u64 edit_voxels = world_light.stats.voxels_lit - before.voxels_lit + world_light.stats.voxels_darkened - before.voxels_darkened;
+	u64 num_emitters = 0;
+	for (u32 i = 0; i < num_chunks; i++) {
+		num_emitters += chunks[i]->num_emitters;
+	}
+
+	// the incremental light against a relight from scratch, light_bits included
+	u8 *incremental = snapshot_light(chunks);
+	u8 **incremental_bits = (u8 **)malloc(sizeof(u8 *) * num_chunks);
+	for (u32 i = 0; i < num_chunks; i++) {
+		incremental_bits[i] = (u8 *)malloc(AO_FACES * chunks[i]->num_blocks + 1);
+		memcpy(incremental_bits[i], chunks[i]->light_bits, AO_FACES * chunks[i]->num_blocks);
+	}
+	light_world(&world_light, chunks, num_chunks);
+	u8 *relit = snapshot_light(chunks);
+
+	u64 volume = chunk_width * chunk_height * chunk_depth;
+	u64 voxel_mismatches = 0;
+	for (u64 v = 0; v < volume * num_chunks; v++) {
+		voxel_mismatches += incremental[v] != relit[v];
+	}
+	u64 instance_mismatches = 0;
+	for (u32 i = 0; i < num_chunks; i++) {
+		for (u64 j = 0; j < AO_FACES * chunks[i]->num_blocks; j++) {
+			instance_mismatches += incremental_bits[i][j] != chunks[i]->light_bits[j];
+		}
+		free(incremental_bits[i]);
+	}
+	free(incremental_bits);
+	free(incremental);
+	free(relit);
+
+	u32 num_edited = edit_samples.count + lamp_samples.count;
+	printf("{\"bench\": \"light\", \"num_x_chunks\": %u, \"num_y_chunks\": %u, \"seed\": %u, \"lamps\": %u, \"iterations\": %u, ",
+		num_x_chunks, num_y_chunks, world_seed, num_lamps, iterations);
+	print_samples_json("relight", &relight_samples);
+	printf(", \"relight_ns_per_chunk_p50\": %.1f, \"voxels_lit_per_relight\": %lu, \"light_bytes\": %lu, \"dense_light_bytes\": %lu, \"light_bytes_per_chunk\": %lu, ",
+		samples_percentile(&relight_samples, 50.0) / num_chunks, relight_voxels, light_bytes_total, dense_bytes, light_bytes_total / num_chunks);
+	printf("\"edits\": %u, \"rejected\": %u, ", num_edits, rejected);
+	print_samples_json("edit", &edit_samples);
+	printf(", ");
+	print_samples_json("lamp", &lamp_samples);
+	printf(", \"voxels_relit_per_edit\": %.1f, \"emitters\": %lu, \"voxel_mismatches\": %lu, \"instance_mismatches\": %lu, \"matches_relight\": %s}\n",
+		num_edited ? (f64)edit_voxels / (f64)num_edited : 0.0, num_emitters, voxel_mismatches, instance_mismatches,
+		voxel_mismatches == 0 && instance_mismatches == 0 ? "true" : "false");
+
+	for (u32 i = 0; i < num_chunks; i++) {
+		free_chunk(chunks[i]);
+	}
+	free(chunks);
+	samples_free(&relight_samples);
+	samples_free(&edit_samples);
+	samples_free(&lamp_samples);
+}
+
+// A zone around nothing, what recording one costs by itself
+__attribute__((noinline)) void profile_empty_zone() {
+	PROFILE_ZONE("empty");
+}
+
+f64 profile_zone_ns(u32 count) {
+	u64 start = get_time_ns();
+	for (u32 i = 0; i < count; i++) {
+		profile_empty_zone();
+	}
+	return (f64)(get_time_ns() - start) / count;
+}
+
+// The world pipeline without a window under a profile capture: a parallel world build, lighting,
+// meshes at every level, single block edits and laps of a streamed world. Writes the capture as a
+// Chrome trace and prints each zone's totals, along with what a zone costs in and out of a capture.
+void bench_profile(int argc, char **argv) {
+	set_world_size(arg_u32(argc, argv, "-x", num_x_chunks), arg_u32(argc, argv, "-y", num_y_chunks));
+	world_seed = arg_u32(argc, argv, "-s", world_seed);
+	u32 num_threads = arg_u32(argc, argv, "-t", 0);
+	u32 num_frames = arg_u32(argc, argv, "-n", 600);
+	u32 num_edits = arg_u32(argc, argv, "-e", 1000);
+	const char *trace_path = arg_str(argc, argv, "-o", "voxel_trace.json");
+
+	profile_name_thread("main");
+	JobSystem *sys = job_system_create(num_threads, num_chunks * 3);
+	Chunk **chunks = (Chunk **)malloc(sizeof(Chunk *) * num_chunks);
+
+	u64 start = get_time_ns();
+	profile_begin();
+	{
+		PROFILE_ZONE("build_world");
+		build_world_parallel(sys, chunks, NULL);
+	}
+	{
+		PROFILE_ZONE("light_world");
+		light_world(&world_light, chunks, num_chunks);
+	}
+	{
+		PROFILE_ZONE("build_meshes");
+		build_world_meshes(sys, chunks);
+		for (u32 i = 0; i < num_chunks; i++) {
+			for (u32 l = 1; l < LOD_LEVELS; l++) {
+				build_lod_mesh(chunks[i], l);
+			}
+		}
+	}
+	{
+		PROFILE_ZONE("edits");
+		srand(world_seed);
+		for (u32 i = 0; i < num_edits; i++) {
+			u32 wx = rand() % (num_x_chunks * chunk_width);
+			u32 wz = rand() % (num_y_chunks * chunk_depth);
+			u32 height = *column_height(chunks, wx, wz);
+			if ((rand() & 1) && height < chunk_height - 2) {
+				set_block(chunks, wx, height + 1, wz, NULL);
+			} else {
+				remove_block(chunks, wx, height, wz, NULL);
+			}
+		}
+	}
+	{
+		PROFILE_ZONE("stream");
+		ChunkStream *stream = stream_create(sys, 4, 6, 16, 4);
+		f32 path_radius = 20.0f * chunk_width;
+		glm::vec3 camera_pos = glm::vec3(path_radius, chunk_height + 3.0, 0.0);
+		stream_fill(stream, camera_pos);
+		for (u32 frame = 0; frame < num_frames; frame++) {
+			PROFILE_ZONE("frame");
+			f32 angle = (f32)frame * 2.0f / path_radius;
+			camera_pos.x = cosf(angle) * path_radius;
+			camera_pos.z = sinf(angle) * path_radius;
+			stream_update(stream, camera_pos);
+		}
+		stream_destroy(stream);
+	}
+	profile_end();
+	u64 capture_ns = get_time_ns() - start;
+
+	u64 write_start = get_time_ns();
+	bool written = profile_write_trace(trace_path);
+	u64 write_ns = get_time_ns() - write_start;
+
+	u64 recorded, dropped;
+	profile_counts(&recorded, &dropped);
+	ProfileTotal totals[64];
+	u32 num_totals = profile_totals(totals, 64);
+
+	u32 zone_iterations = 1000000;
+	f64 idle_ns = profile_zone_ns(zone_iterations);
+	profile_begin();
+	f64 capture_zone_ns = profile_zone_ns(zone_iterations);
+	profile_end();
+
+	printf("{\"bench\": \"profile\", \"num_x_chunks\": %u, \"num_y_chunks\": %u, \"seed\": %u, \"threads\": %u, \"frames\": %u, \"edits\": %u, ",
+		num_x_chunks, num_y_chunks, world_seed, sys->num_threads, num_frames, num_edits);
+	printf("\"capture_ms\": %.3f, \"zones_recorded\": %lu, \"zones_dropped\": %lu, \"tracks\": %u, \"trace\": \"%s\", \"trace_written\": %s, \"write_ms\": %.3f, ",
+		(f64)capture_ns / 1e6, recorded, dropped, profiler.num_threads, trace_path, written ? "true" : "false", (f64)write_ns / 1e6);
+	printf("\"zone_ns_idle\": %.2f, \"zone_ns_capturing\": %.2f, \"zones\": {", idle_ns, capture_zone_ns);
+	for (u32 i = 0; i < num_totals; i++) {
+		printf("%s\"%s\": {\"count\": %lu, \"total_ms\": %.3f, \"mean_us\": %.3f, \"max_us\": %.3f}", i ? ", " : "", totals[i].name,
+			totals[i].count, (f64)totals[i].total_ns / 1e6, (f64)totals[i].total_ns / 1e3 / totals[i].count, (f64)totals[i].max_ns / 1e3);
+	}
+	printf("}}\n");
+
+	for (u32 i = 0; i < num_chunks; i++) {
+		free_chunk(chunks[i]);
+	}
+	free(chunks);
+	job_system_destroy(sys);
+}
+
+typedef struct Bench {
+	const char *name;
+	void (*run)(int argc, char **argv);
+} Bench;
+
+Bench benches[] = {
+	{"world", bench_world},
+	{"noise", bench_noise},
+	{"storage", bench_storage},
+	{"instances", bench_instances},
+	{"mesh", bench_mesh},
+	{"edit", bench_edit},
+	{"stream", bench_stream},
+	{"region", bench_region},
+	{"cache", bench_cache},
+	{"frames", bench_frames},
+	{"frustum", bench_frustum},
+	{"occlusion", bench_occlusion},
+	{"lod", bench_lod},
+	{"arena", bench_arena},
+	{"hull", bench_hull},
+	{"occupancy", bench_occupancy},
+	{"density", bench_density},
+	{"raycast", bench_raycast},
+	{"trace", bench_trace},
+	{"ao", bench_ao},
+	{"light", bench_light},
+	{"profile", bench_profile},
+};
+
+void print_usage() {
+	puts("usage: voxel_bench <bench> [options]");
+	puts("  world  -x <num_x_chunks> -y <num_y_chunks> -s <seed> -n <iterations> -t <threads, 0 for all cores>");
+	puts("  noise  -n <iterations>");
+	puts("  storage  -x <num_x_chunks> -y <num_y_chunks> -s <seed> -n <random sets>");
+	puts("  instances  -x <num_x_chunks> -y <num_y_chunks> -s <seed>");
+	puts("  mesh  -x <num_x_chunks> -y <num_y_chunks> -s <seed>");
+	puts("  edit  -x <num_x_chunks> -y <num_y_chunks> -s <seed> -n <edits>");
+	puts("  stream  -s <seed> -r <radius> -k <keep radius> -n <frames> -v <blocks per frame> -p <path radius in chunks> -b <hulls per update> -t <threads, 0 for all cores> [-d <region directory>]");
+	puts("  region  -x <num_x_chunks> -y <num_y_chunks> -s <seed> -d <directory>");
+	puts("  cache  -s <seed> -r <radius> -k <keep radius> -n <frames> -v <blocks per frame> -p <path radius in chunks> -t <threads, 0 for all cores> -m <budget in KB> -e <edits> -d <region directory>");
+	puts("  frames  -s <seed> -r <radius> -n <frames> -v <blocks per frame> -e <edits per frame> -g <greedy meshes, 0 or 1> -t <threads, 0 for all cores>");
+	puts("  frustum  -x <num_x_chunks> -y <num_y_chunks> -s <seed> -n <random boxes> -i <iterations>");
+	puts("  occlusion  -x <num_x_chunks> -y <num_y_chunks> -s <seed> -n <camera poses> -o <occluder chunks>");
+	puts("  lod  -x <num_x_chunks> -y <num_y_chunks> -s <seed>");
+	puts("  arena  -x <num_x_chunks> -y <num_y_chunks> -s <seed> -n <ops> -r <resident chunks>");
+	puts("  hull  -x <num_x_chunks> -y <num_y_chunks> -s <seed> -n <iterations>");
+	puts("  occupancy  -x <num_x_chunks> -y <num_y_chunks> -s <seed> -n <iterations>");
+	puts("  density  -x <num_x_chunks> -y <num_y_chunks> -s <seed>");
+	puts("  raycast  -x <num_x_chunks> -y <num_y_chunks> -s <seed> -n <rays> -m <max distance> -t <threads, 0 for all cores>");
+	puts("  trace  -x <num_x_chunks> -y <num_y_chunks> -s <seed> -w <width> -h <height> -t <max threads, 0 for all cores> -e <eye x,y,z> -f <front x,y,z> -o <tga path>");
+	puts("  ao  -x <num_x_chunks> -y <num_y_chunks> -s <seed> -n <iterations>");
+	puts("  light  -x <num_x_chunks> -y <num_y_chunks> -s <seed> -n <edits> -l <lamps> -i <relight iterations>");
+	puts("  profile  -x <num_x_chunks> -y <num_y_chunks> -s <seed> -t <threads, 0 for all cores> -n <stream frames> -e <edits> -o <trace path>");
+	puts("every bench takes -c 1 to build density terrain with caves and overhangs instead of the heightmap");
+}
+
+int main(int argc, char **argv) {
+	const char *name = argc > 1 ? argv[1] : "world";
+	world_terrain = arg_u32(argc, argv, "-c", 0) ? TERRAIN_DENSITY : TERRAIN_HEIGHTMAP;
+
+	u32 num_benches = ARRAY_SIZE(benches);
+	for (u32 i = 0; i < num_benches; i++) {
+		if (!strcmp(benches[i].name, name)) {
+			benches[i].run(argc, argv);
+			return 0;
+		}
+	}
+
+	print_usage();
+	return 1;
+}
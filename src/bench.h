@@ -0,0 +1,100 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+
+#include "common.h"
+
+typedef struct Samples {
+	f64 *values;
+	u32 count;
+	u32 capacity;
+} Samples;
+
+// ru_maxrss is kilobytes on linux and bytes on OSX
+u64 get_peak_rss() {
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+	return (u64)usage.ru_maxrss;
+#else
+	return (u64)usage.ru_maxrss * 1024;
+#endif
+}
+
+void samples_push(Samples *s, f64 value) {
+	if (s->count == s->capacity) {
+		s->capacity = s->capacity ? s->capacity * 2 : 256;
+		s->values = (f64 *)realloc(s->values, sizeof(f64) * s->capacity);
+	}
+	s->values[s->count++] = value;
+}
+
+void samples_free(Samples *s) {
+	free(s->values);
+	memset(s, 0, sizeof(Samples));
+}
+
+int compare_f64(const void *a, const void *b) {
+	f64 x = *(const f64 *)a;
+	f64 y = *(const f64 *)b;
+	return (x > y) - (x < y);
+}
+
+f64 samples_total(Samples *s) {
+	f64 total = 0.0;
+	for (u32 i = 0; i < s->count; i++) {
+		total += s->values[i];
+	}
+	return total;
+}
+
+// Nearest-rank percentile, sorts the samples in place
+f64 samples_percentile(Samples *s, f64 p) {
+	if (s->count == 0) {
+		return 0.0;
+	}
+
+	qsort(s->values, s->count, sizeof(f64), compare_f64);
+
+	u32 rank = (u32)((p / 100.0) * (f64)s->count + 0.5);
+	if (rank > 0) {
+		rank--;
+	}
+	if (rank >= s->count) {
+		rank = s->count - 1;
+	}
+	return s->values[rank];
+}
+
+// Samples are expected in nanoseconds, reported in microseconds
+void print_samples_json(const char *name, Samples *s) {
+	printf("\"%s\": {\"count\": %u, \"total_ms\": %.3f, \"p50_us\": %.3f, \"p90_us\": %.3f, \"p99_us\": %.3f, \"max_us\": %.3f}",
+		name, s->count, samples_total(s) / 1e6,
+		samples_percentile(s, 50.0) / 1e3, samples_percentile(s, 90.0) / 1e3,
+		samples_percentile(s, 99.0) / 1e3, samples_percentile(s, 100.0) / 1e3);
+}
+
+// Looks up "-flag value" in argv, falling back to default_value
+u32 arg_u32(int argc, char **argv, const char *flag, u32 default_value) {
+	for (i32 i = 0; i < argc - 1; i++) {
+		if (!strcmp(argv[i], flag)) {
+			return (u32)strtoul(argv[i + 1], NULL, 10);
+		}
+	}
+	return default_value;
+}
+
+const char *arg_str(int argc, char **argv, const char *flag, const char *default_value) {
+	for (i32 i = 0; i < argc - 1; i++) {
+		if (!strcmp(argv[i], flag)) {
+			return argv[i + 1];
+		}
+	}
+	return default_value;
+}
+
+#endif
@@ -0,0 +1,382 @@
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "common.h"
+#include "chunk.h"
+#include "region.h"
+
+// Keeps chunks the stream lets go of, under a byte budget shared with the loaded chunks.
+// Chunks are in one of three tiers:
+// hot - loaded by the stream, hulled, lit and instanced (chunk_bytes each)
+// warm - just the region encoding of their heights, voxels and emitters (region.h), a few hundred
+//        bytes for heightmap terrain. Coming back they are decoded instead of generated or read from
+//        disk, then hulled, lit and instanced again.
+// cold - dropped, edits written to the region store first. A chunk whose edits cannot be written,
+//        with no store or a failed write, stays warm. The last CACHE_COLD_RECORDS dropped are
+//        remembered so coming back counts as a rebuild caused by eviction.
+// The stream demotes chunks to warm as they leave keep_radius, and sooner when the hot chunks alone
+// go over the budget (see stream_fit_budget). Warm chunks go cold least recently used first, the
+// furthest from the camera first among those that went warm together. The table and the cold
+// records count toward the budget too, so the cache stays within it however far the camera goes.
+
+typedef struct CacheEntry {
+	i32 cx;
+	i32 cz;
+	// malloced encoding, NULL for a cold chunk
+	u8 *data;
+	u32 size;
+	u32 encoding;
+	// cache_tick count when the chunk went warm
+	u64 last_used;
+	bool used;
+	// edited since last saved, written to the store as it goes cold
+	bool unsaved;
+} CacheEntry;
+
+#define CACHE_COLD_RECORDS 1024
+
+typedef struct ColdRecord {
+	i32 cx;
+	i32 cz;
+	bool used;
+} ColdRecord;
+
+typedef struct CacheStats {
+	// loads served by the warm tier
+	u64 hits;
+	// loads that had to read the store or generate
+	u64 misses;
+	// misses on chunks the cache had dropped, regenerated or read back because of the budget
+	u64 cold_rebuilds;
+	// hot to warm, and those of them forced by the budget rather than keep_radius
+	u64 demoted;
+	u64 budget_demoted;
+	// warm to cold
+	u64 dropped;
+	// demotions whose encoding failed, freed (and saved) as if there were no cache
+	u64 unencodable;
+	// drops refused because the chunk's edits could not be written, it stayed warm
+	u64 unsaved_kept;
+
+	u32 warm_chunks;
+	u32 cold_chunks;
+	// encodings of the warm chunks
+	u64 warm_bytes;
+	// the hash table and its trimming scratch, used slots or not, and the cold records
+	u64 table_bytes;
+	u64 cold_bytes;
+} CacheStats;
+
+typedef struct ChunkCache {
+	pthread_mutex_t lock;
+	// bytes of hot and warm chunks together
+	u64 budget;
+
+	// warm chunks, open addressing by chunk coordinate with linear probing, a power of two in size
+	CacheEntry *entries;
+	u32 capacity;
+	u32 count;
+
+	// ring of the chunks dropped last, cold_next is the oldest
+	ColdRecord *cold;
+	u32 cold_next;
+
+	u64 clock;
+	// scratch for ordering warm entries when trimming, as long as the table
+	CacheEntry **order;
+
+	// camera chunk, for breaking LRU ties
+	i32 centre_x;
+	i32 centre_z;
+
+	CacheStats stats;
+} ChunkCache;
+
+ChunkCache *cache_create(u64 budget) {
+	ChunkCache *cache = (ChunkCache *)calloc(1, sizeof(ChunkCache));
+	pthread_mutex_init(&cache->lock, NULL);
+	cache->budget = budget;
+	cache->capacity = 1024;
+	cache->entries = (CacheEntry *)calloc(cache->capacity, sizeof(CacheEntry));
+	cache->order = (CacheEntry **)malloc(sizeof(CacheEntry *) * cache->capacity);
+	cache->cold = (ColdRecord *)calloc(CACHE_COLD_RECORDS, sizeof(ColdRecord));
+	cache->stats.table_bytes = (sizeof(CacheEntry) + sizeof(CacheEntry *)) * cache->capacity;
+	cache->stats.cold_bytes = sizeof(ColdRecord) * CACHE_COLD_RECORDS;
+	return cache;
+}
+
+u32 cache_hash(i32 cx, i32 cz) {
+	u32 h = (u32)cx * 0x9E3779B1u ^ (u32)cz * 0x85EBCA77u;
+	return h ^ (h >> 15);
+}
+
+// The entry for (cx, cz), or the empty slot it would go in
+CacheEntry *cache_slot(ChunkCache *cache, i32 cx, i32 cz) {
+	u32 mask = cache->capacity - 1;
+	u32 i = cache_hash(cx, cz) & mask;
+	while (cache->entries[i].used && (cache->entries[i].cx != cx || cache->entries[i].cz != cz)) {
+		i = (i + 1) & mask;
+	}
+	return &cache->entries[i];
+}
+
+// Moves the entries still holding an encoding to a table of capacity slots
+void cache_rehash(ChunkCache *cache, u32 capacity) {
+	CacheEntry *old = cache->entries;
+	u32 old_capacity = cache->capacity;
+	cache->capacity = capacity;
+	cache->entries = (CacheEntry *)calloc(cache->capacity, sizeof(CacheEntry));
+	cache->count = 0;
+	for (u32 i = 0; i < old_capacity; i++) {
+		if (old[i].used && old[i].data) {
+			*cache_slot(cache, old[i].cx, old[i].cz) = old[i];
+			cache->count++;
+		}
+	}
+	free(old);
+	cache->order = (CacheEntry **)realloc(cache->order, sizeof(CacheEntry *) * cache->capacity);
+	cache->stats.table_bytes = (sizeof(CacheEntry) + sizeof(CacheEntry *)) * cache->capacity;
+}
+
+// Empties the entry's slot, shifting back the entries after it that probed past it
+void cache_remove(ChunkCache *cache, CacheEntry *entry) {
+	u32 mask = cache->capacity - 1;
+	u32 hole = (u32)(entry - cache->entries);
+	u32 i = hole;
+	for (;;) {
+		i = (i + 1) & mask;
+		if (!cache->entries[i].used) {
+			break;
+		}
+		// an entry stays put when its home lies cyclically in (hole, i]
+		u32 home = cache_hash(cache->entries[i].cx, cache->entries[i].cz) & mask;
+		if (((i - home) & mask) < ((i - hole) & mask)) {
+			continue;
+		}
+		cache->entries[hole] = cache->entries[i];
+		hole = i;
+	}
+	memset(&cache->entries[hole], 0, sizeof(CacheEntry));
+	cache->count--;
+}
+
+void cache_remember_cold(ChunkCache *cache, i32 cx, i32 cz) {
+	ColdRecord *record = &cache->cold[cache->cold_next];
+	cache->stats.cold_chunks += !record->used;
+	record->cx = cx;
+	record->cz = cz;
+	record->used = true;
+	cache->cold_next = (cache->cold_next + 1) % CACHE_COLD_RECORDS;
+}
+
+// Forgets (cx, cz) if it is among the chunks dropped last, true when it was
+bool cache_forget_cold(ChunkCache *cache, i32 cx, i32 cz) {
+	for (u32 i = 0; i < CACHE_COLD_RECORDS; i++) {
+		ColdRecord *record = &cache->cold[i];
+		if (record->used && record->cx == cx && record->cz == cz) {
+			record->used = false;
+			cache->stats.cold_chunks--;
+			return true;
+		}
+	}
+	return false;
+}
+
+// Demotes a chunk the stream is letting go of to warm, the caller still frees it. False when it
+// does not encode, the caller saves it as without a cache then.
+bool cache_put(ChunkCache *cache, Chunk *chunk) {
+	PROFILE_ZONE("cache_put");
+	u8 *encoded = (u8 *)malloc(chunk_encoding_bound(chunk));
+	u32 encoding;
+	u32 size = encode_chunk(chunk, encoded, &encoding);
+	if (size == 0) {
+		free(encoded);
+		cache->stats.unencodable++;
+		return false;
+	}
+	encoded = (u8 *)realloc(encoded, size);
+
+	pthread_mutex_lock(&cache->lock);
+	if ((cache->count + 1) * 2 > cache->capacity) {
+		cache_rehash(cache, cache->capacity * 2);
+	}
+
+	i32 cx = chunk->x_off / (i32)chunk_width;
+	i32 cz = chunk->z_off / (i32)chunk_depth;
+	CacheEntry *entry = cache_slot(cache, cx, cz);
+	cache->count++;
+
+	entry->cx = cx;
+	entry->cz = cz;
+	entry->data = encoded;
+	entry->size = size;
+	entry->encoding = encoding;
+	entry->last_used = cache->clock;
+	entry->used = true;
+	entry->unsaved = chunk->unsaved;
+
+	cache->stats.demoted++;
+	cache->stats.warm_chunks++;
+	cache->stats.warm_bytes += size;
+	pthread_mutex_unlock(&cache->lock);
+	return true;
+}
+
+// Chunk (cx, cz) decoded from the warm tier, which lets go of it, NULL on a miss. Safe from the job system.
+Chunk *cache_take(ChunkCache *cache, i32 cx, i32 cz) {
+	pthread_mutex_lock(&cache->lock);
+	CacheEntry *entry = cache_slot(cache, cx, cz);
+
+	Chunk *chunk = NULL;
+	if (entry->used) {
+		chunk = alloc_chunk(cx, cz);
+		decode_chunk(entry->data, entry->size, entry->encoding, chunk);
+		chunk->unsaved = entry->unsaved;
+
+		free(entry->data);
+		cache->stats.hits++;
+		cache->stats.warm_chunks--;
+		cache->stats.warm_bytes -= entry->size;
+		cache_remove(cache, entry);
+	} else {
+		cache->stats.misses++;
+		cache->stats.cold_rebuilds += cache_forget_cold(cache, cx, cz);
+	}
+
+	pthread_mutex_unlock(&cache->lock);
+	return chunk;
+}
+
+// Drops a warm entry's encoding, writing it to store first when it holds unsaved edits. False, the
+// entry staying warm, when the edits cannot be written: there is no store or the write failed.
+// The caller removes dropped entries from the table.
+bool cache_drop(ChunkCache *cache, CacheEntry *entry, RegionStore *store) {
+	if (entry->unsaved && (store == NULL || !region_write_chunk(store, entry->cx, entry->cz, entry->data, entry->size, entry->encoding))) {
+		cache->stats.unsaved_kept++;
+		return false;
+	}
+
+	cache->stats.warm_chunks--;
+	cache->stats.warm_bytes -= entry->size;
+	cache->stats.dropped++;
+	cache_remember_cold(cache, entry->cx, entry->cz);
+
+	free(entry->data);
+	entry->data = NULL;
+	entry->size = 0;
+	entry->unsaved = false;
+	return true;
+}
+
+i32 cache_centre_dist2(ChunkCache *cache, CacheEntry *entry) {
+	i32 dx = entry->cx - cache->centre_x;
+	i32 dz = entry->cz - cache->centre_z;
+	return dx * dx + dz * dz;
+}
+
+// qsort has no context pointer, the cache is stashed here while sorting
+ChunkCache *sorting_cache = NULL;
+
+int compare_cache_entry(const void *a, const void *b) {
+	CacheEntry *ea = *(CacheEntry **)a;
+	CacheEntry *eb = *(CacheEntry **)b;
+	if (ea->last_used != eb->last_used) {
+		return ea->last_used < eb->last_used ? -1 : 1;
+	}
+	i32 da = cache_centre_dist2(sorting_cache, ea);
+	i32 db = cache_centre_dist2(sorting_cache, eb);
+	return (db > da) - (db < da);
+}
+
+// Bytes the cache holds besides the warm chunks, its table and cold records
+u64 cache_overhead(ChunkCache *cache) {
+	return cache->stats.table_bytes + cache->stats.cold_bytes;
+}
+
+u64 cache_bytes(ChunkCache *cache) {
+	return cache->stats.warm_bytes + cache_overhead(cache);
+}
+
+// Drops warm chunks until they fit in what the hot ones, the table and the cold records leave of the
+// budget, then shrinks the table to what is left in it
+void cache_trim(ChunkCache *cache, u64 hot_bytes, RegionStore *store) {
+	PROFILE_ZONE("cache_trim");
+	pthread_mutex_lock(&cache->lock);
+	u64 fixed = hot_bytes + cache_overhead(cache);
+	u64 room = fixed < cache->budget ? cache->budget - fixed : 0;
+	if (cache->stats.warm_bytes <= room) {
+		pthread_mutex_unlock(&cache->lock);
+		return;
+	}
+
+	u32 count = 0;
+	for (u32 i = 0; i < cache->capacity; i++) {
+		if (cache->entries[i].used) {
+			cache->order[count++] = &cache->entries[i];
+		}
+	}
+
+	sorting_cache = cache;
+	qsort(cache->order, count, sizeof(CacheEntry *), compare_cache_entry);
+	sorting_cache = NULL;
+
+	// dropping only clears an entry's data, so the pointers stay valid until the rehash
+	u32 dropped = 0;
+	for (u32 i = 0; i < count && cache->stats.warm_bytes > room; i++) {
+		dropped += cache_drop(cache, cache->order[i], store);
+	}
+	if (dropped) {
+		u32 capacity = cache->capacity;
+		while (capacity > 1024 && cache->stats.warm_chunks * 4 < capacity / 2) {
+			capacity /= 2;
+		}
+		cache_rehash(cache, capacity);
+	}
+	pthread_mutex_unlock(&cache->lock);
+}
+
+// Moves the clock and the camera chunk, called by the stream once per update
+void cache_tick(ChunkCache *cache, i32 centre_x, i32 centre_z) {
+	pthread_mutex_lock(&cache->lock);
+	cache->clock++;
+	cache->centre_x = centre_x;
+	cache->centre_z = centre_z;
+	pthread_mutex_unlock(&cache->lock);
+}
+
+// Writes every warm chunk with unsaved edits to store, e.g. before exiting
+void cache_flush(ChunkCache *cache, RegionStore *store) {
+	pthread_mutex_lock(&cache->lock);
+	for (u32 i = 0; store && i < cache->capacity; i++) {
+		CacheEntry *entry = &cache->entries[i];
+		if (entry->used && entry->unsaved &&
+			region_write_chunk(store, entry->cx, entry->cz, entry->data, entry->size, entry->encoding)) {
+			entry->unsaved = false;
+		}
+	}
+	pthread_mutex_unlock(&cache->lock);
+}
+
+// Share of loads the warm tier served
+f64 cache_hit_rate(ChunkCache *cache) {
+	u64 loads = cache->stats.hits + cache->stats.misses;
+	return loads ? (f64)cache->stats.hits / loads : 0.0;
+}
+
+// Unsaved warm chunks are lost, cache_flush them first
+void cache_destroy(ChunkCache *cache) {
+	for (u32 i = 0; i < cache->capacity; i++) {
+		free(cache->entries[i].data);
+	}
+	free(cache->entries);
+	free(cache->cold);
+	free(cache->order);
+	pthread_mutex_destroy(&cache->lock);
+	free(cache);
+}
+
+#endif
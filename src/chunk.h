@@ -0,0 +1,1076 @@
+#ifndef CHUNK_H
+#define CHUNK_H
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <glm/glm.hpp>
+
+#include "common.h"
+#include "point.h"
+#include "perlin_simd.h"
+#include "section.h"
+#include "occupancy.h"
+#include "light.h"
+#include "arena.h"
+#include "pool.h"
+#include "profile.h"
+
+u32 chunk_width = 16;
+u32 chunk_height = 256;
+u32 chunk_depth = 16;
+u32 chunk_size = chunk_width * chunk_height * chunk_depth;
+
+u32 num_x_chunks = 9;
+u32 num_y_chunks = 9;
+u32 num_chunks = num_x_chunks * num_y_chunks;
+
+// Level 0 is full resolution, level l is drawn with blocks 2^l wide (see lod.h)
+#define LOD_LEVELS 4
+
+// Offsets the noise lookup so different seeds give different worlds, 0 is the original world
+u32 world_seed = 0;
+
+typedef enum TerrainKind {
+	// columns solid from the bottom up to their height
+	TERRAIN_HEIGHTMAP,
+	// 3D density with overhangs and caves (see generate_density_chunk)
+	TERRAIN_DENSITY,
+} TerrainKind;
+
+TerrainKind world_terrain = TERRAIN_HEIGHTMAP;
+
+void set_world_size(u32 x_chunks, u32 y_chunks) {
+	num_x_chunks = x_chunks;
+	num_y_chunks = y_chunks;
+	num_chunks = num_x_chunks * num_y_chunks;
+}
+
+// Greedy meshed faces of a chunk, built by greedy.h
+typedef struct MeshVertex {
+	// chunk-local corner position and tile_colors index, the renderer packs the chunk's draw slot
+	// into the bits of color above the index at upload
+	u16 x;
+	u16 y;
+	u16 z;
+	u16 color;
+} MeshVertex;
+
+typedef struct ChunkMesh {
+	MeshVertex *vertices;
+	u32 *indices;
+	u32 num_vertices;
+	u32 num_indices;
+	u32 vertex_capacity;
+	u32 index_capacity;
+
+	u32 num_quads;
+	// unit faces covered by the quads
+	u64 area;
+
+	// where the mesh lives in the renderer's shared vertex and index buffers, count 0 until first upload
+	ArenaRange vertex_range;
+	ArenaRange index_range;
+	bool dirty;
+	// set by block edits (edit.h), the mesh no longer matches the hull until rebuilt
+	bool stale;
+} ChunkMesh;
+
+typedef struct Chunk {
+	ChunkStorage *pre_render_list;
+	u8 *real_blocks;
+	// solid voxels per column, indexed like real_blocks. What the hull is built from, real_blocks is
+	// each column's highest solid voxel. Generation, loading and edits keep the two in step.
+	OccupancyColumn *occupancy;
+	// highest entry of real_blocks, raycasts skip chunks they pass above. Edits only raise it.
+	u8 top;
+
+	glm::vec3 *positions;
+	glm::vec3 *colors;
+	u32 *instances;
+	// AO_FACES bytes per instance, the ambient occlusion of its faces (see ao_column)
+	u8 *ao_bits;
+	// AO_FACES bytes per instance, the light of the voxel in front of each face (see instance_light)
+	u8 *light_bits;
+
+	u64 num_blocks;
+	u64 instance_capacity;
+
+	// lowest and highest hull block, with x_off and z_off they bound the chunk for culling.
+	// update_chunk sets them, update_column only widens them.
+	u32 y_min;
+	u32 y_max;
+
+	// the chunk's entry in the renderer's origin table, 0 until first upload (see render.h)
+	u32 draw_slot;
+	// where the instances live in the renderer's shared instance buffer, count 0 until first upload
+	ArenaRange instance_range;
+	// set by update_chunk and when the renderer moves the range, cleared once the instances are uploaded
+	bool dirty;
+
+	// NULL until build_chunk_mesh runs
+	ChunkMesh *mesh;
+	// downsampled meshes, NULL until build_lod_mesh runs. lod_meshes[0] stays NULL, level 0 draws the hull
+	ChunkMesh *lod_meshes[LOD_LEVELS];
+	// level the chunk was last drawn at, lod_select moves it with hysteresis
+	u8 lod;
+
+	// indexed by ChunkSide, NULL past the edge of the world or of what is loaded
+	struct Chunk *neighbours[4];
+
+	// light of every voxel, filled in by light_chunk (lighting.h). Until lit is set the chunk is
+	// taken to be open sky throughout and light does not spread into it.
+	ChunkLight light;
+	bool lit;
+	// set while the chunk is on the light engine's list of chunks with out of date light_bits
+	bool light_changed;
+	// blocks giving off light, the array stays in the slot for the next chunk
+	LightEmitter *emitters;
+	u32 num_emitters;
+	u32 emitter_capacity;
+
+	// heights differ from what is on disk, set for generated and edited chunks (see region.h)
+	bool unsaved;
+
+	// world block coordinates of the chunk's (0, 0) column
+	i32 x_off;
+	i32 z_off;
+} Chunk;
+
+typedef enum ChunkSide {
+	SIDE_POS_X,
+	SIDE_NEG_X,
+	SIDE_POS_Z,
+	SIDE_NEG_Z,
+} ChunkSide;
+
+ChunkSide opposite_side(u32 side) {
+	return (ChunkSide)(side ^ 1);
+}
+
+// Every chunk lives in a slot of chunk_pool: the Chunk, its storage, the storage's section headers
+// its occupancy and its heights side by side. The instance arrays come from instance_pools, one pool per power of
+// two capacity with a chunk's positions, colors and instances back to back in one slot. A freed
+// chunk gives both back and frees its meshes, so once the pools have grown to what is loaded at
+// once, loading and unloading chunks allocates nothing outside the section payloads, which follow
+// what the hull holds (see section.h), and the meshes, which are built as chunks are drawn.
+Pool chunk_pool;
+// slots the pool grows by when it runs out, stream_create reserves its whole window up front
+u32 chunk_pool_block = 64;
+pthread_once_t chunk_pool_once = PTHREAD_ONCE_INIT;
+
+// capacities 256 << class, the last holds a completely full chunk
+#define MIN_INSTANCE_CAPACITY 256
+#define INSTANCE_CLASSES 9
+Pool instance_pools[INSTANCE_CLASSES];
+
+// Faces of a cube instance, one ao_bits and one light_bits byte each
+#define AO_FACES 6
+
+u64 instance_slot_bytes(u64 capacity) {
+	return (sizeof(glm::vec3) * 2 + sizeof(u32) + AO_FACES * 2) * capacity;
+}
+
+void chunk_pool_setup() {
+	u32 num_sections = chunk_height / SECTION_SIZE;
+	pool_init(&chunk_pool, sizeof(Chunk) + sizeof(ChunkStorage) + sizeof(Section) * num_sections +
+		(sizeof(OccupancyColumn) + 1) * chunk_width * chunk_depth, chunk_pool_block);
+
+	// blocks of about 256KB, at least one slot
+	for (u32 c = 0; c < INSTANCE_CLASSES; c++) {
+		u64 slot_bytes = instance_slot_bytes(MIN_INSTANCE_CAPACITY << c);
+		u32 per_block = (u32)((256 * 1024) / slot_bytes);
+		pool_init(&instance_pools[c], slot_bytes, per_block ? per_block : 1);
+	}
+
+	// 16 sections to a block, most chunks hold only a few
+	pool_init(&light_pool, SECTION_VOLUME, 16);
+}
+
+u32 instance_class(u64 capacity) {
+	u32 c = 0;
+	while ((u64)(MIN_INSTANCE_CAPACITY << c) < capacity) {
+		c++;
+	}
+	return c;
+}
+
+// Live chunks, their high-water mark and the bytes all the pools hold on to
+PoolStats chunk_pool_stats() {
+	PoolStats stats = chunk_pool.stats;
+	stats.bytes_reserved += light_pool.stats.bytes_reserved;
+	stats.blocks += light_pool.stats.blocks;
+	for (u32 c = 0; c < INSTANCE_CLASSES; c++) {
+		stats.bytes_reserved += instance_pools[c].stats.bytes_reserved;
+		stats.blocks += instance_pools[c].stats.blocks;
+	}
+	return stats;
+}
+
+void chunk_pool_reserve(u32 count) {
+	pthread_once(&chunk_pool_once, chunk_pool_setup);
+	pool_reserve(&chunk_pool, count);
+}
+
+// Frees a mesh and its buffers, idle pool slots hold none so they cost nothing against a budget
+void free_mesh(ChunkMesh **mesh) {
+	if (*mesh == NULL) {
+		return;
+	}
+
+	free((*mesh)->vertices);
+	free((*mesh)->indices);
+	free(*mesh);
+	*mesh = NULL;
+}
+
+u64 mesh_bytes(ChunkMesh *mesh) {
+	if (mesh == NULL) {
+		return 0;
+	}
+	return sizeof(ChunkMesh) + sizeof(MeshVertex) * mesh->vertex_capacity + sizeof(u32) * mesh->index_capacity;
+}
+
+// A chunk with its heights zeroed for the caller to fill.
+// x_off and z_off are in chunks, negative chunks extend the world past the origin
+Chunk *alloc_chunk(i32 x_off, i32 z_off) {
+	pthread_once(&chunk_pool_once, chunk_pool_setup);
+	Chunk *chunk = (Chunk *)pool_take(&chunk_pool);
+	ChunkStorage *storage = (ChunkStorage *)(chunk + 1);
+	Section *sections = (Section *)(storage + 1);
+
+	// a fresh slot is zeroed, a recycled one still holds its last chunk's buffers
+	if (storage->sections == NULL) {
+		storage->sections = sections;
+		storage->num_sections = chunk_height / SECTION_SIZE;
+	}
+
+	chunk->num_blocks = 0;
+	chunk->y_min = 0;
+	chunk->y_max = 0;
+	chunk->draw_slot = 0;
+	memset(&chunk->instance_range, 0, sizeof(ArenaRange));
+	chunk->dirty = false;
+	chunk->lod = 0;
+	memset(chunk->neighbours, 0, sizeof(chunk->neighbours));
+	chunk->pre_render_list = storage;
+	chunk->x_off = x_off * (i32)chunk_width;
+	chunk->z_off = z_off * (i32)chunk_depth;
+	chunk->unsaved = false;
+	light_clear(&chunk->light);
+	chunk->lit = false;
+	chunk->light_changed = false;
+	chunk->num_emitters = 0;
+
+	chunk->occupancy = (OccupancyColumn *)(sections + storage->num_sections);
+	chunk->real_blocks = (u8 *)(chunk->occupancy + chunk_width * chunk_depth);
+	memset(chunk->real_blocks, 0, chunk_width * chunk_depth);
+	chunk->top = 0;
+	return chunk;
+}
+
+void set_chunk_top(Chunk *chunk) {
+	u8 top = 0;
+	for (u32 i = 0; i < chunk_width * chunk_depth; i++) {
+		top = chunk->real_blocks[i] > top ? chunk->real_blocks[i] : top;
+	}
+	chunk->top = top;
+}
+
+// Surface height of count columns step apart along x from world column (wx, wz), three octaves of
+// noise evaluated as one batch per octave. Unclamped, count is at most SECTION_SIZE + 1.
+void surface_heights(i32 wx, i32 wz, u32 step, u32 count, f32 *out) {
+	u32 seed_x = (world_seed * 7919) & 0xFFFF;
+	u32 seed_z = (world_seed * 104729) & 0xFFFF;
+	f32 avg_height = chunk_height / 2;
+
+	f32 noise_buffer[(SECTION_SIZE + 1) * 6];
+	f32 *xs = noise_buffer;
+	f32 *ys = xs + count;
+	f32 *zs = ys + count;
+	f32 *noise = zs + count;
+
+	for (u8 o = 5; o < 8; o++) {
+		f32 scale = (f32)(2 << o) * 1.01f;
+		for (u32 i = 0; i < count; i++) {
+			xs[i] = (f32)(wx + (i32)(i * step) + (i32)seed_x) / scale;
+			ys[i] = (f32)(wz + (i32)seed_z) / scale;
+			zs[i] = o * 2.0f;
+		}
+		perlin_noise3_batch(xs, ys, zs, noise + (o - 5) * count, count, 256, 256, 256);
+	}
+
+	for (u32 i = 0; i < count; i++) {
+		f32 column_height = avg_height;
+		for (u8 o = 5; o < 8; o++) {
+			column_height += (f32)(o << 4) * noise[(o - 5) * count + i];
+		}
+		out[i] = column_height;
+	}
+}
+
+// Sets each column's occupancy solid up to its height
+void fill_height_occupancy(Chunk *chunk) {
+	for (u32 i = 0; i < chunk_width * chunk_depth; i++) {
+		chunk->occupancy[i] = column_to_height(chunk->real_blocks[i]);
+	}
+}
+
+Chunk *generate_height_chunk(i32 x_off, i32 z_off) {
+	Chunk *chunk = alloc_chunk(x_off, z_off);
+	chunk->unsaved = true;
+	u8 *height_map = chunk->real_blocks;
+
+	f32 min_height = chunk_height / 5;
+
+	// chunk_width is SECTION_SIZE (see section.h)
+	f32 row[SECTION_SIZE];
+	for (u32 z = 0; z < chunk_depth; z++) {
+		surface_heights(chunk->x_off, (i32)z + chunk->z_off, 1, chunk_width, row);
+		for (u32 x = 0; x < chunk_width; x++) {
+			f32 column_height = row[x];
+			if (column_height > chunk_height) {
+				column_height = chunk_height;
+			}
+
+			if (column_height < min_height) {
+				column_height = min_height;
+			}
+
+			height_map[twod_to_oned(x, z, chunk_width)] = column_height;
+		}
+	}
+
+	fill_height_occupancy(chunk);
+	return chunk;
+}
+
+// Density terrain: solid where the density is above 0. Density falls off with height above the
+// surface of the heightmap terrain and two octaves of 3D noise on top carve overhangs and caves
+// out of the top DENSITY_FALLOFF or so blocks, below that the ground is solid. y = 0 is always
+// solid so nothing shows a face under the world.
+// The noise is only sampled every DENSITY_LATTICE blocks along each axis, 5 x 65 x 5 points for
+// a chunk's 16 x 256 x 16 voxels, and trilinearly interpolated in between. Lattice points are placed in world
+// coordinates, so neighbouring chunks agree along their shared face.
+#define DENSITY_LATTICE 4
+#define DENSITY_FALLOFF 32.0f
+
+// Density of count voxels up world column (wx, wz) starting at y_from, step apart, with the column's
+// surface height already known. count is at most chunk_height + 1.
+void column_density(i32 wx, i32 wz, f32 surface, u32 y_from, u32 step, u32 count, f32 *out) {
+	u32 seed_x = (world_seed * 7919) & 0xFFFF;
+	u32 seed_z = (world_seed * 104729) & 0xFFFF;
+
+	f32 noise_buffer[(OCCUPANCY_WORDS * 64 + 1) * 4];
+	f32 *xs = noise_buffer;
+	f32 *ys = xs + count;
+	f32 *zs = ys + count;
+	f32 *noise = zs + count;
+	for (u32 i = 0; i < count; i++) {
+		out[i] = (surface - (f32)(y_from + i * step)) / DENSITY_FALLOFF;
+	}
+
+	for (u8 o = 0; o < 2; o++) {
+		f32 scale = (f32)(24 << o);
+		for (u32 i = 0; i < count; i++) {
+			xs[i] = (f32)(wx + (i32)seed_x) / scale;
+			ys[i] = (f32)(y_from + i * step) / scale + o * 17.0f;
+			zs[i] = (f32)(wz + (i32)seed_z) / scale;
+		}
+		perlin_noise3_batch(xs, ys, zs, noise, count, 256, 256, 256);
+		for (u32 i = 0; i < count; i++) {
+			out[i] += noise[i] / (f32)(1 << o);
+		}
+	}
+}
+
+Chunk *generate_density_chunk(i32 x_off, i32 z_off) {
+	Chunk *chunk = alloc_chunk(x_off, z_off);
+	chunk->unsaved = true;
+
+	const u32 lattice_width = SECTION_SIZE / DENSITY_LATTICE + 1;
+	u32 lattice_height = chunk_height / DENSITY_LATTICE + 1;
+	f32 *lattice = (f32 *)malloc(sizeof(f32) * lattice_width * lattice_width * lattice_height);
+	for (u32 lz = 0; lz < lattice_width; lz++) {
+		i32 wz = chunk->z_off + (i32)(lz * DENSITY_LATTICE);
+		f32 surface[lattice_width];
+		surface_heights(chunk->x_off, wz, DENSITY_LATTICE, lattice_width, surface);
+		for (u32 lx = 0; lx < lattice_width; lx++) {
+			i32 wx = chunk->x_off + (i32)(lx * DENSITY_LATTICE);
+			f32 *corner = &lattice[twod_to_oned(lx, lz, lattice_width) * lattice_height];
+			column_density(wx, wz, surface[lx], 0, DENSITY_LATTICE, lattice_height, corner);
+		}
+	}
+
+	f32 column[OCCUPANCY_WORDS * 64 / DENSITY_LATTICE + 1];
+	for (u32 z = 0; z < chunk_depth; z++) {
+		for (u32 x = 0; x < chunk_width; x++) {
+			// the four lattice columns around this one, blended into one column of lattice points
+			u32 lx = x / DENSITY_LATTICE;
+			u32 lz = z / DENSITY_LATTICE;
+			f32 fx = (f32)(x % DENSITY_LATTICE) / DENSITY_LATTICE;
+			f32 fz = (f32)(z % DENSITY_LATTICE) / DENSITY_LATTICE;
+			f32 *c00 = &lattice[twod_to_oned(lx, lz, lattice_width) * lattice_height];
+			f32 *c10 = c00 + lattice_height;
+			f32 *c01 = c00 + lattice_width * lattice_height;
+			f32 *c11 = c01 + lattice_height;
+			for (u32 ly = 0; ly < lattice_height; ly++) {
+				f32 near = c00[ly] + (c10[ly] - c00[ly]) * fx;
+				f32 far = c01[ly] + (c11[ly] - c01[ly]) * fx;
+				column[ly] = near + (far - near) * fz;
+			}
+
+			// a span whose two ends agree is all solid or all empty, only spans crossing 0 interpolate
+			OccupancyColumn *solid = &chunk->occupancy[twod_to_oned(x, z, chunk_width)];
+			memset(solid, 0, sizeof(OccupancyColumn));
+			for (u32 ly = 0; ly + 1 < lattice_height; ly++) {
+				f32 below = column[ly];
+				f32 above = column[ly + 1];
+				if (below <= 0 && above <= 0) {
+					continue;
+				}
+
+				u32 y = ly * DENSITY_LATTICE;
+				u64 span = ((u64)1 << DENSITY_LATTICE) - 1;
+				if (below > 0 && above > 0) {
+					solid->words[y / 64] |= span << (y % 64);
+					continue;
+				}
+				for (u32 i = 0; i < DENSITY_LATTICE; i++) {
+					f32 density = below + (above - below) * ((f32)i / DENSITY_LATTICE);
+					solid->words[(y + i) / 64] |= (u64)(density > 0) << ((y + i) % 64);
+				}
+			}
+			solid->words[0] |= 1;
+			chunk->real_blocks[twod_to_oned(x, z, chunk_width)] = column_highest(*solid);
+		}
+	}
+
+	free(lattice);
+	return chunk;
+}
+
+Chunk *generate_chunk(i32 x_off, i32 z_off) {
+	PROFILE_ZONE("generate_chunk");
+	Chunk *chunk = world_terrain == TERRAIN_DENSITY ? generate_density_chunk(x_off, z_off) : generate_height_chunk(x_off, z_off);
+	set_chunk_top(chunk);
+	return chunk;
+}
+
+// Gives the chunk's slot back to chunk_pool and its instance arrays to instance_pools, and frees its meshes
+void free_chunk(Chunk *chunk) {
+	if (chunk->instance_capacity) {
+		pool_give(&instance_pools[instance_class(chunk->instance_capacity)], chunk->positions);
+		chunk->positions = NULL;
+		chunk->colors = NULL;
+		chunk->instances = NULL;
+		chunk->ao_bits = NULL;
+		chunk->light_bits = NULL;
+		chunk->instance_capacity = 0;
+	}
+	light_release(&chunk->light);
+	storage_clear(chunk->pre_render_list, 0);
+	free_mesh(&chunk->mesh);
+	for (u32 l = 0; l < LOD_LEVELS; l++) {
+		free_mesh(&chunk->lod_meshes[l]);
+	}
+	pool_give(&chunk_pool, chunk);
+}
+
+
+bool inside_chunk(u32 x, u32 y, u32 z) {
+	if (x < chunk_width && y < chunk_height && z < chunk_depth) {
+		return true;
+	}
+
+	return false;
+}
+
+bool voxel_solid(Chunk *chunk, u32 x, u32 y, u32 z) {
+	return (chunk->occupancy[twod_to_oned(x, z, chunk_width)].words[y / 64] >> (y % 64)) & 1;
+}
+
+// Sets the level of the emitter at chunk-local (x, y, z), adding it when there is none and
+// dropping it for level 0. Only the list, the light is spread by lighting.h.
+void chunk_set_emitter(Chunk *chunk, u32 x, u32 y, u32 z, u8 level) {
+	for (u32 e = 0; e < chunk->num_emitters; e++) {
+		LightEmitter *emitter = &chunk->emitters[e];
+		if (emitter->x == x && emitter->y == y && emitter->z == z) {
+			if (level) {
+				emitter->level = level;
+			} else {
+				*emitter = chunk->emitters[--chunk->num_emitters];
+			}
+			return;
+		}
+	}
+	if (level == 0) {
+		return;
+	}
+
+	if (chunk->num_emitters == chunk->emitter_capacity) {
+		chunk->emitter_capacity = chunk->emitter_capacity ? chunk->emitter_capacity * 2 : 8;
+		chunk->emitters = (LightEmitter *)realloc(chunk->emitters, sizeof(LightEmitter) * chunk->emitter_capacity);
+	}
+	LightEmitter emitter = {(u8)x, (u8)y, (u8)z, level};
+	chunk->emitters[chunk->num_emitters++] = emitter;
+}
+
+// The chunk across the corner between two sides, reached through either neighbour
+Chunk *chunk_diagonal(Chunk *chunk, ChunkSide x_side, ChunkSide z_side) {
+	Chunk *beside = chunk->neighbours[x_side];
+	if (beside && beside->neighbours[z_side]) {
+		return beside->neighbours[z_side];
+	}
+	beside = chunk->neighbours[z_side];
+	return beside ? beside->neighbours[x_side] : NULL;
+}
+
+// Fills solid with the chunk's occupancy plus a one column apron copied from the four
+// neighbours and the diagonal chunks, (chunk_width + 2) x (chunk_depth + 2) with the chunk's
+// (0, 0) at (1, 1). Where there is no neighbour (world edge, a diagonal not linked to) the apron
+// repeats the chunk's own edge.
+void fill_occupancy_apron(Chunk *chunk, OccupancyColumn *solid) {
+	u32 apron_width = chunk_width + 2;
+
+	for (u32 z = 0; z < chunk_depth + 2; z++) {
+		for (u32 x = 0; x < apron_width; x++) {
+			u32 cx = x == 0 ? 0 : (x > chunk_width ? chunk_width - 1 : x - 1);
+			u32 cz = z == 0 ? 0 : (z > chunk_depth ? chunk_depth - 1 : z - 1);
+			solid[twod_to_oned(x, z, apron_width)] = chunk->occupancy[twod_to_oned(cx, cz, chunk_width)];
+		}
+	}
+
+	for (u32 z = 0; z < chunk_depth; z++) {
+		if (chunk->neighbours[SIDE_NEG_X]) {
+			Chunk *other_chunk = chunk->neighbours[SIDE_NEG_X];
+			solid[twod_to_oned(0, z + 1, apron_width)] = other_chunk->occupancy[twod_to_oned(chunk_width - 1, z, chunk_width)];
+		}
+		if (chunk->neighbours[SIDE_POS_X]) {
+			Chunk *other_chunk = chunk->neighbours[SIDE_POS_X];
+			solid[twod_to_oned(chunk_width + 1, z + 1, apron_width)] = other_chunk->occupancy[twod_to_oned(0, z, chunk_width)];
+		}
+	}
+
+	for (u32 x = 0; x < chunk_width; x++) {
+		if (chunk->neighbours[SIDE_NEG_Z]) {
+			Chunk *other_chunk = chunk->neighbours[SIDE_NEG_Z];
+			solid[twod_to_oned(x + 1, 0, apron_width)] = other_chunk->occupancy[twod_to_oned(x, chunk_depth - 1, chunk_width)];
+		}
+		if (chunk->neighbours[SIDE_POS_Z]) {
+			Chunk *other_chunk = chunk->neighbours[SIDE_POS_Z];
+			solid[twod_to_oned(x + 1, chunk_depth + 1, apron_width)] = other_chunk->occupancy[twod_to_oned(x, 0, chunk_width)];
+		}
+	}
+
+	// only ambient occlusion reads the corners
+	ChunkSide x_sides[2] = {SIDE_NEG_X, SIDE_POS_X};
+	ChunkSide z_sides[2] = {SIDE_NEG_Z, SIDE_POS_Z};
+	for (u32 i = 0; i < 4; i++) {
+		Chunk *other_chunk = chunk_diagonal(chunk, x_sides[i & 1], z_sides[i >> 1]);
+		if (other_chunk) {
+			u32 ax = i & 1 ? chunk_width + 1 : 0;
+			u32 az = i >> 1 ? chunk_depth + 1 : 0;
+			u32 cx = i & 1 ? 0 : chunk_width - 1;
+			u32 cz = i >> 1 ? 0 : chunk_depth - 1;
+			solid[twod_to_oned(ax, az, apron_width)] = other_chunk->occupancy[twod_to_oned(cx, cz, chunk_width)];
+		}
+	}
+}
+
+// Points the chunk at its neighbours in a num_x_chunks x num_y_chunks grid
+void link_chunk(Chunk **chunks, u32 chunk_idx) {
+	Chunk *chunk = chunks[chunk_idx];
+	Point cp = oned_to_twod(chunk_idx, num_x_chunks);
+
+	chunk->neighbours[SIDE_POS_X] = cp.x < num_x_chunks - 1 ? chunks[twod_to_oned(cp.x + 1, cp.y, num_x_chunks)] : NULL;
+	chunk->neighbours[SIDE_NEG_X] = cp.x > 0 ? chunks[twod_to_oned(cp.x - 1, cp.y, num_x_chunks)] : NULL;
+	chunk->neighbours[SIDE_POS_Z] = cp.y < num_y_chunks - 1 ? chunks[twod_to_oned(cp.x, cp.y + 1, num_x_chunks)] : NULL;
+	chunk->neighbours[SIDE_NEG_Z] = cp.y > 0 ? chunks[twod_to_oned(cp.x, cp.y - 1, num_x_chunks)] : NULL;
+}
+
+// Tile of a column's wall facing each ChunkSide, the second when it faces into a neighbour chunk
+u8 hull_wall_tiles[4][2] = {
+	{3, 6},
+	{2, 7},
+	{5, 8},
+	{4, 9},
+};
+
+// Where two walls of a column overlap the first side here wins
+ChunkSide hull_wall_order[4] = {SIDE_POS_Z, SIDE_POS_X, SIDE_NEG_X, SIDE_NEG_Z};
+
+// The underside of an overhang or cave ceiling, only density terrain has them
+#define HULL_BOTTOM_TILE 10
+
+// Top, the four walls in hull_wall_order, bottom
+#define HULL_FACES 6
+
+// Index of the column beside apron column i
+u32 apron_beside(u32 i, ChunkSide side) {
+	u32 apron_width = chunk_width + 2;
+	switch (side) {
+		case SIDE_POS_X: return i + 1;
+		case SIDE_NEG_X: return i - 1;
+		case SIDE_POS_Z: return i + apron_width;
+		default: return i - apron_width;
+	}
+}
+
+// Whether the wall of column (x, z) facing side looks into the neighbour chunk
+bool wall_across(u32 x, u32 z, ChunkSide side) {
+	switch (side) {
+		case SIDE_POS_X: return x == chunk_width - 1;
+		case SIDE_NEG_X: return x == 0;
+		case SIDE_POS_Z: return z == chunk_depth - 1;
+		default: return z == 0;
+	}
+}
+
+// The hull of column (x, z) from the occupancy apron (see fill_occupancy_apron): a solid voxel is
+// a top when the voxel above is empty, in a wall when the voxel beside it is and a bottom when
+// the voxel below is, the world's floor counting as solid. A voxel showing several faces takes
+// the first of top, the walls in hull_wall_order and bottom. Fills faces and tiles with the
+// HULL_FACES classes and returns them all.
+// Border columns read the neighbour chunk from the apron like interior ones read the chunk, so
+// every column takes this one branch-free path. Done a word at a time, a word buried on every
+// side is skipped.
+OccupancyColumn hull_column_faces(OccupancyColumn *solid, u32 x, u32 z, OccupancyColumn *faces, u8 *tiles) {
+	u32 i = twod_to_oned(x + 1, z + 1, chunk_width + 2);
+	u64 *column = solid[i].words;
+
+	u64 *beside[4];
+	tiles[0] = 1;
+	for (u32 w = 0; w < 4; w++) {
+		ChunkSide side = hull_wall_order[w];
+		beside[w] = solid[apron_beside(i, side)].words;
+		tiles[w + 1] = hull_wall_tiles[side][wall_across(x, z, side)];
+	}
+	tiles[5] = HULL_BOTTOM_TILE;
+
+	OccupancyColumn hull;
+	for (u32 k = 0; k < OCCUPANCY_WORDS; k++) {
+		u64 above = (column[k] >> 1) | (k + 1 < OCCUPANCY_WORDS ? column[k + 1] << 63 : 0);
+		u64 below = (column[k] << 1) | (k > 0 ? column[k - 1] >> 63 : 1);
+		u64 covered = above & below & beside[0][k] & beside[1][k] & beside[2][k] & beside[3][k];
+		hull.words[k] = column[k] & ~covered;
+		if (hull.words[k] == 0) {
+			for (u32 f = 0; f < HULL_FACES; f++) {
+				faces[f].words[k] = 0;
+			}
+			continue;
+		}
+
+		u64 taken = column[k] & ~above;
+		faces[0].words[k] = taken;
+		for (u32 w = 0; w < 4; w++) {
+			faces[w + 1].words[k] = column[k] & ~beside[w][k] & ~taken;
+			taken |= faces[w + 1].words[k];
+		}
+		faces[5].words[k] = column[k] & ~below & ~taken;
+	}
+	return hull;
+}
+
+// Needs the chunk's neighbours generated and linked. Each section the hull reaches is filled in a
+// dense buffer first and packed once (section_load), rather than set voxel by voxel.
+void hull_chunk(Chunk *chunk) {
+	PROFILE_ZONE("hull_chunk");
+	ChunkStorage *list = chunk->pre_render_list;
+	storage_clear(list, 0);
+
+	OccupancyColumn solid[(SECTION_SIZE + 2) * (SECTION_SIZE + 2)];
+	fill_occupancy_apron(chunk, solid);
+
+	u32 columns = chunk_width * chunk_depth;
+	OccupancyColumn faces[SECTION_SIZE * SECTION_SIZE][HULL_FACES];
+	u8 tiles[SECTION_SIZE * SECTION_SIZE][HULL_FACES];
+	// every column's hull together, to skip the sections it misses
+	OccupancyColumn reached = {};
+	for (u32 c = 0; c < columns; c++) {
+		OccupancyColumn hull = hull_column_faces(solid, c % chunk_width, c / chunk_width, faces[c], tiles[c]);
+		for (u32 k = 0; k < OCCUPANCY_WORDS; k++) {
+			reached.words[k] |= hull.words[k];
+		}
+	}
+
+	u64 section_mask = ((u64)1 << SECTION_SIZE) - 1;
+	u8 values[SECTION_VOLUME];
+	for (u32 s = 0; s < list->num_sections; s++) {
+		u32 k = (s * SECTION_SIZE) / 64;
+		u32 shift = (s * SECTION_SIZE) % 64;
+		if (((reached.words[k] >> shift) & section_mask) == 0) {
+			continue;
+		}
+
+		memset(values, 0, sizeof(values));
+		for (u32 c = 0; c < columns; c++) {
+			u32 x = c % chunk_width;
+			u32 z = c / chunk_width;
+			for (u32 f = 0; f < HULL_FACES; f++) {
+				u64 bits = (faces[c][f].words[k] >> shift) & section_mask;
+				while (bits) {
+					values[section_index(x, __builtin_ctzll(bits), z)] = tiles[c][f];
+					bits &= bits - 1;
+				}
+			}
+		}
+		section_load(&list->sections[s], values);
+	}
+}
+
+// Rebuilds one column of a hulled chunk, giving the same tiles hull_chunk would
+void hull_column(Chunk *chunk, u32 x, u32 z) {
+	ChunkStorage *list = chunk->pre_render_list;
+
+	for (u32 s = 0; s < list->num_sections; s++) {
+		Section *section = &list->sections[s];
+		if (section->bits == 0 && section->value == 0) {
+			continue;
+		}
+		for (u32 sy = 0; sy < SECTION_SIZE; sy++) {
+			section_set(section, section_index(x, sy, z), 0);
+		}
+	}
+
+	OccupancyColumn solid[(SECTION_SIZE + 2) * (SECTION_SIZE + 2)];
+	fill_occupancy_apron(chunk, solid);
+
+	OccupancyColumn faces[HULL_FACES];
+	u8 tiles[HULL_FACES];
+	hull_column_faces(solid, x, z, faces, tiles);
+	for (u32 f = 0; f < HULL_FACES; f++) {
+		for (u32 k = 0; k < OCCUPANCY_WORDS; k++) {
+			u64 bits = faces[f].words[k];
+			while (bits) {
+				storage_set(list, x, k * 64 + __builtin_ctzll(bits), z, tiles[f]);
+				bits &= bits - 1;
+			}
+		}
+	}
+}
+
+// Colour per pre_render_list tile id, also uploaded as the shader's palette
+#define TILE_PALETTE_SIZE 16
+glm::vec3 tile_colors[TILE_PALETTE_SIZE] = {
+	glm::vec3(0.0, 0.0, 0.0),
+	//green
+	glm::vec3(0.0, 0.3, 0.0),
+	//blue
+	glm::vec3(0.0, 0.0, 1.0),
+	//GB
+	glm::vec3(1.0, 0.645, 0.0),
+	//RB
+	glm::vec3(1.0, 0.0, 1.0),
+	//red
+	glm::vec3(1.0, 0.0, 0.0),
+	//red
+	glm::vec3(0.5, 1.0, 0.8),
+	//gray
+	glm::vec3(0.255, 0.412, 0.88),
+	//white
+	glm::vec3(1.0, 1.0, 1.0),
+	//magenta
+	glm::vec3(0.9, 0.2, 0.5),
+	//brown, undersides
+	glm::vec3(0.45, 0.3, 0.15),
+};
+
+// Instances are packed into 4 bytes for upload, obj_vert.vsh unpacks them:
+// bits 0-3 chunk-local x, 4-7 chunk-local z, 8-15 y, 16-19 tile_colors index,
+// 20-31 the chunk's draw slot, filled in by the renderer at upload
+u32 pack_instance(u32 x, u32 y, u32 z, u32 color_idx) {
+	return (x & 15) | ((z & 15) << 4) | ((y & 255) << 8) | ((color_idx & 15) << 16);
+}
+
+// CPU copy of the shader's unpacking
+void unpack_instance(Chunk *chunk, u32 instance, glm::vec3 *position, glm::vec3 *color) {
+	*position = glm::vec3((i32)(instance & 15) + chunk->x_off, (instance >> 8) & 255, (i32)((instance >> 4) & 15) + chunk->z_off);
+	*color = tile_colors[((instance >> 16) & 15) % TILE_PALETTE_SIZE];
+}
+
+// Grows the instance arrays to hold at least count blocks, moving them to the next pool that fits
+void reserve_instances(Chunk *chunk, u64 count) {
+	if (count <= chunk->instance_capacity) {
+		return;
+	}
+
+	u32 c = instance_class(count);
+	assert(c < INSTANCE_CLASSES);
+	u64 capacity = MIN_INSTANCE_CAPACITY << c;
+	glm::vec3 *positions = (glm::vec3 *)pool_take(&instance_pools[c]);
+	glm::vec3 *colors = positions + capacity;
+	u32 *instances = (u32 *)(colors + capacity);
+	u8 *ao_bits = (u8 *)(instances + capacity);
+	u8 *light_bits = ao_bits + AO_FACES * capacity;
+
+	if (chunk->instance_capacity) {
+		// update_chunk grows the arrays before it sets num_blocks, so all of the old capacity is copied
+		memcpy(positions, chunk->positions, sizeof(glm::vec3) * chunk->instance_capacity);
+		memcpy(colors, chunk->colors, sizeof(glm::vec3) * chunk->instance_capacity);
+		memcpy(instances, chunk->instances, sizeof(u32) * chunk->instance_capacity);
+		memcpy(ao_bits, chunk->ao_bits, AO_FACES * chunk->instance_capacity);
+		memcpy(light_bits, chunk->light_bits, AO_FACES * chunk->instance_capacity);
+		pool_give(&instance_pools[instance_class(chunk->instance_capacity)], chunk->positions);
+	}
+
+	chunk->positions = positions;
+	chunk->colors = colors;
+	chunk->instances = instances;
+	chunk->ao_bits = ao_bits;
+	chunk->light_bits = light_bits;
+	chunk->instance_capacity = capacity;
+}
+
+// Cube faces in the order obj_vert.vsh draws them, by the axis of their normal and its sign
+typedef struct AoFace {
+	u32 axis;
+	i32 sign;
+} AoFace;
+
+AoFace ao_faces[AO_FACES] = {
+	{2, 1}, {1, 1}, {2, -1}, {1, -1}, {0, -1}, {0, 1},
+};
+
+// Corner c of a face sits at the low or high end of axis (axis + 1) % 3 by bit 0 of c and of
+// axis (axis + 2) % 3 by bit 1. Its ambient occlusion is how many of the three voxels touching
+// it in front of the face are solid, 3 when the two beside it both are. The face's byte of
+// ao_bits holds corner c in bits 2c and 2c + 1, a face covered by the voxel in front of it is 0.
+//
+// Voxels around a voxel are numbered (dx + 1) * 9 + (dy + 1) * 3 + dz + 1. Per face the voxel in
+// front of it, and per corner the one beside it along (axis + 1) % 3, the one along
+// (axis + 2) % 3 and the diagonal one.
+u8 ao_front_voxel[AO_FACES] = {14, 16, 12, 10, 4, 22};
+u8 ao_corner_voxels[AO_FACES][4][3] = {
+	{{5, 11, 2}, {23, 11, 20}, {5, 17, 8}, {23, 17, 26}},
+	{{15, 7, 6}, {17, 7, 8}, {15, 25, 24}, {17, 25, 26}},
+	{{3, 9, 0}, {21, 9, 18}, {3, 15, 6}, {21, 15, 24}},
+	{{9, 1, 0}, {11, 1, 2}, {9, 19, 18}, {11, 19, 20}},
+	{{1, 3, 0}, {7, 3, 6}, {1, 5, 2}, {7, 5, 8}},
+	{{19, 21, 18}, {25, 21, 24}, {19, 23, 20}, {25, 23, 26}},
+};
+
+// Ambient occlusion of a whole column as bits, see ao_column
+typedef struct ColumnAo {
+	// voxels whose face is not covered
+	OccupancyColumn open[AO_FACES];
+	// bit b of corner c of face f
+	OccupancyColumn bits[AO_FACES][4][2];
+} ColumnAo;
+
+// Every voxel of column (x, z) is done at once: a word of the 3x3x3 voxels around each voxel is a
+// word of an occupancy apron column moved a voxel up or down, and the count is a bitwise add of
+// three of those words. Only the words hull has any voxels in are filled.
+void ao_column(OccupancyColumn *solid, u32 x, u32 z, OccupancyColumn *hull, ColumnAo *ao) {
+	u32 apron_width = chunk_width + 2;
+	for (u32 k = 0; k < OCCUPANCY_WORDS; k++) {
+		if (hull->words[k] == 0) {
+			continue;
+		}
+
+		u64 around[27];
+		for (u32 i = 0; i < 3; i++) {
+			for (u32 j = 0; j < 3; j++) {
+				const u64 *words = solid[twod_to_oned(x + i, z + j, apron_width)].words;
+				around[i * 9 + j] = column_below_word(words, k);
+				around[i * 9 + 3 + j] = words[k];
+				around[i * 9 + 6 + j] = column_above_word(words, k);
+			}
+		}
+
+		for (u32 f = 0; f < AO_FACES; f++) {
+			ao->open[f].words[k] = ~around[ao_front_voxel[f]];
+			for (u32 c = 0; c < 4; c++) {
+				u8 *voxels = ao_corner_voxels[f][c];
+				u64 both = around[voxels[0]] & around[voxels[1]];
+				u64 one = around[voxels[0]] ^ around[voxels[1]];
+				u64 diagonal = around[voxels[2]];
+				ao->bits[f][c][0].words[k] = (one ^ diagonal) | both;
+				ao->bits[f][c][1].words[k] = (one & diagonal) | both;
+			}
+		}
+	}
+}
+
+// The face bytes of voxel y out of ao_column's bits
+void ao_voxel(ColumnAo *ao, u32 y, u8 *out) {
+	u32 k = y / 64;
+	u32 shift = y % 64;
+	for (u32 f = 0; f < AO_FACES; f++) {
+		u32 bits = 0;
+		if ((ao->open[f].words[k] >> shift) & 1) {
+			for (u32 c = 0; c < 4; c++) {
+				bits |= ((ao->bits[f][c][0].words[k] >> shift) & 1) << (c * 2);
+				bits |= ((ao->bits[f][c][1].words[k] >> shift) & 1) << (c * 2 + 1);
+			}
+		}
+		out[f] = (u8)bits;
+	}
+}
+
+// Light of chunk-local voxel (x, y, z), which may be one voxel into a neighbour. Open sky above
+// the world and in chunks not lit yet, none below the floor.
+u8 chunk_light_at(Chunk *chunk, i32 x, i32 y, i32 z) {
+	if (y < 0) {
+		return 0;
+	}
+	if (y >= (i32)chunk_height) {
+		return LIGHT_SKY;
+	}
+
+	if (x < 0 || x >= (i32)chunk_width) {
+		chunk = chunk->neighbours[x < 0 ? SIDE_NEG_X : SIDE_POS_X];
+		x = x < 0 ? x + (i32)chunk_width : x - (i32)chunk_width;
+	} else if (z < 0 || z >= (i32)chunk_depth) {
+		chunk = chunk->neighbours[z < 0 ? SIDE_NEG_Z : SIDE_POS_Z];
+		z = z < 0 ? z + (i32)chunk_depth : z - (i32)chunk_depth;
+	}
+	if (chunk == NULL || !chunk->lit) {
+		return LIGHT_SKY;
+	}
+	return light_get(&chunk->light, x, y, z);
+}
+
+// The light_bits of the instance at voxel (x, y, z): per face the light of the voxel in front of it
+void instance_light(Chunk *chunk, u32 x, u32 y, u32 z, u8 *out) {
+	if (!chunk->lit) {
+		memset(out, LIGHT_SKY, AO_FACES);
+		return;
+	}
+	for (u32 f = 0; f < AO_FACES; f++) {
+		i32 front[3] = {(i32)x, (i32)y, (i32)z};
+		front[ao_faces[f].axis] += ao_faces[f].sign;
+		out[f] = chunk_light_at(chunk, front[0], front[1], front[2]);
+	}
+}
+
+// Writes an instance, its ambient occlusion and its light for every voxel of the column's hull from index on,
+// found by hull_column_faces on the apron solid. The caller has reserved room for them, returns
+// the index after the last.
+u64 emit_column_instances(Chunk *chunk, u64 index, OccupancyColumn *solid, u32 x, u32 z, OccupancyColumn *hull, OccupancyColumn *faces, u8 *tiles) {
+	ColumnAo ao;
+	ao_column(solid, x, z, hull, &ao);
+
+	for (u32 k = 0; k < OCCUPANCY_WORDS; k++) {
+		if (hull->words[k] == 0) {
+			continue;
+		}
+
+		for (u32 f = 0; f < HULL_FACES; f++) {
+			u64 word = faces[f].words[k];
+			while (word) {
+				u32 y = k * 64 + __builtin_ctzll(word);
+				word &= word - 1;
+
+				chunk->colors[index] = tile_colors[tiles[f]];
+				chunk->instances[index] = pack_instance(x, y, z, tiles[f]);
+				chunk->positions[index] = glm::vec3((i32)x + chunk->x_off, y, (i32)z + chunk->z_off);
+				ao_voxel(&ao, y, &chunk->ao_bits[AO_FACES * index]);
+				instance_light(chunk, x, y, z, &chunk->light_bits[AO_FACES * index]);
+				index++;
+			}
+		}
+	}
+	return index;
+}
+
+// Instances for every hull block, column by column. The hull is found again on the occupancy
+// bits (hull_column_faces) instead of being read back out of pre_render_list, so the work
+// follows the number of hull blocks rather than the chunk's volume. Needs the same neighbours
+// hull_chunk had, the blocks are the ones it put in pre_render_list.
+void update_chunk(Chunk *chunk) {
+	PROFILE_ZONE("update_chunk");
+	OccupancyColumn solid[(SECTION_SIZE + 2) * (SECTION_SIZE + 2)];
+	fill_occupancy_apron(chunk, solid);
+
+	u64 tile_index = 0;
+	u32 y_min = chunk_height;
+	u32 y_max = 0;
+	for (u32 z = 0; z < chunk_depth; z++) {
+		for (u32 x = 0; x < chunk_width; x++) {
+			OccupancyColumn faces[HULL_FACES];
+			u8 tiles[HULL_FACES];
+			OccupancyColumn hull = hull_column_faces(solid, x, z, faces, tiles);
+			u32 count = column_count(hull);
+			if (count == 0) {
+				continue;
+			}
+
+			u32 lowest = column_lowest(hull);
+			u32 highest = column_highest(hull);
+			y_min = lowest < y_min ? lowest : y_min;
+			y_max = highest > y_max ? highest : y_max;
+
+			reserve_instances(chunk, tile_index + count);
+			tile_index = emit_column_instances(chunk, tile_index, solid, x, z, &hull, faces, tiles);
+		}
+	}
+
+	chunk->num_blocks = tile_index;
+	chunk->y_min = y_min;
+	chunk->y_max = y_max;
+	chunk->dirty = true;
+}
+
+// Replaces one column's instances without walking the rest of the chunk, the old ones are
+// swapped out from the end of the arrays and the column's current hull appended.
+// Instance order differs from update_chunk's afterwards, returns the bytes of instance data written.
+u64 update_column(Chunk *chunk, u32 x, u32 z) {
+	u64 bytes = 0;
+	u32 key = x | (z << 4);
+
+	for (u64 j = 0; j < chunk->num_blocks;) {
+		if ((chunk->instances[j] & 0xFF) != key) {
+			j++;
+			continue;
+		}
+
+		u64 last = --chunk->num_blocks;
+		chunk->instances[j] = chunk->instances[last];
+		chunk->positions[j] = chunk->positions[last];
+		chunk->colors[j] = chunk->colors[last];
+		memcpy(&chunk->ao_bits[AO_FACES * j], &chunk->ao_bits[AO_FACES * last], AO_FACES);
+		memcpy(&chunk->light_bits[AO_FACES * j], &chunk->light_bits[AO_FACES * last], AO_FACES);
+		bytes += sizeof(u32) + AO_FACES * 2;
+	}
+
+	OccupancyColumn solid[(SECTION_SIZE + 2) * (SECTION_SIZE + 2)];
+	fill_occupancy_apron(chunk, solid);
+
+	OccupancyColumn faces[HULL_FACES];
+	u8 tiles[HULL_FACES];
+	OccupancyColumn hull = hull_column_faces(solid, x, z, faces, tiles);
+	u32 count = column_count(hull);
+	if (count) {
+		u32 lowest = column_lowest(hull);
+		u32 highest = column_highest(hull);
+		chunk->y_min = lowest < chunk->y_min ? lowest : chunk->y_min;
+		chunk->y_max = highest > chunk->y_max ? highest : chunk->y_max;
+
+		reserve_instances(chunk, chunk->num_blocks + count);
+		chunk->num_blocks = emit_column_instances(chunk, chunk->num_blocks, solid, x, z, &hull, faces, tiles);
+		bytes += (sizeof(u32) + AO_FACES * 2) * count;
+	}
+
+	chunk->dirty = true;
+	return bytes;
+}
+
+// Box around the chunk's hull blocks in world coordinates
+void chunk_aabb(Chunk *chunk, glm::vec3 *min, glm::vec3 *max) {
+	*min = glm::vec3(chunk->x_off, chunk->y_min, chunk->z_off);
+	*max = glm::vec3(chunk->x_off + (i32)chunk_width, chunk->y_max + 1, chunk->z_off + (i32)chunk_depth);
+}
+
+// Bytes held by the chunk, its pool slot and meshes included
+u64 chunk_bytes(Chunk *chunk) {
+	u64 bytes = sizeof(Chunk) + storage_bytes(chunk->pre_render_list) +
+		instance_slot_bytes(chunk->instance_capacity) + ((sizeof(OccupancyColumn) + 1) * chunk_width * chunk_depth) +
+		light_bytes(&chunk->light) + sizeof(LightEmitter) * chunk->emitter_capacity + mesh_bytes(chunk->mesh);
+	for (u32 l = 1; l < LOD_LEVELS; l++) {
+		bytes += mesh_bytes(chunk->lod_meshes[l]);
+	}
+	return bytes;
+}
+
+#endif
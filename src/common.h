@@ -1,6 +1,8 @@
 #ifndef COMMON_H
 #define COMMON_H
 
+#include <time.h>
+
 typedef unsigned long u64;
 typedef unsigned int u32;
 typedef unsigned short u16;
@@ -14,6 +16,12 @@ typedef double f64;
 
 #define ARRAY_SIZE(x) sizeof(x) / sizeof(*x);
 
+u64 get_time_ns() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (u64)ts.tv_sec * 1000000000 + (u64)ts.tv_nsec;
+}
+
 // Allocates a string, must be freed by user
 char *file_to_string(const char *filename) {
 	FILE *file = fopen(filename, "r");
@@ -0,0 +1,196 @@
+#ifndef EDIT_H
+#define EDIT_H
+
+#include "common.h"
+#include "point.h"
+#include "chunk.h"
+#include "lighting.h"
+
+// Block edits on a built world. An edit moves the top of a column: placing a block above a column
+// raises it to that block, removing a block digs the column down to just below it. Whatever the
+// column holds under the dug out part (density terrain caves) stays as it was. Only the columns
+// whose hull depends on the edited one are rehulled and re-instanced, neighbour chunks are
+// touched only when the edit sits on a chunk border. The diagonal columns keep their hull but
+// are re-instanced for their ambient occlusion. In a lit chunk the light is brought up to date
+// incrementally by world_light (lighting.h).
+
+typedef struct EditStats {
+	u64 edits;
+	u64 columns_rehulled;
+	// diagonal columns re-instanced for their ambient occlusion only
+	u64 columns_reshaded;
+	u64 chunks_touched;
+	// instance bytes rewritten by update_column
+	u64 bytes_remeshed;
+} EditStats;
+
+void refresh_column(Chunk *chunk, u32 x, u32 z, EditStats *stats) {
+	hull_column(chunk, x, z);
+	u64 bytes = update_column(chunk, x, z);
+	if (chunk->mesh) {
+		chunk->mesh->stale = true;
+	}
+	for (u32 l = 0; l < LOD_LEVELS; l++) {
+		if (chunk->lod_meshes[l]) {
+			chunk->lod_meshes[l]->stale = true;
+		}
+	}
+
+	if (stats) {
+		stats->columns_rehulled++;
+		stats->bytes_remeshed += bytes;
+	}
+}
+
+void reshade_column(Chunk *chunk, u32 x, u32 z, EditStats *stats) {
+	u64 bytes = update_column(chunk, x, z);
+	if (stats) {
+		stats->columns_reshaded++;
+		stats->bytes_remeshed += bytes;
+	}
+}
+
+// Rehulls the edited column and every column whose hull reads its height, and re-instances the
+// diagonal ones, whose ambient occlusion reads it
+void refresh_edited_column(Chunk *chunk, u32 x, u32 z, EditStats *stats) {
+	refresh_column(chunk, x, z, stats);
+	if (x > 0) {
+		refresh_column(chunk, x - 1, z, stats);
+	}
+	if (x < chunk_width - 1) {
+		refresh_column(chunk, x + 1, z, stats);
+	}
+	if (z > 0) {
+		refresh_column(chunk, x, z - 1, stats);
+	}
+	if (z < chunk_depth - 1) {
+		refresh_column(chunk, x, z + 1, stats);
+	}
+
+	// the border rules of the facing column in a neighbour chunk compare against this one
+	u32 touched = 1;
+	if (x == 0 && chunk->neighbours[SIDE_NEG_X]) {
+		refresh_column(chunk->neighbours[SIDE_NEG_X], chunk_width - 1, z, stats);
+		touched++;
+	}
+	if (x == chunk_width - 1 && chunk->neighbours[SIDE_POS_X]) {
+		refresh_column(chunk->neighbours[SIDE_POS_X], 0, z, stats);
+		touched++;
+	}
+	if (z == 0 && chunk->neighbours[SIDE_NEG_Z]) {
+		refresh_column(chunk->neighbours[SIDE_NEG_Z], x, chunk_depth - 1, stats);
+		touched++;
+	}
+	if (z == chunk_depth - 1 && chunk->neighbours[SIDE_POS_Z]) {
+		refresh_column(chunk->neighbours[SIDE_POS_Z], x, 0, stats);
+		touched++;
+	}
+
+	for (u32 i = 0; i < 4; i++) {
+		i32 nx = (i32)x + (i & 1 ? 1 : -1);
+		i32 nz = (i32)z + (i & 2 ? 1 : -1);
+		bool across_x = nx < 0 || nx >= (i32)chunk_width;
+		bool across_z = nz < 0 || nz >= (i32)chunk_depth;
+		ChunkSide x_side = nx < 0 ? SIDE_NEG_X : SIDE_POS_X;
+		ChunkSide z_side = nz < 0 ? SIDE_NEG_Z : SIDE_POS_Z;
+
+		Chunk *other_chunk = chunk;
+		if (across_x && across_z) {
+			other_chunk = chunk_diagonal(chunk, x_side, z_side);
+			touched += other_chunk != NULL;
+		} else if (across_x) {
+			other_chunk = chunk->neighbours[x_side];
+		} else if (across_z) {
+			other_chunk = chunk->neighbours[z_side];
+		}
+		if (other_chunk) {
+			reshade_column(other_chunk, (u32)(nx + (i32)chunk_width) % chunk_width, (u32)(nz + (i32)chunk_depth) % chunk_depth, stats);
+		}
+	}
+
+	if (stats) {
+		stats->edits++;
+		stats->chunks_touched += touched;
+	}
+}
+
+// Fills chunk-local column (x, z) up to y, false when y is already solid or above the chunk
+bool chunk_set_block(Chunk *chunk, u32 x, u32 y, u32 z, EditStats *stats) {
+	PROFILE_ZONE("set_block");
+	u8 *height = &chunk->real_blocks[twod_to_oned(x, z, chunk_width)];
+	if (y >= chunk_height || y <= *height) {
+		return false;
+	}
+
+	OccupancyColumn *column = &chunk->occupancy[twod_to_oned(x, z, chunk_width)];
+	OccupancyColumn before = *column;
+	u32 old_height = *height;
+	OccupancyColumn filled = column_to_height(y);
+	OccupancyColumn old_top = column_to_height(*height);
+	for (u32 k = 0; k < OCCUPANCY_WORDS; k++) {
+		column->words[k] |= filled.words[k] & ~old_top.words[k];
+	}
+
+	*height = y;
+	chunk->top = y > chunk->top ? y : chunk->top;
+	chunk->unsaved = true;
+	light_edited_column(&world_light, chunk, x, z, before, old_height);
+	refresh_edited_column(chunk, x, z, stats);
+	light_flush(&world_light);
+	return true;
+}
+
+// Digs chunk-local column (x, z) down to just below y, false when y is above the top or the bottom block
+bool chunk_remove_block(Chunk *chunk, u32 x, u32 y, u32 z, EditStats *stats) {
+	PROFILE_ZONE("remove_block");
+	u8 *height = &chunk->real_blocks[twod_to_oned(x, z, chunk_width)];
+	if (y == 0 || y > *height) {
+		return false;
+	}
+
+	OccupancyColumn *column = &chunk->occupancy[twod_to_oned(x, z, chunk_width)];
+	OccupancyColumn before = *column;
+	u32 old_height = *height;
+	OccupancyColumn kept = column_to_height(y - 1);
+	for (u32 k = 0; k < OCCUPANCY_WORDS; k++) {
+		column->words[k] &= kept.words[k];
+	}
+
+	// the floor is always solid, so something is left
+	*height = column_highest(*column);
+	chunk->unsaved = true;
+	light_edited_column(&world_light, chunk, x, z, before, old_height);
+	refresh_edited_column(chunk, x, z, stats);
+	light_flush(&world_light);
+	return true;
+}
+
+u8 *column_height(Chunk **chunks, u32 wx, u32 wz) {
+	if (wx >= num_x_chunks * chunk_width || wz >= num_y_chunks * chunk_depth) {
+		return NULL;
+	}
+
+	Chunk *chunk = chunks[twod_to_oned(wx / chunk_width, wz / chunk_depth, num_x_chunks)];
+	return &chunk->real_blocks[twod_to_oned(wx % chunk_width, wz % chunk_depth, chunk_width)];
+}
+
+// World block coordinate versions over a num_x_chunks x num_y_chunks grid
+bool set_block(Chunk **chunks, u32 wx, u32 y, u32 wz, EditStats *stats) {
+	if (wx >= num_x_chunks * chunk_width || wz >= num_y_chunks * chunk_depth) {
+		return false;
+	}
+
+	Chunk *chunk = chunks[twod_to_oned(wx / chunk_width, wz / chunk_depth, num_x_chunks)];
+	return chunk_set_block(chunk, wx % chunk_width, y, wz % chunk_depth, stats);
+}
+
+bool remove_block(Chunk **chunks, u32 wx, u32 y, u32 wz, EditStats *stats) {
+	if (wx >= num_x_chunks * chunk_width || wz >= num_y_chunks * chunk_depth) {
+		return false;
+	}
+
+	Chunk *chunk = chunks[twod_to_oned(wx / chunk_width, wz / chunk_depth, num_x_chunks)];
+	return chunk_remove_block(chunk, wx % chunk_width, y, wz % chunk_depth, stats);
+}
+
+#endif
@@ -0,0 +1,218 @@
+#ifndef FRUSTUM_H
+#define FRUSTUM_H
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <glm/glm.hpp>
+
+#include "common.h"
+
+// View frustum culling of axis aligned boxes. The six planes come straight out of the
+// view-projection matrix, and boxes are kept as centres and half extents in separate arrays
+// so the SSE and AVX kernels can test 4 or 8 of them per plane at once.
+// A box is culled only when it lies entirely behind one plane, so boxes near a frustum corner
+// can be kept when they are actually outside. They are never culled when visible.
+
+#if defined(__x86_64__) || defined(__i386__)
+#define CULL_SIMD_X86 1
+#include <immintrin.h>
+#else
+#define CULL_SIMD_X86 0
+#endif
+
+typedef enum CullSimdLevel {
+	CULL_SCALAR,
+	CULL_SSE,
+	CULL_AVX,
+} CullSimdLevel;
+
+const char *cull_simd_level_names[] = {"scalar", "sse", "avx"};
+
+typedef struct Frustum {
+	// a, b, c, d with a point inside when ax + by + cz + d >= 0
+	f32 planes[6][4];
+} Frustum;
+
+typedef struct AabbList {
+	f32 *cx;
+	f32 *cy;
+	f32 *cz;
+	f32 *ex;
+	f32 *ey;
+	f32 *ez;
+	u32 count;
+	u32 capacity;
+} AabbList;
+
+// Gribb-Hartmann extraction, pv is column major so row i is pv[0][i] .. pv[3][i]
+Frustum frustum_from_pv(glm::mat4 pv) {
+	Frustum frustum;
+	for (u32 p = 0; p < 6; p++) {
+		u32 row = p / 2;
+		f32 sign = (p & 1) ? -1.0f : 1.0f;
+		for (u32 k = 0; k < 4; k++) {
+			frustum.planes[p][k] = pv[k][3] + sign * pv[k][row];
+		}
+	}
+	return frustum;
+}
+
+void aabb_list_clear(AabbList *list) {
+	list->count = 0;
+}
+
+void aabb_list_push(AabbList *list, glm::vec3 min, glm::vec3 max) {
+	if (list->count == list->capacity) {
+		u32 capacity = list->capacity ? list->capacity * 2 : 256;
+		list->cx = (f32 *)realloc(list->cx, sizeof(f32) * capacity);
+		list->cy = (f32 *)realloc(list->cy, sizeof(f32) * capacity);
+		list->cz = (f32 *)realloc(list->cz, sizeof(f32) * capacity);
+		list->ex = (f32 *)realloc(list->ex, sizeof(f32) * capacity);
+		list->ey = (f32 *)realloc(list->ey, sizeof(f32) * capacity);
+		list->ez = (f32 *)realloc(list->ez, sizeof(f32) * capacity);
+		list->capacity = capacity;
+	}
+
+	u32 i = list->count++;
+	list->cx[i] = (min.x + max.x) * 0.5f;
+	list->cy[i] = (min.y + max.y) * 0.5f;
+	list->cz[i] = (min.z + max.z) * 0.5f;
+	list->ex[i] = (max.x - min.x) * 0.5f;
+	list->ey[i] = (max.y - min.y) * 0.5f;
+	list->ez[i] = (max.z - min.z) * 0.5f;
+}
+
+void aabb_list_free(AabbList *list) {
+	free(list->cx);
+	free(list->cy);
+	free(list->cz);
+	free(list->ex);
+	free(list->ey);
+	free(list->ez);
+	memset(list, 0, sizeof(AabbList));
+}
+
+bool aabb_in_frustum(Frustum *frustum, f32 cx, f32 cy, f32 cz, f32 ex, f32 ey, f32 ez) {
+	for (u32 p = 0; p < 6; p++) {
+		f32 *plane = frustum->planes[p];
+		f32 dist = plane[0] * cx + plane[1] * cy + plane[2] * cz + plane[3];
+		f32 radius = fabsf(plane[0]) * ex + fabsf(plane[1]) * ey + fabsf(plane[2]) * ez;
+		if (dist + radius < 0.0f) {
+			return false;
+		}
+	}
+	return true;
+}
+
+void cull_aabbs_scalar(Frustum *frustum, AabbList *list, u32 start, u8 *visible) {
+	for (u32 i = start; i < list->count; i++) {
+		visible[i] = aabb_in_frustum(frustum, list->cx[i], list->cy[i], list->cz[i], list->ex[i], list->ey[i], list->ez[i]);
+	}
+}
+
+#if CULL_SIMD_X86
+
+__attribute__((target("sse4.1")))
+u32 cull_aabbs_sse(Frustum *frustum, AabbList *list, u8 *visible) {
+	__m128 abs_mask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+	u32 end = list->count & ~3u;
+	for (u32 i = 0; i < end; i += 4) {
+		__m128 cx = _mm_loadu_ps(list->cx + i);
+		__m128 cy = _mm_loadu_ps(list->cy + i);
+		__m128 cz = _mm_loadu_ps(list->cz + i);
+		__m128 ex = _mm_loadu_ps(list->ex + i);
+		__m128 ey = _mm_loadu_ps(list->ey + i);
+		__m128 ez = _mm_loadu_ps(list->ez + i);
+
+		__m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+		for (u32 p = 0; p < 6; p++) {
+			f32 *plane = frustum->planes[p];
+			__m128 a = _mm_set1_ps(plane[0]);
+			__m128 b = _mm_set1_ps(plane[1]);
+			__m128 c = _mm_set1_ps(plane[2]);
+
+			// same order of operations as aabb_in_frustum so both agree on boxes touching a plane
+			__m128 dist = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(a, cx), _mm_mul_ps(b, cy)), _mm_mul_ps(c, cz)), _mm_set1_ps(plane[3]));
+			__m128 radius = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_and_ps(a, abs_mask), ex), _mm_mul_ps(_mm_and_ps(b, abs_mask), ey)), _mm_mul_ps(_mm_and_ps(c, abs_mask), ez));
+			inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(dist, radius), _mm_setzero_ps()));
+		}
+
+		u32 bits = _mm_movemask_ps(inside);
+		for (u32 k = 0; k < 4; k++) {
+			visible[i + k] = (bits >> k) & 1;
+		}
+	}
+	return end;
+}
+
+__attribute__((target("avx")))
+u32 cull_aabbs_avx(Frustum *frustum, AabbList *list, u8 *visible) {
+	__m256 abs_mask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7FFFFFFF));
+	u32 end = list->count & ~7u;
+	for (u32 i = 0; i < end; i += 8) {
+		__m256 cx = _mm256_loadu_ps(list->cx + i);
+		__m256 cy = _mm256_loadu_ps(list->cy + i);
+		__m256 cz = _mm256_loadu_ps(list->cz + i);
+		__m256 ex = _mm256_loadu_ps(list->ex + i);
+		__m256 ey = _mm256_loadu_ps(list->ey + i);
+		__m256 ez = _mm256_loadu_ps(list->ez + i);
+
+		__m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+		for (u32 p = 0; p < 6; p++) {
+			f32 *plane = frustum->planes[p];
+			__m256 a = _mm256_set1_ps(plane[0]);
+			__m256 b = _mm256_set1_ps(plane[1]);
+			__m256 c = _mm256_set1_ps(plane[2]);
+
+			__m256 dist = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(a, cx), _mm256_mul_ps(b, cy)), _mm256_mul_ps(c, cz)), _mm256_set1_ps(plane[3]));
+			__m256 radius = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_and_ps(a, abs_mask), ex), _mm256_mul_ps(_mm256_and_ps(b, abs_mask), ey)), _mm256_mul_ps(_mm256_and_ps(c, abs_mask), ez));
+			inside = _mm256_and_ps(inside, _mm256_cmp_ps(_mm256_add_ps(dist, radius), _mm256_setzero_ps(), _CMP_GE_OQ));
+		}
+
+		u32 bits = _mm256_movemask_ps(inside);
+		for (u32 k = 0; k < 8; k++) {
+			visible[i + k] = (bits >> k) & 1;
+		}
+	}
+	return end;
+}
+
+#endif
+
+CullSimdLevel detect_cull_simd_level() {
+#if CULL_SIMD_X86
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx")) {
+		return CULL_AVX;
+	}
+	if (__builtin_cpu_supports("sse4.1")) {
+		return CULL_SSE;
+	}
+#endif
+	return CULL_SCALAR;
+}
+
+// Picked on first use, can be lowered to force a narrower kernel
+CullSimdLevel cull_simd_level = detect_cull_simd_level();
+
+// visible[i] = 1 when box i may be in the frustum, 0 when it is culled. Returns the visible count.
+u32 cull_aabbs(Frustum *frustum, AabbList *list, u8 *visible) {
+	u32 done = 0;
+#if CULL_SIMD_X86
+	if (cull_simd_level == CULL_AVX) {
+		done = cull_aabbs_avx(frustum, list, visible);
+	} else if (cull_simd_level == CULL_SSE) {
+		done = cull_aabbs_sse(frustum, list, visible);
+	}
+#endif
+	cull_aabbs_scalar(frustum, list, done, visible);
+
+	u32 num_visible = 0;
+	for (u32 i = 0; i < list->count; i++) {
+		num_visible += visible[i];
+	}
+	return num_visible;
+}
+
+#endif
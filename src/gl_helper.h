@@ -1,13 +1,76 @@
 #ifndef GL_HELPER_H
 #define GL_HELPER_H
 
+#include "profile.h"
+
 #define RELEASE 0
+// glGetError waits on the driver, so it is skipped while a profile capture runs (see profile.h)
+// rather than show up as the cost of every call it follows
 #if RELEASE
 #define GL_CHECK(x) x
 #else
-#define GL_CHECK(x) do { x; GLenum err = glGetError(); assert(err == GL_NO_ERROR); } while(0)
+#define GL_CHECK(x) do { x; if (!profile_capturing()) { GLenum err = glGetError(); assert(err == GL_NO_ERROR); } } while(0)
 #endif
 
+// Frames a GPU timer's queries are read back after, by then the GPU has long finished them
+#define GPU_TIMER_FRAMES 4
+
+// GPU time of a span of GL calls once a frame, from GL_TIME_ELAPSED queries. Results are read
+// GPU_TIMER_FRAMES frames later so reading them never stalls, and go on a profile track of
+// their own at the CPU time their calls were issued. Queries cannot nest, one timer runs at a time.
+typedef struct GpuTimer {
+	const char *name;
+	ProfileThread *track;
+	GLuint queries[GPU_TIMER_FRAMES];
+	u64 issued_ns[GPU_TIMER_FRAMES];
+	bool pending[GPU_TIMER_FRAMES];
+	bool running;
+	u32 frame;
+} GpuTimer;
+
+void gpu_timer_init(GpuTimer *timer, const char *name) {
+	memset(timer, 0, sizeof(GpuTimer));
+	timer->name = name;
+	timer->track = profile_add_track("gpu");
+	glGenQueries(GPU_TIMER_FRAMES, timer->queries);
+}
+
+// Collects the result from GPU_TIMER_FRAMES frames ago, then starts timing when a capture runs
+void gpu_timer_begin(GpuTimer *timer) {
+	u32 i = timer->frame % GPU_TIMER_FRAMES;
+	if (timer->pending[i]) {
+		GLint available = 0;
+		glGetQueryObjectiv(timer->queries[i], GL_QUERY_RESULT_AVAILABLE, &available);
+		if (available) {
+			GLuint64 elapsed = 0;
+			glGetQueryObjectui64v(timer->queries[i], GL_QUERY_RESULT, &elapsed);
+			if (profile_capturing()) {
+				profile_record_on(timer->track, timer->name, timer->issued_ns[i], timer->issued_ns[i] + elapsed);
+			}
+		}
+		timer->pending[i] = false;
+	}
+
+	timer->running = profile_capturing();
+	if (timer->running) {
+		glBeginQuery(GL_TIME_ELAPSED, timer->queries[i]);
+		timer->issued_ns[i] = get_time_ns();
+	}
+}
+
+void gpu_timer_end(GpuTimer *timer) {
+	if (timer->running) {
+		glEndQuery(GL_TIME_ELAPSED);
+		timer->pending[timer->frame % GPU_TIMER_FRAMES] = true;
+		timer->running = false;
+	}
+	timer->frame++;
+}
+
+void gpu_timer_destroy(GpuTimer *timer) {
+	glDeleteQueries(GPU_TIMER_FRAMES, timer->queries);
+}
+
 void get_shader_err(GLuint shader) {
 	GLint err_log_max_length = 0;
 	glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &err_log_max_length);
@@ -0,0 +1,233 @@
+#ifndef GREEDY_H
+#define GREEDY_H
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "common.h"
+#include "point.h"
+#include "chunk.h"
+#include "jobs.h"
+#include "world.h"
+
+// Greedy mesher, an alternative to drawing every hull block as a full cube instance.
+// A face of a hull block is exposed when the voxel next to it is empty in the occupancy apron,
+// exposed faces of the same tile colour in the same plane are merged into one quad.
+// The floor of the world counts as solid, so bottom faces only show under overhangs and caves.
+
+typedef struct FaceDir {
+	u32 axis;
+	i32 sign;
+} FaceDir;
+
+FaceDir greedy_face_dirs[] = {
+	{0, 1}, {0, -1},
+	{1, 1}, {1, -1},
+	{2, 1}, {2, -1},
+};
+
+void reserve_mesh(ChunkMesh *mesh, u32 num_vertices, u32 num_indices) {
+	if (num_vertices > mesh->vertex_capacity) {
+		u32 capacity = mesh->vertex_capacity ? mesh->vertex_capacity : 1024;
+		while (capacity < num_vertices) {
+			capacity *= 2;
+		}
+		mesh->vertices = (MeshVertex *)realloc(mesh->vertices, sizeof(MeshVertex) * capacity);
+		mesh->vertex_capacity = capacity;
+	}
+
+	if (num_indices > mesh->index_capacity) {
+		u32 capacity = mesh->index_capacity ? mesh->index_capacity : 1536;
+		while (capacity < num_indices) {
+			capacity *= 2;
+		}
+		mesh->indices = (u32 *)realloc(mesh->indices, sizeof(u32) * capacity);
+		mesh->index_capacity = capacity;
+	}
+}
+
+void emit_quad(ChunkMesh *mesh, FaceDir dir, u32 slice, u32 i, u32 j, u32 w, u32 h, u8 color) {
+	u32 d = dir.axis;
+	u32 u = (d + 1) % 3;
+	u32 v = (d + 2) % 3;
+
+	reserve_mesh(mesh, mesh->num_vertices + 4, mesh->num_indices + 6);
+
+	u32 corners[4][3];
+	for (u32 c = 0; c < 4; c++) {
+		corners[c][d] = slice + (dir.sign > 0 ? 1 : 0);
+		corners[c][u] = i + ((c == 1 || c == 2) ? w : 0);
+		corners[c][v] = j + ((c == 2 || c == 3) ? h : 0);
+	}
+
+	u32 base = mesh->num_vertices;
+	for (u32 c = 0; c < 4; c++) {
+		MeshVertex *vertex = &mesh->vertices[mesh->num_vertices++];
+		vertex->x = corners[c][0];
+		vertex->y = corners[c][1];
+		vertex->z = corners[c][2];
+		vertex->color = color;
+	}
+
+	// u x v points along +axis, so the positive faces wind 0 1 2 and the negative ones 0 3 2
+	u32 order[2][6] = {
+		{0, 1, 2, 2, 3, 0},
+		{0, 3, 2, 2, 1, 0},
+	};
+	for (u32 k = 0; k < 6; k++) {
+		mesh->indices[mesh->num_indices++] = base + order[dir.sign > 0 ? 0 : 1][k];
+	}
+
+	mesh->num_quads++;
+	mesh->area += w * h;
+}
+
+// Merges runs of equal non-zero cells of a nu x nv mask into rectangles, clearing the mask as it goes
+void greedy_merge(ChunkMesh *mesh, FaceDir dir, u32 slice, u8 *mask, u32 nu, u32 nv) {
+	for (u32 j = 0; j < nv; j++) {
+		for (u32 i = 0; i < nu; i++) {
+			u8 color = mask[twod_to_oned(i, j, nu)];
+			if (color == 0) {
+				continue;
+			}
+
+			u32 w = 1;
+			while (i + w < nu && mask[twod_to_oned(i + w, j, nu)] == color) {
+				w++;
+			}
+
+			u32 h = 1;
+			bool row_matches = true;
+			while (j + h < nv && row_matches) {
+				for (u32 k = 0; k < w; k++) {
+					if (mask[twod_to_oned(i + k, j + h, nu)] != color) {
+						row_matches = false;
+						break;
+					}
+				}
+				if (row_matches) {
+					h++;
+				}
+			}
+
+			for (u32 dv = 0; dv < h; dv++) {
+				memset(&mask[twod_to_oned(i, j + dv, nu)], 0, w);
+			}
+
+			emit_quad(mesh, dir, slice, i, j, w, h, color);
+			i += w - 1;
+		}
+	}
+}
+
+// Rebuilds chunk->mesh from the chunk's hull, needs the neighbours linked for the apron and update_chunk run
+void build_chunk_mesh(Chunk *chunk) {
+	PROFILE_ZONE("build_chunk_mesh");
+	if (chunk->mesh == NULL) {
+		chunk->mesh = (ChunkMesh *)calloc(1, sizeof(ChunkMesh));
+	}
+
+	ChunkMesh *mesh = chunk->mesh;
+	mesh->num_vertices = 0;
+	mesh->num_indices = 0;
+	mesh->num_quads = 0;
+	mesh->area = 0;
+
+	u32 apron_width = chunk_width + 2;
+	OccupancyColumn *solid = (OccupancyColumn *)malloc(sizeof(OccupancyColumn) * apron_width * (chunk_depth + 2));
+	fill_occupancy_apron(chunk, solid);
+
+	// hull blocks only sit between the bounds update_chunk found
+	u32 y_min = chunk->y_min;
+	u32 y_max = chunk->y_max;
+
+	u8 *tiles = (u8 *)calloc(chunk_size, 1);
+	for (u32 z = 0; z < chunk_depth; z++) {
+		for (u32 y = y_min; y <= y_max; y++) {
+			for (u32 x = 0; x < chunk_width; x++) {
+				tiles[threed_to_oned(x, y, z, chunk_width, chunk_height)] = storage_get(chunk->pre_render_list, x, y, z);
+			}
+		}
+	}
+
+	u32 dims[3] = {chunk_width, chunk_height, chunk_depth};
+	u32 lo[3] = {0, y_min, 0};
+	u32 hi[3] = {chunk_width - 1, y_max, chunk_depth - 1};
+	u8 *mask = (u8 *)calloc(chunk_height * chunk_width, 1);
+
+	u32 num_dirs = ARRAY_SIZE(greedy_face_dirs);
+	for (u32 f = 0; f < num_dirs; f++) {
+		FaceDir dir = greedy_face_dirs[f];
+		u32 d = dir.axis;
+		u32 u = (d + 1) % 3;
+		u32 v = (d + 2) % 3;
+
+		for (u32 slice = lo[d]; slice <= hi[d]; slice++) {
+			bool any = false;
+			for (u32 j = lo[v]; j <= hi[v]; j++) {
+				for (u32 i = lo[u]; i <= hi[u]; i++) {
+					u32 p[3];
+					p[d] = slice;
+					p[u] = i;
+					p[v] = j;
+
+					u8 tile = tiles[threed_to_oned(p[0], p[1], p[2], chunk_width, chunk_height)];
+					if (tile == 0) {
+						continue;
+					}
+
+					// the voxel across the face, in apron coordinates
+					u32 nx = p[0] + 1 + (d == 0 ? dir.sign : 0);
+					i32 ny = (i32)p[1] + (d == 1 ? dir.sign : 0);
+					u32 nz = p[2] + 1 + (d == 2 ? dir.sign : 0);
+					bool exposed;
+					if (ny < 0) {
+						exposed = false;
+					} else if (ny >= (i32)chunk_height) {
+						exposed = true;
+					} else {
+						OccupancyColumn *across = &solid[twod_to_oned(nx, nz, apron_width)];
+						exposed = !((across->words[ny / 64] >> (ny % 64)) & 1);
+					}
+
+					if (exposed) {
+						mask[twod_to_oned(i, j, dims[u])] = tile;
+						any = true;
+					}
+				}
+			}
+
+			if (any) {
+				greedy_merge(mesh, dir, slice, mask, dims[u], dims[v]);
+			}
+		}
+	}
+
+	mesh->dirty = true;
+	mesh->stale = false;
+
+	free(mask);
+	free(tiles);
+	free(solid);
+}
+
+void build_chunk_mesh_job(void *data) {
+	ChunkJobData *job = (ChunkJobData *)data;
+	build_chunk_mesh(job->chunks[job->chunk_idx]);
+}
+
+// Meshes every chunk of an already built world across the job system
+void build_world_meshes(JobSystem *sys, Chunk **chunks) {
+	ChunkJobData *job_data = (ChunkJobData *)malloc(sizeof(ChunkJobData) * num_chunks);
+	for (u32 i = 0; i < num_chunks; i++) {
+		job_data[i].chunks = chunks;
+		job_data[i].chunk_idx = i;
+		job_data[i].times = NULL;
+		job_submit(sys, job_create(sys, build_chunk_mesh_job, &job_data[i]));
+	}
+
+	job_system_wait(sys);
+	free(job_data);
+}
+
+#endif
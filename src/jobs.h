@@ -0,0 +1,291 @@
+#ifndef JOBS_H
+#define JOBS_H
+
+#include <assert.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "common.h"
+#include "profile.h"
+
+// Work stealing job system. Each thread owns a deque, it pushes and pops at the bottom
+// while idle threads steal from the top of the other deques. Jobs form a dependency graph,
+// a job is pushed once every job it depends on has finished.
+//
+// Usage: create all jobs, wire them with job_depends_on, submit them all, then job_system_wait.
+// Dependencies must be added before the dependency itself is submitted.
+
+#define JOB_MAX_DEPENDENTS 8
+
+struct JobSystem;
+
+typedef struct Job {
+	void (*fn)(void *data);
+	void *data;
+
+	struct Job *dependents[JOB_MAX_DEPENDENTS];
+	u32 num_dependents;
+
+	// unfinished dependencies, plus one held until the job is submitted
+	i32 pending;
+} Job;
+
+typedef struct JobDeque {
+	Job **jobs;
+	i64 top;
+	i64 bottom;
+	pthread_mutex_t lock;
+} JobDeque;
+
+typedef struct JobSystem {
+	pthread_t *threads;
+	JobDeque *deques;
+	u32 num_threads;
+
+	Job *jobs;
+	u32 max_jobs;
+	u32 num_jobs;
+
+	// jobs created and not yet finished
+	i32 unfinished;
+	// jobs sitting in a deque
+	i32 queued;
+	i32 quit;
+
+	pthread_mutex_t sleep_lock;
+	pthread_cond_t sleep_cond;
+} JobSystem;
+
+typedef struct JobWorker {
+	JobSystem *sys;
+	u32 idx;
+} JobWorker;
+
+// the thread that created the job system is worker 0
+static __thread u32 job_worker_idx = 0;
+
+u32 get_num_cores() {
+	i64 cores = sysconf(_SC_NPROCESSORS_ONLN);
+	return cores > 0 ? (u32)cores : 1;
+}
+
+void job_deque_push(JobDeque *deque, Job *job) {
+	pthread_mutex_lock(&deque->lock);
+	deque->jobs[deque->bottom++] = job;
+	pthread_mutex_unlock(&deque->lock);
+}
+
+Job *job_deque_pop(JobDeque *deque) {
+	Job *job = NULL;
+	pthread_mutex_lock(&deque->lock);
+	if (deque->bottom > deque->top) {
+		job = deque->jobs[--deque->bottom];
+		if (deque->bottom == deque->top) {
+			deque->top = 0;
+			deque->bottom = 0;
+		}
+	}
+	pthread_mutex_unlock(&deque->lock);
+	return job;
+}
+
+Job *job_deque_steal(JobDeque *deque) {
+	Job *job = NULL;
+	pthread_mutex_lock(&deque->lock);
+	if (deque->bottom > deque->top) {
+		job = deque->jobs[deque->top++];
+		if (deque->bottom == deque->top) {
+			deque->top = 0;
+			deque->bottom = 0;
+		}
+	}
+	pthread_mutex_unlock(&deque->lock);
+	return job;
+}
+
+void job_push(JobSystem *sys, Job *job) {
+	job_deque_push(&sys->deques[job_worker_idx], job);
+	__atomic_add_fetch(&sys->queued, 1, __ATOMIC_SEQ_CST);
+
+	pthread_mutex_lock(&sys->sleep_lock);
+	pthread_cond_signal(&sys->sleep_cond);
+	pthread_mutex_unlock(&sys->sleep_lock);
+}
+
+Job *job_next(JobSystem *sys) {
+	Job *job = job_deque_pop(&sys->deques[job_worker_idx]);
+	for (u32 i = 1; job == NULL && i < sys->num_threads; i++) {
+		job = job_deque_steal(&sys->deques[(job_worker_idx + i) % sys->num_threads]);
+	}
+
+	if (job != NULL) {
+		__atomic_sub_fetch(&sys->queued, 1, __ATOMIC_SEQ_CST);
+	}
+	return job;
+}
+
+void job_run(JobSystem *sys, Job *job) {
+	PROFILE_ZONE("job");
+	job->fn(job->data);
+
+	for (u32 i = 0; i < job->num_dependents; i++) {
+		Job *dependent = job->dependents[i];
+		if (__atomic_sub_fetch(&dependent->pending, 1, __ATOMIC_ACQ_REL) == 0) {
+			job_push(sys, dependent);
+		}
+	}
+
+	__atomic_sub_fetch(&sys->unfinished, 1, __ATOMIC_ACQ_REL);
+}
+
+void *job_worker_loop(void *data) {
+	JobWorker *worker = (JobWorker *)data;
+	JobSystem *sys = worker->sys;
+	job_worker_idx = worker->idx;
+	free(worker);
+
+	char name[32];
+	snprintf(name, sizeof(name), "worker %u", job_worker_idx);
+	profile_name_thread(name);
+
+	for (;;) {
+		Job *job = job_next(sys);
+		if (job != NULL) {
+			job_run(sys, job);
+			continue;
+		}
+
+		pthread_mutex_lock(&sys->sleep_lock);
+		while (!__atomic_load_n(&sys->quit, __ATOMIC_SEQ_CST) && __atomic_load_n(&sys->queued, __ATOMIC_SEQ_CST) == 0) {
+			pthread_cond_wait(&sys->sleep_cond, &sys->sleep_lock);
+		}
+		pthread_mutex_unlock(&sys->sleep_lock);
+
+		if (__atomic_load_n(&sys->quit, __ATOMIC_SEQ_CST)) {
+			break;
+		}
+	}
+
+	return NULL;
+}
+
+// num_threads includes the calling thread, 0 uses every core
+JobSystem *job_system_create(u32 num_threads, u32 max_jobs) {
+	JobSystem *sys = (JobSystem *)malloc(sizeof(JobSystem));
+	memset(sys, 0, sizeof(JobSystem));
+
+	if (num_threads == 0) {
+		num_threads = get_num_cores();
+	}
+
+	sys->num_threads = num_threads;
+	sys->max_jobs = max_jobs;
+	sys->jobs = (Job *)malloc(sizeof(Job) * max_jobs);
+	sys->deques = (JobDeque *)malloc(sizeof(JobDeque) * num_threads);
+	sys->threads = (pthread_t *)malloc(sizeof(pthread_t) * num_threads);
+
+	pthread_mutex_init(&sys->sleep_lock, NULL);
+	pthread_cond_init(&sys->sleep_cond, NULL);
+
+	for (u32 i = 0; i < num_threads; i++) {
+		JobDeque *deque = &sys->deques[i];
+		deque->jobs = (Job **)malloc(sizeof(Job *) * max_jobs);
+		deque->top = 0;
+		deque->bottom = 0;
+		pthread_mutex_init(&deque->lock, NULL);
+	}
+
+	for (u32 i = 1; i < num_threads; i++) {
+		JobWorker *worker = (JobWorker *)malloc(sizeof(JobWorker));
+		worker->sys = sys;
+		worker->idx = i;
+		pthread_create(&sys->threads[i], NULL, job_worker_loop, worker);
+	}
+
+	return sys;
+}
+
+void job_system_destroy(JobSystem *sys) {
+	pthread_mutex_lock(&sys->sleep_lock);
+	__atomic_store_n(&sys->quit, 1, __ATOMIC_SEQ_CST);
+	pthread_cond_broadcast(&sys->sleep_cond);
+	pthread_mutex_unlock(&sys->sleep_lock);
+
+	for (u32 i = 1; i < sys->num_threads; i++) {
+		pthread_join(sys->threads[i], NULL);
+	}
+
+	for (u32 i = 0; i < sys->num_threads; i++) {
+		free(sys->deques[i].jobs);
+		pthread_mutex_destroy(&sys->deques[i].lock);
+	}
+
+	pthread_mutex_destroy(&sys->sleep_lock);
+	pthread_cond_destroy(&sys->sleep_cond);
+	free(sys->deques);
+	free(sys->threads);
+	free(sys->jobs);
+	free(sys);
+}
+
+Job *job_create(JobSystem *sys, void (*fn)(void *data), void *data) {
+	assert(sys->num_jobs < sys->max_jobs);
+
+	Job *job = &sys->jobs[sys->num_jobs++];
+	job->fn = fn;
+	job->data = data;
+	job->num_dependents = 0;
+	job->pending = 1;
+
+	__atomic_add_fetch(&sys->unfinished, 1, __ATOMIC_SEQ_CST);
+	return job;
+}
+
+void job_depends_on(Job *job, Job *dependency) {
+	assert(dependency->num_dependents < JOB_MAX_DEPENDENTS);
+
+	dependency->dependents[dependency->num_dependents++] = job;
+	__atomic_add_fetch(&job->pending, 1, __ATOMIC_ACQ_REL);
+}
+
+void job_submit(JobSystem *sys, Job *job) {
+	if (__atomic_sub_fetch(&job->pending, 1, __ATOMIC_ACQ_REL) == 0) {
+		job_push(sys, job);
+	}
+}
+
+// True while a created job has not finished, lets a caller poll instead of blocking in job_system_wait
+bool job_system_busy(JobSystem *sys) {
+	return __atomic_load_n(&sys->unfinished, __ATOMIC_ACQUIRE) > 0;
+}
+
+// Runs one queued job on the calling thread, false when there was nothing to run
+bool job_system_run_one(JobSystem *sys) {
+	Job *job = job_next(sys);
+	if (job == NULL) {
+		return false;
+	}
+
+	job_run(sys, job);
+	return true;
+}
+
+// Runs jobs on the calling thread until every created job has finished, then recycles the job slots
+void job_system_wait(JobSystem *sys) {
+	while (__atomic_load_n(&sys->unfinished, __ATOMIC_ACQUIRE) > 0) {
+		Job *job = job_next(sys);
+		if (job != NULL) {
+			job_run(sys, job);
+		} else {
+			sched_yield();
+		}
+	}
+
+	sys->num_jobs = 0;
+}
+
+#endif
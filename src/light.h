@@ -0,0 +1,113 @@
+#ifndef LIGHT_H
+#define LIGHT_H
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "common.h"
+#include "section.h"
+#include "pool.h"
+
+// Light of a chunk's voxels, a byte each: skylight in the low nibble and block light from
+// emitters in the high one, 0 to LIGHT_MAX. Stored per section of SECTION_VOLUME voxels indexed
+// like section.h. A section every voxel of which holds the same byte (open sky above the terrain,
+// unlit rock under it) keeps just that byte until something else is written into it, so a chunk
+// only holds storage for the few sections around its surface, caves and lamps.
+// The propagation that fills it is in lighting.h.
+
+#define LIGHT_MAX 15
+// chunk_height / SECTION_SIZE
+#define LIGHT_SECTIONS 16
+
+// nothing but open sky
+#define LIGHT_SKY LIGHT_MAX
+
+typedef struct ChunkLight {
+	// SECTION_VOLUME bytes, NULL while the whole section holds fill
+	u8 *sections[LIGHT_SECTIONS];
+	u8 fill[LIGHT_SECTIONS];
+} ChunkLight;
+
+// A block giving off light, in chunk-local coordinates
+typedef struct LightEmitter {
+	u8 x;
+	u8 y;
+	u8 z;
+	u8 level;
+} LightEmitter;
+
+// Section storage for every chunk, set up with chunk_pool
+Pool light_pool;
+
+u8 light_sky(u8 light) {
+	return light & 15;
+}
+
+u8 light_block(u8 light) {
+	return light >> 4;
+}
+
+// Channel 0 is skylight, 1 block light
+u8 light_channel(u8 light, u32 channel) {
+	return (light >> (channel * 4)) & 15;
+}
+
+u8 light_with_channel(u8 light, u32 channel, u8 level) {
+	u32 shift = channel * 4;
+	return (u8)((light & ~(15 << shift)) | (level << shift));
+}
+
+// Every section open sky, no storage held
+void light_clear(ChunkLight *light) {
+	for (u32 s = 0; s < LIGHT_SECTIONS; s++) {
+		light->sections[s] = NULL;
+		light->fill[s] = LIGHT_SKY;
+	}
+}
+
+// Drops section s's storage, all of it holds value
+void light_fill_section(ChunkLight *light, u32 s, u8 value) {
+	if (light->sections[s]) {
+		pool_give(&light_pool, light->sections[s]);
+		light->sections[s] = NULL;
+	}
+	light->fill[s] = value;
+}
+
+// Gives every section back to light_pool
+void light_release(ChunkLight *light) {
+	for (u32 s = 0; s < LIGHT_SECTIONS; s++) {
+		light_fill_section(light, s, LIGHT_SKY);
+	}
+}
+
+u8 light_get(ChunkLight *light, u32 x, u32 y, u32 z) {
+	u32 s = y / SECTION_SIZE;
+	if (light->sections[s] == NULL) {
+		return light->fill[s];
+	}
+	return light->sections[s][section_index(x, y % SECTION_SIZE, z)];
+}
+
+// Gives the section storage when the value differs from the one it is filled with
+void light_set(ChunkLight *light, u32 x, u32 y, u32 z, u8 value) {
+	u32 s = y / SECTION_SIZE;
+	if (light->sections[s] == NULL) {
+		if (value == light->fill[s]) {
+			return;
+		}
+		light->sections[s] = (u8 *)pool_take(&light_pool);
+		memset(light->sections[s], light->fill[s], SECTION_VOLUME);
+	}
+	light->sections[s][section_index(x, y % SECTION_SIZE, z)] = value;
+}
+
+u64 light_bytes(ChunkLight *light) {
+	u64 bytes = 0;
+	for (u32 s = 0; s < LIGHT_SECTIONS; s++) {
+		bytes += light->sections[s] ? SECTION_VOLUME : 0;
+	}
+	return bytes;
+}
+
+#endif
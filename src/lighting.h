@@ -0,0 +1,421 @@
+#ifndef LIGHTING_H
+#define LIGHTING_H
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "common.h"
+#include "chunk.h"
+
+// Light propagation over the chunks' light (light.h). Skylight is LIGHT_MAX in every voxel above
+// its column's real_blocks height and block light LIGHT_MAX at most in an emitter. From there both
+// spread breadth first through the voxels that are not solid, one level less per step, across
+// chunk borders through the neighbour links into any chunk that is lit.
+// An edit does not relight anything from scratch: the voxels it darkens are cleared, the darkness
+// is spread the same way out to the voxels lit from somewhere else, and those spread their light
+// back in. Only the voxels the edit's light reached are visited.
+
+// Channel 0 and 1 of light_channel
+#define LIGHT_CHANNELS 2
+
+typedef struct LightNode {
+	Chunk *chunk;
+	u8 x;
+	u8 y;
+	u8 z;
+	// the light the voxel held before it was darkened, unused when spreading
+	u8 level;
+} LightNode;
+
+// A FIFO, emptied by whoever drains it
+typedef struct LightQueue {
+	LightNode *nodes;
+	u32 head;
+	u32 count;
+	u32 capacity;
+} LightQueue;
+
+typedef struct LightStats {
+	// voxels whose light was raised
+	u64 voxels_lit;
+	// voxels whose light was cleared for spreading back in
+	u64 voxels_darkened;
+	// chunks whose light_bits light_flush rewrote
+	u64 chunks_refreshed;
+} LightStats;
+
+typedef struct LightEngine {
+	// per channel, voxels whose light spreads on to their neighbours
+	LightQueue spread[LIGHT_CHANNELS];
+	// per channel, darkened voxels with the light they held
+	LightQueue unspread[LIGHT_CHANNELS];
+
+	// chunks whose light changed since the last light_flush
+	Chunk **changed;
+	u32 num_changed;
+	u32 changed_capacity;
+
+	LightStats stats;
+} LightEngine;
+
+// The engine edits and streaming light the world with. It belongs to the thread that owns the stream,
+// the world thread in the game (see snapshot.h), and must not be called into from the render thread.
+LightEngine world_light;
+
+// Per direction the step to the voxel beside, +x -x +y -y +z -z
+i32 light_steps[6][3] = {
+	{1, 0, 0}, {-1, 0, 0}, {0, 1, 0}, {0, -1, 0}, {0, 0, 1}, {0, 0, -1},
+};
+
+// Per ChunkSide the step in x and z to the column beside
+i32 light_side_steps[4][2] = {
+	{1, 0}, {-1, 0}, {0, 1}, {0, -1},
+};
+
+void light_push(LightQueue *queue, Chunk *chunk, u32 x, u32 y, u32 z, u8 level) {
+	if (queue->count == queue->capacity) {
+		queue->capacity = queue->capacity ? queue->capacity * 2 : 4096;
+		queue->nodes = (LightNode *)realloc(queue->nodes, sizeof(LightNode) * queue->capacity);
+	}
+
+	LightNode *node = &queue->nodes[queue->count++];
+	node->chunk = chunk;
+	node->x = (u8)x;
+	node->y = (u8)y;
+	node->z = (u8)z;
+	node->level = level;
+}
+
+// The voxel beside node in direction dir, false under the floor, above the world or past the lit chunks
+bool light_neighbour(LightNode *node, u32 dir, LightNode *out) {
+	i32 x = (i32)node->x + light_steps[dir][0];
+	i32 y = (i32)node->y + light_steps[dir][1];
+	i32 z = (i32)node->z + light_steps[dir][2];
+	if (y < 0 || y >= (i32)chunk_height) {
+		return false;
+	}
+
+	Chunk *chunk = node->chunk;
+	if (x < 0 || x >= (i32)chunk_width) {
+		chunk = chunk->neighbours[x < 0 ? SIDE_NEG_X : SIDE_POS_X];
+		x = x < 0 ? x + (i32)chunk_width : x - (i32)chunk_width;
+	} else if (z < 0 || z >= (i32)chunk_depth) {
+		chunk = chunk->neighbours[z < 0 ? SIDE_NEG_Z : SIDE_POS_Z];
+		z = z < 0 ? z + (i32)chunk_depth : z - (i32)chunk_depth;
+	}
+	if (chunk == NULL || !chunk->lit) {
+		return false;
+	}
+
+	out->chunk = chunk;
+	out->x = (u8)x;
+	out->y = (u8)y;
+	out->z = (u8)z;
+	return true;
+}
+
+void light_mark_changed(LightEngine *engine, Chunk *chunk) {
+	if (chunk == NULL || chunk->light_changed) {
+		return;
+	}
+	if (engine->num_changed == engine->changed_capacity) {
+		engine->changed_capacity = engine->changed_capacity ? engine->changed_capacity * 2 : 64;
+		engine->changed = (Chunk **)realloc(engine->changed, sizeof(Chunk *) * engine->changed_capacity);
+	}
+	engine->changed[engine->num_changed++] = chunk;
+	chunk->light_changed = true;
+}
+
+// Sets a voxel's light and queues the chunks whose light_bits read it, the neighbour too on a border
+void light_write(LightEngine *engine, Chunk *chunk, u32 x, u32 y, u32 z, u8 value) {
+	light_set(&chunk->light, x, y, z, value);
+	light_mark_changed(engine, chunk);
+	if (x == 0 || x == chunk_width - 1) {
+		light_mark_changed(engine, chunk->neighbours[x == 0 ? SIDE_NEG_X : SIDE_POS_X]);
+	}
+	if (z == 0 || z == chunk_depth - 1) {
+		light_mark_changed(engine, chunk->neighbours[z == 0 ? SIDE_NEG_Z : SIDE_POS_Z]);
+	}
+}
+
+// Drains the channel's spread queue, raising every open neighbour to one less than the voxel
+void light_spread(LightEngine *engine, u32 channel) {
+	LightQueue *queue = &engine->spread[channel];
+	for (; queue->head < queue->count; queue->head++) {
+		LightNode node = queue->nodes[queue->head];
+		u8 level = light_channel(light_get(&node.chunk->light, node.x, node.y, node.z), channel);
+		if (level <= 1) {
+			continue;
+		}
+
+		for (u32 dir = 0; dir < 6; dir++) {
+			LightNode next;
+			if (!light_neighbour(&node, dir, &next) || voxel_solid(next.chunk, next.x, next.y, next.z)) {
+				continue;
+			}
+
+			u8 value = light_get(&next.chunk->light, next.x, next.y, next.z);
+			if (light_channel(value, channel) + 1 < level) {
+				light_write(engine, next.chunk, next.x, next.y, next.z, light_with_channel(value, channel, level - 1));
+				light_push(queue, next.chunk, next.x, next.y, next.z, 0);
+				engine->stats.voxels_lit++;
+			}
+		}
+	}
+	queue->head = 0;
+	queue->count = 0;
+}
+
+// Drains the channel's unspread queue. A neighbour dimmer than the darkened voxel was lit through
+// it and is darkened in turn, anything at least as bright (and any emitter) has its own source and
+// is queued to spread back into the dark.
+void light_unspread(LightEngine *engine, u32 channel) {
+	LightQueue *queue = &engine->unspread[channel];
+	for (; queue->head < queue->count; queue->head++) {
+		LightNode node = queue->nodes[queue->head];
+		for (u32 dir = 0; dir < 6; dir++) {
+			LightNode next;
+			if (!light_neighbour(&node, dir, &next)) {
+				continue;
+			}
+
+			u8 value = light_get(&next.chunk->light, next.x, next.y, next.z);
+			u8 level = light_channel(value, channel);
+			if (level == 0) {
+				continue;
+			}
+
+			if (level < node.level && !voxel_solid(next.chunk, next.x, next.y, next.z)) {
+				light_write(engine, next.chunk, next.x, next.y, next.z, light_with_channel(value, channel, 0));
+				light_push(queue, next.chunk, next.x, next.y, next.z, level);
+				engine->stats.voxels_darkened++;
+			} else {
+				light_push(&engine->spread[channel], next.chunk, next.x, next.y, next.z, 0);
+			}
+		}
+	}
+	queue->head = 0;
+	queue->count = 0;
+}
+
+void light_propagate(LightEngine *engine) {
+	for (u32 channel = 0; channel < LIGHT_CHANNELS; channel++) {
+		light_unspread(engine, channel);
+	}
+	for (u32 channel = 0; channel < LIGHT_CHANNELS; channel++) {
+		light_spread(engine, channel);
+	}
+}
+
+// Queues the lit neighbours of a voxel to spread into it
+void light_pull(LightEngine *engine, Chunk *chunk, u32 x, u32 y, u32 z) {
+	LightNode node = {chunk, (u8)x, (u8)y, (u8)z, 0};
+	for (u32 dir = 0; dir < 6; dir++) {
+		LightNode next;
+		if (!light_neighbour(&node, dir, &next)) {
+			continue;
+		}
+		u8 value = light_get(&next.chunk->light, next.x, next.y, next.z);
+		for (u32 channel = 0; channel < LIGHT_CHANNELS; channel++) {
+			if (light_channel(value, channel) > 1) {
+				light_push(&engine->spread[channel], next.chunk, next.x, next.y, next.z, 0);
+			}
+		}
+	}
+}
+
+// Lights the chunk from scratch: skylight down its columns, its emitters, and whatever the lit
+// neighbours hold along its borders, spread through it and back out into them
+void light_chunk(LightEngine *engine, Chunk *chunk) {
+	PROFILE_ZONE("light_chunk");
+	ChunkLight *light = &chunk->light;
+	u32 floor = chunk_height;
+	for (u32 i = 0; i < chunk_width * chunk_depth; i++) {
+		u32 run = column_floor_run(chunk->occupancy[i]);
+		floor = run < floor ? run : floor;
+	}
+
+	// sections above the top are open sky and those under every column's floor run dark, only
+	// the ones in between get storage
+	for (u32 s = 0; s < LIGHT_SECTIONS; s++) {
+		u32 base = s * SECTION_SIZE;
+		light_fill_section(light, s, base > chunk->top ? LIGHT_SKY : 0);
+		if (base > chunk->top || base + SECTION_SIZE <= floor) {
+			continue;
+		}
+		for (u32 z = 0; z < chunk_depth; z++) {
+			for (u32 x = 0; x < chunk_width; x++) {
+				u32 y = chunk->real_blocks[twod_to_oned(x, z, chunk_width)] + 1;
+				for (y = y > base ? y : base; y < base + SECTION_SIZE; y++) {
+					light_set(light, x, y, z, LIGHT_SKY);
+				}
+			}
+		}
+	}
+	chunk->lit = true;
+	light_mark_changed(engine, chunk);
+
+	// skylight only spreads sideways out of a column, into the open voxels of a column beside it
+	// that are below that column's top
+	for (u32 z = 0; z < chunk_depth; z++) {
+		for (u32 x = 0; x < chunk_width; x++) {
+			u32 height = chunk->real_blocks[twod_to_oned(x, z, chunk_width)];
+			u32 highest = height;
+			for (u32 side = 0; side < 4; side++) {
+				i32 nx = (i32)x + light_side_steps[side][0];
+				i32 nz = (i32)z + light_side_steps[side][1];
+				Chunk *other = chunk;
+				if (nx < 0 || nx >= (i32)chunk_width || nz < 0 || nz >= (i32)chunk_depth) {
+					other = chunk->neighbours[side];
+					nx = (nx + (i32)chunk_width) % (i32)chunk_width;
+					nz = (nz + (i32)chunk_depth) % (i32)chunk_depth;
+				}
+				if (other && other->lit) {
+					u32 beside = other->real_blocks[twod_to_oned(nx, nz, chunk_width)];
+					highest = beside > highest ? beside : highest;
+				}
+			}
+			for (u32 y = height + 1; y < highest; y++) {
+				light_push(&engine->spread[0], chunk, x, y, z, 0);
+			}
+		}
+	}
+
+	for (u32 e = 0; e < chunk->num_emitters; e++) {
+		LightEmitter *emitter = &chunk->emitters[e];
+		u8 value = light_get(light, emitter->x, emitter->y, emitter->z);
+		light_set(light, emitter->x, emitter->y, emitter->z, light_with_channel(value, 1, emitter->level));
+		light_push(&engine->spread[1], chunk, emitter->x, emitter->y, emitter->z, 0);
+	}
+
+	// the lit neighbours' border voxels spread in, skylight only below the higher of the two tops
+	for (u32 side = 0; side < 4; side++) {
+		Chunk *other = chunk->neighbours[side];
+		if (other == NULL || !other->lit) {
+			continue;
+		}
+		u32 sky_top = other->top > chunk->top ? other->top : chunk->top;
+		for (u32 i = 0; i < chunk_width; i++) {
+			u32 x = side == SIDE_POS_X ? 0 : side == SIDE_NEG_X ? chunk_width - 1 : i;
+			u32 z = side == SIDE_POS_Z ? 0 : side == SIDE_NEG_Z ? chunk_depth - 1 : i;
+			for (u32 y = 0; y < chunk_height; y++) {
+				u8 value = light_get(&other->light, x, y, z);
+				if (light_sky(value) > 1 && y <= sky_top) {
+					light_push(&engine->spread[0], other, x, y, z, 0);
+				}
+				if (light_block(value) > 1) {
+					light_push(&engine->spread[1], other, x, y, z, 0);
+				}
+			}
+		}
+	}
+
+	light_propagate(engine);
+}
+
+// Rewrites the light_bits of every chunk whose light changed since the last flush, and marks them
+// for upload
+void light_flush(LightEngine *engine) {
+	PROFILE_ZONE("light_flush");
+	for (u32 i = 0; i < engine->num_changed; i++) {
+		Chunk *chunk = engine->changed[i];
+		for (u64 j = 0; j < chunk->num_blocks; j++) {
+			u32 instance = chunk->instances[j];
+			instance_light(chunk, instance & 15, (instance >> 8) & 255, (instance >> 4) & 15, &chunk->light_bits[AO_FACES * j]);
+		}
+		chunk->light_changed = false;
+		chunk->dirty = true;
+	}
+	engine->stats.chunks_refreshed += engine->num_changed;
+	engine->num_changed = 0;
+}
+
+// Relights count chunks from scratch, as though each had just been loaded
+void light_world(LightEngine *engine, Chunk **chunks, u32 count) {
+	for (u32 i = 0; i < count; i++) {
+		chunks[i]->lit = false;
+	}
+	for (u32 i = 0; i < count; i++) {
+		light_chunk(engine, chunks[i]);
+	}
+	light_flush(engine);
+}
+
+// Brings the light up to date after column (x, z) of a lit chunk changed from before, whose top
+// was old_height. Voxels that turned solid or lost the sky are darkened, ones that opened up take
+// the sky or their neighbours' light. Emitters in voxels that are no longer solid go. The caller
+// flushes once the instances are rebuilt.
+void light_edited_column(LightEngine *engine, Chunk *chunk, u32 x, u32 z, OccupancyColumn before, u32 old_height) {
+	PROFILE_ZONE("light_edit");
+	OccupancyColumn *after = &chunk->occupancy[twod_to_oned(x, z, chunk_width)];
+	u32 new_height = chunk->real_blocks[twod_to_oned(x, z, chunk_width)];
+
+	for (u32 e = 0; e < chunk->num_emitters;) {
+		LightEmitter *emitter = &chunk->emitters[e];
+		if (emitter->x == x && emitter->z == z && !voxel_solid(chunk, x, emitter->y, z)) {
+			*emitter = chunk->emitters[--chunk->num_emitters];
+		} else {
+			e++;
+		}
+	}
+	if (!chunk->lit) {
+		return;
+	}
+
+	u32 lo = old_height < new_height ? old_height : new_height;
+	u32 hi = old_height > new_height ? old_height : new_height;
+	for (u32 y = lo; y <= hi; y++) {
+		bool was_solid = (before.words[y / 64] >> (y % 64)) & 1;
+		bool is_solid = (after->words[y / 64] >> (y % 64)) & 1;
+		bool was_sky = y > old_height;
+		bool is_sky = y > new_height;
+		if (was_solid == is_solid && was_sky == is_sky) {
+			continue;
+		}
+
+		u8 value = light_get(&chunk->light, x, y, z);
+		u8 sky = !is_solid && is_sky ? LIGHT_MAX : 0;
+		u8 block = was_solid != is_solid ? 0 : light_block(value);
+		if (sky < light_sky(value)) {
+			light_push(&engine->unspread[0], chunk, x, y, z, light_sky(value));
+		}
+		if (block < light_block(value)) {
+			light_push(&engine->unspread[1], chunk, x, y, z, light_block(value));
+		}
+		light_write(engine, chunk, x, y, z, (u8)(sky | (block << 4)));
+
+		if (sky) {
+			light_push(&engine->spread[0], chunk, x, y, z, 0);
+		}
+		if (was_solid && !is_solid) {
+			light_pull(engine, chunk, x, y, z);
+		}
+	}
+
+	light_propagate(engine);
+}
+
+// Makes chunk-local voxel (x, y, z) give off level, 0 to stop it. Only solid voxels can, false otherwise.
+bool light_set_emitter(LightEngine *engine, Chunk *chunk, u32 x, u32 y, u32 z, u8 level) {
+	PROFILE_ZONE("light_emitter");
+	if (!inside_chunk(x, y, z) || !voxel_solid(chunk, x, y, z) || level > LIGHT_MAX) {
+		return false;
+	}
+
+	chunk_set_emitter(chunk, x, y, z, level);
+	chunk->unsaved = true;
+	if (!chunk->lit) {
+		return true;
+	}
+
+	u8 value = light_get(&chunk->light, x, y, z);
+	if (level < light_block(value)) {
+		light_push(&engine->unspread[1], chunk, x, y, z, light_block(value));
+	}
+	light_write(engine, chunk, x, y, z, light_with_channel(value, 1, level));
+	light_push(&engine->spread[1], chunk, x, y, z, 0);
+	light_propagate(engine);
+	return true;
+}
+
+#endif
@@ -0,0 +1,159 @@
+#ifndef LOD_H
+#define LOD_H
+
+#include <math.h>
+#include <stdlib.h>
+#include <glm/glm.hpp>
+
+#include "common.h"
+#include "point.h"
+#include "chunk.h"
+#include "greedy.h"
+
+// Level of detail for far chunks. Level l splits the chunk's heightmap into cells 2^l columns wide,
+// each drawn as one box as tall as the highest column in it, so the coarse terrain never dips below
+// the real one. Neighbouring chunks may be drawn at different levels, so every border cell hangs a
+// skirt down to the lowest real column facing it on the other side. Whatever the neighbour draws
+// there is at least that high, so no gap shows between the two.
+// The meshes use the greedy mesh vertex format and are drawn with the greedy shader.
+
+// chunk distance in blocks at which each level takes over, and how far past it the camera has to
+// move back before the finer level returns
+f32 lod_distances[LOD_LEVELS] = {0.0f, 64.0f, 112.0f, 160.0f};
+f32 lod_hysteresis = 8.0f;
+
+u32 lod_cell_size(u32 level) {
+	return 1u << level;
+}
+
+u32 lod_cell_height(Chunk *chunk, u32 x0, u32 z0, u32 size) {
+	u32 top = 0;
+	for (u32 z = z0; z < z0 + size; z++) {
+		for (u32 x = x0; x < x0 + size; x++) {
+			u32 height = chunk->real_blocks[twod_to_oned(x, z, chunk_width)];
+			top = height > top ? height : top;
+		}
+	}
+	return top;
+}
+
+// Lowest of count real columns starting at (x, z) and stepping by (dx, dz)
+u32 lod_lowest_column(Chunk *chunk, u32 x, u32 z, u32 dx, u32 dz, u32 count) {
+	u32 lowest = chunk_height;
+	for (u32 i = 0; i < count; i++) {
+		u32 height = chunk->real_blocks[twod_to_oned(x + dx * i, z + dz * i, chunk_width)];
+		lowest = height < lowest ? height : lowest;
+	}
+	return lowest;
+}
+
+// Side face of a cell from the top of column height bottom up to the top of column height top
+void lod_emit_wall(ChunkMesh *mesh, FaceDir dir, u32 x0, u32 z0, u32 size, u32 bottom, u32 top, u8 color) {
+	if (top <= bottom) {
+		return;
+	}
+
+	if (dir.axis == 0) {
+		u32 slice = dir.sign > 0 ? x0 + size - 1 : x0;
+		emit_quad(mesh, dir, slice, bottom + 1, z0, top - bottom, size, color);
+	} else {
+		u32 slice = dir.sign > 0 ? z0 + size - 1 : z0;
+		emit_quad(mesh, dir, slice, x0, bottom + 1, size, top - bottom, color);
+	}
+}
+
+// Rebuilds chunk->lod_meshes[level] for level 1 and up
+void build_lod_mesh(Chunk *chunk, u32 level) {
+	PROFILE_ZONE("build_lod_mesh");
+	if (chunk->lod_meshes[level] == NULL) {
+		chunk->lod_meshes[level] = (ChunkMesh *)calloc(1, sizeof(ChunkMesh));
+	}
+
+	ChunkMesh *mesh = chunk->lod_meshes[level];
+	mesh->num_vertices = 0;
+	mesh->num_indices = 0;
+	mesh->num_quads = 0;
+	mesh->area = 0;
+
+	u32 size = lod_cell_size(level);
+	u32 cells_x = chunk_width / size;
+	u32 cells_z = chunk_depth / size;
+	u32 *tops = (u32 *)malloc(sizeof(u32) * cells_x * cells_z);
+	for (u32 cz = 0; cz < cells_z; cz++) {
+		for (u32 cx = 0; cx < cells_x; cx++) {
+			tops[twod_to_oned(cx, cz, cells_x)] = lod_cell_height(chunk, cx * size, cz * size, size);
+		}
+	}
+
+	FaceDir up = {1, 1};
+	FaceDir pos_x = {0, 1};
+	FaceDir neg_x = {0, -1};
+	FaceDir pos_z = {2, 1};
+	FaceDir neg_z = {2, -1};
+
+	for (u32 cz = 0; cz < cells_z; cz++) {
+		for (u32 cx = 0; cx < cells_x; cx++) {
+			u32 top = tops[twod_to_oned(cx, cz, cells_x)];
+			u32 x0 = cx * size;
+			u32 z0 = cz * size;
+
+			// the y face's u axis is z and its v axis is x
+			emit_quad(mesh, up, top, z0, x0, size, size, 1);
+
+			// walls inside the chunk, each drawn by the higher cell, same colours as the hull
+			if (cx + 1 < cells_x) {
+				u32 other = tops[twod_to_oned(cx + 1, cz, cells_x)];
+				lod_emit_wall(mesh, pos_x, x0, z0, size, other, top, 3);
+				lod_emit_wall(mesh, neg_x, x0 + size, z0, size, top, other, 2);
+			}
+			if (cz + 1 < cells_z) {
+				u32 other = tops[twod_to_oned(cx, cz + 1, cells_x)];
+				lod_emit_wall(mesh, pos_z, x0, z0, size, other, top, 5);
+				lod_emit_wall(mesh, neg_z, x0, z0 + size, size, top, other, 4);
+			}
+
+			// skirts, down to the lowest real column across the border
+			if (cx == cells_x - 1 && chunk->neighbours[SIDE_POS_X]) {
+				u32 lowest = lod_lowest_column(chunk->neighbours[SIDE_POS_X], 0, z0, 0, 1, size);
+				lod_emit_wall(mesh, pos_x, x0, z0, size, lowest, top, 6);
+			}
+			if (cx == 0 && chunk->neighbours[SIDE_NEG_X]) {
+				u32 lowest = lod_lowest_column(chunk->neighbours[SIDE_NEG_X], chunk_width - 1, z0, 0, 1, size);
+				lod_emit_wall(mesh, neg_x, x0, z0, size, lowest, top, 7);
+			}
+			if (cz == cells_z - 1 && chunk->neighbours[SIDE_POS_Z]) {
+				u32 lowest = lod_lowest_column(chunk->neighbours[SIDE_POS_Z], x0, 0, 1, 0, size);
+				lod_emit_wall(mesh, pos_z, x0, z0, size, lowest, top, 8);
+			}
+			if (cz == 0 && chunk->neighbours[SIDE_NEG_Z]) {
+				u32 lowest = lod_lowest_column(chunk->neighbours[SIDE_NEG_Z], x0, chunk_depth - 1, 1, 0, size);
+				lod_emit_wall(mesh, neg_z, x0, z0, size, lowest, top, 9);
+			}
+		}
+	}
+
+	mesh->dirty = true;
+	mesh->stale = false;
+	free(tops);
+}
+
+// Distance in the xz plane from the camera to the nearest point of the chunk
+f32 chunk_distance(Chunk *chunk, glm::vec3 camera_pos) {
+	f32 dx = fmaxf(fmaxf(chunk->x_off - camera_pos.x, camera_pos.x - (f32)(chunk->x_off + (i32)chunk_width)), 0.0f);
+	f32 dz = fmaxf(fmaxf(chunk->z_off - camera_pos.z, camera_pos.z - (f32)(chunk->z_off + (i32)chunk_depth)), 0.0f);
+	return sqrtf(dx * dx + dz * dz);
+}
+
+// Level to draw at distance, moving from current only once the distance is lod_hysteresis past a boundary
+u8 lod_select(u8 current, f32 distance) {
+	u8 level = current;
+	while (level + 1 < LOD_LEVELS && distance > lod_distances[level + 1] + lod_hysteresis) {
+		level++;
+	}
+	while (level > 0 && distance < lod_distances[level] - lod_hysteresis) {
+		level--;
+	}
+	return level;
+}
+
+#endif
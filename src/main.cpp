@@ -16,71 +16,21 @@
 #include "cube.h"
 #include "tga.h"
 #include "gl_helper.h"
-
-u32 chunk_width = 16;
-u32 chunk_height = 256;
-u32 chunk_depth = 16;
-u32 chunk_size = chunk_width * chunk_height * chunk_depth;
-
-u32 num_x_chunks = 9;
-u32 num_y_chunks = 9;
-u32 num_chunks = num_x_chunks * num_y_chunks;
-
-typedef struct Chunk {
-	u8 *pre_render_list;
-	u8 *real_blocks;
-
-	u32 *mappings;
-	glm::vec3 *positions;
-	glm::vec3 *colors;
-	u8 *ao_bits;
-
-	u64 num_blocks;
-	u32 x_off;
-	u32 z_off;
-} Chunk;
-
-Chunk *generate_chunk(u32 x_off, u32 z_off) {
-	Chunk *chunk = (Chunk *)malloc(sizeof(Chunk));
-
-	chunk->positions = (glm::vec3 *)malloc(sizeof(glm::vec3) * chunk_size);
-	chunk->colors = (glm::vec3 *)malloc(sizeof(glm::vec3) * chunk_size);
-	chunk->mappings = (u32 *)malloc(sizeof(u32) * chunk_size);
-	chunk->pre_render_list = (u8 *)malloc(chunk_size);
-	chunk->x_off = x_off * chunk_width;
-	chunk->z_off = z_off * chunk_depth;
-
-	u8 *height_map = (u8 *)malloc(chunk_width * chunk_depth);
-	memset(height_map, 0, sizeof(chunk_width * chunk_depth));
-
-	f32 min_height = chunk_height / 5;
-	f32 avg_height = chunk_height / 2;
-	for (u32 x = 0; x < chunk_width; x++) {
-		for (u32 z = 0; z < chunk_depth; z++) {
-
-			f32 column_height = avg_height;
-			for (u8 o = 5; o < 8; o++) {
-				f32 scale = (f32)(2 << o) * 1.01f;
-				column_height += (f32)(o << 4) * stb_perlin_noise3((f32)(x + chunk->x_off) / scale, (f32)(z + chunk->z_off) / scale, o * 2.0f, 256, 256, 256);
-			}
-
-			if (column_height > chunk_height) {
-				column_height = chunk_height;
-			}
-
-			if (column_height < min_height) {
-				column_height = min_height;
-			}
-
-			height_map[twod_to_oned(x, z, chunk_width)] = column_height;
-		}
-	}
-
-
-	chunk->real_blocks = height_map;
-	return chunk;
-}
-
+#include "chunk.h"
+#include "jobs.h"
+#include "world.h"
+#include "greedy.h"
+#include "edit.h"
+#include "lighting.h"
+#include "region.h"
+#include "stream.h"
+#include "cache.h"
+#include "frustum.h"
+#include "occlusion.h"
+#include "lod.h"
+#include "render.h"
+#include "raycast.h"
+#include "snapshot.h"
 
 glm::vec3 random_color() {
 	f32 r = ((f32)(rand() % 10)) / 10;
@@ -91,148 +41,19 @@ glm::vec3 random_color() {
 	return color;
 }
 
-bool inside_chunk(u32 x, u32 y, u32 z) {
-	if (x < chunk_width && y < chunk_height && z < chunk_depth) {
-		return true;
-	}
-
-	return false;
-}
-
-void hull_chunk(Chunk **chunks, u32 chunk_idx) {
-	Chunk *chunk = chunks[chunk_idx];
-	memset(chunk->pre_render_list, 0, chunk_size);
-
-	for (u64 i = 0; i < chunk_width * chunk_depth; i++) {
-		Point p = oned_to_twod(i, chunk_width);
-
-		if (p.x > 0 && p.x < (chunk_width - 1) && p.y > 0 && p.y < (chunk_depth - 1)) {
-			//B
-			if (chunk->real_blocks[i] + 1 < chunk->real_blocks[twod_to_oned(p.x - 1, p.y, chunk_width)]) {
-				for (u32 dy = chunk->real_blocks[i] + 1; dy < chunk->real_blocks[twod_to_oned(p.x - 1, p.y, chunk_width)]; dy++) {
-					chunk->pre_render_list[threed_to_oned(p.x - 1, dy, p.y, chunk_width, chunk_height)] = 3;
-				}
-			}
-			//GB
-			if (chunk->real_blocks[i] + 1 < chunk->real_blocks[twod_to_oned(p.x + 1, p.y, chunk_width)]) {
-				//printf("(%d, %d, %d) | %d < (%d, %d, %d) | %d { delta: %d}\n", p.x, p.y, p.z, chunk->real_blocks[i], p.x+1, p.y, p.z, chunk->real_blocks[twod_to_oned(p.x + 1, p.y, chunk_width)], chunk->real_blocks[twod_to_oned(p.x + 1, p.y, chunk_width)] - chunk->real_blocks[i]);
-				for (u32 dy = chunk->real_blocks[i] + 1; dy < chunk->real_blocks[twod_to_oned(p.x + 1, p.y, chunk_width)]; dy++) {
-					chunk->pre_render_list[threed_to_oned(p.x + 1, dy, p.y, chunk_width, chunk_height)] = 2;
-				}
-			}
-			//RB
-			if (chunk->real_blocks[i] + 1 < chunk->real_blocks[twod_to_oned(p.x, p.y + 1, chunk_width)]) {
-				for (u32 dy = chunk->real_blocks[i] + 1; dy < chunk->real_blocks[twod_to_oned(p.x, p.y + 1, chunk_width)]; dy++) {
-					chunk->pre_render_list[threed_to_oned(p.x, dy, p.y + 1, chunk_width, chunk_height)] = 4;
-				}
-			}
-			//R
-			if (chunk->real_blocks[i] + 1 < chunk->real_blocks[twod_to_oned(p.x, p.y - 1, chunk_width)]) {
-				for (u32 dy = chunk->real_blocks[i] + 1; dy < chunk->real_blocks[twod_to_oned(p.x, p.y - 1, chunk_width)]; dy++) {
-					chunk->pre_render_list[threed_to_oned(p.x, dy, p.y - 1, chunk_width, chunk_height)] = 5;
-				}
-			}
-		} else {
-			Point cp = oned_to_twod(chunk_idx, num_x_chunks);
-			if (p.x == chunk_width - 1 && cp.x < (num_x_chunks - 1)) {
-				Chunk *other_chunk = chunks[threed_to_oned(cp.x + 1, cp.y, cp.z, num_x_chunks, num_y_chunks)];
-				if (chunk->real_blocks[i] > other_chunk->real_blocks[twod_to_oned(0, p.y, chunk_width)] + 1) {
-					for (u32 dy = chunk->real_blocks[i]; dy > other_chunk->real_blocks[twod_to_oned(0, p.y, chunk_width)]; dy--) {
-						chunk->pre_render_list[threed_to_oned(p.x, dy, p.y, chunk_width, chunk_height)] = 6;
-					}
-				}
-			}
-			if (p.x == 0 && cp.x > 0) {
-				Chunk *other_chunk = chunks[threed_to_oned(cp.x - 1, cp.y, cp.z, num_x_chunks, num_y_chunks)];
-				if (chunk->real_blocks[i] > other_chunk->real_blocks[twod_to_oned(chunk_width - 1, p.y, chunk_width)] + 1) {
-					for (u32 dy = chunk->real_blocks[i]; dy > other_chunk->real_blocks[twod_to_oned(chunk_width - 1, p.y, chunk_width)]; dy--) {
-						chunk->pre_render_list[threed_to_oned(p.x, dy, p.y, chunk_width, chunk_height)] = 7;
-					}
-				}
-			}
-			if (p.y == chunk_width - 1 && cp.y < (num_y_chunks - 1)) {
-				Chunk *other_chunk = chunks[threed_to_oned(cp.x, cp.y + 1, cp.z, num_x_chunks, num_y_chunks)];
-				if (chunk->real_blocks[i] > other_chunk->real_blocks[twod_to_oned(p.x, 0, chunk_width)] + 1) {
-					for (u32 dy = chunk->real_blocks[i]; dy > other_chunk->real_blocks[twod_to_oned(p.x, 0, chunk_width)]; dy--) {
-						chunk->pre_render_list[threed_to_oned(p.x, dy, p.y, chunk_width, chunk_height)] = 8;
-					}
-				}
-			}
-			if (p.y == 0 && cp.y > 0) {
-				Chunk *other_chunk = chunks[threed_to_oned(cp.x, cp.y - 1, cp.z, num_x_chunks, num_y_chunks)];
-				if (chunk->real_blocks[i] > other_chunk->real_blocks[twod_to_oned(p.x, chunk_depth - 1, chunk_width)] + 1) {
-					for (u32 dy = chunk->real_blocks[i]; dy > other_chunk->real_blocks[twod_to_oned(p.x, chunk_depth - 1, chunk_width)]; dy--) {
-						chunk->pre_render_list[threed_to_oned(p.x, dy, p.y, chunk_width, chunk_height)] = 9;
-					}
-				}
-			}
-
-		}
+WorldRenderer *renderer;
 
-		chunk->pre_render_list[threed_to_oned(p.x, chunk->real_blocks[i], p.y, chunk_width, chunk_height)] = 1;
-	}
+// Releases a proxy chunk's ranges of the shared buffers before the render world frees it
+void free_chunk_gl(Chunk *chunk) {
+	renderer_release_chunk(renderer, chunk);
 }
 
-void update_chunk(Chunk **chunks, u32 chunk_idx) {
-	Chunk *chunk = chunks[chunk_idx];
-
-	u32 tile_index = 0;
-	for (u64 i = 0; i < chunk_size; i++) {
-		u32 tile_id = chunk->pre_render_list[i];
-		if (tile_id != 0) {
-			Point p = oned_to_threed(i, chunk_width, chunk_height);
-
-			switch (chunk->pre_render_list[i]) {
-				case 1: {
-					//green
-					chunk->colors[tile_index] = glm::vec3(0.0, 0.3, 0.0);
-				} break;
-				case 2: {
-					//blue
-					chunk->colors[tile_index] = glm::vec3(0.0, 0.0, 1.0);
-				} break;
-				case 3: {
-					//GB
-					chunk->colors[tile_index] = glm::vec3(1.0, 0.645, 0.0);
-				} break;
-				case 4: {
-					//RB
-					chunk->colors[tile_index] = glm::vec3(1.0, 0.0, 1.0);
-				} break;
-				case 5: {
-					//red
-					chunk->colors[tile_index] = glm::vec3(1.0, 0.0, 0.0);
-				} break;
-				case 6: {
-					//red
-					chunk->colors[tile_index] = glm::vec3(0.5, 1.0, 0.8);
-				} break;
-				case 7: {
-					//gray
-					chunk->colors[tile_index] = glm::vec3(0.255, 0.412, 0.88);
-				} break;
-				case 8: {
-					//white
-					chunk->colors[tile_index] = glm::vec3(1.0, 1.0, 1.0);
-				} break;
-				case 9: {
-					//magenta
-					chunk->colors[tile_index] = glm::vec3(0.9, 0.2, 0.5);
-				} break;
-			}
-
-			glm::vec3 m = glm::vec3(p.x + chunk->x_off, p.y, p.z + chunk->z_off);
-			chunk->positions[tile_index] = m;
-			chunk->mappings[i] = tile_index;
-
-			tile_index++;
-		}
+int main(int argc, char **argv) {
+	// ./voxel caves generates density terrain with caves and overhangs instead of the heightmap
+	if (argc > 1 && !strcmp(argv[1], "caves")) {
+		world_terrain = TERRAIN_DENSITY;
 	}
 
-	chunk->num_blocks = tile_index;
-}
-
-int main() {
 	SDL_Init(SDL_INIT_VIDEO);
 
 	SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 3);
@@ -258,20 +79,6 @@ int main() {
 	glGenVertexArrays(1, &vao);
 	glBindVertexArray(vao);
 
-	GLuint vbo_cube_points;
-	glGenBuffers(1, &vbo_cube_points);
-	glBindBuffer(GL_ARRAY_BUFFER, vbo_cube_points);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(cube_points), cube_points, GL_STATIC_DRAW);
-
-	GLuint ibo_cube_indices;
-	glGenBuffers(1, &ibo_cube_indices);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo_cube_indices);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(cube_indices), cube_indices, GL_STATIC_DRAW);
-
-	GLuint points_attr = glGetAttribLocation(obj_shader_program, "coords");
-	GLuint tile_color_attr = glGetAttribLocation(obj_shader_program, "color");
-	GLuint model_attr = glGetAttribLocation(obj_shader_program, "model");
-
 	GLuint vbo_rect_points;
 	glGenBuffers(1, &vbo_rect_points);
 	glBindBuffer(GL_ARRAY_BUFFER, vbo_rect_points);
@@ -283,49 +90,76 @@ int main() {
 	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(rect_indices), rect_indices, GL_STATIC_DRAW);
 
 	GLuint pv_uniform = glGetUniformLocation(obj_shader_program, "pv");
+	GLuint offset_uniform = glGetUniformLocation(obj_shader_program, "offset");
+	GLuint palette_uniform = glGetUniformLocation(obj_shader_program, "palette");
+	glUseProgram(obj_shader_program);
+	glUniform1i(glGetUniformLocation(obj_shader_program, "instances"), 0);
+	glUniform1i(glGetUniformLocation(obj_shader_program, "chunk_origins"), 1);
+	glUniform1i(glGetUniformLocation(obj_shader_program, "instance_ao"), 2);
+	glUniform1i(glGetUniformLocation(obj_shader_program, "instance_light"), 3);
+	GLuint ao_strength_uniform = glGetUniformLocation(obj_shader_program, "ao_strength");
+	GLuint light_strength_uniform = glGetUniformLocation(obj_shader_program, "light_strength");
+
+	GLuint greedy_shader_program = load_and_build_program("src/greedy_vert.vsh", "src/obj_frag.fsh");
+	GLuint greedy_vertex_attr = glGetAttribLocation(greedy_shader_program, "vertex");
+	GLuint greedy_pv_uniform = glGetUniformLocation(greedy_shader_program, "pv");
+	GLuint greedy_palette_uniform = glGetUniformLocation(greedy_shader_program, "palette");
+	glUseProgram(greedy_shader_program);
+	glUniform1i(glGetUniformLocation(greedy_shader_program, "chunk_origins"), 1);
+
+	// every chunk's instances and meshes share a few buffers and draw in one call each
+	renderer = renderer_create(greedy_vertex_attr);
 
 	glViewport(0, 0, screen_width, screen_height);
 
 	u32 start_time = SDL_GetTicks();
 
-	Chunk **chunks = (Chunk **)malloc(sizeof(Chunk *) * num_chunks);
-	for (u32 x = 0; x < num_x_chunks; x++) {
-		for (u32 y = 0; y < num_y_chunks; y++) {
-			Chunk *chunk = generate_chunk(x, y);
-			chunks[twod_to_oned(x, y, num_x_chunks)] = chunk;
-		}
-	}
+	glm::vec3 camera_pos = glm::vec3(chunk_width / 2, chunk_height + 3.0, chunk_depth / 2);
+
+	// far chunks are drawn downsampled (lod.h), so the stream reaches past the last level's switch distance
+	profile_name_thread("main");
+	JobSystem *job_system = job_system_create(0, 64);
+	ChunkStream *stream = stream_create(job_system, 10, 12, 16, 4);
+	// chunks saved by earlier runs, edits included, load from here instead of being generated
+	stream->store = region_store_open(world_terrain == TERRAIN_DENSITY ? "regions_caves" : "regions");
+	// chunks left behind stay encoded in memory within 64MB, loaded chunks included, before going to disk
+	stream->cache = cache_create((u64)64 << 20);
+	stream_fill(stream, camera_pos);
 
 	Image img;
 	img.width = chunk_width;
 	img.height = chunk_depth;
-	img.data = chunks[0]->real_blocks;
+	img.data = stream_find(stream, 0, 0)->chunk->real_blocks;
 	write_tga_bitmap("test.tga", &img);
 
 	u32 block_load = 0;
-	for (u32 i = 0; i < num_chunks; i++) {
-		hull_chunk(chunks, i);
-		update_chunk(chunks, i);
-		block_load += chunks[i]->num_blocks;
+	u32 num_slots = stream->window * stream->window;
+	for (u32 i = 0; i < num_slots; i++) {
+		if (stream->slots[i].state == SLOT_READY) {
+			block_load += stream->slots[i].chunk->num_blocks;
+		}
 	}
 
 	u32 end_time = SDL_GetTicks();
 	printf("%u blocks in %u ms, %f bps\n", block_load, end_time - start_time, (f64)block_load / (f64)((end_time - start_time) / 1000.0f));
 
-	Point hovered = new_point(0, 0, 0);
+	// from here on the stream is the world thread's, frames are drawn from the snapshots it publishes
+	WorldThread *world = world_thread_create(stream);
+	RenderWorld *render_world = render_world_create(stream->window);
+	render_world->release_fn = free_chunk_gl;
+	world_send_camera(world, camera_pos, glm::vec3(0.0, 0.0, 1.0), false);
+	world_thread_start(world);
+	// render frames, input to swap, next to the world's ticks in world->tick_times
+	FrameHistogram frame_times = {};
 
-	GLuint vbo_model;
-	glGenBuffers(1, &vbo_model);
-	glBindBuffer(GL_ARRAY_BUFFER, vbo_model);
+	// light given off by blocks turned into lamps
+	u8 lamp_level = 14;
 
-	GLuint vbo_tile_color;
-	glGenBuffers(1, &vbo_tile_color);
-	glBindBuffer(GL_ARRAY_BUFFER, vbo_tile_color);
+	u32 frame = 0;
 
 	f32 current_time = (f32)SDL_GetTicks() / 60.0;
 	f32 t = 0.0;
 
-	glm::vec3 camera_pos = glm::vec3(chunk_width / 2, chunk_height + 3.0, chunk_depth / 2);
 	glm::vec3 camera_front = glm::vec3(0.0, 0.0, 1.0);
 	glm::vec3 camera_up = glm::vec3(0.0, 1.0, 0.0);
 
@@ -337,9 +171,38 @@ int main() {
 	u8 warped = false;
 	u8 warp = false;
 	bool clicked = false;
+	bool greedy = false;
+	bool occlusion = true;
+	bool ambient_occlusion = true;
+	bool lighting = true;
+
+	// bounds of the render world's chunks, rebuilt every frame before culling
+	u8 *chunk_visible = (u8 *)malloc(num_slots);
+	AabbList chunk_bounds = {};
+	// chunks drawn, culled and occluded over the session, printed on quit as per frame means
+	u64 drawn_total = 0;
+	u64 culled_total = 0;
+	u64 occluded_total = 0;
+	u64 at_level_total[LOD_LEVELS] = {};
+	u32 drawn_max = 0;
+	u64 occlusion_ns = 0;
+	// uploads to the shared buffers over the session, printed on quit
+	u64 bytes_uploaded = 0;
+	u64 chunks_uploaded = 0;
+	u32 upload_frames = 0;
+	// the nearest 24 chunks on screen are drawn as occluders
+	OcclusionBuffer *occlusion_buffer = occlusion_create(24);
+
+	// P starts and stops a profile capture, written to trace_path when it stops or on quit
+	const char *trace_path = "voxel_trace.json";
+	GpuTimer gpu_draw;
+	gpu_timer_init(&gpu_draw, "gpu draw");
 
 	u8 running = true;
 	while (running) {
+		PROFILE_ZONE("frame");
+		u64 frame_start = get_time_ns();
+		u64 span = profile_span_start();
 		SDL_Event event;
 
 		f32 new_time = (f32)SDL_GetTicks() / 60.0;
@@ -372,6 +235,31 @@ int main() {
 							warp = false;
 							SDL_SetRelativeMouseMode(SDL_FALSE);
 						} break;
+						case SDLK_g: {
+							greedy = !greedy;
+							printf("rendering with %s\n", greedy ? "greedy meshes" : "cube instances");
+						} break;
+						case SDLK_o: {
+							occlusion = !occlusion;
+							printf("occlusion culling %s\n", occlusion ? "on" : "off");
+						} break;
+						case SDLK_v: {
+							ambient_occlusion = !ambient_occlusion;
+							printf("ambient occlusion %s\n", ambient_occlusion ? "on" : "off");
+						} break;
+						case SDLK_p: {
+							if (!profile_capturing()) {
+								profile_begin();
+								printf("profiling\n");
+							} else {
+								profile_end();
+								printf("%s %s\n", profile_write_trace(trace_path) ? "wrote" : "could not write", trace_path);
+							}
+						} break;
+						case SDLK_l: {
+							lighting = !lighting;
+							printf("lighting %s\n", lighting ? "on" : "off");
+						} break;
 					}
 				} break;
 				case SDL_MOUSEMOTION: {
@@ -415,9 +303,27 @@ int main() {
 					SDL_SetRelativeMouseMode(SDL_TRUE);
 					warp = true;
 
+					// left click digs out the hovered block, right click places one against the face it is looked at through,
+					// middle click turns the hovered block into a lamp or back. The world thread applies them on its next tick.
+					if (!render_world->hovered) {
+						break;
+					}
+					WorldCommand command = {};
+					command.x = render_world->hovered_block[0];
+					command.y = render_world->hovered_block[1];
+					command.z = render_world->hovered_block[2];
+					memcpy(command.normal, render_world->hovered_normal, sizeof(command.normal));
+					command.level = lamp_level;
 					if (buttons & SDL_BUTTON(SDL_BUTTON_LEFT)) {
+						command.kind = COMMAND_DIG;
 					} else if (buttons & SDL_BUTTON(SDL_BUTTON_RIGHT)) {
+						command.kind = COMMAND_PLACE;
+					} else if (buttons & SDL_BUTTON(SDL_BUTTON_MIDDLE)) {
+						command.kind = COMMAND_LAMP;
+					} else {
+						break;
 					}
+					world_send_command(world, command);
 				} break;
 				case SDL_QUIT: {
 					running = 0;
@@ -425,66 +331,149 @@ int main() {
 			}
 		}
 
+		world_send_camera(world, camera_pos, camera_front, greedy);
+		profile_span("input", &span);
+
+		// streaming, edits, picking and meshing ran on the world thread, this only copies in what changed
+		WorldSnapshot *snapshot = snapshot_take(&world->exchange);
+		if (snapshot) {
+			render_world_apply(render_world, snapshot);
+		}
+		profile_span("snapshot", &span);
+
 		glEnable(GL_DEPTH_TEST);
 		glClear(GL_DEPTH_BUFFER_BIT | GL_COLOR_BUFFER_BIT);
 		glUseProgram(obj_shader_program);
 
-		glEnableVertexAttribArray(points_attr);
-		glEnableVertexAttribArray(tile_color_attr);
-		glEnableVertexAttribArray(model_attr);
+		glm::mat4 perspective;
+		perspective = glm::perspective(glm::radians(45.0f), (f32)screen_width / (f32)screen_height, 0.1f, 5000.0f);
+		glm::mat4 view;
+		view = glm::lookAt(camera_pos, camera_pos + camera_front, camera_up);
+		glm::mat4 pv = perspective * view;
+
+		RenderStats frame_stats = {};
 
-		i32 size;
+		Chunk **ready_chunks = render_world->ready;
+		u32 num_ready = render_world->num_ready;
+		aabb_list_clear(&chunk_bounds);
+		for (u32 i = 0; i < num_ready; i++) {
+			glm::vec3 min, max;
+			chunk_aabb(ready_chunks[i], &min, &max);
+			aabb_list_push(&chunk_bounds, min, max);
+		}
 
-		GL_CHECK(glBindBuffer(GL_ARRAY_BUFFER, vbo_cube_points));
-		GL_CHECK(glVertexAttribPointer(points_attr, 3, GL_FLOAT, GL_FALSE, 0, 0));
+		Frustum frustum = frustum_from_pv(pv);
+		frame_stats.chunks_drawn = cull_aabbs(&frustum, &chunk_bounds, chunk_visible);
+		frame_stats.chunks_culled = num_ready - frame_stats.chunks_drawn;
+		if (occlusion) {
+			frame_stats.chunks_occluded = occlusion_cull_chunks(occlusion_buffer, pv, camera_pos, ready_chunks, num_ready, chunk_visible);
+			frame_stats.chunks_drawn -= frame_stats.chunks_occluded;
+		}
 
-		GL_CHECK(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo_cube_indices));
-		GL_CHECK(glGetBufferParameteriv(GL_ELEMENT_ARRAY_BUFFER, GL_BUFFER_SIZE, &size));
+		// the world thread picked each chunk's level for the camera it last ticked with
+		for (u32 i = 0; i < num_ready; i++) {
+			if (chunk_visible[i]) {
+				frame_stats.chunks_at_level[ready_chunks[i]->lod]++;
+			}
+		}
 
-		GL_CHECK(glBindBuffer(GL_ARRAY_BUFFER, vbo_tile_color));
-		GL_CHECK(glVertexAttribPointer(tile_color_attr, 3, GL_FLOAT, GL_FALSE, 0, 0));
-		GL_CHECK(glVertexAttribDivisor(tile_color_attr, 1));
+		profile_span("cull", &span);
+		renderer_begin_frame(renderer);
+		for (u32 i = 0; i < num_ready; i++) {
+			if (!chunk_visible[i]) {
+				continue;
+			}
 
-		GL_CHECK(glBindBuffer(GL_ARRAY_BUFFER, vbo_model));
-		GL_CHECK(glVertexAttribPointer(model_attr, 3, GL_FLOAT, GL_FALSE, 0, 0));
-		GL_CHECK(glVertexAttribDivisor(model_attr, 1));
+			// near chunks go through the path picked with G, far ones through their downsampled meshes.
+			// A mesh the world has not sent yet, e.g. the frame after pressing G, is drawn as cubes.
+			Chunk *chunk = ready_chunks[i];
+			ChunkMesh *mesh = chunk->lod ? chunk->lod_meshes[chunk->lod] : (greedy ? chunk->mesh : NULL);
+			if (mesh == NULL) {
+				renderer_queue_cubes(renderer, chunk, &frame_stats);
+			} else {
+				renderer_queue_mesh(renderer, chunk, mesh, &frame_stats);
+			}
+		}
 
-		glm::mat4 perspective;
-		perspective = glm::perspective(glm::radians(45.0f), (f32)screen_width / (f32)screen_height, 0.1f, 5000.0f);
-		glm::mat4 view;
-		view = glm::lookAt(camera_pos, camera_pos + camera_front, camera_up);
-		glm::mat4 pv = perspective * view;
+		profile_span("queue", &span);
+		gpu_timer_begin(&gpu_draw);
 		glUniformMatrix4fv(pv_uniform, 1, GL_FALSE, &pv[0][0]);
+		glUniform3fv(palette_uniform, TILE_PALETTE_SIZE, &tile_colors[0][0]);
+		glUniform3f(offset_uniform, 0.0, 0.0, 0.0);
+		glUniform1f(ao_strength_uniform, ambient_occlusion ? 0.2f : 0.0f);
+		glUniform1f(light_strength_uniform, lighting ? 1.0f : 0.0f);
+		renderer_draw_cubes(renderer, &frame_stats);
 
-		for (u32 i = 0; i < num_chunks; i++) {
-			glBindBuffer(GL_ARRAY_BUFFER, vbo_tile_color);
-			glBufferData(GL_ARRAY_BUFFER, sizeof(glm::vec3) * chunks[i]->num_blocks, chunks[i]->colors, GL_STREAM_DRAW);
+		glUseProgram(greedy_shader_program);
+		glUniformMatrix4fv(greedy_pv_uniform, 1, GL_FALSE, &pv[0][0]);
+		glUniform3fv(greedy_palette_uniform, TILE_PALETTE_SIZE, &tile_colors[0][0]);
+		renderer_draw_meshes(renderer, &frame_stats);
 
-			glBindBuffer(GL_ARRAY_BUFFER, vbo_model);
-			glBufferData(GL_ARRAY_BUFFER, sizeof(glm::vec3) * chunks[i]->num_blocks, chunks[i]->positions, GL_STREAM_DRAW);
+		glUseProgram(obj_shader_program);
 
-			GL_CHECK(glDrawElementsInstanced(GL_TRIANGLES, size / sizeof(GLushort), GL_UNSIGNED_SHORT, 0, chunks[i]->num_blocks));
+		bytes_uploaded += frame_stats.bytes_uploaded;
+		chunks_uploaded += frame_stats.chunks_uploaded;
+		upload_frames += frame_stats.bytes_uploaded != 0;
+		drawn_total += frame_stats.chunks_drawn;
+		culled_total += frame_stats.chunks_culled;
+		occluded_total += frame_stats.chunks_occluded;
+		for (u32 l = 0; l < LOD_LEVELS; l++) {
+			at_level_total[l] += frame_stats.chunks_at_level[l];
 		}
+		drawn_max = frame_stats.chunks_drawn > drawn_max ? frame_stats.chunks_drawn : drawn_max;
+		occlusion_ns += occlusion ? occlusion_buffer->stats.cull_ns : 0;
 
 		glDisable(GL_DEPTH_TEST);
 
-        chunks[0]->colors[0] = glm::vec3(1.0, 1.0, 1.0);
 		pv = glm::ortho(-66.5f, 66.5f, -37.6f, 37.6f, -1.0f, 1.0f);
 
-		chunks[0]->positions[0] = glm::vec3(0.1, 0.0, 0.0);
-
-		glBindBuffer(GL_ARRAY_BUFFER, vbo_tile_color);
-		glBufferData(GL_ARRAY_BUFFER, sizeof(glm::vec3), chunks[0]->colors, GL_STREAM_DRAW);
-
-		glBindBuffer(GL_ARRAY_BUFFER, vbo_model);
-		glBufferData(GL_ARRAY_BUFFER, sizeof(glm::vec3), chunks[0]->positions, GL_STREAM_DRAW);
-
+		glUniform3f(offset_uniform, 0.1, 0.0, 0.0);
 		glUniformMatrix4fv(pv_uniform, 1, GL_FALSE, &pv[0][0]);
-		GL_CHECK(glDrawElementsInstanced(GL_TRIANGLES, size / sizeof(GLushort), GL_UNSIGNED_SHORT, 0, 1));
+		renderer_draw_cursor(renderer);
+		gpu_timer_end(&gpu_draw);
+		profile_span("draw", &span);
 
 		SDL_GL_SwapWindow(window);
+		profile_span("swap", &span);
+		histogram_push(&frame_times, get_time_ns() - frame_start);
+		frame++;
+	}
+
+	aabb_list_free(&chunk_bounds);
+	occlusion_destroy(occlusion_buffer);
+	free(chunk_visible);
+	printf("uploads: %lu bytes for %lu chunks over %u of %u frames\n", bytes_uploaded, chunks_uploaded, upload_frames, frame);
+	if (frame) {
+		printf("chunks per frame: drew %.1f (max %u), culled %.1f, occluded %.1f, per level", (f64)drawn_total / frame, drawn_max,
+			(f64)culled_total / frame, (f64)occluded_total / frame);
+		for (u32 l = 0; l < LOD_LEVELS; l++) {
+			printf(" %.1f", (f64)at_level_total[l] / frame);
+		}
+		printf(", occlusion %.3f ms\n", (f64)occlusion_ns / frame / 1e6);
 	}
 
+	// the stream is this thread's again once the world thread is joined
+	world_thread_stop(world);
+	histogram_print(&frame_times, "render frames");
+	histogram_print(&world->tick_times, "world ticks");
+	printf("snapshots: %lu published, %lu skipped, %lu bytes copied\n", world->exchange.stats.published, world->exchange.stats.skipped, world->exchange.stats.bytes_copied);
+	render_world_destroy(render_world);
+	world_thread_destroy(world);
+
+	RegionStore *store = stream->store;
+	ChunkCache *cache = stream->cache;
+	printf("chunk cache: %.1f%% hit rate, %lu rebuilt from warm, %lu from cold, %u warm chunks in %lu bytes, %u cold\n",
+		cache_hit_rate(cache) * 100.0, cache->stats.hits, cache->stats.cold_rebuilds, cache->stats.warm_chunks, cache->stats.warm_bytes, cache->stats.cold_chunks);
+	stream_destroy(stream);
+	cache_destroy(cache);
+	renderer_destroy(renderer);
+	region_store_close(store);
+	gpu_timer_destroy(&gpu_draw);
+	if (profile_capturing()) {
+		profile_end();
+		printf("%s %s\n", profile_write_trace(trace_path) ? "wrote" : "could not write", trace_path);
+	}
+	job_system_destroy(job_system);
 	SDL_Quit();
 
 	return 0;
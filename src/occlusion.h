@@ -0,0 +1,339 @@
+#ifndef OCCLUSION_H
+#define OCCLUSION_H
+
+#include <float.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <glm/glm.hpp>
+
+#include "common.h"
+#include "chunk.h"
+
+// Software occlusion culling on the CPU. The terrain under each OCCLUDER_TILE x OCCLUDER_TILE patch
+// of columns is solid down to y = 0, so a box from the ground up to the patch's lowest top hides
+// whatever is behind it. The nearest chunks draw those slabs into a small depth buffer, which is
+// reduced into a max depth pyramid, and chunk boxes are tested against the pyramid before drawing.
+// Depths are clip space w (distance along the view direction).
+// An occluder only covers pixels its silhouette covers completely, at the depth of its farthest
+// corner, so a box is only ever culled when it really is hidden. Everything is plain scalar float
+// math, the same inputs always give the same result.
+
+#define OCCLUSION_WIDTH 256
+#define OCCLUSION_HEIGHT 128
+// 256x128 down to 2x1
+#define OCCLUSION_LEVELS 8
+#define OCCLUDER_TILE 4
+// corners closer than this are too near the eye to project, such boxes are never occluders and never culled
+#define OCCLUSION_MIN_W 0.01f
+
+typedef struct OcclusionStats {
+	u32 occluders_drawn;
+	u32 boxes_tested;
+	u32 boxes_occluded;
+	u64 cull_ns;
+} OcclusionStats;
+
+typedef struct OccluderCandidate {
+	f32 dist2;
+	u32 index;
+} OccluderCandidate;
+
+typedef struct OcclusionBuffer {
+	glm::mat4 pv;
+	// level 0 is OCCLUSION_WIDTH x OCCLUSION_HEIGHT, each level above holds the farthest of 2x2 texels below
+	f32 *levels[OCCLUSION_LEVELS];
+	// how many of the nearest visible chunks draw their slabs each frame
+	u32 max_occluder_chunks;
+	OccluderCandidate *candidates;
+	u32 candidate_capacity;
+	OcclusionStats stats;
+} OcclusionBuffer;
+
+OcclusionBuffer *occlusion_create(u32 max_occluder_chunks) {
+	OcclusionBuffer *buf = (OcclusionBuffer *)calloc(1, sizeof(OcclusionBuffer));
+	for (u32 l = 0; l < OCCLUSION_LEVELS; l++) {
+		buf->levels[l] = (f32 *)malloc(sizeof(f32) * (OCCLUSION_WIDTH >> l) * (OCCLUSION_HEIGHT >> l));
+	}
+	buf->max_occluder_chunks = max_occluder_chunks;
+	return buf;
+}
+
+void occlusion_destroy(OcclusionBuffer *buf) {
+	for (u32 l = 0; l < OCCLUSION_LEVELS; l++) {
+		free(buf->levels[l]);
+	}
+	free(buf->candidates);
+	free(buf);
+}
+
+void occlusion_begin(OcclusionBuffer *buf, glm::mat4 pv) {
+	buf->pv = pv;
+	f32 *depth = buf->levels[0];
+	for (u32 i = 0; i < OCCLUSION_WIDTH * OCCLUSION_HEIGHT; i++) {
+		depth[i] = FLT_MAX;
+	}
+	memset(&buf->stats, 0, sizeof(OcclusionStats));
+}
+
+// Projects the 8 corners into pixel coordinates, false when one is too close to the eye
+bool occlusion_project_box(OcclusionBuffer *buf, glm::vec3 min, glm::vec3 max, f32 *xs, f32 *ys, f32 *w_min, f32 *w_max) {
+	*w_min = FLT_MAX;
+	*w_max = 0.0f;
+	for (u32 i = 0; i < 8; i++) {
+		glm::vec4 corner = glm::vec4((i & 1) ? max.x : min.x, (i & 2) ? max.y : min.y, (i & 4) ? max.z : min.z, 1.0f);
+		glm::vec4 clip = buf->pv * corner;
+		if (clip.w < OCCLUSION_MIN_W) {
+			return false;
+		}
+
+		xs[i] = (clip.x / clip.w * 0.5f + 0.5f) * OCCLUSION_WIDTH;
+		ys[i] = (clip.y / clip.w * 0.5f + 0.5f) * OCCLUSION_HEIGHT;
+		*w_min = clip.w < *w_min ? clip.w : *w_min;
+		*w_max = clip.w > *w_max ? clip.w : *w_max;
+	}
+	return true;
+}
+
+f32 hull_cross(f32 *xs, f32 *ys, u32 o, u32 a, u32 b) {
+	return (xs[a] - xs[o]) * (ys[b] - ys[o]) - (ys[a] - ys[o]) * (xs[b] - xs[o]);
+}
+
+// Andrew's monotone chain over the projected corners, writes the counter clockwise hull to out
+u32 occlusion_convex_hull(f32 *xs, f32 *ys, u32 *out) {
+	u32 order[8];
+	for (u32 i = 0; i < 8; i++) {
+		u32 j = i;
+		while (j > 0 && (xs[order[j - 1]] > xs[i] || (xs[order[j - 1]] == xs[i] && ys[order[j - 1]] > ys[i]))) {
+			order[j] = order[j - 1];
+			j--;
+		}
+		order[j] = i;
+	}
+
+	u32 hull[16];
+	u32 n = 0;
+	for (u32 i = 0; i < 8; i++) {
+		while (n >= 2 && hull_cross(xs, ys, hull[n - 2], hull[n - 1], order[i]) <= 0.0f) {
+			n--;
+		}
+		hull[n++] = order[i];
+	}
+	u32 lower = n + 1;
+	for (i32 i = 6; i >= 0; i--) {
+		while (n >= lower && hull_cross(xs, ys, hull[n - 2], hull[n - 1], order[i]) <= 0.0f) {
+			n--;
+		}
+		hull[n++] = order[i];
+	}
+
+	// the last point repeats the first
+	n--;
+	memcpy(out, hull, sizeof(u32) * n);
+	return n;
+}
+
+// Draws a solid box as an occluder, false when it could not be drawn
+bool occlusion_draw_box(OcclusionBuffer *buf, glm::vec3 min, glm::vec3 max) {
+	f32 xs[8], ys[8];
+	f32 w_min, w_max;
+	if (!occlusion_project_box(buf, min, max, xs, ys, &w_min, &w_max)) {
+		return false;
+	}
+
+	u32 hull[8];
+	u32 n = occlusion_convex_hull(xs, ys, hull);
+	if (n < 3) {
+		return false;
+	}
+
+	// inside edge e when a * x + b * y + c >= 0
+	f32 a[8], b[8], c[8];
+	f32 x_min = FLT_MAX, x_max = -FLT_MAX, y_min = FLT_MAX, y_max = -FLT_MAX;
+	for (u32 e = 0; e < n; e++) {
+		u32 p = hull[e];
+		u32 q = hull[(e + 1) % n];
+		a[e] = ys[p] - ys[q];
+		b[e] = xs[q] - xs[p];
+		c[e] = xs[p] * ys[q] - ys[p] * xs[q];
+		x_min = fminf(x_min, xs[p]);
+		x_max = fmaxf(x_max, xs[p]);
+		y_min = fminf(y_min, ys[p]);
+		y_max = fmaxf(y_max, ys[p]);
+	}
+
+	// pixel (px, py) spans [px, px + 1] x [py, py + 1] and is only covered when all four corners are inside
+	i32 row_start = (i32)fmaxf(ceilf(y_min), 0.0f);
+	i32 row_end = (i32)fminf(floorf(y_max), (f32)OCCLUSION_HEIGHT) - 1;
+	f32 *depth = buf->levels[0];
+	for (i32 py = row_start; py <= row_end; py++) {
+		f32 span_start = fmaxf(ceilf(x_min), 0.0f);
+		f32 span_end = fminf(floorf(x_max), (f32)OCCLUSION_WIDTH) - 1.0f;
+		for (u32 e = 0; e < n && span_start <= span_end; e++) {
+			// the corner row that is worst for this edge
+			f32 y = b[e] < 0.0f ? (f32)(py + 1) : (f32)py;
+			f32 t = -(b[e] * y + c[e]);
+			if (a[e] > 0.0f) {
+				span_start = fmaxf(span_start, ceilf(t / a[e]));
+			} else if (a[e] < 0.0f) {
+				span_end = fminf(span_end, floorf(t / a[e]) - 1.0f);
+			} else if (t > 0.0f) {
+				span_end = -1.0f;
+			}
+		}
+
+		for (i32 px = (i32)span_start; px <= (i32)span_end; px++) {
+			f32 *d = &depth[py * OCCLUSION_WIDTH + px];
+			*d = w_max < *d ? w_max : *d;
+		}
+	}
+
+	buf->stats.occluders_drawn++;
+	return true;
+}
+
+// Draws the solid slab under each tile of columns. A side without a neighbour has no wall drawn
+// over it, so chunks missing one are left out rather than hiding what shows through the gap.
+void occlusion_draw_chunk(OcclusionBuffer *buf, Chunk *chunk) {
+	for (u32 side = 0; side < 4; side++) {
+		if (chunk->neighbours[side] == NULL) {
+			return;
+		}
+	}
+
+	for (u32 tz = 0; tz < chunk_depth; tz += OCCLUDER_TILE) {
+		for (u32 tx = 0; tx < chunk_width; tx += OCCLUDER_TILE) {
+			// solid from the floor up, caves and overhangs above it let things show through
+			u32 run = chunk_height;
+			for (u32 z = tz; z < tz + OCCLUDER_TILE; z++) {
+				for (u32 x = tx; x < tx + OCCLUDER_TILE; x++) {
+					u32 floor = column_floor_run(chunk->occupancy[twod_to_oned(x, z, chunk_width)]);
+					run = floor < run ? floor : run;
+				}
+			}
+
+			glm::vec3 min = glm::vec3((i32)tx + chunk->x_off, 0, (i32)tz + chunk->z_off);
+			glm::vec3 max = glm::vec3((i32)(tx + OCCLUDER_TILE) + chunk->x_off, run, (i32)(tz + OCCLUDER_TILE) + chunk->z_off);
+			occlusion_draw_box(buf, min, max);
+		}
+	}
+}
+
+// Builds the max depth pyramid once every occluder is drawn
+void occlusion_finish(OcclusionBuffer *buf) {
+	for (u32 l = 1; l < OCCLUSION_LEVELS; l++) {
+		u32 width = OCCLUSION_WIDTH >> l;
+		u32 height = OCCLUSION_HEIGHT >> l;
+		f32 *below = buf->levels[l - 1];
+		f32 *level = buf->levels[l];
+		for (u32 y = 0; y < height; y++) {
+			for (u32 x = 0; x < width; x++) {
+				u32 i = (y * 2) * (width * 2) + x * 2;
+				f32 d = fmaxf(fmaxf(below[i], below[i + 1]), fmaxf(below[i + width * 2], below[i + width * 2 + 1]));
+				level[y * width + x] = d;
+			}
+		}
+	}
+}
+
+// False when the box is hidden behind the occluders drawn so far
+bool occlusion_test_box(OcclusionBuffer *buf, glm::vec3 min, glm::vec3 max) {
+	buf->stats.boxes_tested++;
+
+	f32 xs[8], ys[8];
+	f32 w_min, w_max;
+	if (!occlusion_project_box(buf, min, max, xs, ys, &w_min, &w_max)) {
+		return true;
+	}
+
+	f32 x_min = FLT_MAX, x_max = -FLT_MAX, y_min = FLT_MAX, y_max = -FLT_MAX;
+	for (u32 i = 0; i < 8; i++) {
+		x_min = fminf(x_min, xs[i]);
+		x_max = fmaxf(x_max, xs[i]);
+		y_min = fminf(y_min, ys[i]);
+		y_max = fmaxf(y_max, ys[i]);
+	}
+
+	// off screen boxes are left to the frustum test
+	i32 x0 = (i32)fmaxf(floorf(x_min), 0.0f);
+	i32 y0 = (i32)fmaxf(floorf(y_min), 0.0f);
+	i32 x1 = (i32)fminf(ceilf(x_max), (f32)OCCLUSION_WIDTH) - 1;
+	i32 y1 = (i32)fminf(ceilf(y_max), (f32)OCCLUSION_HEIGHT) - 1;
+	if (x0 > x1 || y0 > y1) {
+		return true;
+	}
+
+	// the finest level where the rectangle spans at most 4x4 texels
+	u32 l = 0;
+	while (l + 1 < OCCLUSION_LEVELS && ((x1 >> l) - (x0 >> l) > 3 || (y1 >> l) - (y0 >> l) > 3)) {
+		l++;
+	}
+
+	u32 width = OCCLUSION_WIDTH >> l;
+	f32 *level = buf->levels[l];
+	for (i32 y = y0 >> l; y <= y1 >> l; y++) {
+		for (i32 x = x0 >> l; x <= x1 >> l; x++) {
+			if (w_min <= level[y * width + x]) {
+				return true;
+			}
+		}
+	}
+
+	buf->stats.boxes_occluded++;
+	return false;
+}
+
+int compare_occluder_dist(const void *a, const void *b) {
+	f32 da = ((const OccluderCandidate *)a)->dist2;
+	f32 db = ((const OccluderCandidate *)b)->dist2;
+	return (da > db) - (da < db);
+}
+
+// Draws the nearest visible chunks as occluders, then clears visible[i] for every chunk hidden
+// behind them. Returns how many were occluded.
+u32 occlusion_cull_chunks(OcclusionBuffer *buf, glm::mat4 pv, glm::vec3 eye, Chunk **chunks, u32 count, u8 *visible) {
+	PROFILE_ZONE("occlusion_cull");
+	u64 start = get_time_ns();
+	occlusion_begin(buf, pv);
+
+	if (count > buf->candidate_capacity) {
+		buf->candidate_capacity = count;
+		buf->candidates = (OccluderCandidate *)realloc(buf->candidates, sizeof(OccluderCandidate) * count);
+	}
+
+	u32 num_candidates = 0;
+	for (u32 i = 0; i < count; i++) {
+		if (!visible[i]) {
+			continue;
+		}
+
+		f32 dx = chunks[i]->x_off + chunk_width * 0.5f - eye.x;
+		f32 dz = chunks[i]->z_off + chunk_depth * 0.5f - eye.z;
+		buf->candidates[num_candidates].dist2 = dx * dx + dz * dz;
+		buf->candidates[num_candidates].index = i;
+		num_candidates++;
+	}
+	qsort(buf->candidates, num_candidates, sizeof(OccluderCandidate), compare_occluder_dist);
+
+	u32 num_occluders = num_candidates < buf->max_occluder_chunks ? num_candidates : buf->max_occluder_chunks;
+	for (u32 i = 0; i < num_occluders; i++) {
+		occlusion_draw_chunk(buf, chunks[buf->candidates[i].index]);
+	}
+	occlusion_finish(buf);
+
+	u32 num_occluded = 0;
+	for (u32 i = 0; i < num_candidates; i++) {
+		u32 index = buf->candidates[i].index;
+		glm::vec3 min, max;
+		chunk_aabb(chunks[index], &min, &max);
+		if (!occlusion_test_box(buf, min, max)) {
+			visible[index] = 0;
+			num_occluded++;
+		}
+	}
+
+	buf->stats.cull_ns = get_time_ns() - start;
+	return num_occluded;
+}
+
+#endif
@@ -0,0 +1,91 @@
+#ifndef OCCUPANCY_H
+#define OCCUPANCY_H
+
+#include "common.h"
+
+// One bit per voxel of a column, bit y of the column in word y / 64. A chunk keeps one
+// OccupancyColumn per column of solid voxels, so face culling is done a whole column at a time:
+// a voxel shows a face when it is solid and the voxel across that face is not, which for the
+// voxel above is a shift and for the column beside is an AND NOT of the two columns.
+// chunk_height is 256, OCCUPANCY_WORDS * 64 of it.
+
+#define OCCUPANCY_WORDS 4
+
+typedef struct OccupancyColumn {
+	u64 words[OCCUPANCY_WORDS];
+} OccupancyColumn;
+
+// Voxels 0 to top inclusive set, a heightmap column
+OccupancyColumn column_to_height(u32 top) {
+	OccupancyColumn column;
+	for (u32 w = 0; w < OCCUPANCY_WORDS; w++) {
+		u32 base = w * 64;
+		if (top < base) {
+			column.words[w] = 0;
+		} else if (top - base >= 63) {
+			column.words[w] = ~(u64)0;
+		} else {
+			column.words[w] = ((u64)2 << (top - base)) - 1;
+		}
+	}
+	return column;
+}
+
+// Word w of a column with voxels lo to hi inclusive set
+u64 column_between_word(i32 w, i32 lo, i32 hi) {
+	i32 base = w * 64;
+	u64 below_hi = hi - base >= 63 ? ~(u64)0 : ((u64)2 << (hi - base)) - 1;
+	u64 from_lo = lo <= base ? ~(u64)0 : ~(((u64)1 << (lo - base)) - 1);
+	return below_hi & from_lo;
+}
+
+// Word k of a column moved so bit y holds voxel y + 1, above the top is empty
+u64 column_above_word(const u64 *words, u32 k) {
+	return (words[k] >> 1) | (k + 1 < OCCUPANCY_WORDS ? words[k + 1] << 63 : 0);
+}
+
+// Word k of a column moved so bit y holds voxel y - 1, below the floor is solid
+u64 column_below_word(const u64 *words, u32 k) {
+	return (words[k] << 1) | (k > 0 ? words[k - 1] >> 63 : 1);
+}
+
+u32 column_count(OccupancyColumn a) {
+	u32 count = 0;
+	for (u32 w = 0; w < OCCUPANCY_WORDS; w++) {
+		count += a.words[w] ? __builtin_popcountll(a.words[w]) : 0;
+	}
+	return count;
+}
+
+// Lowest set voxel, OCCUPANCY_WORDS * 64 when empty
+u32 column_lowest(OccupancyColumn a) {
+	for (u32 w = 0; w < OCCUPANCY_WORDS; w++) {
+		if (a.words[w]) {
+			return w * 64 + __builtin_ctzll(a.words[w]);
+		}
+	}
+	return OCCUPANCY_WORDS * 64;
+}
+
+// Highest set voxel, 0 when empty
+u32 column_highest(OccupancyColumn a) {
+	for (u32 w = OCCUPANCY_WORDS; w > 0; w--) {
+		if (a.words[w - 1]) {
+			return (w - 1) * 64 + 63 - __builtin_clzll(a.words[w - 1]);
+		}
+	}
+	return 0;
+}
+
+// Voxels solid without a gap from y = 0 up
+u32 column_floor_run(OccupancyColumn a) {
+	u32 run = 0;
+	for (u32 w = 0; w < OCCUPANCY_WORDS; w++) {
+		if (a.words[w] != ~(u64)0) {
+			return run + __builtin_ctzll(~a.words[w]);
+		}
+		run += 64;
+	}
+	return run;
+}
+#endif
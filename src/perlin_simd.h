@@ -0,0 +1,284 @@
+#ifndef PERLIN_SIMD_H
+#define PERLIN_SIMD_H
+
+#include "common.h"
+
+// Batched version of stb_perlin_noise3, must be included after the STB_PERLIN_IMPLEMENTATION
+// since it shares stb's permutation table.
+//
+// The SSE4.1 and AVX2 kernels do the same float operations in the same order as stb
+// (floor, ease curve, gradient dot, lerps) and never use FMA, so they match the scalar
+// noise bit for bit. PERLIN_SIMD_TOLERANCE is what the noise bench holds them to.
+
+#if defined(__x86_64__) || defined(__i386__)
+#define PERLIN_SIMD_X86 1
+#include <immintrin.h>
+#else
+#define PERLIN_SIMD_X86 0
+#endif
+
+#define PERLIN_SIMD_TOLERANCE 1e-6f
+
+typedef enum PerlinSimdLevel {
+	PERLIN_SCALAR,
+	PERLIN_SSE41,
+	PERLIN_AVX2,
+} PerlinSimdLevel;
+
+const char *perlin_simd_level_names[] = {"scalar", "sse4.1", "avx2"};
+
+// gradient per hash & 63, flattened from stb__perlin_grad's basis and indices tables
+static f32 perlin_grad_x[64];
+static f32 perlin_grad_y[64];
+static f32 perlin_grad_z[64];
+
+bool init_perlin_grads() {
+	static const f32 basis[12][3] = {
+		{ 1, 1, 0 }, {-1, 1, 0 }, { 1,-1, 0 }, {-1,-1, 0 },
+		{ 1, 0, 1 }, {-1, 0, 1 }, { 1, 0,-1 }, {-1, 0,-1 },
+		{ 0, 1, 1 }, { 0,-1, 1 }, { 0, 1,-1 }, { 0,-1,-1 },
+	};
+	static const u8 indices[64] = {
+		0,1,2,3,4,5,6,7,8,9,10,11,
+		0,9,1,11,
+		0,1,2,3,4,5,6,7,8,9,10,11,
+		0,1,2,3,4,5,6,7,8,9,10,11,
+		0,1,2,3,4,5,6,7,8,9,10,11,
+		0,1,2,3,4,5,6,7,8,9,10,11,
+	};
+
+	for (u32 i = 0; i < 64; i++) {
+		perlin_grad_x[i] = basis[indices[i]][0];
+		perlin_grad_y[i] = basis[indices[i]][1];
+		perlin_grad_z[i] = basis[indices[i]][2];
+	}
+	return true;
+}
+
+bool perlin_grads_ready = init_perlin_grads();
+
+#if PERLIN_SIMD_X86
+
+__attribute__((target("sse4.1")))
+static inline __m128 perlin_ease_4(__m128 a) {
+	__m128 r = _mm_sub_ps(_mm_mul_ps(a, _mm_set1_ps(6.0f)), _mm_set1_ps(15.0f));
+	r = _mm_add_ps(_mm_mul_ps(r, a), _mm_set1_ps(10.0f));
+	return _mm_mul_ps(_mm_mul_ps(_mm_mul_ps(r, a), a), a);
+}
+
+__attribute__((target("sse4.1")))
+static inline __m128 perlin_lerp_4(__m128 a, __m128 b, __m128 t) {
+	return _mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(b, a), t));
+}
+
+// SSE has no gather, the table lookups go through the stack
+__attribute__((target("sse4.1")))
+static inline __m128i perlin_lookup_4(__m128i idx) {
+	i32 lanes[4];
+	_mm_storeu_si128((__m128i *)lanes, idx);
+	return _mm_setr_epi32(stb__perlin_randtab[lanes[0]], stb__perlin_randtab[lanes[1]], stb__perlin_randtab[lanes[2]], stb__perlin_randtab[lanes[3]]);
+}
+
+__attribute__((target("sse4.1")))
+static inline __m128 perlin_grad_4(__m128i hash, __m128 x, __m128 y, __m128 z) {
+	i32 lanes[4];
+	_mm_storeu_si128((__m128i *)lanes, _mm_and_si128(hash, _mm_set1_epi32(63)));
+	__m128 gx = _mm_setr_ps(perlin_grad_x[lanes[0]], perlin_grad_x[lanes[1]], perlin_grad_x[lanes[2]], perlin_grad_x[lanes[3]]);
+	__m128 gy = _mm_setr_ps(perlin_grad_y[lanes[0]], perlin_grad_y[lanes[1]], perlin_grad_y[lanes[2]], perlin_grad_y[lanes[3]]);
+	__m128 gz = _mm_setr_ps(perlin_grad_z[lanes[0]], perlin_grad_z[lanes[1]], perlin_grad_z[lanes[2]], perlin_grad_z[lanes[3]]);
+	return _mm_add_ps(_mm_add_ps(_mm_mul_ps(gx, x), _mm_mul_ps(gy, y)), _mm_mul_ps(gz, z));
+}
+
+__attribute__((target("sse4.1")))
+void perlin_noise3_sse41(const f32 *xs, const f32 *ys, const f32 *zs, f32 *out, u32 count, u32 x_mask_, u32 y_mask_, u32 z_mask_) {
+	__m128 one = _mm_set1_ps(1.0f);
+	__m128i one_i = _mm_set1_epi32(1);
+	__m128i x_mask = _mm_set1_epi32(x_mask_);
+	__m128i y_mask = _mm_set1_epi32(y_mask_);
+	__m128i z_mask = _mm_set1_epi32(z_mask_);
+
+	for (u32 i = 0; i < count; i += 4) {
+		__m128 x = _mm_loadu_ps(xs + i);
+		__m128 y = _mm_loadu_ps(ys + i);
+		__m128 z = _mm_loadu_ps(zs + i);
+
+		__m128 fx = _mm_floor_ps(x);
+		__m128 fy = _mm_floor_ps(y);
+		__m128 fz = _mm_floor_ps(z);
+		__m128i px = _mm_cvttps_epi32(fx);
+		__m128i py = _mm_cvttps_epi32(fy);
+		__m128i pz = _mm_cvttps_epi32(fz);
+
+		__m128i x0 = _mm_and_si128(px, x_mask), x1 = _mm_and_si128(_mm_add_epi32(px, one_i), x_mask);
+		__m128i y0 = _mm_and_si128(py, y_mask), y1 = _mm_and_si128(_mm_add_epi32(py, one_i), y_mask);
+		__m128i z0 = _mm_and_si128(pz, z_mask), z1 = _mm_and_si128(_mm_add_epi32(pz, one_i), z_mask);
+
+		x = _mm_sub_ps(x, fx);
+		y = _mm_sub_ps(y, fy);
+		z = _mm_sub_ps(z, fz);
+		__m128 u = perlin_ease_4(x);
+		__m128 v = perlin_ease_4(y);
+		__m128 w = perlin_ease_4(z);
+		__m128 x_1 = _mm_sub_ps(x, one);
+		__m128 y_1 = _mm_sub_ps(y, one);
+		__m128 z_1 = _mm_sub_ps(z, one);
+
+		__m128i r0 = perlin_lookup_4(x0);
+		__m128i r1 = perlin_lookup_4(x1);
+
+		__m128i r00 = perlin_lookup_4(_mm_add_epi32(r0, y0));
+		__m128i r01 = perlin_lookup_4(_mm_add_epi32(r0, y1));
+		__m128i r10 = perlin_lookup_4(_mm_add_epi32(r1, y0));
+		__m128i r11 = perlin_lookup_4(_mm_add_epi32(r1, y1));
+
+		__m128 n000 = perlin_grad_4(perlin_lookup_4(_mm_add_epi32(r00, z0)), x, y, z);
+		__m128 n001 = perlin_grad_4(perlin_lookup_4(_mm_add_epi32(r00, z1)), x, y, z_1);
+		__m128 n010 = perlin_grad_4(perlin_lookup_4(_mm_add_epi32(r01, z0)), x, y_1, z);
+		__m128 n011 = perlin_grad_4(perlin_lookup_4(_mm_add_epi32(r01, z1)), x, y_1, z_1);
+		__m128 n100 = perlin_grad_4(perlin_lookup_4(_mm_add_epi32(r10, z0)), x_1, y, z);
+		__m128 n101 = perlin_grad_4(perlin_lookup_4(_mm_add_epi32(r10, z1)), x_1, y, z_1);
+		__m128 n110 = perlin_grad_4(perlin_lookup_4(_mm_add_epi32(r11, z0)), x_1, y_1, z);
+		__m128 n111 = perlin_grad_4(perlin_lookup_4(_mm_add_epi32(r11, z1)), x_1, y_1, z_1);
+
+		__m128 n00 = perlin_lerp_4(n000, n001, w);
+		__m128 n01 = perlin_lerp_4(n010, n011, w);
+		__m128 n10 = perlin_lerp_4(n100, n101, w);
+		__m128 n11 = perlin_lerp_4(n110, n111, w);
+
+		__m128 n0 = perlin_lerp_4(n00, n01, v);
+		__m128 n1 = perlin_lerp_4(n10, n11, v);
+
+		_mm_storeu_ps(out + i, perlin_lerp_4(n0, n1, u));
+	}
+}
+
+__attribute__((target("avx2")))
+static inline __m256 perlin_ease_8(__m256 a) {
+	__m256 r = _mm256_sub_ps(_mm256_mul_ps(a, _mm256_set1_ps(6.0f)), _mm256_set1_ps(15.0f));
+	r = _mm256_add_ps(_mm256_mul_ps(r, a), _mm256_set1_ps(10.0f));
+	return _mm256_mul_ps(_mm256_mul_ps(_mm256_mul_ps(r, a), a), a);
+}
+
+__attribute__((target("avx2")))
+static inline __m256 perlin_lerp_8(__m256 a, __m256 b, __m256 t) {
+	return _mm256_add_ps(a, _mm256_mul_ps(_mm256_sub_ps(b, a), t));
+}
+
+__attribute__((target("avx2")))
+static inline __m256i perlin_lookup_8(__m256i idx) {
+	return _mm256_i32gather_epi32(stb__perlin_randtab, idx, 4);
+}
+
+__attribute__((target("avx2")))
+static inline __m256 perlin_grad_8(__m256i hash, __m256 x, __m256 y, __m256 z) {
+	__m256i idx = _mm256_and_si256(hash, _mm256_set1_epi32(63));
+	__m256 gx = _mm256_i32gather_ps(perlin_grad_x, idx, 4);
+	__m256 gy = _mm256_i32gather_ps(perlin_grad_y, idx, 4);
+	__m256 gz = _mm256_i32gather_ps(perlin_grad_z, idx, 4);
+	return _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(gx, x), _mm256_mul_ps(gy, y)), _mm256_mul_ps(gz, z));
+}
+
+__attribute__((target("avx2")))
+void perlin_noise3_avx2(const f32 *xs, const f32 *ys, const f32 *zs, f32 *out, u32 count, u32 x_mask_, u32 y_mask_, u32 z_mask_) {
+	__m256 one = _mm256_set1_ps(1.0f);
+	__m256i one_i = _mm256_set1_epi32(1);
+	__m256i x_mask = _mm256_set1_epi32(x_mask_);
+	__m256i y_mask = _mm256_set1_epi32(y_mask_);
+	__m256i z_mask = _mm256_set1_epi32(z_mask_);
+
+	for (u32 i = 0; i < count; i += 8) {
+		__m256 x = _mm256_loadu_ps(xs + i);
+		__m256 y = _mm256_loadu_ps(ys + i);
+		__m256 z = _mm256_loadu_ps(zs + i);
+
+		__m256 fx = _mm256_floor_ps(x);
+		__m256 fy = _mm256_floor_ps(y);
+		__m256 fz = _mm256_floor_ps(z);
+		__m256i px = _mm256_cvttps_epi32(fx);
+		__m256i py = _mm256_cvttps_epi32(fy);
+		__m256i pz = _mm256_cvttps_epi32(fz);
+
+		__m256i x0 = _mm256_and_si256(px, x_mask), x1 = _mm256_and_si256(_mm256_add_epi32(px, one_i), x_mask);
+		__m256i y0 = _mm256_and_si256(py, y_mask), y1 = _mm256_and_si256(_mm256_add_epi32(py, one_i), y_mask);
+		__m256i z0 = _mm256_and_si256(pz, z_mask), z1 = _mm256_and_si256(_mm256_add_epi32(pz, one_i), z_mask);
+
+		x = _mm256_sub_ps(x, fx);
+		y = _mm256_sub_ps(y, fy);
+		z = _mm256_sub_ps(z, fz);
+		__m256 u = perlin_ease_8(x);
+		__m256 v = perlin_ease_8(y);
+		__m256 w = perlin_ease_8(z);
+		__m256 x_1 = _mm256_sub_ps(x, one);
+		__m256 y_1 = _mm256_sub_ps(y, one);
+		__m256 z_1 = _mm256_sub_ps(z, one);
+
+		__m256i r0 = perlin_lookup_8(x0);
+		__m256i r1 = perlin_lookup_8(x1);
+
+		__m256i r00 = perlin_lookup_8(_mm256_add_epi32(r0, y0));
+		__m256i r01 = perlin_lookup_8(_mm256_add_epi32(r0, y1));
+		__m256i r10 = perlin_lookup_8(_mm256_add_epi32(r1, y0));
+		__m256i r11 = perlin_lookup_8(_mm256_add_epi32(r1, y1));
+
+		__m256 n000 = perlin_grad_8(perlin_lookup_8(_mm256_add_epi32(r00, z0)), x, y, z);
+		__m256 n001 = perlin_grad_8(perlin_lookup_8(_mm256_add_epi32(r00, z1)), x, y, z_1);
+		__m256 n010 = perlin_grad_8(perlin_lookup_8(_mm256_add_epi32(r01, z0)), x, y_1, z);
+		__m256 n011 = perlin_grad_8(perlin_lookup_8(_mm256_add_epi32(r01, z1)), x, y_1, z_1);
+		__m256 n100 = perlin_grad_8(perlin_lookup_8(_mm256_add_epi32(r10, z0)), x_1, y, z);
+		__m256 n101 = perlin_grad_8(perlin_lookup_8(_mm256_add_epi32(r10, z1)), x_1, y, z_1);
+		__m256 n110 = perlin_grad_8(perlin_lookup_8(_mm256_add_epi32(r11, z0)), x_1, y_1, z);
+		__m256 n111 = perlin_grad_8(perlin_lookup_8(_mm256_add_epi32(r11, z1)), x_1, y_1, z_1);
+
+		__m256 n00 = perlin_lerp_8(n000, n001, w);
+		__m256 n01 = perlin_lerp_8(n010, n011, w);
+		__m256 n10 = perlin_lerp_8(n100, n101, w);
+		__m256 n11 = perlin_lerp_8(n110, n111, w);
+
+		__m256 n0 = perlin_lerp_8(n00, n01, v);
+		__m256 n1 = perlin_lerp_8(n10, n11, v);
+
+		_mm256_storeu_ps(out + i, perlin_lerp_8(n0, n1, u));
+	}
+}
+
+#endif
+
+PerlinSimdLevel detect_perlin_simd_level() {
+#if PERLIN_SIMD_X86
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2")) {
+		return PERLIN_AVX2;
+	}
+	if (__builtin_cpu_supports("sse4.1")) {
+		return PERLIN_SSE41;
+	}
+#endif
+	return PERLIN_SCALAR;
+}
+
+// Picked on first use, can be lowered to force a narrower kernel
+PerlinSimdLevel perlin_simd_level = detect_perlin_simd_level();
+
+// out[i] = stb_perlin_noise3(xs[i], ys[i], zs[i], x_wrap, y_wrap, z_wrap) for every i < count
+void perlin_noise3_batch(const f32 *xs, const f32 *ys, const f32 *zs, f32 *out, u32 count, i32 x_wrap, i32 y_wrap, i32 z_wrap) {
+	u32 done = 0;
+#if PERLIN_SIMD_X86
+	u32 x_mask = (x_wrap - 1) & 255;
+	u32 y_mask = (y_wrap - 1) & 255;
+	u32 z_mask = (z_wrap - 1) & 255;
+
+	if (perlin_simd_level == PERLIN_AVX2) {
+		done = count & ~7u;
+		perlin_noise3_avx2(xs, ys, zs, out, done, x_mask, y_mask, z_mask);
+	} else if (perlin_simd_level == PERLIN_SSE41) {
+		done = count & ~3u;
+		perlin_noise3_sse41(xs, ys, zs, out, done, x_mask, y_mask, z_mask);
+	}
+#endif
+
+	for (u32 i = done; i < count; i++) {
+		out[i] = stb_perlin_noise3(xs[i], ys[i], zs[i], x_wrap, y_wrap, z_wrap);
+	}
+}
+
+#endif
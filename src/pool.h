@@ -0,0 +1,90 @@
+#ifndef POOL_H
+#define POOL_H
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "common.h"
+
+// Fixed size slots carved out of a few big zeroed blocks. Given back slots go on a free list and
+// are handed out again most recent first, so their memory stays warm and keeps whatever the owner
+// left in it. The pool only allocates when every slot is taken, it grows by a whole block then.
+// Safe to use from several threads.
+
+typedef struct PoolStats {
+	u32 live;
+	u32 high_water;
+	u32 capacity;
+	u32 blocks;
+	u64 bytes_reserved;
+	u64 takes;
+	u64 gives;
+} PoolStats;
+
+typedef struct Pool {
+	pthread_mutex_t lock;
+	u64 slot_size;
+	u32 slots_per_block;
+	u8 **blocks;
+	void **free_slots;
+	u32 num_free;
+	PoolStats stats;
+} Pool;
+
+void pool_init(Pool *pool, u64 slot_size, u32 slots_per_block) {
+	memset(pool, 0, sizeof(Pool));
+	pthread_mutex_init(&pool->lock, NULL);
+	// 16 byte aligned slots whatever the owner puts in them
+	pool->slot_size = (slot_size + 15) & ~(u64)15;
+	pool->slots_per_block = slots_per_block;
+}
+
+// Adds a block of count slots, caller holds the lock
+void pool_add_block(Pool *pool, u32 count) {
+	u8 *block = (u8 *)calloc(count, pool->slot_size);
+	pool->blocks = (u8 **)realloc(pool->blocks, sizeof(u8 *) * (pool->stats.blocks + 1));
+	pool->blocks[pool->stats.blocks++] = block;
+	pool->stats.capacity += count;
+	pool->stats.bytes_reserved += pool->slot_size * count;
+
+	pool->free_slots = (void **)realloc(pool->free_slots, sizeof(void *) * pool->stats.capacity);
+	// pushed backwards so the block is handed out front to back
+	for (u32 i = count; i > 0; i--) {
+		pool->free_slots[pool->num_free++] = block + pool->slot_size * (i - 1);
+	}
+}
+
+// Makes sure count slots can be live at once without the pool growing later
+void pool_reserve(Pool *pool, u32 count) {
+	pthread_mutex_lock(&pool->lock);
+	if (count > pool->stats.capacity) {
+		pool_add_block(pool, count - pool->stats.capacity);
+	}
+	pthread_mutex_unlock(&pool->lock);
+}
+
+// A slot that is either zeroed or exactly as its last owner gave it back
+void *pool_take(Pool *pool) {
+	pthread_mutex_lock(&pool->lock);
+	if (pool->num_free == 0) {
+		pool_add_block(pool, pool->slots_per_block);
+	}
+
+	void *slot = pool->free_slots[--pool->num_free];
+	pool->stats.live++;
+	pool->stats.takes++;
+	pool->stats.high_water = pool->stats.live > pool->stats.high_water ? pool->stats.live : pool->stats.high_water;
+	pthread_mutex_unlock(&pool->lock);
+	return slot;
+}
+
+void pool_give(Pool *pool, void *slot) {
+	pthread_mutex_lock(&pool->lock);
+	pool->free_slots[pool->num_free++] = slot;
+	pool->stats.live--;
+	pool->stats.gives++;
+	pthread_mutex_unlock(&pool->lock);
+}
+
+#endif
@@ -0,0 +1,314 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "common.h"
+
+// Scoped zone profiler. PROFILE_ZONE("name") times the rest of the enclosing scope into a ring
+// buffer owned by the calling thread, so threads never share a cache line or a lock while
+// recording. Zones are only recorded during a capture (profile_begin to profile_end), outside one
+// a zone costs a load and a branch, and building with -DPROFILE=0 compiles them out altogether.
+// profile_write_trace dumps a capture as Chrome trace event JSON, which chrome://tracing and
+// Perfetto open, one track per thread.
+
+#ifndef PROFILE
+#define PROFILE 1
+#endif
+
+#define PROFILE_MAX_THREADS 64
+// zones kept per thread, a power of two. Past it the oldest are overwritten.
+#define PROFILE_RING (1 << 16)
+
+typedef struct ProfileEvent {
+	// a string literal, so it outlives the capture
+	const char *name;
+	u64 start_ns;
+	u64 end_ns;
+} ProfileEvent;
+
+typedef struct ProfileThread {
+	char name[32];
+	ProfileEvent *events;
+	// zones written this capture, the ring holds the last PROFILE_RING of them
+	u64 written;
+} ProfileThread;
+
+typedef struct Profiler {
+	ProfileThread threads[PROFILE_MAX_THREADS];
+	u32 num_threads;
+	bool capturing;
+	u64 capture_start_ns;
+} Profiler;
+
+// Zone totals of a capture, by name
+typedef struct ProfileTotal {
+	const char *name;
+	u64 count;
+	u64 total_ns;
+	u64 max_ns;
+} ProfileTotal;
+
+Profiler profiler;
+
+// NULL until the thread first records or is named
+static __thread ProfileThread *profile_thread = NULL;
+
+bool profile_capturing() {
+	return __atomic_load_n(&profiler.capturing, __ATOMIC_RELAXED);
+}
+
+// A track of its own, NULL once every one is taken. Each track must have a single writer.
+ProfileThread *profile_add_track(const char *name) {
+	u32 index = __atomic_fetch_add(&profiler.num_threads, 1, __ATOMIC_ACQ_REL);
+	if (index >= PROFILE_MAX_THREADS) {
+		return NULL;
+	}
+
+	ProfileThread *thread = &profiler.threads[index];
+	thread->events = (ProfileEvent *)calloc(PROFILE_RING, sizeof(ProfileEvent));
+	snprintf(thread->name, sizeof(thread->name), "%s", name);
+	return thread;
+}
+
+// Names the calling thread's track
+void profile_name_thread(const char *name) {
+	if (profile_thread == NULL) {
+		profile_thread = profile_add_track(name);
+	} else {
+		snprintf(profile_thread->name, sizeof(profile_thread->name), "%s", name);
+	}
+}
+
+void profile_record_on(ProfileThread *thread, const char *name, u64 start_ns, u64 end_ns) {
+	if (thread == NULL) {
+		return;
+	}
+
+	u64 written = thread->written;
+	ProfileEvent *event = &thread->events[written & (PROFILE_RING - 1)];
+	event->name = name;
+	event->start_ns = start_ns;
+	event->end_ns = end_ns;
+	__atomic_store_n(&thread->written, written + 1, __ATOMIC_RELEASE);
+}
+
+void profile_record(const char *name, u64 start_ns, u64 end_ns) {
+	if (profile_thread == NULL) {
+		char track_name[32];
+		snprintf(track_name, sizeof(track_name), "thread %u", __atomic_load_n(&profiler.num_threads, __ATOMIC_RELAXED));
+		profile_thread = profile_add_track(track_name);
+	}
+	profile_record_on(profile_thread, name, start_ns, end_ns);
+}
+
+// Times its scope, start_ns stays 0 when no capture was running as it opened
+typedef struct ProfileZone {
+	const char *name;
+	u64 start_ns;
+
+	ProfileZone(const char *zone_name) : name(zone_name), start_ns(profile_capturing() ? get_time_ns() : 0) {}
+	~ProfileZone() {
+		if (start_ns) {
+			profile_record(name, start_ns, get_time_ns());
+		}
+	}
+} ProfileZone;
+
+#if PROFILE
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+#define PROFILE_ZONE(name) ProfileZone PROFILE_CONCAT(profile_zone_, __LINE__)(name)
+#else
+#define PROFILE_ZONE(name)
+#endif
+
+// Start of a run of back to back spans (profile_span), 0 when no capture is running
+u64 profile_span_start() {
+	return PROFILE && profile_capturing() ? get_time_ns() : 0;
+}
+
+// Records the span from *start to now as name and starts the next span there. For cutting a long
+// scope like a frame into parts without a block per part.
+void profile_span(const char *name, u64 *start) {
+	if (*start == 0) {
+		*start = profile_span_start();
+		return;
+	}
+	u64 now = get_time_ns();
+	profile_record(name, *start, now);
+	*start = profile_capturing() ? now : 0;
+}
+
+// Starts a capture, dropping whatever the last one recorded. Zones already open when it starts
+// are not recorded.
+void profile_begin() {
+	u32 num_threads = __atomic_load_n(&profiler.num_threads, __ATOMIC_ACQUIRE);
+	for (u32 t = 0; t < num_threads && t < PROFILE_MAX_THREADS; t++) {
+		__atomic_store_n(&profiler.threads[t].written, 0, __ATOMIC_RELEASE);
+	}
+	profiler.capture_start_ns = get_time_ns();
+	__atomic_store_n(&profiler.capturing, true, __ATOMIC_RELEASE);
+}
+
+void profile_end() {
+	__atomic_store_n(&profiler.capturing, false, __ATOMIC_RELEASE);
+}
+
+// The oldest zone the track's ring still holds
+u64 profile_oldest(u64 written) {
+	return written > PROFILE_RING ? written - PROFILE_RING : 0;
+}
+
+// Zones written this capture and those of them the rings overwrote
+void profile_counts(u64 *recorded, u64 *dropped) {
+	*recorded = 0;
+	*dropped = 0;
+	u32 num_threads = __atomic_load_n(&profiler.num_threads, __ATOMIC_ACQUIRE);
+	for (u32 t = 0; t < num_threads && t < PROFILE_MAX_THREADS; t++) {
+		u64 written = __atomic_load_n(&profiler.threads[t].written, __ATOMIC_ACQUIRE);
+		*recorded += written;
+		*dropped += profile_oldest(written);
+	}
+}
+
+// Sums the captured zones by name into totals, returns how many names there were
+u32 profile_totals(ProfileTotal *totals, u32 max_totals) {
+	u32 count = 0;
+	u32 num_threads = __atomic_load_n(&profiler.num_threads, __ATOMIC_ACQUIRE);
+	for (u32 t = 0; t < num_threads && t < PROFILE_MAX_THREADS; t++) {
+		ProfileThread *thread = &profiler.threads[t];
+		u64 written = __atomic_load_n(&thread->written, __ATOMIC_ACQUIRE);
+		for (u64 e = profile_oldest(written); e < written; e++) {
+			ProfileEvent *event = &thread->events[e & (PROFILE_RING - 1)];
+			u32 i = 0;
+			while (i < count && totals[i].name != event->name && strcmp(totals[i].name, event->name)) {
+				i++;
+			}
+			if (i == count) {
+				if (count == max_totals) {
+					continue;
+				}
+				memset(&totals[count++], 0, sizeof(ProfileTotal));
+				totals[i].name = event->name;
+			}
+
+			u64 ns = event->end_ns - event->start_ns;
+			totals[i].count++;
+			totals[i].total_ns += ns;
+			totals[i].max_ns = ns > totals[i].max_ns ? ns : totals[i].max_ns;
+		}
+	}
+	return count;
+}
+
+// Frame times bucketed by duration, for the hitches a mean hides. Cheap enough to keep running
+// for every frame of a session, unlike a capture.
+#define FRAME_HISTOGRAM_BUCKETS 10
+
+// upper bounds of each bucket in milliseconds, the last bucket holds everything slower
+f64 frame_histogram_bounds[FRAME_HISTOGRAM_BUCKETS - 1] = {0.5, 1.0, 2.0, 4.0, 8.0, 16.7, 33.3, 50.0, 100.0};
+
+typedef struct FrameHistogram {
+	u64 counts[FRAME_HISTOGRAM_BUCKETS];
+	u64 frames;
+	u64 total_ns;
+	u64 max_ns;
+} FrameHistogram;
+
+void histogram_push(FrameHistogram *h, u64 ns) {
+	f64 ms = (f64)ns / 1e6;
+	u32 b = 0;
+	while (b < FRAME_HISTOGRAM_BUCKETS - 1 && ms > frame_histogram_bounds[b]) {
+		b++;
+	}
+	h->counts[b]++;
+	h->frames++;
+	h->total_ns += ns;
+	h->max_ns = ns > h->max_ns ? ns : h->max_ns;
+}
+
+// Upper bound in milliseconds of the bucket holding the p-th percentile frame, the slowest frame
+// for the last bucket
+f64 histogram_percentile(FrameHistogram *h, f64 p) {
+	u64 rank = (u64)(p / 100.0 * h->frames);
+	u64 seen = 0;
+	for (u32 b = 0; b < FRAME_HISTOGRAM_BUCKETS - 1; b++) {
+		seen += h->counts[b];
+		if (seen > rank) {
+			return frame_histogram_bounds[b];
+		}
+	}
+	return (f64)h->max_ns / 1e6;
+}
+
+// A line per bucket with a bar scaled to the fullest one
+void histogram_print(FrameHistogram *h, const char *name) {
+	printf("%s: %lu frames, mean %.2f ms, p50 <= %.1f ms, p99 <= %.1f ms, max %.2f ms\n", name, h->frames,
+		h->frames ? (f64)h->total_ns / h->frames / 1e6 : 0.0, histogram_percentile(h, 50.0), histogram_percentile(h, 99.0), (f64)h->max_ns / 1e6);
+
+	u64 most = 1;
+	for (u32 b = 0; b < FRAME_HISTOGRAM_BUCKETS; b++) {
+		most = h->counts[b] > most ? h->counts[b] : most;
+	}
+	for (u32 b = 0; b < FRAME_HISTOGRAM_BUCKETS; b++) {
+		char bar[41];
+		u32 width = (u32)(h->counts[b] * 40 / most);
+		memset(bar, '#', width);
+		bar[width] = 0;
+		if (b < FRAME_HISTOGRAM_BUCKETS - 1) {
+			printf("  <= %5.1f ms %8lu %s\n", frame_histogram_bounds[b], h->counts[b], bar);
+		} else {
+			printf("  >  %5.1f ms %8lu %s\n", frame_histogram_bounds[b - 1], h->counts[b], bar);
+		}
+	}
+}
+
+// As a json object of its counts, keyed by bucket upper bound
+void histogram_print_json(const char *name, FrameHistogram *h) {
+	printf("\"%s\": {\"frames\": %lu, \"mean_ms\": %.3f, \"p50_ms\": %.1f, \"p99_ms\": %.1f, \"max_ms\": %.3f, \"buckets\": {", name, h->frames,
+		h->frames ? (f64)h->total_ns / h->frames / 1e6 : 0.0, histogram_percentile(h, 50.0), histogram_percentile(h, 99.0), (f64)h->max_ns / 1e6);
+	for (u32 b = 0; b < FRAME_HISTOGRAM_BUCKETS; b++) {
+		if (b < FRAME_HISTOGRAM_BUCKETS - 1) {
+			printf("%s\"%.1f\": %lu", b ? ", " : "", frame_histogram_bounds[b], h->counts[b]);
+		} else {
+			printf(", \"inf\": %lu", h->counts[b]);
+		}
+	}
+	printf("}}");
+}
+
+// Writes the last capture as Chrome trace events, times in microseconds from the capture's start.
+// Best called once the capture has ended, threads still recording may tear their newest zone.
+bool profile_write_trace(const char *path) {
+	FILE *file = fopen(path, "w");
+	if (file == NULL) {
+		return false;
+	}
+
+	fprintf(file, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n");
+	bool first = true;
+	u32 num_threads = __atomic_load_n(&profiler.num_threads, __ATOMIC_ACQUIRE);
+	for (u32 t = 0; t < num_threads && t < PROFILE_MAX_THREADS; t++) {
+		ProfileThread *thread = &profiler.threads[t];
+		fprintf(file, "%s{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %u, \"args\": {\"name\": \"%s\"}}",
+			first ? "" : ",\n", t, thread->name);
+		first = false;
+
+		u64 written = __atomic_load_n(&thread->written, __ATOMIC_ACQUIRE);
+		for (u64 e = profile_oldest(written); e < written; e++) {
+			ProfileEvent *event = &thread->events[e & (PROFILE_RING - 1)];
+			if (event->start_ns < profiler.capture_start_ns) {
+				continue;
+			}
+			fprintf(file, ",\n{\"name\": \"%s\", \"ph\": \"X\", \"pid\": 1, \"tid\": %u, \"ts\": %.3f, \"dur\": %.3f}", event->name, t,
+				(f64)(event->start_ns - profiler.capture_start_ns) / 1e3, (f64)(event->end_ns - event->start_ns) / 1e3);
+		}
+	}
+	fprintf(file, "\n]}\n");
+	return fclose(file) == 0;
+}
+
+#endif
@@ -0,0 +1,260 @@
+#ifndef RAYCAST_H
+#define RAYCAST_H
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <glm/glm.hpp>
+
+#include "common.h"
+#include "chunk.h"
+#include "jobs.h"
+
+// Voxel raycasts for picking, walking chunks through their neighbour links. The ray is stepped a
+// column at a time with an Amanatides-Woo grid walk over x and z. Inside a column the ray covers a
+// range of y, and the first solid voxel of that range comes straight out of the column's occupancy
+// bits, so a ray crossing a column costs the same however steeply it goes through it.
+// Columns whose top the ray stays above are passed over without looking at their bits, and a whole
+// chunk is passed over when the ray stays above its top.
+
+typedef struct Ray {
+	glm::vec3 origin;
+	// need not be unit length, distances are in blocks along it either way
+	glm::vec3 dir;
+} Ray;
+
+typedef struct RayHit {
+	bool hit;
+	Chunk *chunk;
+	// chunk-local block
+	u32 x;
+	u32 y;
+	u32 z;
+	// outward normal of the face the ray entered through, zero when the ray starts inside a block
+	i32 normal[3];
+	f32 distance;
+} RayHit;
+
+// Walks neighbour links from chunk to the chunk holding world column (wx, wz), NULL when a chunk on
+// the way is not loaded
+Chunk *chunk_containing(Chunk *chunk, i32 wx, i32 wz) {
+	while (chunk) {
+		if (wx < chunk->x_off) {
+			chunk = chunk->neighbours[SIDE_NEG_X];
+		} else if (wx >= chunk->x_off + (i32)chunk_width) {
+			chunk = chunk->neighbours[SIDE_POS_X];
+		} else if (wz < chunk->z_off) {
+			chunk = chunk->neighbours[SIDE_NEG_Z];
+		} else if (wz >= chunk->z_off + (i32)chunk_depth) {
+			chunk = chunk->neighbours[SIDE_POS_Z];
+		} else {
+			break;
+		}
+	}
+	return chunk;
+}
+
+// Distance along the ray to the next cell boundary after cell along one axis
+f32 ray_boundary(f32 origin, f32 dir, i32 cell) {
+	if (dir > 0) {
+		return ((f32)(cell + 1) - origin) / dir;
+	} else if (dir < 0) {
+		return (origin - (f32)cell) / -dir;
+	}
+	return INFINITY;
+}
+
+// floorf without the libm call it compiles to below SSE4.1
+i32 floor_to_i32(f32 v) {
+	i32 i = (i32)v;
+	return i - (v < (f32)i);
+}
+
+// First solid block within max_distance of the ray's origin. start is any loaded chunk the
+// origin's chunk can be reached from through neighbour links. Misses past the loaded chunks.
+bool raycast(Chunk *start, Ray ray, f32 max_distance, RayHit *hit) {
+	memset(hit, 0, sizeof(RayHit));
+
+	f32 length = glm::length(ray.dir);
+	if (length == 0) {
+		return false;
+	}
+	glm::vec3 o = ray.origin;
+	glm::vec3 d = ray.dir / length;
+
+	i32 x = (i32)floorf(o.x);
+	i32 z = (i32)floorf(o.z);
+	Chunk *chunk = chunk_containing(start, x, z);
+
+	i32 step_x = d.x > 0 ? 1 : -1;
+	i32 step_z = d.z > 0 ? 1 : -1;
+	f32 delta_x = d.x != 0 ? 1.0f / fabsf(d.x) : INFINITY;
+	f32 delta_z = d.z != 0 ? 1.0f / fabsf(d.z) : INFINITY;
+	f32 next_x = ray_boundary(o.x, d.x, x);
+	f32 next_z = ray_boundary(o.z, d.z, z);
+
+	// axis the ray crossed to get into the current column, -1 in the column it starts in
+	i32 entered = -1;
+	f32 t = 0;
+	f32 y_in = o.y;
+	Chunk *checked = NULL;
+	while (chunk && t <= max_distance) {
+		bool above_chunk = false;
+		if (chunk != checked) {
+			// where the ray leaves the chunk, and whether it is above the chunk's top the whole way
+			checked = chunk;
+			i32 last_x = d.x > 0 ? chunk->x_off + (i32)chunk_width - 1 : chunk->x_off;
+			i32 last_z = d.z > 0 ? chunk->z_off + (i32)chunk_depth - 1 : chunk->z_off;
+			f32 exit_x = x != last_x ? next_x + (f32)abs(last_x - x) * delta_x : next_x;
+			f32 exit_z = z != last_z ? next_z + (f32)abs(last_z - z) * delta_z : next_z;
+			f32 chunk_exit = fminf(fminf(exit_x, exit_z), max_distance);
+			f32 lowest = fminf(y_in, o.y + d.y * chunk_exit);
+
+			above_chunk = floor_to_i32(lowest) > (i32)chunk->top;
+			if (above_chunk) {
+				// jump to the chunk's last column along the ray, the step below leaves the chunk
+				if (exit_x <= exit_z) {
+					x = last_x;
+					next_x = exit_x;
+					z = floor_to_i32(o.z + d.z * exit_x);
+					next_z = ray_boundary(o.z, d.z, z);
+				} else {
+					z = last_z;
+					next_z = exit_z;
+					x = floor_to_i32(o.x + d.x * exit_z);
+					next_x = ray_boundary(o.x, d.x, x);
+				}
+			}
+		}
+
+		if (!above_chunk) {
+			u32 lx = (u32)(x - chunk->x_off);
+			u32 lz = (u32)(z - chunk->z_off);
+			u32 c = twod_to_oned(lx, lz, chunk_width);
+
+			f32 column_exit = fminf(fminf(next_x, next_z), max_distance);
+			f32 y_out = o.y + d.y * column_exit;
+			i32 lo = floor_to_i32(fminf(y_in, y_out));
+			i32 hi = floor_to_i32(fmaxf(y_in, y_out));
+			hi = hi < (i32)chunk->real_blocks[c] ? hi : (i32)chunk->real_blocks[c];
+			lo = lo > 0 ? lo : 0;
+
+			i32 y = -1;
+			if (lo <= hi) {
+				// the first solid voxel in lo..hi the way the ray goes, only the words the range covers
+				u64 *words = chunk->occupancy[c].words;
+				if (d.y > 0) {
+					for (i32 w = lo / 64; w <= hi / 64 && y < 0; w++) {
+						u64 bits = words[w] & column_between_word(w, lo, hi);
+						y = bits ? w * 64 + __builtin_ctzll(bits) : -1;
+					}
+				} else {
+					for (i32 w = hi / 64; w >= lo / 64 && y < 0; w--) {
+						u64 bits = words[w] & column_between_word(w, lo, hi);
+						y = bits ? w * 64 + 63 - __builtin_clzll(bits) : -1;
+					}
+				}
+			}
+
+			if (y >= 0) {
+				hit->hit = true;
+				hit->chunk = chunk;
+				hit->x = lx;
+				hit->y = y;
+				hit->z = lz;
+				if (y == floor_to_i32(y_in)) {
+					// the block the ray came into the column at
+					hit->distance = t;
+					if (entered == 0) {
+						hit->normal[0] = -step_x;
+					} else if (entered == 2) {
+						hit->normal[2] = -step_z;
+					}
+				} else {
+					hit->distance = ((f32)y + (d.y > 0 ? 0.0f : 1.0f) - o.y) / d.y;
+					hit->normal[1] = d.y > 0 ? -1 : 1;
+				}
+				return true;
+			}
+		}
+
+		// on to the next column, and its chunk when the step leaves this one. Which axis steps is a
+		// coin flip for most rays, so it is picked with selects rather than a branch.
+		bool along_x = next_x <= next_z;
+		t = along_x ? next_x : next_z;
+		x += along_x ? step_x : 0;
+		z += along_x ? 0 : step_z;
+		next_x += along_x ? delta_x : 0;
+		next_z += along_x ? 0 : delta_z;
+		entered = along_x ? 0 : 2;
+		y_in = o.y + d.y * t;
+		chunk = chunk_containing(chunk, x, z);
+	}
+
+	return false;
+}
+
+// Casts count rays, returns how many hit. Each ray starts its chunk search from the previous ray's
+// chunk, so rays from nearby origins find theirs in a step or two.
+u32 raycast_batch(Chunk *start, const Ray *rays, u32 count, f32 max_distance, RayHit *hits) {
+	u32 num_hits = 0;
+	for (u32 i = 0; i < count; i++) {
+		Chunk *origin = chunk_containing(start, (i32)floorf(rays[i].origin.x), (i32)floorf(rays[i].origin.z));
+		if (origin == NULL) {
+			memset(&hits[i], 0, sizeof(RayHit));
+			continue;
+		}
+		num_hits += raycast(origin, rays[i], max_distance, &hits[i]);
+		start = origin;
+	}
+	return num_hits;
+}
+
+typedef struct RaycastJobData {
+	Chunk *start;
+	const Ray *rays;
+	u32 count;
+	f32 max_distance;
+	RayHit *hits;
+	u32 num_hits;
+} RaycastJobData;
+
+void raycast_job(void *data) {
+	RaycastJobData *job = (RaycastJobData *)data;
+	job->num_hits = raycast_batch(job->start, job->rays, job->count, job->max_distance, job->hits);
+}
+
+// raycast_batch split into runs across the job system. Rays only read chunks, so the world must not
+// be edited meanwhile. Waits for every job on the system, like build_world_parallel.
+u32 raycast_batch_parallel(JobSystem *sys, Chunk *start, const Ray *rays, u32 count, f32 max_distance, RayHit *hits) {
+	u32 num_jobs = sys->num_threads * 4;
+	num_jobs = num_jobs < sys->max_jobs - sys->num_jobs ? num_jobs : sys->max_jobs - sys->num_jobs;
+	num_jobs = num_jobs < count ? num_jobs : count;
+	if (num_jobs == 0) {
+		return raycast_batch(start, rays, count, max_distance, hits);
+	}
+
+	RaycastJobData *job_data = (RaycastJobData *)malloc(sizeof(RaycastJobData) * num_jobs);
+	u32 per_job = (count + num_jobs - 1) / num_jobs;
+	u32 created = 0;
+	for (u32 first = 0; first < count; first += per_job) {
+		RaycastJobData *data = &job_data[created++];
+		data->start = start;
+		data->rays = rays + first;
+		data->count = count - first < per_job ? count - first : per_job;
+		data->max_distance = max_distance;
+		data->hits = hits + first;
+		data->num_hits = 0;
+		job_submit(sys, job_create(sys, raycast_job, data));
+	}
+	job_system_wait(sys);
+
+	u32 num_hits = 0;
+	for (u32 i = 0; i < created; i++) {
+		num_hits += job_data[i].num_hits;
+	}
+	free(job_data);
+	return num_hits;
+}
+
+#endif
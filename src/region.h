@@ -0,0 +1,466 @@
+#ifndef REGION_H
+#define REGION_H
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "common.h"
+#include "point.h"
+#include "chunk.h"
+
+// On disk chunk storage. Chunks are grouped into REGION_SIZE x REGION_SIZE regions, one file each,
+// holding a header with an offset table followed by the encoded chunks. Only the solid voxels are
+// stored, as heights when every column is solid up to its top and as runs of solid voxels per
+// column otherwise (density terrain), with the chunk's light emitters after them. The hull, instances and
+// light are rebuilt from them. A chunk is rewritten in place when its new
+// encoding fits the space it had, otherwise it is appended to the end of the file.
+// Files are mapped read only and chunks decode straight out of the mapping, writes go through pwrite.
+// Everything is stored in native byte order.
+
+#define REGION_SIZE 32
+#define REGION_MAGIC 0x47525856 // "VXRG"
+#define REGION_VERSION 1
+#define REGION_MAX_OPEN 16
+
+typedef enum ChunkEncoding {
+	ENCODING_NONE,
+	// chunk_width * chunk_depth heights as bytes
+	ENCODING_RAW,
+	// each height as a 4 bit delta from the column to its left (above for x = 0),
+	// a delta of -8 is an escape followed by the height in the next two nibbles
+	ENCODING_DELTA,
+	// per column a byte count of the heights where the column turns from empty to solid or back,
+	// going up from an empty y = 0, followed by those heights as bytes
+	ENCODING_RUNS,
+} ChunkEncoding;
+
+// Set on top of the encoding when the chunk's light emitters follow its voxels, 4 bytes each
+// (x, y, z, level) and a 16 bit count after the last. Files without emitters read as before.
+#define ENCODING_EMITTERS 0x100
+
+typedef struct RegionEntry {
+	u32 offset;
+	u16 size;
+	u16 capacity;
+	u32 encoding;
+} RegionEntry;
+
+typedef struct RegionHeader {
+	u32 magic;
+	u32 version;
+	RegionEntry entries[REGION_SIZE * REGION_SIZE];
+} RegionHeader;
+
+typedef struct Region {
+	i32 rx;
+	i32 rz;
+	i32 fd;
+	u8 *map;
+	u64 map_size;
+	// bumped on use, the least recently used region is closed first
+	u64 last_used;
+} Region;
+
+typedef struct RegionStats {
+	u64 chunks_loaded;
+	u64 chunks_saved;
+	u64 bytes_saved;
+} RegionStats;
+
+typedef struct RegionStore {
+	char dir[256];
+	Region regions[REGION_MAX_OPEN];
+	u32 num_regions;
+	u64 clock;
+	// loads come from generation jobs, saves from the thread that evicts
+	pthread_mutex_t lock;
+	RegionStats stats;
+} RegionStore;
+
+// Flooring division, so chunk -1 lands in region -1
+i32 region_coord(i32 c) {
+	return c >= 0 ? c / REGION_SIZE : (c - (REGION_SIZE - 1)) / REGION_SIZE;
+}
+
+u32 region_entry_index(i32 cx, i32 cz) {
+	i32 lx = cx - region_coord(cx) * REGION_SIZE;
+	i32 lz = cz - region_coord(cz) * REGION_SIZE;
+	return twod_to_oned(lx, lz, REGION_SIZE);
+}
+
+RegionStore *region_store_open(const char *dir) {
+	mkdir(dir, 0755);
+
+	RegionStore *store = (RegionStore *)malloc(sizeof(RegionStore));
+	memset(store, 0, sizeof(RegionStore));
+	snprintf(store->dir, sizeof(store->dir), "%s", dir);
+	pthread_mutex_init(&store->lock, NULL);
+	return store;
+}
+
+void region_unmap(Region *region) {
+	if (region->map) {
+		munmap(region->map, region->map_size);
+	}
+	region->map = NULL;
+	region->map_size = 0;
+}
+
+// Maps the whole file, called again whenever a write grew it
+bool region_map(Region *region) {
+	region_unmap(region);
+
+	struct stat st;
+	if (fstat(region->fd, &st) != 0 || (u64)st.st_size < sizeof(RegionHeader)) {
+		return false;
+	}
+
+	void *map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, region->fd, 0);
+	if (map == MAP_FAILED) {
+		return false;
+	}
+
+	region->map = (u8 *)map;
+	region->map_size = st.st_size;
+	return true;
+}
+
+void region_close(Region *region) {
+	region_unmap(region);
+	close(region->fd);
+	region->fd = -1;
+}
+
+// Opens (creating when asked) the region holding chunk (cx, cz), NULL when it is not on disk.
+// The caller holds store->lock.
+Region *region_get(RegionStore *store, i32 cx, i32 cz, bool create) {
+	i32 rx = region_coord(cx);
+	i32 rz = region_coord(cz);
+	store->clock++;
+
+	for (u32 i = 0; i < store->num_regions; i++) {
+		Region *region = &store->regions[i];
+		if (region->rx == rx && region->rz == rz) {
+			region->last_used = store->clock;
+			return region;
+		}
+	}
+
+	char path[512];
+	snprintf(path, sizeof(path), "%s/r.%d.%d.vxr", store->dir, rx, rz);
+
+	i32 fd = open(path, O_RDWR);
+	if (fd < 0) {
+		if (!create) {
+			return NULL;
+		}
+
+		fd = open(path, O_RDWR | O_CREAT, 0644);
+		if (fd < 0) {
+			return NULL;
+		}
+
+		RegionHeader *header = (RegionHeader *)calloc(1, sizeof(RegionHeader));
+		header->magic = REGION_MAGIC;
+		header->version = REGION_VERSION;
+		bool written = pwrite(fd, header, sizeof(RegionHeader), 0) == (ssize_t)sizeof(RegionHeader);
+		free(header);
+		if (!written) {
+			close(fd);
+			return NULL;
+		}
+	}
+
+	Region *region;
+	if (store->num_regions < REGION_MAX_OPEN) {
+		region = &store->regions[store->num_regions++];
+	} else {
+		region = &store->regions[0];
+		for (u32 i = 1; i < store->num_regions; i++) {
+			if (store->regions[i].last_used < region->last_used) {
+				region = &store->regions[i];
+			}
+		}
+		region_close(region);
+	}
+
+	memset(region, 0, sizeof(Region));
+	region->rx = rx;
+	region->rz = rz;
+	region->fd = fd;
+	region->last_used = store->clock;
+
+	RegionHeader *header = region_map(region) ? (RegionHeader *)region->map : NULL;
+	if (header == NULL || header->magic != REGION_MAGIC || header->version != REGION_VERSION) {
+		fprintf(stderr, "%s is not a version %d region file\n", path, REGION_VERSION);
+		region_close(region);
+		*region = store->regions[--store->num_regions];
+		return NULL;
+	}
+
+	return region;
+}
+
+void region_store_close(RegionStore *store) {
+	for (u32 i = 0; i < store->num_regions; i++) {
+		region_close(&store->regions[i]);
+	}
+	pthread_mutex_destroy(&store->lock);
+	free(store);
+}
+
+u32 encode_heights_delta(u8 *heights, u8 *out) {
+	u32 nibbles = 0;
+	for (u32 i = 0; i < chunk_width * chunk_depth; i++) {
+		u32 predicted = i == 0 ? 0 : (i % chunk_width ? heights[i - 1] : heights[i - chunk_width]);
+		i32 delta = (i32)heights[i] - (i32)predicted;
+
+		u8 codes[3];
+		u32 num_codes = 0;
+		if (i > 0 && delta >= -7 && delta <= 7) {
+			codes[num_codes++] = delta & 15;
+		} else {
+			codes[num_codes++] = 8;
+			codes[num_codes++] = heights[i] & 15;
+			codes[num_codes++] = heights[i] >> 4;
+		}
+
+		for (u32 c = 0; c < num_codes; c++, nibbles++) {
+			if (nibbles & 1) {
+				out[nibbles >> 1] |= codes[c] << 4;
+			} else {
+				out[nibbles >> 1] = codes[c];
+			}
+		}
+	}
+	return (nibbles + 1) / 2;
+}
+
+void decode_heights_delta(const u8 *data, u8 *heights) {
+	u32 nibble = 0;
+	for (u32 i = 0; i < chunk_width * chunk_depth; i++, nibble++) {
+		u8 code = (data[nibble >> 1] >> ((nibble & 1) * 4)) & 15;
+		if (code == 8) {
+			nibble++;
+			u8 lo = (data[nibble >> 1] >> ((nibble & 1) * 4)) & 15;
+			nibble++;
+			u8 hi = (data[nibble >> 1] >> ((nibble & 1) * 4)) & 15;
+			heights[i] = lo | (hi << 4);
+			continue;
+		}
+
+		u32 predicted = i % chunk_width ? heights[i - 1] : heights[i - chunk_width];
+		i32 delta = (code & 8) ? (i32)code - 16 : (i32)code;
+		heights[i] = (u8)((i32)predicted + delta);
+	}
+}
+
+// Returns the size, 0 when a column turns more often than its count byte holds
+u32 encode_runs(Chunk *chunk, u8 *out) {
+	u32 size = 0;
+	for (u32 i = 0; i < chunk_width * chunk_depth; i++) {
+		u8 *count = &out[size++];
+		*count = 0;
+
+		bool solid = false;
+		for (u32 y = 0; y < chunk_height; y++) {
+			bool voxel = (chunk->occupancy[i].words[y / 64] >> (y % 64)) & 1;
+			if (voxel == solid) {
+				continue;
+			}
+			if (*count == 255) {
+				return 0;
+			}
+			out[size++] = y;
+			(*count)++;
+			solid = voxel;
+		}
+	}
+	return size;
+}
+
+// Fills the occupancy and the heights from it
+void decode_runs(const u8 *data, Chunk *chunk) {
+	u32 offset = 0;
+	for (u32 i = 0; i < chunk_width * chunk_depth; i++) {
+		u32 count = data[offset++];
+		OccupancyColumn *column = &chunk->occupancy[i];
+		memset(column, 0, sizeof(OccupancyColumn));
+
+		for (u32 t = 0; t < count; t += 2) {
+			u32 from = data[offset + t];
+			u32 to = t + 1 < count ? data[offset + t + 1] : chunk_height;
+			for (u32 y = from; y < to; y++) {
+				column->words[y / 64] |= (u64)1 << (y % 64);
+			}
+		}
+		offset += count;
+		chunk->real_blocks[i] = column_highest(*column);
+	}
+}
+
+// Fills the chunk's heights, occupancy and emitters from an encoding of size bytes
+void decode_chunk(const u8 *data, u32 size, u32 encoding, Chunk *chunk) {
+	u32 voxels = encoding & ~ENCODING_EMITTERS;
+	if (voxels == ENCODING_RUNS) {
+		decode_runs(data, chunk);
+	} else {
+		if (voxels == ENCODING_RAW) {
+			memcpy(chunk->real_blocks, data, chunk_width * chunk_depth);
+		} else {
+			decode_heights_delta(data, chunk->real_blocks);
+		}
+		fill_height_occupancy(chunk);
+	}
+	set_chunk_top(chunk);
+
+	if (encoding & ENCODING_EMITTERS) {
+		u16 count;
+		memcpy(&count, data + size - sizeof(u16), sizeof(u16));
+		const u8 *emitters = data + size - sizeof(u16) - sizeof(LightEmitter) * count;
+		for (u32 e = 0; e < count; e++) {
+			const u8 *emitter = emitters + sizeof(LightEmitter) * e;
+			chunk_set_emitter(chunk, emitter[0], emitter[1], emitter[2], emitter[3]);
+		}
+	}
+}
+
+// Decodes chunk (cx, cz) into its heights and occupancy, false when it has never been saved
+bool region_load_chunk(RegionStore *store, i32 cx, i32 cz, Chunk *chunk) {
+	PROFILE_ZONE("region_load");
+	pthread_mutex_lock(&store->lock);
+
+	bool loaded = false;
+	Region *region = region_get(store, cx, cz, false);
+	if (region) {
+		RegionEntry *entry = &((RegionHeader *)region->map)->entries[region_entry_index(cx, cz)];
+		if (entry->encoding != ENCODING_NONE && (u64)entry->offset + entry->size <= region->map_size) {
+			decode_chunk(region->map + entry->offset, entry->size, entry->encoding, chunk);
+			store->stats.chunks_loaded++;
+			loaded = true;
+		}
+	}
+
+	pthread_mutex_unlock(&store->lock);
+	return loaded;
+}
+
+// True when every column is solid from the bottom up to its height and nothing above
+bool chunk_is_heightmap(Chunk *chunk) {
+	for (u32 i = 0; i < chunk_width * chunk_depth; i++) {
+		OccupancyColumn column = column_to_height(chunk->real_blocks[i]);
+		if (memcmp(&column, &chunk->occupancy[i], sizeof(OccupancyColumn))) {
+			return false;
+		}
+	}
+	return true;
+}
+
+// Bytes encode_chunk may write for the chunk: a count byte and a run ending at every height, then the emitters
+u32 chunk_encoding_bound(Chunk *chunk) {
+	return chunk_width * chunk_depth * (chunk_height + 1) + sizeof(LightEmitter) * chunk->num_emitters + sizeof(u16);
+}
+
+// Encodes the chunk's voxels and emitters into out, returns the size, 0 when the chunk does not fit
+// an entry. A heightmap chunk picks whichever of the height encodings is smaller, anything else is
+// stored as runs.
+u32 encode_chunk(Chunk *chunk, u8 *out, u32 *encoding) {
+	u32 raw_size = chunk_width * chunk_depth;
+	u32 size;
+	if (chunk_is_heightmap(chunk)) {
+		size = encode_heights_delta(chunk->real_blocks, out);
+		*encoding = ENCODING_DELTA;
+		if (size >= raw_size) {
+			memcpy(out, chunk->real_blocks, raw_size);
+			size = raw_size;
+			*encoding = ENCODING_RAW;
+		}
+	} else {
+		size = encode_runs(chunk, out);
+		*encoding = ENCODING_RUNS;
+		if (size == 0) {
+			return 0;
+		}
+	}
+
+	if (chunk->num_emitters) {
+		u16 count = (u16)chunk->num_emitters;
+		memcpy(out + size, chunk->emitters, sizeof(LightEmitter) * count);
+		size += sizeof(LightEmitter) * count;
+		memcpy(out + size, &count, sizeof(u16));
+		size += sizeof(u16);
+		*encoding |= ENCODING_EMITTERS;
+	}
+	// entry sizes are 16 bit
+	return size > 0xFFFF ? 0 : size;
+}
+
+// Writes an encoded chunk (cx, cz) to its region
+bool region_write_chunk(RegionStore *store, i32 cx, i32 cz, const u8 *encoded, u32 size, u32 encoding) {
+	pthread_mutex_lock(&store->lock);
+
+	bool saved = false;
+	Region *region = region_get(store, cx, cz, true);
+	if (region) {
+		u32 index = region_entry_index(cx, cz);
+		RegionEntry entry = ((RegionHeader *)region->map)->entries[index];
+
+		if (entry.encoding == ENCODING_NONE || size > entry.capacity) {
+			entry.offset = region->map_size;
+			entry.capacity = size;
+		}
+		entry.size = size;
+		entry.encoding = encoding;
+
+		u64 entry_offset = offsetof(RegionHeader, entries) + sizeof(RegionEntry) * index;
+		saved = pwrite(region->fd, encoded, size, entry.offset) == (ssize_t)size &&
+			pwrite(region->fd, &entry, sizeof(RegionEntry), entry_offset) == (ssize_t)sizeof(RegionEntry);
+
+		if ((u64)entry.offset + size > region->map_size && !region_map(region)) {
+			saved = false;
+		}
+
+		if (saved) {
+			store->stats.chunks_saved++;
+			store->stats.bytes_saved += size;
+		}
+	}
+
+	pthread_mutex_unlock(&store->lock);
+	return saved;
+}
+
+// Writes the chunk to its region
+bool region_save_chunk(RegionStore *store, Chunk *chunk) {
+	PROFILE_ZONE("region_save");
+	u8 *encoded = (u8 *)malloc(chunk_encoding_bound(chunk));
+	u32 encoding;
+	u32 size = encode_chunk(chunk, encoded, &encoding);
+	bool saved = size && region_write_chunk(store, chunk->x_off / (i32)chunk_width, chunk->z_off / (i32)chunk_depth, encoded, size, encoding);
+	if (saved) {
+		chunk->unsaved = false;
+	}
+	free(encoded);
+	return saved;
+}
+
+// Reads the chunk from disk when it was saved before, otherwise generates it. store may be NULL.
+Chunk *load_or_generate_chunk(RegionStore *store, i32 x_off, i32 z_off) {
+	if (store) {
+		Chunk *chunk = alloc_chunk(x_off, z_off);
+		if (region_load_chunk(store, x_off, z_off, chunk)) {
+			return chunk;
+		}
+		free_chunk(chunk);
+	}
+	return generate_chunk(x_off, z_off);
+}
+
+#endif
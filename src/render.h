@@ -0,0 +1,525 @@
+#ifndef RENDER_H
+#define RENDER_H
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "common.h"
+#include "arena.h"
+#include "chunk.h"
+
+// The whole world lives in a few big buffers shared by every chunk: one for cube instances, one
+// for mesh vertices and one for mesh indices, each sub-allocated by an Arena. Chunks only upload
+// when update_chunk or a mesh rebuild has marked them dirty, and the visible world is drawn with
+// one glMultiDrawArrays for the cubes and one glMultiDrawElementsBaseVertex for the meshes.
+// GL 3.3 has no base instance, so cubes are not instanced: obj_vert.vsh pulls the instance for
+// gl_VertexID / 36 out of a texture buffer and builds the cube corner itself. Each chunk owns a
+// draw slot whose origin sits in a second texture buffer, instances and mesh vertices carry the
+// slot so the draws need no per-chunk uniforms. Each instance's ambient occlusion bytes sit in a
+// third texture buffer at the same offset as the instance, times AO_FACES, and its light bytes in
+// a fourth laid out the same way.
+
+#define DRAW_SLOTS 4096
+#define CUBE_VERTICES 36
+
+// slot 0 has origin 0 and holds the cursor cube
+#define CURSOR_SLOT 0
+
+typedef struct RenderStats {
+	u64 bytes_uploaded;
+	u32 chunks_uploaded;
+	u32 draw_calls;
+	u32 chunks_drawn;
+	u32 chunks_culled;
+	u32 chunks_occluded;
+	u32 chunks_at_level[LOD_LEVELS];
+} RenderStats;
+
+typedef struct WorldRenderer {
+	// cubes are pulled from the instance texture, so their vao has no attributes
+	GLuint cube_vao;
+	GLuint mesh_vao;
+	GLuint mesh_vertex_attr;
+
+	GLuint instance_buffer;
+	GLuint instance_texture;
+	GLuint ao_buffer;
+	GLuint ao_texture;
+	GLuint light_buffer;
+	GLuint light_texture;
+	GLuint origin_buffer;
+	GLuint origin_texture;
+	GLuint vertex_buffer;
+	GLuint index_buffer;
+
+	Arena instances;
+	Arena vertices;
+	Arena indices;
+
+	// chunk holding each draw slot, NULL when free
+	Chunk **slot_chunks;
+	u32 *free_slots;
+	u32 num_free_slots;
+
+	// instances and vertices with the draw slot packed in, on their way to the gpu
+	u8 *staging;
+	u64 staging_capacity;
+
+	// this frame's draws, filled by renderer_queue_* and flushed by renderer_draw_*
+	Chunk **queued_cubes;
+	u32 num_queued_cubes;
+	Chunk **queued_mesh_chunks;
+	ChunkMesh **queued_meshes;
+	u32 num_queued_meshes;
+
+	GLint *cube_firsts;
+	GLsizei *cube_counts;
+	GLsizei *mesh_counts;
+	void **mesh_offsets;
+	GLint *mesh_base_vertices;
+
+	ArenaRange cursor_range;
+} WorldRenderer;
+
+GLuint renderer_create_buffer(GLenum target, u64 bytes) {
+	GLuint buffer;
+	glGenBuffers(1, &buffer);
+	glBindBuffer(target, buffer);
+	glBufferData(target, bytes, NULL, GL_DYNAMIC_DRAW);
+	return buffer;
+}
+
+// Moves a buffer's contents into a bigger one, offsets stay valid
+void renderer_grow_buffer(GLuint *buffer, u64 old_bytes, u64 new_bytes) {
+	GLuint grown = renderer_create_buffer(GL_COPY_WRITE_BUFFER, new_bytes);
+	glBindBuffer(GL_COPY_READ_BUFFER, *buffer);
+	GL_CHECK(glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, old_bytes));
+	glDeleteBuffers(1, buffer);
+	*buffer = grown;
+}
+
+void renderer_bind_mesh_buffers(WorldRenderer *r) {
+	glBindVertexArray(r->mesh_vao);
+	GL_CHECK(glBindBuffer(GL_ARRAY_BUFFER, r->vertex_buffer));
+	GL_CHECK(glEnableVertexAttribArray(r->mesh_vertex_attr));
+	GL_CHECK(glVertexAttribIPointer(r->mesh_vertex_attr, 4, GL_UNSIGNED_SHORT, 0, 0));
+	GL_CHECK(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, r->index_buffer));
+	glBindVertexArray(0);
+}
+
+u8 *renderer_staging(WorldRenderer *r, u64 bytes) {
+	if (bytes > r->staging_capacity) {
+		r->staging_capacity = bytes * 2;
+		r->staging = (u8 *)realloc(r->staging, r->staging_capacity);
+	}
+	return r->staging;
+}
+
+// White, unoccluded and fully lit
+void renderer_upload_cursor(WorldRenderer *r) {
+	u32 cursor_instance = pack_instance(0, 0, 0, 8) | (CURSOR_SLOT << 20);
+	u8 cursor_ao[AO_FACES] = {};
+	u8 cursor_light[AO_FACES];
+	memset(cursor_light, LIGHT_SKY, AO_FACES);
+	glBindBuffer(GL_TEXTURE_BUFFER, r->instance_buffer);
+	glBufferSubData(GL_TEXTURE_BUFFER, sizeof(u32) * r->cursor_range.offset, sizeof(u32), &cursor_instance);
+	glBindBuffer(GL_TEXTURE_BUFFER, r->ao_buffer);
+	glBufferSubData(GL_TEXTURE_BUFFER, AO_FACES * r->cursor_range.offset, AO_FACES, cursor_ao);
+	glBindBuffer(GL_TEXTURE_BUFFER, r->light_buffer);
+	glBufferSubData(GL_TEXTURE_BUFFER, AO_FACES * r->cursor_range.offset, AO_FACES, cursor_light);
+}
+
+WorldRenderer *renderer_create(GLuint mesh_vertex_attr) {
+	WorldRenderer *r = (WorldRenderer *)calloc(1, sizeof(WorldRenderer));
+	r->mesh_vertex_attr = mesh_vertex_attr;
+
+	// room for the starting window, the arenas double from here if the view distance needs more
+	arena_init(&r->instances, 1 << 20);
+	arena_init(&r->vertices, 1 << 19);
+	arena_init(&r->indices, 1 << 20);
+
+	r->instance_buffer = renderer_create_buffer(GL_TEXTURE_BUFFER, sizeof(u32) * r->instances.capacity);
+	glGenTextures(1, &r->instance_texture);
+	glBindTexture(GL_TEXTURE_BUFFER, r->instance_texture);
+	GL_CHECK(glTexBuffer(GL_TEXTURE_BUFFER, GL_R32UI, r->instance_buffer));
+
+	r->ao_buffer = renderer_create_buffer(GL_TEXTURE_BUFFER, AO_FACES * r->instances.capacity);
+	glGenTextures(1, &r->ao_texture);
+	glBindTexture(GL_TEXTURE_BUFFER, r->ao_texture);
+	GL_CHECK(glTexBuffer(GL_TEXTURE_BUFFER, GL_R8UI, r->ao_buffer));
+
+	r->light_buffer = renderer_create_buffer(GL_TEXTURE_BUFFER, AO_FACES * r->instances.capacity);
+	glGenTextures(1, &r->light_texture);
+	glBindTexture(GL_TEXTURE_BUFFER, r->light_texture);
+	GL_CHECK(glTexBuffer(GL_TEXTURE_BUFFER, GL_R8UI, r->light_buffer));
+
+	// vec4 per slot, RGB32F texture buffers need GL 4.0
+	u64 origin_bytes = sizeof(f32) * 4 * DRAW_SLOTS;
+	f32 *origins = (f32 *)calloc(DRAW_SLOTS * 4, sizeof(f32));
+	r->origin_buffer = renderer_create_buffer(GL_TEXTURE_BUFFER, origin_bytes);
+	glBufferSubData(GL_TEXTURE_BUFFER, 0, origin_bytes, origins);
+	free(origins);
+	glGenTextures(1, &r->origin_texture);
+	glBindTexture(GL_TEXTURE_BUFFER, r->origin_texture);
+	GL_CHECK(glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, r->origin_buffer));
+
+	r->vertex_buffer = renderer_create_buffer(GL_ARRAY_BUFFER, sizeof(MeshVertex) * r->vertices.capacity);
+	r->index_buffer = renderer_create_buffer(GL_ARRAY_BUFFER, sizeof(u32) * r->indices.capacity);
+
+	glGenVertexArrays(1, &r->cube_vao);
+	glGenVertexArrays(1, &r->mesh_vao);
+	renderer_bind_mesh_buffers(r);
+
+	r->slot_chunks = (Chunk **)calloc(DRAW_SLOTS, sizeof(Chunk *));
+	r->free_slots = (u32 *)malloc(sizeof(u32) * DRAW_SLOTS);
+	for (u32 slot = DRAW_SLOTS - 1; slot > CURSOR_SLOT; slot--) {
+		r->free_slots[r->num_free_slots++] = slot;
+	}
+
+	r->queued_cubes = (Chunk **)malloc(sizeof(Chunk *) * DRAW_SLOTS);
+	r->queued_mesh_chunks = (Chunk **)malloc(sizeof(Chunk *) * DRAW_SLOTS);
+	r->queued_meshes = (ChunkMesh **)malloc(sizeof(ChunkMesh *) * DRAW_SLOTS);
+	r->cube_firsts = (GLint *)malloc(sizeof(GLint) * DRAW_SLOTS);
+	r->cube_counts = (GLsizei *)malloc(sizeof(GLsizei) * DRAW_SLOTS);
+	r->mesh_counts = (GLsizei *)malloc(sizeof(GLsizei) * DRAW_SLOTS);
+	r->mesh_offsets = (void **)malloc(sizeof(void *) * DRAW_SLOTS);
+	r->mesh_base_vertices = (GLint *)malloc(sizeof(GLint) * DRAW_SLOTS);
+
+	arena_alloc(&r->instances, 1, &r->cursor_range);
+	renderer_upload_cursor(r);
+
+	return r;
+}
+
+void renderer_destroy(WorldRenderer *r) {
+	GLuint buffers[6] = {r->instance_buffer, r->ao_buffer, r->light_buffer, r->origin_buffer, r->vertex_buffer, r->index_buffer};
+	GLuint textures[4] = {r->instance_texture, r->ao_texture, r->light_texture, r->origin_texture};
+	GLuint vaos[2] = {r->cube_vao, r->mesh_vao};
+	glDeleteBuffers(6, buffers);
+	glDeleteTextures(4, textures);
+	glDeleteVertexArrays(2, vaos);
+
+	arena_destroy(&r->instances);
+	arena_destroy(&r->vertices);
+	arena_destroy(&r->indices);
+
+	free(r->slot_chunks);
+	free(r->free_slots);
+	free(r->staging);
+	free(r->queued_cubes);
+	free(r->queued_mesh_chunks);
+	free(r->queued_meshes);
+	free(r->cube_firsts);
+	free(r->cube_counts);
+	free(r->mesh_counts);
+	free(r->mesh_offsets);
+	free(r->mesh_base_vertices);
+	free(r);
+}
+
+// Gives the chunk a draw slot and uploads its origin, false when every slot is taken
+bool renderer_acquire_slot(WorldRenderer *r, Chunk *chunk) {
+	if (chunk->draw_slot != 0) {
+		return true;
+	}
+	if (r->num_free_slots == 0) {
+		return false;
+	}
+
+	u32 slot = r->free_slots[--r->num_free_slots];
+	r->slot_chunks[slot] = chunk;
+	chunk->draw_slot = slot;
+
+	f32 origin[4] = {(f32)chunk->x_off, 0.0f, (f32)chunk->z_off, 0.0f};
+	glBindBuffer(GL_TEXTURE_BUFFER, r->origin_buffer);
+	glBufferSubData(GL_TEXTURE_BUFFER, sizeof(origin) * slot, sizeof(origin), origin);
+	return true;
+}
+
+// Packs every live instance range to the front. Moved chunks are marked dirty and re-upload
+// from their CPU copies before they are next drawn.
+void renderer_compact_instances(WorldRenderer *r) {
+	PROFILE_ZONE("compact_instances");
+	ArenaRange **live = (ArenaRange **)malloc(sizeof(ArenaRange *) * DRAW_SLOTS);
+	u8 *moved = (u8 *)malloc(DRAW_SLOTS);
+	u32 count = 0;
+	live[count++] = &r->cursor_range;
+	for (u32 slot = 0; slot < DRAW_SLOTS; slot++) {
+		Chunk *chunk = r->slot_chunks[slot];
+		if (chunk && chunk->instance_range.count) {
+			live[count++] = &chunk->instance_range;
+		}
+	}
+
+	arena_compact(&r->instances, live, count, moved);
+
+	if (moved[0]) {
+		renderer_upload_cursor(r);
+	}
+	for (u32 i = 1, slot = 0; i < count; slot++) {
+		Chunk *chunk = r->slot_chunks[slot];
+		if (chunk && chunk->instance_range.count) {
+			chunk->dirty |= moved[i++];
+		}
+	}
+
+	free(live);
+	free(moved);
+}
+
+// Vertices and indices compact separately, a mesh moved in either re-uploads both
+void renderer_compact_meshes(WorldRenderer *r, Arena *arena) {
+	PROFILE_ZONE("compact_meshes");
+	u32 max_meshes = DRAW_SLOTS * LOD_LEVELS;
+	ArenaRange **live = (ArenaRange **)malloc(sizeof(ArenaRange *) * max_meshes);
+	ChunkMesh **meshes = (ChunkMesh **)malloc(sizeof(ChunkMesh *) * max_meshes);
+	u8 *moved = (u8 *)malloc(max_meshes);
+	u32 count = 0;
+	for (u32 slot = 0; slot < DRAW_SLOTS; slot++) {
+		Chunk *chunk = r->slot_chunks[slot];
+		if (chunk == NULL) {
+			continue;
+		}
+
+		// level 0 draws chunk->mesh, lod_meshes[0] is always NULL
+		for (u32 l = 0; l < LOD_LEVELS; l++) {
+			ChunkMesh *mesh = l ? chunk->lod_meshes[l] : chunk->mesh;
+			ArenaRange *range = NULL;
+			if (mesh) {
+				range = arena == &r->vertices ? &mesh->vertex_range : &mesh->index_range;
+			}
+			if (range && range->count) {
+				meshes[count] = mesh;
+				live[count++] = range;
+			}
+		}
+	}
+
+	arena_compact(arena, live, count, moved);
+	for (u32 i = 0; i < count; i++) {
+		meshes[i]->dirty |= moved[i];
+	}
+
+	free(live);
+	free(meshes);
+	free(moved);
+}
+
+// Makes range hold at least count elements of arena, keeping it where it is when it already does.
+// Returns true when the range moved, the caller then has to upload all of it.
+bool renderer_reserve(WorldRenderer *r, Arena *arena, u32 count, ArenaRange *range) {
+	if (count <= range->count) {
+		return false;
+	}
+
+	arena_free(arena, *range);
+	range->count = 0;
+
+	u32 padded = arena_padded(count);
+	if (arena_alloc(arena, padded, range)) {
+		return true;
+	}
+
+	if (arena_should_compact(arena, padded)) {
+		if (arena == &r->instances) {
+			renderer_compact_instances(r);
+		} else {
+			renderer_compact_meshes(r, arena);
+		}
+		if (arena_alloc(arena, padded, range)) {
+			return true;
+		}
+	}
+
+	u32 old_capacity = arena->capacity;
+	arena_grow(arena, arena_grown_capacity(arena, padded));
+	if (arena == &r->instances) {
+		renderer_grow_buffer(&r->instance_buffer, sizeof(u32) * old_capacity, sizeof(u32) * arena->capacity);
+		glBindTexture(GL_TEXTURE_BUFFER, r->instance_texture);
+		GL_CHECK(glTexBuffer(GL_TEXTURE_BUFFER, GL_R32UI, r->instance_buffer));
+		renderer_grow_buffer(&r->ao_buffer, AO_FACES * old_capacity, AO_FACES * arena->capacity);
+		glBindTexture(GL_TEXTURE_BUFFER, r->ao_texture);
+		GL_CHECK(glTexBuffer(GL_TEXTURE_BUFFER, GL_R8UI, r->ao_buffer));
+		renderer_grow_buffer(&r->light_buffer, AO_FACES * old_capacity, AO_FACES * arena->capacity);
+		glBindTexture(GL_TEXTURE_BUFFER, r->light_texture);
+		GL_CHECK(glTexBuffer(GL_TEXTURE_BUFFER, GL_R8UI, r->light_buffer));
+	} else if (arena == &r->vertices) {
+		renderer_grow_buffer(&r->vertex_buffer, sizeof(MeshVertex) * old_capacity, sizeof(MeshVertex) * arena->capacity);
+		renderer_bind_mesh_buffers(r);
+	} else {
+		renderer_grow_buffer(&r->index_buffer, sizeof(u32) * old_capacity, sizeof(u32) * arena->capacity);
+		renderer_bind_mesh_buffers(r);
+	}
+
+	arena_alloc(arena, padded, range);
+	return true;
+}
+
+void renderer_upload_chunk(WorldRenderer *r, Chunk *chunk, RenderStats *stats) {
+	PROFILE_ZONE("upload_instances");
+	if (!chunk->dirty || !renderer_acquire_slot(r, chunk)) {
+		return;
+	}
+
+	u32 count = (u32)chunk->num_blocks;
+	renderer_reserve(r, &r->instances, count, &chunk->instance_range);
+
+	u32 *staged = (u32 *)renderer_staging(r, sizeof(u32) * count);
+	u32 slot_bits = chunk->draw_slot << 20;
+	for (u32 i = 0; i < count; i++) {
+		staged[i] = chunk->instances[i] | slot_bits;
+	}
+
+	u64 bytes = sizeof(u32) * count;
+	glBindBuffer(GL_TEXTURE_BUFFER, r->instance_buffer);
+	glBufferSubData(GL_TEXTURE_BUFFER, sizeof(u32) * chunk->instance_range.offset, bytes, staged);
+	glBindBuffer(GL_TEXTURE_BUFFER, r->ao_buffer);
+	glBufferSubData(GL_TEXTURE_BUFFER, AO_FACES * chunk->instance_range.offset, AO_FACES * count, chunk->ao_bits);
+	glBindBuffer(GL_TEXTURE_BUFFER, r->light_buffer);
+	glBufferSubData(GL_TEXTURE_BUFFER, AO_FACES * chunk->instance_range.offset, AO_FACES * count, chunk->light_bits);
+	bytes += AO_FACES * 2 * count;
+
+	chunk->dirty = false;
+	stats->bytes_uploaded += bytes;
+	stats->chunks_uploaded++;
+}
+
+// mesh is chunk->mesh or one of its lod_meshes
+void renderer_upload_mesh(WorldRenderer *r, Chunk *chunk, ChunkMesh *mesh, RenderStats *stats) {
+	PROFILE_ZONE("upload_mesh");
+	if (!mesh->dirty || !renderer_acquire_slot(r, chunk)) {
+		return;
+	}
+
+	renderer_reserve(r, &r->vertices, mesh->num_vertices, &mesh->vertex_range);
+	renderer_reserve(r, &r->indices, mesh->num_indices, &mesh->index_range);
+
+	MeshVertex *staged = (MeshVertex *)renderer_staging(r, sizeof(MeshVertex) * mesh->num_vertices);
+	u16 slot_bits = (u16)(chunk->draw_slot << 4);
+	for (u32 i = 0; i < mesh->num_vertices; i++) {
+		staged[i] = mesh->vertices[i];
+		staged[i].color = (mesh->vertices[i].color & 15) | slot_bits;
+	}
+
+	u64 vertex_bytes = sizeof(MeshVertex) * mesh->num_vertices;
+	u64 index_bytes = sizeof(u32) * mesh->num_indices;
+	glBindBuffer(GL_ARRAY_BUFFER, r->vertex_buffer);
+	glBufferSubData(GL_ARRAY_BUFFER, sizeof(MeshVertex) * mesh->vertex_range.offset, vertex_bytes, staged);
+	glBindBuffer(GL_ARRAY_BUFFER, r->index_buffer);
+	glBufferSubData(GL_ARRAY_BUFFER, sizeof(u32) * mesh->index_range.offset, index_bytes, mesh->indices);
+
+	mesh->dirty = false;
+	stats->bytes_uploaded += vertex_bytes + index_bytes;
+	stats->chunks_uploaded++;
+}
+
+void renderer_release_mesh(WorldRenderer *r, ChunkMesh *mesh) {
+	if (mesh == NULL) {
+		return;
+	}
+
+	arena_free(&r->vertices, mesh->vertex_range);
+	arena_free(&r->indices, mesh->index_range);
+	mesh->vertex_range.count = 0;
+	mesh->index_range.count = 0;
+	mesh->dirty = true;
+}
+
+// Gives back everything the chunk holds in the shared buffers, before the chunk is freed
+void renderer_release_chunk(WorldRenderer *r, Chunk *chunk) {
+	arena_free(&r->instances, chunk->instance_range);
+	chunk->instance_range.count = 0;
+	chunk->dirty = true;
+
+	renderer_release_mesh(r, chunk->mesh);
+	for (u32 l = 1; l < LOD_LEVELS; l++) {
+		renderer_release_mesh(r, chunk->lod_meshes[l]);
+	}
+
+	if (chunk->draw_slot != 0) {
+		r->slot_chunks[chunk->draw_slot] = NULL;
+		r->free_slots[r->num_free_slots++] = chunk->draw_slot;
+		chunk->draw_slot = 0;
+	}
+}
+
+void renderer_begin_frame(WorldRenderer *r) {
+	r->num_queued_cubes = 0;
+	r->num_queued_meshes = 0;
+}
+
+void renderer_queue_cubes(WorldRenderer *r, Chunk *chunk, RenderStats *stats) {
+	renderer_upload_chunk(r, chunk, stats);
+	if (chunk->draw_slot != 0 && chunk->num_blocks) {
+		r->queued_cubes[r->num_queued_cubes++] = chunk;
+	}
+}
+
+void renderer_queue_mesh(WorldRenderer *r, Chunk *chunk, ChunkMesh *mesh, RenderStats *stats) {
+	renderer_upload_mesh(r, chunk, mesh, stats);
+	if (chunk->draw_slot != 0 && mesh->num_indices) {
+		r->queued_mesh_chunks[r->num_queued_meshes] = chunk;
+		r->queued_meshes[r->num_queued_meshes++] = mesh;
+	}
+}
+
+void renderer_bind_textures(WorldRenderer *r) {
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_BUFFER, r->instance_texture);
+	glActiveTexture(GL_TEXTURE1);
+	glBindTexture(GL_TEXTURE_BUFFER, r->origin_texture);
+	glActiveTexture(GL_TEXTURE2);
+	glBindTexture(GL_TEXTURE_BUFFER, r->ao_texture);
+	glActiveTexture(GL_TEXTURE3);
+	glBindTexture(GL_TEXTURE_BUFFER, r->light_texture);
+	glActiveTexture(GL_TEXTURE0);
+}
+
+// One draw for every queued chunk. A compaction while queueing a later chunk can move one queued
+// earlier, those are dirty again and re-upload in place here before the offsets are read.
+void renderer_draw_cubes(WorldRenderer *r, RenderStats *stats) {
+	PROFILE_ZONE("draw_cubes");
+	if (r->num_queued_cubes == 0) {
+		return;
+	}
+
+	for (u32 i = 0; i < r->num_queued_cubes; i++) {
+		Chunk *chunk = r->queued_cubes[i];
+		renderer_upload_chunk(r, chunk, stats);
+		r->cube_firsts[i] = chunk->instance_range.offset * CUBE_VERTICES;
+		r->cube_counts[i] = chunk->num_blocks * CUBE_VERTICES;
+	}
+
+	renderer_bind_textures(r);
+	glBindVertexArray(r->cube_vao);
+	GL_CHECK(glMultiDrawArrays(GL_TRIANGLES, r->cube_firsts, r->cube_counts, r->num_queued_cubes));
+	stats->draw_calls++;
+}
+
+void renderer_draw_meshes(WorldRenderer *r, RenderStats *stats) {
+	PROFILE_ZONE("draw_meshes");
+	if (r->num_queued_meshes == 0) {
+		return;
+	}
+
+	for (u32 i = 0; i < r->num_queued_meshes; i++) {
+		ChunkMesh *mesh = r->queued_meshes[i];
+		renderer_upload_mesh(r, r->queued_mesh_chunks[i], mesh, stats);
+		r->mesh_counts[i] = mesh->num_indices;
+		r->mesh_offsets[i] = (void *)(sizeof(u32) * (u64)mesh->index_range.offset);
+		r->mesh_base_vertices[i] = mesh->vertex_range.offset;
+	}
+
+	renderer_bind_textures(r);
+	glBindVertexArray(r->mesh_vao);
+	GL_CHECK(glMultiDrawElementsBaseVertex(GL_TRIANGLES, r->mesh_counts, GL_UNSIGNED_INT, r->mesh_offsets, r->num_queued_meshes, r->mesh_base_vertices));
+	stats->draw_calls++;
+}
+
+void renderer_draw_cursor(WorldRenderer *r) {
+	renderer_bind_textures(r);
+	glBindVertexArray(r->cube_vao);
+	GL_CHECK(glDrawArrays(GL_TRIANGLES, r->cursor_range.offset * CUBE_VERTICES, CUBE_VERTICES));
+}
+
+#endif
@@ -0,0 +1,291 @@
+#ifndef SECTION_H
+#define SECTION_H
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "common.h"
+
+// Chunk voxel storage split into 16^3 sections stacked along y.
+// A section holding a single value keeps just that value, a mixed section keeps a palette
+// of the values it holds and a bit packed index per voxel (1, 2, 4 or 8 bits, so an index never
+// straddles two words). Palettes grow on set, storage_compact shrinks them back down and
+// collapses sections that became uniform.
+// A section covers the chunk's whole footprint, so chunk_width and chunk_depth must be SECTION_SIZE.
+
+#define SECTION_SIZE 16
+#define SECTION_VOLUME (SECTION_SIZE * SECTION_SIZE * SECTION_SIZE)
+
+typedef struct Section {
+	u64 *data;
+	u8 *palette;
+	u16 palette_len;
+	// 0 while uniform
+	u8 bits;
+	// the whole section's value while uniform
+	u8 value;
+} Section;
+
+typedef struct ChunkStorage {
+	Section *sections;
+	u32 num_sections;
+} ChunkStorage;
+
+u32 section_index(u32 x, u32 y, u32 z) {
+	return (((y * SECTION_SIZE) + z) * SECTION_SIZE) + x;
+}
+
+u32 section_words(u8 bits) {
+	return (SECTION_VOLUME * bits) / 64;
+}
+
+void section_make_uniform(Section *section, u8 value) {
+	free(section->data);
+	free(section->palette);
+	section->data = NULL;
+	section->palette = NULL;
+	section->palette_len = 0;
+	section->bits = 0;
+	section->value = value;
+}
+
+u32 section_get_index(Section *section, u32 idx) {
+	u32 bit = idx * section->bits;
+	u64 mask = ((u64)1 << section->bits) - 1;
+	return (u32)((section->data[bit >> 6] >> (bit & 63)) & mask);
+}
+
+void section_set_index(Section *section, u32 idx, u32 palette_idx) {
+	u32 bit = idx * section->bits;
+	u64 mask = ((u64)1 << section->bits) - 1;
+	u64 *word = &section->data[bit >> 6];
+	*word = (*word & ~(mask << (bit & 63))) | ((u64)palette_idx << (bit & 63));
+}
+
+u8 section_get(Section *section, u32 idx) {
+	if (section->bits == 0) {
+		return section->value;
+	}
+	return section->palette[section_get_index(section, idx)];
+}
+
+// Re-packs the indices at a new width, the palette keeps its order
+void section_repack(Section *section, u8 bits) {
+	u64 *data = (u64 *)calloc(section_words(bits), sizeof(u64));
+	u8 *palette = (u8 *)malloc(1 << bits);
+
+	if (section->bits == 0) {
+		palette[0] = section->value;
+		section->palette_len = 1;
+	} else {
+		memcpy(palette, section->palette, section->palette_len);
+
+		u8 old_bits = section->bits;
+		u64 *old_data = section->data;
+		u64 old_mask = ((u64)1 << old_bits) - 1;
+		for (u32 i = 0; i < SECTION_VOLUME; i++) {
+			u32 old_bit = i * old_bits;
+			u64 palette_idx = (old_data[old_bit >> 6] >> (old_bit & 63)) & old_mask;
+			u32 bit = i * bits;
+			data[bit >> 6] |= palette_idx << (bit & 63);
+		}
+	}
+
+	free(section->data);
+	free(section->palette);
+	section->data = data;
+	section->palette = palette;
+	section->bits = bits;
+}
+
+void section_set(Section *section, u32 idx, u8 value) {
+	if (section->bits == 0) {
+		if (section->value == value) {
+			return;
+		}
+		section_repack(section, 1);
+	}
+
+	u32 palette_idx = 0;
+	while (palette_idx < section->palette_len && section->palette[palette_idx] != value) {
+		palette_idx++;
+	}
+
+	if (palette_idx == section->palette_len) {
+		if (section->palette_len == (1 << section->bits)) {
+			section_repack(section, section->bits * 2);
+		}
+		section->palette[section->palette_len++] = value;
+	}
+
+	section_set_index(section, idx, palette_idx);
+}
+
+// Drops unused palette entries, narrows the indices and collapses single valued sections
+void section_compact(Section *section) {
+	if (section->bits == 0) {
+		return;
+	}
+
+	u32 counts[256];
+	memset(counts, 0, sizeof(counts));
+	for (u32 i = 0; i < SECTION_VOLUME; i++) {
+		counts[section_get_index(section, i)]++;
+	}
+
+	u8 remap[256];
+	u8 palette[256];
+	u32 palette_len = 0;
+	for (u32 i = 0; i < section->palette_len; i++) {
+		if (counts[i]) {
+			remap[i] = palette_len;
+			palette[palette_len++] = section->palette[i];
+		}
+	}
+
+	if (palette_len == 1) {
+		section_make_uniform(section, palette[0]);
+		return;
+	}
+
+	u8 bits = 1;
+	while ((1u << bits) < palette_len) {
+		bits *= 2;
+	}
+
+	if (palette_len == section->palette_len && bits == section->bits) {
+		return;
+	}
+
+	u64 *data = (u64 *)calloc(section_words(bits), sizeof(u64));
+	for (u32 i = 0; i < SECTION_VOLUME; i++) {
+		u32 bit = i * bits;
+		data[bit >> 6] |= (u64)remap[section_get_index(section, i)] << (bit & 63);
+	}
+
+	free(section->data);
+	section->data = data;
+	section->palette = (u8 *)realloc(section->palette, 1 << bits);
+	memcpy(section->palette, palette, palette_len);
+	section->palette_len = palette_len;
+	section->bits = bits;
+}
+
+// Replaces the whole section with values, one per voxel in section_index order, packed at the
+// narrowest width that holds them. Same values as setting each voxel and compacting.
+void section_load(Section *section, u8 *values) {
+	u8 present[256];
+	memset(present, 0, sizeof(present));
+	for (u32 i = 0; i < SECTION_VOLUME; i++) {
+		present[values[i]] = 1;
+	}
+
+	u8 remap[256];
+	u8 palette[256];
+	u32 palette_len = 0;
+	for (u32 v = 0; v < 256; v++) {
+		remap[v] = palette_len;
+		palette[palette_len] = v;
+		palette_len += present[v];
+	}
+
+	if (palette_len == 1) {
+		section_make_uniform(section, palette[0]);
+		return;
+	}
+
+	u8 bits = 1;
+	while ((1u << bits) < palette_len) {
+		bits *= 2;
+	}
+
+	// a word at a time, indices never straddle two words
+	u32 per_word = 64 / bits;
+	u64 *data = (u64 *)malloc(sizeof(u64) * section_words(bits));
+	for (u32 w = 0; w < section_words(bits); w++) {
+		u8 *word_values = &values[w * per_word];
+		u64 word = 0;
+		for (u32 k = 0; k < per_word; k++) {
+			word |= (u64)remap[word_values[k]] << (k * bits);
+		}
+		data[w] = word;
+	}
+
+	free(section->data);
+	free(section->palette);
+	section->data = data;
+	section->palette = (u8 *)malloc(1 << bits);
+	memcpy(section->palette, palette, palette_len);
+	section->palette_len = palette_len;
+	section->bits = bits;
+}
+
+ChunkStorage *storage_create(u32 height, u8 value) {
+	assert(height % SECTION_SIZE == 0);
+
+	ChunkStorage *storage = (ChunkStorage *)malloc(sizeof(ChunkStorage));
+	storage->num_sections = height / SECTION_SIZE;
+	storage->sections = (Section *)calloc(storage->num_sections, sizeof(Section));
+	for (u32 i = 0; i < storage->num_sections; i++) {
+		storage->sections[i].value = value;
+	}
+	return storage;
+}
+
+void storage_clear(ChunkStorage *storage, u8 value) {
+	for (u32 i = 0; i < storage->num_sections; i++) {
+		section_make_uniform(&storage->sections[i], value);
+	}
+}
+
+void storage_free(ChunkStorage *storage) {
+	storage_clear(storage, 0);
+	free(storage->sections);
+	free(storage);
+}
+
+u8 storage_get(ChunkStorage *storage, u32 x, u32 y, u32 z) {
+	Section *section = &storage->sections[y / SECTION_SIZE];
+	return section_get(section, section_index(x, y % SECTION_SIZE, z));
+}
+
+void storage_set(ChunkStorage *storage, u32 x, u32 y, u32 z, u8 value) {
+	Section *section = &storage->sections[y / SECTION_SIZE];
+	section_set(section, section_index(x, y % SECTION_SIZE, z), value);
+}
+
+void storage_compact(ChunkStorage *storage) {
+	for (u32 i = 0; i < storage->num_sections; i++) {
+		section_compact(&storage->sections[i]);
+	}
+}
+
+bool storage_equal(ChunkStorage *a, ChunkStorage *b) {
+	if (a->num_sections != b->num_sections) {
+		return false;
+	}
+
+	for (u32 s = 0; s < a->num_sections; s++) {
+		for (u32 i = 0; i < SECTION_VOLUME; i++) {
+			if (section_get(&a->sections[s], i) != section_get(&b->sections[s], i)) {
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+// Heap bytes held by the storage, including the section headers
+u64 storage_bytes(ChunkStorage *storage) {
+	u64 bytes = sizeof(ChunkStorage) + sizeof(Section) * storage->num_sections;
+	for (u32 i = 0; i < storage->num_sections; i++) {
+		Section *section = &storage->sections[i];
+		if (section->bits) {
+			bytes += section_words(section->bits) * sizeof(u64) + (1 << section->bits);
+		}
+	}
+	return bytes;
+}
+
+#endif
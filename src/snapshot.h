@@ -0,0 +1,723 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <glm/glm.hpp>
+
+#include "common.h"
+#include "profile.h"
+#include "chunk.h"
+#include "edit.h"
+#include "lighting.h"
+#include "stream.h"
+#include "greedy.h"
+#include "lod.h"
+#include "raycast.h"
+
+// The world runs on a thread of its own: streaming, edits, lighting, picking and mesh building all
+// happen there, and the render thread never touches a chunk the world owns. After every tick the
+// world thread publishes a WorldSnapshot, an immutable description of what to draw: the ready
+// chunks with their bounds and level of detail, and copies of the instances, occupancy and meshes
+// that changed since the render thread last took a snapshot. Snapshots go through a triple buffer,
+// the world fills one while the render thread reads another and the third holds the newest
+// finished one, so neither thread waits on the other for more than swapping two indices. When the
+// render thread has not taken the newest one by the next tick, the world thread takes it back and
+// adds to it, so copies reach the render thread in the order they were made.
+// The render thread applies snapshots to a RenderWorld of proxy chunks, Chunk structs holding just
+// what render.h, frustum.h and occlusion.h read, so drawing works on them as it did on the world's.
+// Input goes the other way, the camera and a queue of block edits (WorldInput).
+
+typedef enum WorldCommandKind {
+	// digs out the block and the rest of its column above it
+	COMMAND_DIG,
+	// places a block against the face of the block
+	COMMAND_PLACE,
+	// turns the block into a lamp of level, or back when it already is one
+	COMMAND_LAMP,
+} WorldCommandKind;
+
+typedef struct WorldCommand {
+	WorldCommandKind kind;
+	// world block coordinates, usually the hovered block of the last snapshot
+	i32 x;
+	i32 y;
+	i32 z;
+	// face normal the block was picked through
+	i32 normal[3];
+	u8 level;
+} WorldCommand;
+
+#define WORLD_MAX_COMMANDS 64
+
+typedef struct WorldInput {
+	glm::vec3 camera_pos;
+	glm::vec3 camera_front;
+	// the nearest chunks are drawn from greedy meshes, which are only built then
+	bool greedy;
+	WorldCommand commands[WORLD_MAX_COMMANDS];
+	u32 num_commands;
+} WorldInput;
+
+typedef struct SnapshotChunk {
+	i32 cx;
+	i32 cz;
+	u32 y_min;
+	u32 y_max;
+	u64 num_blocks;
+	u8 lod;
+} SnapshotChunk;
+
+typedef enum SnapshotUpdateKind {
+	// instances, their ao and light bytes and the chunk's occupancy
+	UPDATE_INSTANCES,
+	// the greedy mesh (level 0) or a downsampled one
+	UPDATE_MESH,
+} SnapshotUpdateKind;
+
+// Changed data of a chunk, copied into the snapshot's data at offset
+typedef struct SnapshotUpdate {
+	SnapshotUpdateKind kind;
+	i32 cx;
+	i32 cz;
+	u32 level;
+	// instances, or mesh vertices
+	u32 count;
+	u32 num_indices;
+	u32 num_quads;
+	u64 area;
+	u64 offset;
+} SnapshotUpdate;
+
+typedef struct WorldSnapshot {
+	// world tick it was taken after, 0 while empty
+	u64 tick;
+
+	SnapshotChunk *chunks;
+	u32 num_chunks;
+	u32 chunk_capacity;
+
+	// in the order they happened, a later update of a chunk overwrites an earlier one
+	SnapshotUpdate *updates;
+	u32 num_updates;
+	u32 update_capacity;
+	u8 *data;
+	u64 data_size;
+	u64 data_capacity;
+
+	// block under the crosshair, in world block coordinates, for the camera the tick ran with
+	bool hovered;
+	i32 hovered_block[3];
+	i32 hovered_normal[3];
+
+	u64 tick_ns;
+} WorldSnapshot;
+
+typedef struct SnapshotStats {
+	u64 published;
+	u64 taken;
+	// published snapshots taken back before the render thread saw them, their copies went out with the next one
+	u64 skipped;
+	u64 bytes_copied;
+} SnapshotStats;
+
+typedef struct SnapshotExchange {
+	pthread_mutex_t lock;
+	WorldSnapshot snapshots[3];
+	u32 writing;
+	u32 ready;
+	u32 reading;
+	// ready holds a snapshot the render thread has not taken yet
+	bool fresh;
+	SnapshotStats stats;
+} SnapshotExchange;
+
+typedef struct WorldThread {
+	pthread_t thread;
+	bool started;
+	ChunkStream *stream;
+	SnapshotExchange exchange;
+
+	// what the render thread last sent, guarded by input_lock
+	pthread_mutex_t input_lock;
+	pthread_cond_t input_cond;
+	WorldInput input;
+	u64 input_serial;
+	u64 ticked_serial;
+	bool quit;
+
+	// the input the running tick works from
+	WorldInput tick_input;
+	RayHit hovered;
+	f32 pick_distance;
+
+	u64 ticks;
+	FrameHistogram tick_times;
+	EditStats edit_stats;
+} WorldThread;
+
+// Room for size more bytes at the end of the data, 16 byte aligned, returns its offset
+u64 snapshot_alloc(WorldSnapshot *snapshot, u64 size) {
+	u64 offset = (snapshot->data_size + 15) & ~(u64)15;
+	if (offset + size > snapshot->data_capacity) {
+		u64 capacity = snapshot->data_capacity ? snapshot->data_capacity : 1 << 20;
+		while (capacity < offset + size) {
+			capacity *= 2;
+		}
+		snapshot->data = (u8 *)realloc(snapshot->data, capacity);
+		snapshot->data_capacity = capacity;
+	}
+	snapshot->data_size = offset + size;
+	return offset;
+}
+
+SnapshotUpdate *snapshot_push_update(WorldSnapshot *snapshot) {
+	if (snapshot->num_updates == snapshot->update_capacity) {
+		snapshot->update_capacity = snapshot->update_capacity ? snapshot->update_capacity * 2 : 256;
+		snapshot->updates = (SnapshotUpdate *)realloc(snapshot->updates, sizeof(SnapshotUpdate) * snapshot->update_capacity);
+	}
+	SnapshotUpdate *update = &snapshot->updates[snapshot->num_updates++];
+	memset(update, 0, sizeof(SnapshotUpdate));
+	return update;
+}
+
+// Occupancy first for its alignment, then instances, ao and light bytes
+u64 snapshot_copy_instances(WorldSnapshot *snapshot, i32 cx, i32 cz, Chunk *chunk) {
+	u64 columns = sizeof(OccupancyColumn) * chunk_width * chunk_depth;
+	u64 count = chunk->num_blocks;
+	u64 size = columns + (sizeof(u32) + AO_FACES * 2) * count;
+	u64 offset = snapshot_alloc(snapshot, size);
+
+	u8 *out = snapshot->data + offset;
+	memcpy(out, chunk->occupancy, columns);
+	memcpy(out + columns, chunk->instances, sizeof(u32) * count);
+	memcpy(out + columns + sizeof(u32) * count, chunk->ao_bits, AO_FACES * count);
+	memcpy(out + columns + (sizeof(u32) + AO_FACES) * count, chunk->light_bits, AO_FACES * count);
+
+	SnapshotUpdate *update = snapshot_push_update(snapshot);
+	update->kind = UPDATE_INSTANCES;
+	update->cx = cx;
+	update->cz = cz;
+	update->count = (u32)count;
+	update->offset = offset;
+	return size;
+}
+
+u64 snapshot_copy_mesh(WorldSnapshot *snapshot, i32 cx, i32 cz, u32 level, ChunkMesh *mesh) {
+	u64 vertex_bytes = sizeof(MeshVertex) * mesh->num_vertices;
+	u64 size = vertex_bytes + sizeof(u32) * mesh->num_indices;
+	u64 offset = snapshot_alloc(snapshot, size);
+	memcpy(snapshot->data + offset, mesh->vertices, vertex_bytes);
+	memcpy(snapshot->data + offset + vertex_bytes, mesh->indices, sizeof(u32) * mesh->num_indices);
+
+	SnapshotUpdate *update = snapshot_push_update(snapshot);
+	update->kind = UPDATE_MESH;
+	update->cx = cx;
+	update->cz = cz;
+	update->level = level;
+	update->count = mesh->num_vertices;
+	update->num_indices = mesh->num_indices;
+	update->num_quads = mesh->num_quads;
+	update->area = mesh->area;
+	update->offset = offset;
+	return size;
+}
+
+void snapshot_free(WorldSnapshot *snapshot) {
+	free(snapshot->chunks);
+	free(snapshot->updates);
+	free(snapshot->data);
+}
+
+// The snapshot for the world thread to fill. When the newest published one was not taken it is
+// taken back, its updates are kept and the new ones go on after them.
+WorldSnapshot *snapshot_begin(SnapshotExchange *exchange) {
+	pthread_mutex_lock(&exchange->lock);
+	bool skipped = exchange->fresh;
+	if (skipped) {
+		u32 withdrawn = exchange->ready;
+		exchange->ready = exchange->writing;
+		exchange->writing = withdrawn;
+		exchange->fresh = false;
+		exchange->stats.skipped++;
+	}
+	pthread_mutex_unlock(&exchange->lock);
+
+	WorldSnapshot *snapshot = &exchange->snapshots[exchange->writing];
+	snapshot->num_chunks = 0;
+	if (!skipped) {
+		snapshot->num_updates = 0;
+		snapshot->data_size = 0;
+	}
+	return snapshot;
+}
+
+// Hands the filled snapshot over as the newest
+void snapshot_publish(SnapshotExchange *exchange) {
+	pthread_mutex_lock(&exchange->lock);
+	u32 published = exchange->writing;
+	exchange->writing = exchange->ready;
+	exchange->ready = published;
+	exchange->fresh = true;
+	exchange->stats.published++;
+	pthread_mutex_unlock(&exchange->lock);
+}
+
+// The newest snapshot when one was published since the last call, NULL otherwise. It stays the
+// render thread's until the next call.
+WorldSnapshot *snapshot_take(SnapshotExchange *exchange) {
+	pthread_mutex_lock(&exchange->lock);
+	WorldSnapshot *snapshot = NULL;
+	if (exchange->fresh) {
+		u32 taken = exchange->ready;
+		exchange->ready = exchange->reading;
+		exchange->reading = taken;
+		exchange->fresh = false;
+		exchange->stats.taken++;
+		snapshot = &exchange->snapshots[taken];
+	}
+	pthread_mutex_unlock(&exchange->lock);
+	return snapshot;
+}
+
+// Takes over the stream and its job system, which from here on must only be used by the world thread
+// (or world_tick callers when the thread is not started). The render side frees its proxies of
+// evicted chunks itself, so the stream's evict_fn should not touch the renderer.
+WorldThread *world_thread_create(ChunkStream *stream) {
+	WorldThread *world = (WorldThread *)calloc(1, sizeof(WorldThread));
+	world->stream = stream;
+	world->exchange.writing = 0;
+	world->exchange.ready = 1;
+	world->exchange.reading = 2;
+	pthread_mutex_init(&world->exchange.lock, NULL);
+	pthread_mutex_init(&world->input_lock, NULL);
+	pthread_cond_init(&world->input_cond, NULL);
+	world->pick_distance = 64.0f;
+	return world;
+}
+
+// Sends the camera for the next tick and wakes the world thread
+void world_send_camera(WorldThread *world, glm::vec3 camera_pos, glm::vec3 camera_front, bool greedy) {
+	pthread_mutex_lock(&world->input_lock);
+	world->input.camera_pos = camera_pos;
+	world->input.camera_front = camera_front;
+	world->input.greedy = greedy;
+	world->input_serial++;
+	pthread_cond_signal(&world->input_cond);
+	pthread_mutex_unlock(&world->input_lock);
+}
+
+// Queues an edit for the next tick, false when the queue is full
+bool world_send_command(WorldThread *world, WorldCommand command) {
+	pthread_mutex_lock(&world->input_lock);
+	bool queued = world->input.num_commands < WORLD_MAX_COMMANDS;
+	if (queued) {
+		world->input.commands[world->input.num_commands++] = command;
+		world->input_serial++;
+		pthread_cond_signal(&world->input_cond);
+	}
+	pthread_mutex_unlock(&world->input_lock);
+	return queued;
+}
+
+// The ready chunk holding world column (wx, wz), NULL when it is not ready
+Chunk *world_ready_chunk(WorldThread *world, i32 wx, i32 wz) {
+	StreamSlot *slot = stream_find(world->stream, world_to_chunk((f32)wx, chunk_width), world_to_chunk((f32)wz, chunk_depth));
+	return slot && slot->state == SLOT_READY ? slot->chunk : NULL;
+}
+
+void world_apply_command(WorldThread *world, WorldCommand *command) {
+	i32 x = command->x;
+	i32 z = command->z;
+	if (command->kind == COMMAND_PLACE) {
+		x += command->normal[0];
+		z += command->normal[2];
+	}
+	i32 y = command->y + (command->kind == COMMAND_PLACE ? command->normal[1] : 0);
+
+	Chunk *chunk = world_ready_chunk(world, x, z);
+	if (chunk == NULL || y < 0 || y >= (i32)chunk_height) {
+		return;
+	}
+
+	u32 lx = (u32)(x - chunk->x_off);
+	u32 lz = (u32)(z - chunk->z_off);
+	if (command->kind == COMMAND_DIG) {
+		chunk_remove_block(chunk, lx, (u32)y, lz, &world->edit_stats);
+	} else if (command->kind == COMMAND_PLACE) {
+		chunk_set_block(chunk, lx, (u32)y, lz, &world->edit_stats);
+	} else {
+		u8 light = light_get(&chunk->light, lx, (u32)y, lz);
+		u8 level = light_block(light) == command->level ? 0 : command->level;
+		light_set_emitter(&world_light, chunk, lx, (u32)y, lz, level);
+		light_flush(&world_light);
+	}
+}
+
+// Only hulled chunks can be edited, a hit in the generated border ring does not count
+void world_pick(WorldThread *world) {
+	WorldInput *input = &world->tick_input;
+	RayHit *hovered = &world->hovered;
+	hovered->hit = false;
+
+	StreamSlot *camera_slot = stream_find(world->stream, world_to_chunk(input->camera_pos.x, chunk_width), world_to_chunk(input->camera_pos.z, chunk_depth));
+	if (camera_slot && camera_slot->state != SLOT_GENERATING) {
+		Ray view_ray = {input->camera_pos, input->camera_front};
+		raycast(camera_slot->chunk, view_ray, world->pick_distance, hovered);
+	}
+	if (hovered->hit) {
+		StreamSlot *slot = stream_find(world->stream, world_to_chunk(hovered->chunk->x_off, chunk_width), world_to_chunk(hovered->chunk->z_off, chunk_depth));
+		hovered->hit = slot && slot->state == SLOT_READY;
+	}
+}
+
+// Lists the ready chunks, builds the meshes their level of detail needs, and copies what changed
+// since it was last copied
+void snapshot_fill(WorldThread *world, WorldSnapshot *snapshot) {
+	PROFILE_ZONE("snapshot_fill");
+	ChunkStream *stream = world->stream;
+	WorldInput *input = &world->tick_input;
+	u64 bytes = 0;
+
+	u32 num_slots = stream->window * stream->window;
+	if (snapshot->chunk_capacity < num_slots) {
+		snapshot->chunk_capacity = num_slots;
+		snapshot->chunks = (SnapshotChunk *)realloc(snapshot->chunks, sizeof(SnapshotChunk) * num_slots);
+	}
+
+	for (u32 i = 0; i < num_slots; i++) {
+		StreamSlot *slot = &stream->slots[i];
+		if (slot->state != SLOT_READY) {
+			continue;
+		}
+
+		// near chunks go through the path picked with G, far ones through their downsampled meshes
+		Chunk *chunk = slot->chunk;
+		chunk->lod = lod_select(chunk->lod, chunk_distance(chunk, input->camera_pos));
+		ChunkMesh *mesh = NULL;
+		if (chunk->lod > 0) {
+			if (chunk->lod_meshes[chunk->lod] == NULL || chunk->lod_meshes[chunk->lod]->stale) {
+				build_lod_mesh(chunk, chunk->lod);
+			}
+			mesh = chunk->lod_meshes[chunk->lod];
+		} else if (input->greedy) {
+			if (chunk->mesh == NULL || chunk->mesh->stale) {
+				build_chunk_mesh(chunk);
+			}
+			mesh = chunk->mesh;
+		}
+
+		if (chunk->dirty) {
+			bytes += snapshot_copy_instances(snapshot, slot->cx, slot->cz, chunk);
+			chunk->dirty = false;
+		}
+		if (mesh && mesh->dirty) {
+			bytes += snapshot_copy_mesh(snapshot, slot->cx, slot->cz, chunk->lod, mesh);
+			mesh->dirty = false;
+		}
+
+		SnapshotChunk *entry = &snapshot->chunks[snapshot->num_chunks++];
+		entry->cx = slot->cx;
+		entry->cz = slot->cz;
+		entry->y_min = chunk->y_min;
+		entry->y_max = chunk->y_max;
+		entry->num_blocks = chunk->num_blocks;
+		entry->lod = chunk->lod;
+	}
+
+	snapshot->hovered = world->hovered.hit;
+	if (world->hovered.hit) {
+		RayHit *hit = &world->hovered;
+		snapshot->hovered_block[0] = hit->chunk->x_off + (i32)hit->x;
+		snapshot->hovered_block[1] = (i32)hit->y;
+		snapshot->hovered_block[2] = hit->chunk->z_off + (i32)hit->z;
+		memcpy(snapshot->hovered_normal, hit->normal, sizeof(snapshot->hovered_normal));
+	}
+	world->exchange.stats.bytes_copied += bytes;
+}
+
+// One step of the world with the latest input: stream, apply the queued edits, pick, then publish
+// a snapshot. Runs on the world thread, or on the caller when it was never started.
+void world_tick(WorldThread *world) {
+	PROFILE_ZONE("world_tick");
+	u64 start = get_time_ns();
+
+	WorldInput *input = &world->tick_input;
+	pthread_mutex_lock(&world->input_lock);
+	*input = world->input;
+	world->input.num_commands = 0;
+	world->ticked_serial = world->input_serial;
+	pthread_mutex_unlock(&world->input_lock);
+
+	stream_update(world->stream, input->camera_pos);
+	for (u32 i = 0; i < input->num_commands; i++) {
+		world_apply_command(world, &input->commands[i]);
+	}
+	world_pick(world);
+
+	WorldSnapshot *snapshot = snapshot_begin(&world->exchange);
+	snapshot_fill(world, snapshot);
+	snapshot->tick = ++world->ticks;
+	snapshot->tick_ns = get_time_ns() - start;
+	histogram_push(&world->tick_times, snapshot->tick_ns);
+	snapshot_publish(&world->exchange);
+}
+
+// Ticks once per input from the render thread, and keeps ticking every millisecond while the
+// stream still has chunks to bring in
+void *world_thread_loop(void *data) {
+	WorldThread *world = (WorldThread *)data;
+	profile_name_thread("world");
+	for (;;) {
+		bool busy = !stream_complete(world->stream);
+		pthread_mutex_lock(&world->input_lock);
+		if (!world->quit && world->input_serial == world->ticked_serial) {
+			if (busy) {
+				struct timespec until;
+				clock_gettime(CLOCK_REALTIME, &until);
+				until.tv_nsec += 1000000;
+				if (until.tv_nsec >= 1000000000) {
+					until.tv_sec++;
+					until.tv_nsec -= 1000000000;
+				}
+				pthread_cond_timedwait(&world->input_cond, &world->input_lock, &until);
+			} else {
+				pthread_cond_wait(&world->input_cond, &world->input_lock);
+			}
+		}
+		bool quit = world->quit;
+		pthread_mutex_unlock(&world->input_lock);
+
+		if (quit) {
+			break;
+		}
+		world_tick(world);
+	}
+	return NULL;
+}
+
+void world_thread_start(WorldThread *world) {
+	world->started = pthread_create(&world->thread, NULL, world_thread_loop, world) == 0;
+}
+
+// Joins the world thread, the stream is the caller's again afterwards
+void world_thread_stop(WorldThread *world) {
+	if (!world->started) {
+		return;
+	}
+	pthread_mutex_lock(&world->input_lock);
+	world->quit = true;
+	pthread_cond_signal(&world->input_cond);
+	pthread_mutex_unlock(&world->input_lock);
+	pthread_join(world->thread, NULL);
+	world->started = false;
+}
+
+// Stops the thread if it runs, the stream is left to the caller
+void world_thread_destroy(WorldThread *world) {
+	world_thread_stop(world);
+	for (u32 i = 0; i < 3; i++) {
+		snapshot_free(&world->exchange.snapshots[i]);
+	}
+	pthread_mutex_destroy(&world->exchange.lock);
+	pthread_mutex_destroy(&world->input_lock);
+	pthread_cond_destroy(&world->input_cond);
+	free(world);
+}
+
+typedef struct RenderWorldStats {
+	u64 snapshots_applied;
+	u64 updates_applied;
+	u64 proxies_created;
+	u64 proxies_dropped;
+} RenderWorldStats;
+
+// The render thread's view of the world, a proxy chunk per chunk of the last snapshot
+typedef struct RenderWorld {
+	// by chunk coordinate like the stream's slots, window must be at least the stream's
+	u32 window;
+	Chunk **proxies;
+	// tick of the snapshot each proxy was last listed in
+	u64 *seen;
+
+	// the last snapshot's chunks in its order
+	Chunk **ready;
+	u32 num_ready;
+	u64 tick;
+
+	bool hovered;
+	i32 hovered_block[3];
+	i32 hovered_normal[3];
+
+	// called before a proxy is freed, e.g. to release its GL buffers, may be NULL
+	void (*release_fn)(Chunk *proxy);
+
+	RenderWorldStats stats;
+} RenderWorld;
+
+RenderWorld *render_world_create(u32 window) {
+	RenderWorld *rw = (RenderWorld *)calloc(1, sizeof(RenderWorld));
+	rw->window = window;
+	rw->proxies = (Chunk **)calloc(window * window, sizeof(Chunk *));
+	rw->seen = (u64 *)calloc(window * window, sizeof(u64));
+	rw->ready = (Chunk **)malloc(sizeof(Chunk *) * window * window);
+	return rw;
+}
+
+u32 render_world_index(RenderWorld *rw, i32 cx, i32 cz) {
+	i32 w = (i32)rw->window;
+	return twod_to_oned(positive_mod(cx, w), positive_mod(cz, w), rw->window);
+}
+
+// The proxy of chunk (cx, cz), NULL when there is none
+Chunk *render_world_find(RenderWorld *rw, i32 cx, i32 cz) {
+	Chunk *proxy = rw->proxies[render_world_index(rw, cx, cz)];
+	if (proxy == NULL || proxy->x_off != cx * (i32)chunk_width || proxy->z_off != cz * (i32)chunk_depth) {
+		return NULL;
+	}
+	return proxy;
+}
+
+void proxy_free_mesh(ChunkMesh *mesh) {
+	if (mesh) {
+		free(mesh->vertices);
+		free(mesh->indices);
+		free(mesh);
+	}
+}
+
+void render_world_drop(RenderWorld *rw, u32 index) {
+	Chunk *proxy = rw->proxies[index];
+	if (rw->release_fn) {
+		rw->release_fn(proxy);
+	}
+	free(proxy->occupancy);
+	free(proxy->instances);
+	free(proxy->ao_bits);
+	free(proxy->light_bits);
+	proxy_free_mesh(proxy->mesh);
+	for (u32 l = 0; l < LOD_LEVELS; l++) {
+		proxy_free_mesh(proxy->lod_meshes[l]);
+	}
+	free(proxy);
+	rw->proxies[index] = NULL;
+	rw->stats.proxies_dropped++;
+}
+
+void proxy_apply_update(Chunk *proxy, SnapshotUpdate *update, const u8 *data) {
+	if (update->kind == UPDATE_INSTANCES) {
+		u64 count = update->count;
+		if (count > proxy->instance_capacity) {
+			u64 capacity = MIN_INSTANCE_CAPACITY;
+			while (capacity < count) {
+				capacity *= 2;
+			}
+			proxy->instances = (u32 *)realloc(proxy->instances, sizeof(u32) * capacity);
+			proxy->ao_bits = (u8 *)realloc(proxy->ao_bits, AO_FACES * capacity);
+			proxy->light_bits = (u8 *)realloc(proxy->light_bits, AO_FACES * capacity);
+			proxy->instance_capacity = capacity;
+		}
+
+		u64 columns = sizeof(OccupancyColumn) * chunk_width * chunk_depth;
+		memcpy(proxy->occupancy, data, columns);
+		memcpy(proxy->instances, data + columns, sizeof(u32) * count);
+		memcpy(proxy->ao_bits, data + columns + sizeof(u32) * count, AO_FACES * count);
+		memcpy(proxy->light_bits, data + columns + (sizeof(u32) + AO_FACES) * count, AO_FACES * count);
+		proxy->dirty = true;
+		return;
+	}
+
+	ChunkMesh **slot = update->level ? &proxy->lod_meshes[update->level] : &proxy->mesh;
+	if (*slot == NULL) {
+		*slot = (ChunkMesh *)calloc(1, sizeof(ChunkMesh));
+	}
+	ChunkMesh *mesh = *slot;
+	reserve_mesh(mesh, update->count, update->num_indices);
+	memcpy(mesh->vertices, data, sizeof(MeshVertex) * update->count);
+	memcpy(mesh->indices, data + sizeof(MeshVertex) * update->count, sizeof(u32) * update->num_indices);
+	mesh->num_vertices = update->count;
+	mesh->num_indices = update->num_indices;
+	mesh->num_quads = update->num_quads;
+	mesh->area = update->area;
+	mesh->dirty = true;
+	mesh->stale = false;
+}
+
+// Brings the proxies in line with the snapshot: new chunks get a proxy, chunks no longer listed lose
+// theirs, the updates are copied in and the proxies linked to their listed neighbours
+void render_world_apply(RenderWorld *rw, WorldSnapshot *snapshot) {
+	PROFILE_ZONE("snapshot_apply");
+	rw->tick = snapshot->tick;
+	rw->num_ready = 0;
+	for (u32 i = 0; i < snapshot->num_chunks; i++) {
+		SnapshotChunk *entry = &snapshot->chunks[i];
+		u32 index = render_world_index(rw, entry->cx, entry->cz);
+		Chunk *proxy = render_world_find(rw, entry->cx, entry->cz);
+		if (proxy == NULL) {
+			if (rw->proxies[index]) {
+				render_world_drop(rw, index);
+			}
+			proxy = (Chunk *)calloc(1, sizeof(Chunk));
+			proxy->x_off = entry->cx * (i32)chunk_width;
+			proxy->z_off = entry->cz * (i32)chunk_depth;
+			proxy->occupancy = (OccupancyColumn *)calloc(chunk_width * chunk_depth, sizeof(OccupancyColumn));
+			rw->proxies[index] = proxy;
+			rw->stats.proxies_created++;
+		}
+
+		proxy->y_min = entry->y_min;
+		proxy->y_max = entry->y_max;
+		proxy->num_blocks = entry->num_blocks;
+		proxy->lod = entry->lod;
+		rw->seen[index] = snapshot->tick;
+		rw->ready[rw->num_ready++] = proxy;
+	}
+
+	for (u32 i = 0; i < rw->window * rw->window; i++) {
+		if (rw->proxies[i] && rw->seen[i] != snapshot->tick) {
+			render_world_drop(rw, i);
+		}
+	}
+
+	for (u32 i = 0; i < snapshot->num_updates; i++) {
+		SnapshotUpdate *update = &snapshot->updates[i];
+		Chunk *proxy = render_world_find(rw, update->cx, update->cz);
+		if (proxy) {
+			proxy_apply_update(proxy, update, snapshot->data + update->offset);
+			rw->stats.updates_applied++;
+		}
+	}
+
+	// occlusion.h only draws chunks with all four neighbours as occluders
+	i32 offsets[4][2] = {{1, 0}, {-1, 0}, {0, 1}, {0, -1}};
+	for (u32 i = 0; i < rw->num_ready; i++) {
+		Chunk *proxy = rw->ready[i];
+		i32 cx = proxy->x_off / (i32)chunk_width;
+		i32 cz = proxy->z_off / (i32)chunk_depth;
+		for (u32 side = 0; side < 4; side++) {
+			proxy->neighbours[side] = render_world_find(rw, cx + offsets[side][0], cz + offsets[side][1]);
+		}
+	}
+
+	rw->hovered = snapshot->hovered;
+	memcpy(rw->hovered_block, snapshot->hovered_block, sizeof(rw->hovered_block));
+	memcpy(rw->hovered_normal, snapshot->hovered_normal, sizeof(rw->hovered_normal));
+	rw->stats.snapshots_applied++;
+}
+
+void render_world_destroy(RenderWorld *rw) {
+	for (u32 i = 0; i < rw->window * rw->window; i++) {
+		if (rw->proxies[i]) {
+			render_world_drop(rw, i);
+		}
+	}
+	free(rw->proxies);
+	free(rw->seen);
+	free(rw->ready);
+	free(rw);
+}
+
+#endif
@@ -0,0 +1,422 @@
+#ifndef STREAM_H
+#define STREAM_H
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "common.h"
+#include "chunk.h"
+#include "jobs.h"
+#include "region.h"
+#include "lighting.h"
+#include "cache.h"
+
+// Streams chunks in and out around a moving centre instead of building a fixed grid up front.
+// Chunks within radius (in chunks, square rings) of the centre are hulled and drawn, the ring
+// just outside is generated so their borders can be hulled. Generation runs as batches on the
+// job system, nearest chunks first, while hulling is done on the calling thread a few chunks per
+// update. Chunks are only freed once they are further than keep_radius, so flying back and forth
+// across a chunk border does not regenerate anything.
+// With a RegionStore chunks that were saved before are read from disk instead of generated,
+// and generated or edited chunks are written back when they are freed. A chunk is lit as it is
+// hulled, its light spreading into the ready chunks around it.
+// With a ChunkCache freed chunks are kept encoded in memory instead and come back from there, and
+// the loaded chunks are held to the cache's byte budget (see cache.h).
+
+typedef enum SlotState {
+	SLOT_EMPTY,
+	// generate_chunk is running on the job system
+	SLOT_GENERATING,
+	// heights are generated and linked to the loaded neighbours
+	SLOT_GENERATED,
+	// hulled and instanced, ready to draw
+	SLOT_READY,
+} SlotState;
+
+typedef struct StreamSlot {
+	i32 cx;
+	i32 cz;
+	Chunk *chunk;
+	SlotState state;
+} StreamSlot;
+
+struct ChunkStream;
+
+typedef struct StreamJob {
+	struct ChunkStream *stream;
+	StreamSlot *slot;
+} StreamJob;
+
+typedef struct StreamStats {
+	u64 generated;
+	u64 hulled;
+	u64 evicted;
+} StreamStats;
+
+typedef struct ChunkStream {
+	u32 radius;
+	u32 keep_radius;
+
+	// side of the slot grid, chunk (cx, cz) lives in slot (cx mod window, cz mod window)
+	u32 window;
+	StreamSlot *slots;
+
+	i32 centre_x;
+	i32 centre_z;
+
+	JobSystem *sys;
+	// slots being generated by the batch in flight
+	StreamJob *batch;
+	u32 batch_size;
+	u32 max_batch;
+
+	// bounds how many chunks one stream_update hulls and instances
+	u32 hulls_per_update;
+
+	// scratch for sorting work by distance
+	StreamSlot **candidates;
+
+	// NULL to always generate
+	RegionStore *store;
+	// NULL to free chunks as they leave keep_radius
+	ChunkCache *cache;
+
+	// called before a chunk is freed, e.g. to release its GL buffers, may be NULL
+	void (*evict_fn)(Chunk *chunk);
+
+	StreamStats stats;
+} ChunkStream;
+
+i32 positive_mod(i32 a, i32 b) {
+	return ((a % b) + b) % b;
+}
+
+// Chunk coordinate holding world coordinate w along an axis of chunks size wide
+i32 world_to_chunk(f32 w, u32 size) {
+	return (i32)floorf(w / (f32)size);
+}
+
+u32 chunk_ring(i32 cx, i32 cz, i32 centre_x, i32 centre_z) {
+	u32 dx = (u32)abs(cx - centre_x);
+	u32 dz = (u32)abs(cz - centre_z);
+	return dx > dz ? dx : dz;
+}
+
+// keep_radius is raised to at least radius + 1 so the generated border ring is never freed early
+ChunkStream *stream_create(JobSystem *sys, u32 radius, u32 keep_radius, u32 max_batch, u32 hulls_per_update) {
+	ChunkStream *stream = (ChunkStream *)malloc(sizeof(ChunkStream));
+	memset(stream, 0, sizeof(ChunkStream));
+
+	stream->radius = radius;
+	stream->keep_radius = keep_radius > radius + 1 ? keep_radius : radius + 1;
+	stream->window = stream->keep_radius * 2 + 1;
+	stream->slots = (StreamSlot *)calloc(stream->window * stream->window, sizeof(StreamSlot));
+	// a slot holds at most one chunk, so the pool never grows past this while streaming
+	chunk_pool_reserve(stream->window * stream->window);
+	stream->candidates = (StreamSlot **)malloc(sizeof(StreamSlot *) * stream->window * stream->window);
+
+	stream->sys = sys;
+	stream->max_batch = max_batch < sys->max_jobs ? max_batch : sys->max_jobs;
+	stream->batch = (StreamJob *)malloc(sizeof(StreamJob) * stream->max_batch);
+	stream->hulls_per_update = hulls_per_update;
+	return stream;
+}
+
+StreamSlot *stream_slot(ChunkStream *stream, i32 cx, i32 cz) {
+	i32 w = (i32)stream->window;
+	return &stream->slots[twod_to_oned(positive_mod(cx, w), positive_mod(cz, w), stream->window)];
+}
+
+// The slot holding chunk (cx, cz), NULL when it is not loaded
+StreamSlot *stream_find(ChunkStream *stream, i32 cx, i32 cz) {
+	StreamSlot *slot = stream_slot(stream, cx, cz);
+	if (slot->state == SLOT_EMPTY || slot->cx != cx || slot->cz != cz) {
+		return NULL;
+	}
+	return slot;
+}
+
+void stream_link(ChunkStream *stream, StreamSlot *slot) {
+	i32 offsets[4][2] = {{1, 0}, {-1, 0}, {0, 1}, {0, -1}};
+	for (u32 side = 0; side < 4; side++) {
+		StreamSlot *other = stream_find(stream, slot->cx + offsets[side][0], slot->cz + offsets[side][1]);
+		if (other == NULL || other->state == SLOT_GENERATING) {
+			continue;
+		}
+
+		slot->chunk->neighbours[side] = other->chunk;
+		other->chunk->neighbours[opposite_side(side)] = slot->chunk;
+	}
+}
+
+void stream_evict(ChunkStream *stream, StreamSlot *slot) {
+	PROFILE_ZONE("stream_evict");
+	Chunk *chunk = slot->chunk;
+	for (u32 side = 0; side < 4; side++) {
+		if (chunk->neighbours[side]) {
+			chunk->neighbours[side]->neighbours[opposite_side(side)] = NULL;
+		}
+	}
+
+	if (stream->evict_fn) {
+		stream->evict_fn(chunk);
+	}
+	bool cached = stream->cache && cache_put(stream->cache, chunk);
+	if (!cached && stream->store && chunk->unsaved) {
+		region_save_chunk(stream->store, chunk);
+	}
+	free_chunk(chunk);
+
+	slot->chunk = NULL;
+	slot->state = SLOT_EMPTY;
+	stream->stats.evicted++;
+}
+
+void stream_generate_job(void *data) {
+	StreamJob *job = (StreamJob *)data;
+	ChunkStream *stream = job->stream;
+	Chunk *chunk = stream->cache ? cache_take(stream->cache, job->slot->cx, job->slot->cz) : NULL;
+	job->slot->chunk = chunk ? chunk : load_or_generate_chunk(stream->store, job->slot->cx, job->slot->cz);
+}
+
+i32 stream_centre_dist2(ChunkStream *stream, StreamSlot *slot) {
+	i32 dx = slot->cx - stream->centre_x;
+	i32 dz = slot->cz - stream->centre_z;
+	return dx * dx + dz * dz;
+}
+
+// qsort has no context pointer, the centre is stashed here while sorting
+ChunkStream *sorting_stream = NULL;
+
+int compare_slot_dist(const void *a, const void *b) {
+	i32 da = stream_centre_dist2(sorting_stream, *(StreamSlot **)a);
+	i32 db = stream_centre_dist2(sorting_stream, *(StreamSlot **)b);
+	return (da > db) - (da < db);
+}
+
+void sort_by_distance(ChunkStream *stream, StreamSlot **slots, u32 count) {
+	sorting_stream = stream;
+	qsort(slots, count, sizeof(StreamSlot *), compare_slot_dist);
+	sorting_stream = NULL;
+}
+
+// True when the batch in flight has finished and been linked in
+bool stream_collect(ChunkStream *stream) {
+	PROFILE_ZONE("stream_collect");
+	if (stream->batch_size == 0) {
+		return true;
+	}
+
+	// a lone thread has no workers to generate in the background, so it runs the batch here
+	if (stream->sys->num_threads == 1) {
+		while (job_system_run_one(stream->sys));
+	}
+
+	if (job_system_busy(stream->sys)) {
+		return false;
+	}
+	job_system_wait(stream->sys);
+
+	for (u32 i = 0; i < stream->batch_size; i++) {
+		StreamSlot *slot = stream->batch[i].slot;
+		slot->state = SLOT_GENERATED;
+		stream_link(stream, slot);
+		stream->stats.generated++;
+	}
+	stream->batch_size = 0;
+	return true;
+}
+
+// Queues the nearest missing chunks within radius + 1 for generation
+void stream_schedule(ChunkStream *stream) {
+	PROFILE_ZONE("stream_schedule");
+	u32 count = 0;
+	i32 reach = (i32)stream->radius + 1;
+	for (i32 cz = stream->centre_z - reach; cz <= stream->centre_z + reach; cz++) {
+		for (i32 cx = stream->centre_x - reach; cx <= stream->centre_x + reach; cx++) {
+			StreamSlot *slot = stream_slot(stream, cx, cz);
+			if (slot->state != SLOT_EMPTY) {
+				continue;
+			}
+			slot->cx = cx;
+			slot->cz = cz;
+			stream->candidates[count++] = slot;
+		}
+	}
+
+	if (count == 0) {
+		return;
+	}
+
+	sort_by_distance(stream, stream->candidates, count);
+	for (u32 i = 0; i < count && i < stream->max_batch; i++) {
+		StreamSlot *slot = stream->candidates[i];
+		slot->state = SLOT_GENERATING;
+
+		StreamJob *job = &stream->batch[stream->batch_size++];
+		job->stream = stream;
+		job->slot = slot;
+		job_submit(stream->sys, job_create(stream->sys, stream_generate_job, job));
+	}
+}
+
+// Hulls the nearest generated chunks within radius whose four neighbours are in
+void stream_hull(ChunkStream *stream) {
+	PROFILE_ZONE("stream_hull");
+	u32 count = 0;
+	i32 reach = (i32)stream->radius;
+	for (i32 cz = stream->centre_z - reach; cz <= stream->centre_z + reach; cz++) {
+		for (i32 cx = stream->centre_x - reach; cx <= stream->centre_x + reach; cx++) {
+			StreamSlot *slot = stream_find(stream, cx, cz);
+			if (slot == NULL || slot->state != SLOT_GENERATED) {
+				continue;
+			}
+
+			Chunk **neighbours = slot->chunk->neighbours;
+			if (neighbours[0] && neighbours[1] && neighbours[2] && neighbours[3]) {
+				stream->candidates[count++] = slot;
+			}
+		}
+	}
+
+	sort_by_distance(stream, stream->candidates, count);
+	for (u32 i = 0; i < count && i < stream->hulls_per_update; i++) {
+		StreamSlot *slot = stream->candidates[i];
+		hull_chunk(slot->chunk);
+		light_chunk(&world_light, slot->chunk);
+		update_chunk(slot->chunk);
+		light_flush(&world_light);
+		slot->state = SLOT_READY;
+		stream->stats.hulled++;
+	}
+}
+
+u64 stream_bytes(ChunkStream *stream) {
+	u64 bytes = 0;
+	for (u32 i = 0; i < stream->window * stream->window; i++) {
+		StreamSlot *slot = &stream->slots[i];
+		if (slot->state != SLOT_EMPTY && slot->state != SLOT_GENERATING) {
+			bytes += chunk_bytes(slot->chunk);
+		}
+	}
+	return bytes;
+}
+
+// With a cache, demotes loaded chunks past the generated ring furthest first while they and the
+// cache's table alone go over the budget, then drops warm chunks until they fit in what is left of it
+void stream_fit_budget(ChunkStream *stream) {
+	if (stream->cache == NULL) {
+		return;
+	}
+
+	u64 overhead = cache_overhead(stream->cache);
+	u64 limit = stream->cache->budget > overhead ? stream->cache->budget - overhead : 0;
+	u64 hot_bytes = stream_bytes(stream);
+	if (hot_bytes > limit) {
+		u32 count = 0;
+		u32 num_slots = stream->window * stream->window;
+		for (u32 i = 0; i < num_slots; i++) {
+			StreamSlot *slot = &stream->slots[i];
+			if ((slot->state == SLOT_GENERATED || slot->state == SLOT_READY) &&
+				chunk_ring(slot->cx, slot->cz, stream->centre_x, stream->centre_z) > stream->radius + 1) {
+				stream->candidates[count++] = slot;
+			}
+		}
+
+		sort_by_distance(stream, stream->candidates, count);
+		for (u32 i = count; i-- > 0 && hot_bytes > limit;) {
+			hot_bytes -= chunk_bytes(stream->candidates[i]->chunk);
+			stream_evict(stream, stream->candidates[i]);
+			stream->cache->stats.budget_demoted++;
+		}
+	}
+	cache_trim(stream->cache, hot_bytes, stream->store);
+}
+
+// Moves the centre to the chunk under camera_pos, frees what fell out of keep_radius, picks up
+// finished generation, queues more, hulls up to hulls_per_update chunks and, with a cache, fits
+// what is left in its budget
+void stream_update(ChunkStream *stream, glm::vec3 camera_pos) {
+	PROFILE_ZONE("stream_update");
+	stream->centre_x = world_to_chunk(camera_pos.x, chunk_width);
+	stream->centre_z = world_to_chunk(camera_pos.z, chunk_depth);
+	if (stream->cache) {
+		cache_tick(stream->cache, stream->centre_x, stream->centre_z);
+	}
+
+	u32 num_slots = stream->window * stream->window;
+	for (u32 i = 0; i < num_slots; i++) {
+		StreamSlot *slot = &stream->slots[i];
+		if (slot->state == SLOT_EMPTY || slot->state == SLOT_GENERATING) {
+			continue;
+		}
+		if (chunk_ring(slot->cx, slot->cz, stream->centre_x, stream->centre_z) > stream->keep_radius) {
+			stream_evict(stream, slot);
+		}
+	}
+
+	if (stream_collect(stream)) {
+		stream_schedule(stream);
+	}
+	stream_hull(stream);
+	stream_fit_budget(stream);
+}
+
+// True once every chunk within radius of the centre is ready
+bool stream_complete(ChunkStream *stream) {
+	i32 reach = (i32)stream->radius;
+	for (i32 cz = stream->centre_z - reach; cz <= stream->centre_z + reach; cz++) {
+		for (i32 cx = stream->centre_x - reach; cx <= stream->centre_x + reach; cx++) {
+			StreamSlot *slot = stream_find(stream, cx, cz);
+			if (slot == NULL || slot->state != SLOT_READY) {
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+// Blocks until everything within radius of camera_pos is ready, for startup
+void stream_fill(ChunkStream *stream, glm::vec3 camera_pos) {
+	do {
+		stream_update(stream, camera_pos);
+		if (stream->batch_size) {
+			job_system_wait(stream->sys);
+		}
+	} while (!stream_complete(stream));
+}
+
+u32 stream_loaded_chunks(ChunkStream *stream) {
+	u32 count = 0;
+	for (u32 i = 0; i < stream->window * stream->window; i++) {
+		count += stream->slots[i].state == SLOT_GENERATED || stream->slots[i].state == SLOT_READY;
+	}
+	return count;
+}
+
+void stream_destroy(ChunkStream *stream) {
+	stream_collect(stream);
+	if (stream->batch_size) {
+		job_system_wait(stream->sys);
+		stream_collect(stream);
+	}
+
+	// the chunks still loaded are saved straight to the store rather than demoted
+	if (stream->cache) {
+		cache_flush(stream->cache, stream->store);
+		stream->cache = NULL;
+	}
+	for (u32 i = 0; i < stream->window * stream->window; i++) {
+		if (stream->slots[i].state != SLOT_EMPTY) {
+			stream_evict(stream, &stream->slots[i]);
+		}
+	}
+
+	free(stream->slots);
+	free(stream->candidates);
+	free(stream->batch);
+	free(stream);
+}
+
+#endif
@@ -0,0 +1,471 @@
+#ifndef SVO_H
+#define SVO_H
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <glm/glm.hpp>
+
+#include "common.h"
+#include "chunk.h"
+#include "raycast.h"
+
+// Sparse voxel octree over a set of built chunks, for tracing rays without the GPU. A node covers
+// a cube and keeps one bit per octant for whether it holds anything, and one for whether it is
+// solid all through. Only octants that are neither get a child, and a node's children are stored
+// one after the other, so a child is found by counting the bits below its own. Cubes of
+// SVO_BRICK voxels are bricks, a 64 bit mask of solid voxels, plus the voxels' tiles when any of
+// them is on the hull. Octants that are solid and off the hull need no tiles, so the ground under
+// the surface collapses into a few big full cubes.
+
+#define SVO_BRICK 4
+// drawn where a full cube shows, which only happens where the octree cuts through the ground
+#define SVO_BURIED_TILE HULL_BOTTOM_TILE
+
+typedef struct SvoNode {
+	u8 child_mask;
+	u8 full_mask;
+	// index of the first child, into nodes or, when the children are bricks, into bricks
+	u32 first_child;
+} SvoNode;
+
+typedef struct SvoBrick {
+	// bit x | y << 2 | z << 4
+	u64 solid;
+	// offset of 64 tiles into Svo.tiles, ~0 when no voxel of the brick is on the hull
+	u32 tiles;
+} SvoBrick;
+
+typedef struct SvoStats {
+	u32 nodes;
+	u32 bricks;
+	u32 tiled_bricks;
+	u32 full_cells;
+	u64 bytes;
+} SvoStats;
+
+typedef struct Svo {
+	// world block coordinates of the octree's (0, 0, 0) corner
+	i32 x_off;
+	i32 z_off;
+	// side of the cube, a power of two at least chunk_height
+	u32 size;
+
+	SvoNode *nodes;
+	u32 num_nodes;
+	u32 node_capacity;
+	SvoBrick *bricks;
+	u32 num_bricks;
+	u32 brick_capacity;
+	u8 *tiles;
+	u32 tiles_size;
+	u32 tiles_capacity;
+	u32 root;
+
+	SvoStats stats;
+} Svo;
+
+// What building one cube of the octree found
+typedef enum SvoCellKind {
+	SVO_EMPTY,
+	SVO_FULL,
+	SVO_CHILD,
+} SvoCellKind;
+
+typedef struct SvoCell {
+	SvoCellKind kind;
+	// the node to store, or the brick already stored, when kind is SVO_CHILD
+	SvoNode node;
+	u32 brick;
+} SvoCell;
+
+// The chunks the octree is built from, laid out as a grid of chunk columns
+typedef struct SvoSource {
+	Chunk **grid;
+	u32 width;
+	u32 depth;
+} SvoSource;
+
+u32 svo_brick_bit(u32 x, u32 y, u32 z) {
+	return x | (y << 2) | (z << 4);
+}
+
+u32 svo_push_node(Svo *svo, SvoNode node) {
+	if (svo->num_nodes == svo->node_capacity) {
+		svo->node_capacity = svo->node_capacity ? svo->node_capacity * 2 : 1024;
+		svo->nodes = (SvoNode *)realloc(svo->nodes, sizeof(SvoNode) * svo->node_capacity);
+	}
+	svo->nodes[svo->num_nodes] = node;
+	return svo->num_nodes++;
+}
+
+u32 svo_push_brick(Svo *svo, SvoBrick brick) {
+	if (svo->num_bricks == svo->brick_capacity) {
+		svo->brick_capacity = svo->brick_capacity ? svo->brick_capacity * 2 : 1024;
+		svo->bricks = (SvoBrick *)realloc(svo->bricks, sizeof(SvoBrick) * svo->brick_capacity);
+	}
+	svo->bricks[svo->num_bricks] = brick;
+	return svo->num_bricks++;
+}
+
+u32 svo_push_tiles(Svo *svo, u8 *tiles) {
+	if (svo->tiles_size + 64 > svo->tiles_capacity) {
+		svo->tiles_capacity = svo->tiles_capacity ? svo->tiles_capacity * 2 : 64 * 1024;
+		svo->tiles = (u8 *)realloc(svo->tiles, svo->tiles_capacity);
+	}
+	memcpy(svo->tiles + svo->tiles_size, tiles, 64);
+	svo->tiles_size += 64;
+	return svo->tiles_size - 64;
+}
+
+SvoCell svo_build_brick(Svo *svo, SvoSource *source, u32 x, u32 y, u32 z) {
+	SvoCell cell = {};
+	Chunk *chunk = source->grid[twod_to_oned(x / chunk_width, z / chunk_depth, source->width)];
+	if (chunk == NULL || y >= chunk_height) {
+		cell.kind = SVO_EMPTY;
+		return cell;
+	}
+
+	SvoBrick brick = {0, ~(u32)0};
+	u8 tiles[64] = {};
+	bool on_hull = false;
+	for (u32 dz = 0; dz < SVO_BRICK; dz++) {
+		for (u32 dx = 0; dx < SVO_BRICK; dx++) {
+			u32 lx = (x + dx) % chunk_width;
+			u32 lz = (z + dz) % chunk_depth;
+			u64 column = chunk->occupancy[twod_to_oned(lx, lz, chunk_width)].words[y / 64] >> (y % 64);
+			for (u32 dy = 0; dy < SVO_BRICK; dy++) {
+				if (!((column >> dy) & 1)) {
+					continue;
+				}
+				u32 bit = svo_brick_bit(dx, dy, dz);
+				brick.solid |= (u64)1 << bit;
+				tiles[bit] = storage_get(chunk->pre_render_list, lx, y + dy, lz);
+				on_hull |= tiles[bit] != 0;
+			}
+		}
+	}
+
+	if (brick.solid == 0) {
+		cell.kind = SVO_EMPTY;
+	} else if (brick.solid == ~(u64)0 && !on_hull) {
+		cell.kind = SVO_FULL;
+	} else {
+		if (on_hull) {
+			brick.tiles = svo_push_tiles(svo, tiles);
+			svo->stats.tiled_bricks++;
+		}
+		cell.kind = SVO_CHILD;
+		cell.brick = svo_push_brick(svo, brick);
+	}
+	return cell;
+}
+
+// Builds the cube of side size at (x, y, z), storing everything under it. A node's children are
+// stored once all of them are built, so they end up next to each other.
+SvoCell svo_build_cell(Svo *svo, SvoSource *source, u32 x, u32 y, u32 z, u32 size) {
+	if (size == SVO_BRICK) {
+		return svo_build_brick(svo, source, x, y, z);
+	}
+
+	u32 half = size / 2;
+	SvoCell children[8];
+	SvoCell cell = {};
+	for (u32 octant = 0; octant < 8; octant++) {
+		u32 cx = x + (octant & 1 ? half : 0);
+		u32 cy = y + (octant & 2 ? half : 0);
+		u32 cz = z + (octant & 4 ? half : 0);
+		bool outside = cx >= source->width * chunk_width || cz >= source->depth * chunk_depth || cy >= chunk_height;
+		if (outside) {
+			children[octant].kind = SVO_EMPTY;
+		} else {
+			children[octant] = svo_build_cell(svo, source, cx, cy, cz, half);
+		}
+
+		if (children[octant].kind != SVO_EMPTY) {
+			cell.node.child_mask |= 1 << octant;
+		}
+		if (children[octant].kind == SVO_FULL) {
+			cell.node.full_mask |= 1 << octant;
+		}
+	}
+
+	if (cell.node.child_mask == 0) {
+		cell.kind = SVO_EMPTY;
+		return cell;
+	}
+	if (cell.node.full_mask == 0xFF) {
+		cell.kind = SVO_FULL;
+		return cell;
+	}
+
+	cell.kind = SVO_CHILD;
+	bool first = true;
+	for (u32 octant = 0; octant < 8; octant++) {
+		if (children[octant].kind != SVO_CHILD) {
+			if (children[octant].kind == SVO_FULL) {
+				svo->stats.full_cells++;
+			}
+			continue;
+		}
+
+		// bricks were stored in octant order as they were built
+		u32 index = half == SVO_BRICK ? children[octant].brick : svo_push_node(svo, children[octant].node);
+		if (first) {
+			cell.node.first_child = index;
+			first = false;
+		}
+	}
+	return cell;
+}
+
+// Octree over the built chunks, which must be hulled so their tiles are known. chunks may be in
+// any order and spread anywhere, the octree covers the box around them and missing chunks are empty.
+Svo *svo_build(Chunk **chunks, u32 count) {
+	Svo *svo = (Svo *)malloc(sizeof(Svo));
+	memset(svo, 0, sizeof(Svo));
+
+	i32 min_cx = 0;
+	i32 min_cz = 0;
+	i32 max_cx = 0;
+	i32 max_cz = 0;
+	for (u32 i = 0; i < count; i++) {
+		i32 cx = chunks[i]->x_off / (i32)chunk_width;
+		i32 cz = chunks[i]->z_off / (i32)chunk_depth;
+		min_cx = i == 0 || cx < min_cx ? cx : min_cx;
+		min_cz = i == 0 || cz < min_cz ? cz : min_cz;
+		max_cx = i == 0 || cx > max_cx ? cx : max_cx;
+		max_cz = i == 0 || cz > max_cz ? cz : max_cz;
+	}
+
+	SvoSource source;
+	source.width = count ? (u32)(max_cx - min_cx + 1) : 1;
+	source.depth = count ? (u32)(max_cz - min_cz + 1) : 1;
+	source.grid = (Chunk **)calloc(source.width * source.depth, sizeof(Chunk *));
+	for (u32 i = 0; i < count; i++) {
+		i32 cx = chunks[i]->x_off / (i32)chunk_width - min_cx;
+		i32 cz = chunks[i]->z_off / (i32)chunk_depth - min_cz;
+		source.grid[twod_to_oned(cx, cz, source.width)] = chunks[i];
+	}
+
+	svo->x_off = min_cx * (i32)chunk_width;
+	svo->z_off = min_cz * (i32)chunk_depth;
+	svo->size = chunk_height;
+	while (svo->size < source.width * chunk_width || svo->size < source.depth * chunk_depth) {
+		svo->size *= 2;
+	}
+
+	SvoCell root = svo_build_cell(svo, &source, 0, 0, 0, svo->size);
+	// a full root cannot happen, chunk_height is above the highest possible column
+	if (root.kind != SVO_CHILD) {
+		memset(&root.node, 0, sizeof(SvoNode));
+	}
+	svo->root = svo_push_node(svo, root.node);
+	free(source.grid);
+
+	svo->stats.nodes = svo->num_nodes;
+	svo->stats.bricks = svo->num_bricks;
+	svo->stats.bytes = sizeof(SvoNode) * svo->num_nodes + sizeof(SvoBrick) * svo->num_bricks + svo->tiles_size;
+	return svo;
+}
+
+void svo_free(Svo *svo) {
+	free(svo->nodes);
+	free(svo->bricks);
+	free(svo->tiles);
+	free(svo);
+}
+
+// The deepest cell holding octree voxel (x, y, z): its side, and for a solid voxel its tile
+typedef struct SvoLookup {
+	u32 size;
+	bool solid;
+	u8 tile;
+	// the brick the voxel is in, NULL when the cell is bigger than a voxel
+	SvoBrick *brick;
+} SvoLookup;
+
+SvoLookup svo_brick_lookup(Svo *svo, SvoBrick *brick, u32 x, u32 y, u32 z) {
+	SvoLookup found = {};
+	u32 voxel = svo_brick_bit(x % SVO_BRICK, y % SVO_BRICK, z % SVO_BRICK);
+	found.size = 1;
+	found.brick = brick;
+	found.solid = (brick->solid >> voxel) & 1;
+	if (found.solid) {
+		// solid voxels off the hull have tile 0
+		found.tile = brick->tiles == ~(u32)0 ? 0 : svo->tiles[brick->tiles + voxel];
+		found.tile = found.tile ? found.tile : SVO_BURIED_TILE;
+	}
+	return found;
+}
+
+// Walks down from path[level], the node of side 1 << level holding (x, y, z), to the deepest cell
+// holding the voxel. Every node passed is stored in path, so a later lookup nearby can start from
+// the smallest node holding both voxels instead of from the root.
+SvoLookup svo_descend(Svo *svo, SvoNode **path, u32 level, u32 x, u32 y, u32 z) {
+	SvoLookup found = {};
+	SvoNode *node = path[level];
+	u32 size = 1 << level;
+	for (;;) {
+		u32 half = size / 2;
+		u32 octant = (x & half ? 1 : 0) | (y & half ? 2 : 0) | (z & half ? 4 : 0);
+		u32 bit = 1 << octant;
+		if (!(node->child_mask & bit)) {
+			found.size = half;
+			return found;
+		}
+		if (node->full_mask & bit) {
+			found.size = half;
+			found.solid = true;
+			found.tile = SVO_BURIED_TILE;
+			return found;
+		}
+
+		u32 index = node->first_child + __builtin_popcount(node->child_mask & ~node->full_mask & (bit - 1));
+		if (half == SVO_BRICK) {
+			return svo_brick_lookup(svo, &svo->bricks[index], x, y, z);
+		}
+		node = &svo->nodes[index];
+		size = half;
+		path[--level] = node;
+	}
+}
+
+u32 svo_levels(Svo *svo) {
+	return __builtin_ctz(svo->size);
+}
+
+SvoLookup svo_lookup(Svo *svo, u32 x, u32 y, u32 z) {
+	SvoNode *path[32];
+	path[svo_levels(svo)] = &svo->nodes[svo->root];
+	return svo_descend(svo, path, svo_levels(svo), x, y, z);
+}
+
+typedef struct SvoHit {
+	bool hit;
+	// world block coordinates
+	i32 x;
+	i32 y;
+	i32 z;
+	i32 normal[3];
+	f32 distance;
+	u8 tile;
+} SvoHit;
+
+// First solid voxel along the ray within max_distance. Empty cells are crossed in one step
+// whatever their size: the walk finds the deepest cell holding the current voxel, and when it is
+// empty moves straight to the voxel just past the face the ray leaves it through.
+bool svo_raycast(Svo *svo, Ray ray, f32 max_distance, SvoHit *hit) {
+	memset(hit, 0, sizeof(SvoHit));
+	f32 length = glm::length(ray.dir);
+	if (length == 0) {
+		return false;
+	}
+	// in the octree's own coordinates
+	glm::vec3 o = ray.origin - glm::vec3(svo->x_off, 0, svo->z_off);
+	glm::vec3 d = ray.dir / length;
+	f32 size = (f32)svo->size;
+
+	// clip to the octree's cube
+	f32 t_enter = 0;
+	f32 t_exit = max_distance;
+	i32 entered = -1;
+	for (u32 a = 0; a < 3; a++) {
+		if (d[a] == 0) {
+			if (o[a] < 0 || o[a] >= size) {
+				return false;
+			}
+			continue;
+		}
+		f32 near = ((d[a] > 0 ? 0 : size) - o[a]) / d[a];
+		f32 far = ((d[a] > 0 ? size : 0) - o[a]) / d[a];
+		if (near > t_enter) {
+			t_enter = near;
+			entered = a;
+		}
+		t_exit = far < t_exit ? far : t_exit;
+	}
+	if (t_enter > t_exit) {
+		return false;
+	}
+
+	i32 step[3];
+	i32 cell[3];
+	for (u32 a = 0; a < 3; a++) {
+		step[a] = d[a] > 0 ? 1 : -1;
+		i32 c = floor_to_i32(o[a] + d[a] * t_enter);
+		if ((i32)a == entered) {
+			c = d[a] > 0 ? 0 : (i32)svo->size - 1;
+		}
+		cell[a] = c < 0 ? 0 : c >= (i32)svo->size ? (i32)svo->size - 1 : c;
+	}
+
+	f32 t = t_enter;
+	// nodes the last lookup passed through, by level, and the cell it was for
+	SvoNode *path[32];
+	u32 root_level = svo_levels(svo);
+	path[root_level] = &svo->nodes[svo->root];
+	SvoBrick *brick = NULL;
+	i32 last[3] = {cell[0], cell[1], cell[2]};
+	bool first = true;
+	while (t <= t_exit) {
+		// the smallest node holding this voxel and the last one is the last one's ancestor
+		// below the highest bit the two differ in
+		u32 diff = (u32)((cell[0] ^ last[0]) | (cell[1] ^ last[1]) | (cell[2] ^ last[2]));
+		u32 level = first || diff >= svo->size ? root_level : 32 - __builtin_clz(diff | 1);
+		level = level < root_level ? level : root_level;
+		SvoLookup found;
+		if (brick && diff < SVO_BRICK) {
+			found = svo_brick_lookup(svo, brick, cell[0], cell[1], cell[2]);
+		} else {
+			found = svo_descend(svo, path, level > 3 ? level : 3, cell[0], cell[1], cell[2]);
+			brick = found.brick;
+		}
+		memcpy(last, cell, sizeof(last));
+		first = false;
+
+		if (found.solid) {
+			hit->hit = true;
+			hit->x = cell[0] + svo->x_off;
+			hit->y = cell[1];
+			hit->z = cell[2] + svo->z_off;
+			if (entered >= 0) {
+				hit->normal[entered] = -step[entered];
+			}
+			hit->distance = t;
+			hit->tile = found.tile;
+			return true;
+		}
+
+		// leave the empty cell through whichever of its far faces the ray reaches first
+		i32 mask = ~(i32)(found.size - 1);
+		f32 best = INFINITY;
+		u32 axis = 0;
+		for (u32 a = 0; a < 3; a++) {
+			i32 low = cell[a] & mask;
+			f32 boundary = ray_boundary(o[a], d[a], d[a] > 0 ? low + (i32)found.size - 1 : low);
+			if (boundary < best) {
+				best = boundary;
+				axis = a;
+			}
+		}
+
+		t = best;
+		for (u32 a = 0; a < 3; a++) {
+			i32 low = cell[a] & mask;
+			if (a == axis) {
+				cell[a] = d[a] > 0 ? low + (i32)found.size : low - 1;
+			} else {
+				i32 c = floor_to_i32(o[a] + d[a] * t);
+				cell[a] = c < low ? low : c > low + (i32)found.size - 1 ? low + (i32)found.size - 1 : c;
+			}
+		}
+		entered = axis;
+		if (cell[axis] < 0 || cell[axis] >= (i32)svo->size) {
+			return false;
+		}
+	}
+	return false;
+}
+
+#endif
@@ -22,11 +22,13 @@ typedef struct Image {
     u8 *data;
 } Image;
 
-typedef struct TGAHeader {
+// 18 bytes on disk, packed so the u16 fields are not padded out
+typedef struct __attribute__((packed)) TGAHeader {
     u8 id_len;
     u8 colormap_t;
     u8 data_t;
     u16 colormap_origin;
+    u16 colormap_length;
     u8 colormap_depth;
     u16 x_origin;
     u16 y_origin;
@@ -59,6 +61,7 @@ Color rgb_to_color(u8 r, u8 g, u8 b) {
 	return c;
 }
 
+// Pixels blue, green, red (and alpha at 4 bytes per pixel), rows from the top of the image down
 void write_tga(const char *filename, Image *img) {
     FILE *out_file = fopen(filename, "wb");
 
@@ -72,7 +75,7 @@ void write_tga(const char *filename, Image *img) {
     header.width = img->width;
     header.height = img->height;
     header.data_t = 2;
-    header.img_desc = 0x10;
+    header.img_desc = 0x20;
 
     fwrite(&header, 1, sizeof(TGAHeader), out_file);
     fwrite((char *)img->data, 1, img->width * img->height * img->bytes_per_pixel, out_file);
@@ -0,0 +1,173 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <glm/glm.hpp>
+
+#include "common.h"
+#include "chunk.h"
+#include "jobs.h"
+#include "svo.h"
+#include "tga.h"
+
+// Headless renders of a world on the CPU: one ray per pixel through a sparse voxel octree (svo.h),
+// shaded by the hit face's tile colour and its angle to a fixed sun. The image is cut into square
+// tiles that the job system's threads take from a shared counter, so a slow tile (looking along
+// the ground) holds up one thread rather than a fixed share of the image.
+
+#define TRACE_TILE 16
+
+typedef struct TraceCamera {
+	glm::vec3 eye;
+	glm::vec3 front;
+	// vertical, degrees
+	f32 fov;
+	f32 max_distance;
+} TraceCamera;
+
+typedef struct TraceImage {
+	u32 width;
+	u32 height;
+	// 3 bytes per pixel blue, green, red, rows top first, what write_tga expects
+	u8 *pixels;
+	// per pixel, the hit or not (left zeroed) that coloured it
+	SvoHit *hits;
+} TraceImage;
+
+// The camera's basis, scaled so pixel rays are front plus a fraction of right and up
+typedef struct TraceView {
+	glm::vec3 eye;
+	glm::vec3 front;
+	glm::vec3 right;
+	glm::vec3 up;
+	u32 width;
+	u32 height;
+} TraceView;
+
+typedef struct TraceJob {
+	Svo *svo;
+	TraceCamera *camera;
+	TraceView view;
+	TraceImage *image;
+	u32 *next_tile;
+} TraceJob;
+
+glm::vec3 trace_sky = glm::vec3(0.55, 0.7, 0.95);
+
+TraceView trace_view(TraceCamera *camera, u32 width, u32 height) {
+	TraceView view;
+	f32 half_height = tanf(glm::radians(camera->fov) / 2.0f);
+	f32 half_width = half_height * (f32)width / (f32)height;
+	view.eye = camera->eye;
+	view.front = glm::normalize(camera->front);
+	view.right = glm::normalize(glm::cross(view.front, glm::vec3(0.0, 1.0, 0.0))) * half_width;
+	view.up = glm::normalize(glm::cross(view.right, view.front)) * half_height;
+	view.width = width;
+	view.height = height;
+	return view;
+}
+
+// The ray through the middle of pixel (x, y)
+Ray trace_pixel_ray(TraceView *view, u32 x, u32 y) {
+	f32 u = ((f32)x + 0.5f) / (f32)view->width * 2.0f - 1.0f;
+	f32 v = 1.0f - ((f32)y + 0.5f) / (f32)view->height * 2.0f;
+	Ray ray = {view->eye, view->front + view->right * u + view->up * v};
+	return ray;
+}
+
+glm::vec3 trace_shade(SvoHit *hit) {
+	if (!hit->hit) {
+		return trace_sky;
+	}
+	glm::vec3 sun = glm::normalize(glm::vec3(0.4, 1.0, 0.25));
+	glm::vec3 normal = glm::vec3(hit->normal[0], hit->normal[1], hit->normal[2]);
+	f32 light = 0.4f + 0.6f * fmaxf(glm::dot(normal, sun), 0.0f);
+	return tile_colors[hit->tile % TILE_PALETTE_SIZE] * light;
+}
+
+void trace_tile(Svo *svo, TraceCamera *camera, TraceView *view, TraceImage *image, u32 tile) {
+	u32 tiles_x = (image->width + TRACE_TILE - 1) / TRACE_TILE;
+	u32 x0 = (tile % tiles_x) * TRACE_TILE;
+	u32 y0 = (tile / tiles_x) * TRACE_TILE;
+	for (u32 y = y0; y < y0 + TRACE_TILE && y < image->height; y++) {
+		for (u32 x = x0; x < x0 + TRACE_TILE && x < image->width; x++) {
+			u32 i = twod_to_oned(x, y, image->width);
+			svo_raycast(svo, trace_pixel_ray(view, x, y), camera->max_distance, &image->hits[i]);
+
+			glm::vec3 color = trace_shade(&image->hits[i]);
+			image->pixels[i * 3 + 0] = (u8)(fminf(color.z, 1.0f) * 255.0f);
+			image->pixels[i * 3 + 1] = (u8)(fminf(color.y, 1.0f) * 255.0f);
+			image->pixels[i * 3 + 2] = (u8)(fminf(color.x, 1.0f) * 255.0f);
+		}
+	}
+}
+
+void trace_job(void *data) {
+	TraceJob *job = (TraceJob *)data;
+	u32 tiles_x = (job->image->width + TRACE_TILE - 1) / TRACE_TILE;
+	u32 num_tiles = tiles_x * ((job->image->height + TRACE_TILE - 1) / TRACE_TILE);
+	for (;;) {
+		u32 tile = __atomic_fetch_add(job->next_tile, 1, __ATOMIC_RELAXED);
+		if (tile >= num_tiles) {
+			break;
+		}
+		trace_tile(job->svo, job->camera, &job->view, job->image, tile);
+	}
+}
+
+TraceImage *trace_image_create(u32 width, u32 height) {
+	TraceImage *image = (TraceImage *)malloc(sizeof(TraceImage));
+	image->width = width;
+	image->height = height;
+	image->pixels = (u8 *)calloc(width * height, 3);
+	image->hits = (SvoHit *)calloc(width * height, sizeof(SvoHit));
+	return image;
+}
+
+void trace_image_free(TraceImage *image) {
+	free(image->pixels);
+	free(image->hits);
+	free(image);
+}
+
+// Renders the camera's view into image, one job per thread of sys, or on the calling thread when
+// the job table is full. Waits for every job on the system.
+void trace_render(JobSystem *sys, Svo *svo, TraceCamera *camera, TraceImage *image) {
+	u32 next_tile = 0;
+	u32 num_jobs = sys->num_threads < sys->max_jobs - sys->num_jobs ? sys->num_threads : sys->max_jobs - sys->num_jobs;
+	if (num_jobs == 0) {
+		TraceJob job;
+		job.svo = svo;
+		job.camera = camera;
+		job.view = trace_view(camera, image->width, image->height);
+		job.image = image;
+		job.next_tile = &next_tile;
+		trace_job(&job);
+		return;
+	}
+
+	TraceJob *jobs = (TraceJob *)calloc(num_jobs, sizeof(TraceJob));
+	for (u32 i = 0; i < num_jobs; i++) {
+		jobs[i].svo = svo;
+		jobs[i].camera = camera;
+		jobs[i].view = trace_view(camera, image->width, image->height);
+		jobs[i].image = image;
+		jobs[i].next_tile = &next_tile;
+		job_submit(sys, job_create(sys, trace_job, &jobs[i]));
+	}
+	job_system_wait(sys);
+	free(jobs);
+}
+
+void trace_write_tga(const char *filename, TraceImage *image) {
+	Image img;
+	img.width = image->width;
+	img.height = image->height;
+	img.bytes_per_pixel = 3;
+	img.data = image->pixels;
+	write_tga(filename, &img);
+}
+
+#endif
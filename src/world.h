@@ -0,0 +1,179 @@
+#ifndef WORLD_H
+#define WORLD_H
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "common.h"
+#include "point.h"
+#include "chunk.h"
+#include "jobs.h"
+
+// Per chunk stage timings in nanoseconds, indexed by chunk
+typedef struct WorldBuildTimes {
+	u64 *generate_ns;
+	u64 *hull_ns;
+	u64 *update_ns;
+} WorldBuildTimes;
+
+typedef struct ChunkJobData {
+	Chunk **chunks;
+	u32 chunk_idx;
+	WorldBuildTimes *times;
+} ChunkJobData;
+
+WorldBuildTimes *alloc_world_build_times() {
+	WorldBuildTimes *times = (WorldBuildTimes *)malloc(sizeof(WorldBuildTimes));
+	times->generate_ns = (u64 *)calloc(num_chunks, sizeof(u64));
+	times->hull_ns = (u64 *)calloc(num_chunks, sizeof(u64));
+	times->update_ns = (u64 *)calloc(num_chunks, sizeof(u64));
+	return times;
+}
+
+void free_world_build_times(WorldBuildTimes *times) {
+	free(times->generate_ns);
+	free(times->hull_ns);
+	free(times->update_ns);
+	free(times);
+}
+
+void generate_chunk_job(void *data) {
+	ChunkJobData *job = (ChunkJobData *)data;
+	Point cp = oned_to_twod(job->chunk_idx, num_x_chunks);
+
+	u64 start = get_time_ns();
+	job->chunks[job->chunk_idx] = generate_chunk(cp.x, cp.y);
+	if (job->times) {
+		job->times->generate_ns[job->chunk_idx] = get_time_ns() - start;
+	}
+}
+
+void hull_chunk_job(void *data) {
+	ChunkJobData *job = (ChunkJobData *)data;
+
+	link_chunk(job->chunks, job->chunk_idx);
+
+	u64 start = get_time_ns();
+	hull_chunk(job->chunks[job->chunk_idx]);
+	if (job->times) {
+		job->times->hull_ns[job->chunk_idx] = get_time_ns() - start;
+	}
+}
+
+void update_chunk_job(void *data) {
+	ChunkJobData *job = (ChunkJobData *)data;
+
+	u64 start = get_time_ns();
+	update_chunk(job->chunks[job->chunk_idx]);
+	if (job->times) {
+		job->times->update_ns[job->chunk_idx] = get_time_ns() - start;
+	}
+}
+
+// Generates, hulls and updates every chunk in order on the calling thread, times may be NULL
+void build_world(Chunk **chunks, WorldBuildTimes *times) {
+	ChunkJobData job;
+	job.chunks = chunks;
+	job.times = times;
+
+	for (u32 i = 0; i < num_chunks; i++) {
+		job.chunk_idx = i;
+		generate_chunk_job(&job);
+	}
+
+	for (u32 i = 0; i < num_chunks; i++) {
+		job.chunk_idx = i;
+		hull_chunk_job(&job);
+	}
+
+	for (u32 i = 0; i < num_chunks; i++) {
+		job.chunk_idx = i;
+		update_chunk_job(&job);
+	}
+}
+
+// Same result as build_world, run as a graph across the job system.
+// A hull waits on the generation of its chunk and its four neighbours, an update waits on its hull
+// and the hulls of its four neighbours: its ambient occlusion reads the diagonal chunks through
+// the neighbours' links, which their hull jobs set.
+void build_world_parallel(JobSystem *sys, Chunk **chunks, WorldBuildTimes *times) {
+	ChunkJobData *job_data = (ChunkJobData *)malloc(sizeof(ChunkJobData) * num_chunks);
+	Job **gen_jobs = (Job **)malloc(sizeof(Job *) * num_chunks);
+	Job **hull_jobs = (Job **)malloc(sizeof(Job *) * num_chunks);
+	Job **update_jobs = (Job **)malloc(sizeof(Job *) * num_chunks);
+
+	for (u32 i = 0; i < num_chunks; i++) {
+		job_data[i].chunks = chunks;
+		job_data[i].chunk_idx = i;
+		job_data[i].times = times;
+
+		gen_jobs[i] = job_create(sys, generate_chunk_job, &job_data[i]);
+		hull_jobs[i] = job_create(sys, hull_chunk_job, &job_data[i]);
+		update_jobs[i] = job_create(sys, update_chunk_job, &job_data[i]);
+	}
+
+	for (u32 i = 0; i < num_chunks; i++) {
+		Point cp = oned_to_twod(i, num_x_chunks);
+
+		job_depends_on(hull_jobs[i], gen_jobs[i]);
+		if (cp.x > 0) {
+			job_depends_on(hull_jobs[i], gen_jobs[twod_to_oned(cp.x - 1, cp.y, num_x_chunks)]);
+		}
+		if (cp.x < num_x_chunks - 1) {
+			job_depends_on(hull_jobs[i], gen_jobs[twod_to_oned(cp.x + 1, cp.y, num_x_chunks)]);
+		}
+		if (cp.y > 0) {
+			job_depends_on(hull_jobs[i], gen_jobs[twod_to_oned(cp.x, cp.y - 1, num_x_chunks)]);
+		}
+		if (cp.y < num_y_chunks - 1) {
+			job_depends_on(hull_jobs[i], gen_jobs[twod_to_oned(cp.x, cp.y + 1, num_x_chunks)]);
+		}
+
+		job_depends_on(update_jobs[i], hull_jobs[i]);
+		if (cp.x > 0) {
+			job_depends_on(update_jobs[i], hull_jobs[twod_to_oned(cp.x - 1, cp.y, num_x_chunks)]);
+		}
+		if (cp.x < num_x_chunks - 1) {
+			job_depends_on(update_jobs[i], hull_jobs[twod_to_oned(cp.x + 1, cp.y, num_x_chunks)]);
+		}
+		if (cp.y > 0) {
+			job_depends_on(update_jobs[i], hull_jobs[twod_to_oned(cp.x, cp.y - 1, num_x_chunks)]);
+		}
+		if (cp.y < num_y_chunks - 1) {
+			job_depends_on(update_jobs[i], hull_jobs[twod_to_oned(cp.x, cp.y + 1, num_x_chunks)]);
+		}
+	}
+
+	for (u32 i = 0; i < num_chunks; i++) {
+		job_submit(sys, gen_jobs[i]);
+		job_submit(sys, hull_jobs[i]);
+		job_submit(sys, update_jobs[i]);
+	}
+
+	job_system_wait(sys);
+
+	free(job_data);
+	free(gen_jobs);
+	free(hull_jobs);
+	free(update_jobs);
+}
+
+// True when both worlds hold the same blocks, hulls and instance data
+bool worlds_match(Chunk **a, Chunk **b) {
+	for (u32 i = 0; i < num_chunks; i++) {
+		if (a[i]->num_blocks != b[i]->num_blocks ||
+			memcmp(a[i]->real_blocks, b[i]->real_blocks, chunk_width * chunk_depth) ||
+			memcmp(a[i]->occupancy, b[i]->occupancy, sizeof(OccupancyColumn) * chunk_width * chunk_depth) ||
+			!storage_equal(a[i]->pre_render_list, b[i]->pre_render_list) ||
+			memcmp(a[i]->positions, b[i]->positions, sizeof(glm::vec3) * a[i]->num_blocks) ||
+			memcmp(a[i]->colors, b[i]->colors, sizeof(glm::vec3) * a[i]->num_blocks) ||
+			memcmp(a[i]->instances, b[i]->instances, sizeof(u32) * a[i]->num_blocks) ||
+			memcmp(a[i]->ao_bits, b[i]->ao_bits, AO_FACES * a[i]->num_blocks) ||
+			memcmp(a[i]->light_bits, b[i]->light_bits, AO_FACES * a[i]->num_blocks)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+#endif